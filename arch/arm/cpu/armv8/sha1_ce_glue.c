@@ -0,0 +1,33 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * SHA-1 using the ARMv8 Crypto Extensions, when the CPU has them
+ */
+
+#include <common.h>
+#include <asm/system.h>
+#include <u-boot/sha1.h>
+
+void sha1_ce_transform(uint32_t state[5], const uint8_t *src,
+		       uint32_t blocks);
+
+void sha1_process(sha1_context *ctx, const unsigned char *data,
+		  unsigned int blocks)
+{
+	uint32_t state[5];
+	int i;
+
+	if (!blocks)
+		return;
+
+	if (!(read_id_aa64isar0() & ID_AA64ISAR0_EL1_SHA1)) {
+		sha1_process_generic(ctx, data, blocks);
+		return;
+	}
+
+	/* the context holds the state as unsigned long */
+	for (i = 0; i < ARRAY_SIZE(state); i++)
+		state[i] = ctx->state[i];
+	sha1_ce_transform(state, data, blocks);
+	for (i = 0; i < ARRAY_SIZE(state); i++)
+		ctx->state[i] = state[i];
+}
@@ -0,0 +1,22 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * SHA-256 using the ARMv8 Crypto Extensions, when the CPU has them
+ */
+
+#include <common.h>
+#include <asm/system.h>
+#include <u-boot/sha256.h>
+
+void sha256_ce_transform(uint32_t state[8], const uint8_t *src,
+			 uint32_t blocks);
+
+void sha256_process(sha256_context *ctx, const uint8_t *data, uint32_t blocks)
+{
+	if (!blocks)
+		return;
+
+	if (read_id_aa64isar0() & ID_AA64ISAR0_EL1_SHA2)
+		sha256_ce_transform(ctx->state, data, blocks);
+	else
+		sha256_process_generic(ctx, data, blocks);
+}
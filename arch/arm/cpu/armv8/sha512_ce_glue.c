@@ -0,0 +1,27 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * SHA-512 using the ARMv8.2 SHA-512 instructions, when the CPU has them
+ */
+
+#include <common.h>
+#include <asm/system.h>
+#include <u-boot/sha512.h>
+
+void sha512_ce_transform(uint64_t state[8], const uint8_t *src,
+			 uint32_t blocks);
+
+void sha512_process(sha512_context *ctx, const uint8_t *data, uint32_t blocks)
+{
+	ulong sha2;
+
+	if (!blocks)
+		return;
+
+	/* a value of 2 means that SHA-512 is implemented as well as SHA-256 */
+	sha2 = (read_id_aa64isar0() & ID_AA64ISAR0_EL1_SHA2) >>
+		ID_AA64ISAR0_EL1_SHA2_SHIFT;
+	if (sha2 >= 2)
+		sha512_ce_transform(ctx->state, data, blocks);
+	else
+		sha512_process_generic(ctx, data, blocks);
+}
@@ -83,6 +83,14 @@
 #define HCR_EL2_RW_AARCH32	(0 << 31) /* Lower levels are AArch32         */
 #define HCR_EL2_HCD_DIS		(1 << 29) /* Hypervisor Call disabled         */
 
+/*
+ * ID_AA64ISAR0_EL1 bits definitions
+ */
+#define ID_AA64ISAR0_EL1_CRC32	(0xF << 16) /* CRC32, CRC32C instructions   */
+#define ID_AA64ISAR0_EL1_SHA2	(0xF << 12) /* SHA-256, SHA-512 (if 2)      */
+#define ID_AA64ISAR0_EL1_SHA2_SHIFT	12
+#define ID_AA64ISAR0_EL1_SHA1	(0xF << 8)  /* SHA-1 instructions           */
+
 /*
  * ID_AA64ISAR1_EL1 bits definitions
  */
@@ -200,6 +208,15 @@ static inline unsigned long read_mpidr(void)
 	return val;
 }
 
+static inline unsigned long read_id_aa64isar0(void)
+{
+	unsigned long val;
+
+	asm volatile("mrs %0, id_aa64isar0_el1" : "=r" (val));
+
+	return val;
+}
+
 #define BSP_COREID	0
 
 void __asm_flush_dcache_all(void);
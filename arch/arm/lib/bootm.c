@@ -13,10 +13,12 @@
 
 #include <common.h>
 #include <bootstage.h>
+#include <boottrace.h>
 #include <command.h>
 #include <cpu_func.h>
 #include <dm.h>
 #include <log.h>
+#include <mp_job.h>
 #include <asm/global_data.h>
 #include <dm/root.h>
 #include <env.h>
@@ -49,9 +51,10 @@ __weak void board_quiesce_devices(void)
 /**
  * announce_and_cleanup() - Print message and prepare for kernel boot
  *
+ * @images: images being booted
  * @fake: non-zero to do everything except actually boot
  */
-static void announce_and_cleanup(int fake)
+static void announce_and_cleanup(bootm_headers_t *images, int fake)
 {
 	bootstage_mark_name(BOOTSTAGE_ID_BOOTM_HANDOFF, "start_kernel");
 #ifdef CONFIG_BOOTSTAGE_FDT
@@ -60,12 +63,19 @@ static void announce_and_cleanup(int fake)
 #ifdef CONFIG_BOOTSTAGE_REPORT
 	bootstage_report();
 #endif
+#ifdef CONFIG_BOOTTRACE_STASH
+	if (boottrace_stash(images->ft_len ? images->ft_addr : NULL,
+			    CONFIG_BOOTTRACE_STASH_ADDR,
+			    CONFIG_BOOTTRACE_STASH_SIZE))
+		puts("boottrace: Failed to stash\n");
+#endif
 
 #ifdef CONFIG_USB_DEVICE
 	udc_disconnect();
 #endif
 
 	board_quiesce_devices();
+	mp_job_stop();
 
 	printf("\nStarting kernel ...%s\n\n", fake ?
 		"(fake run for tracing)" : "");
@@ -304,7 +314,7 @@ static void boot_jump_linux(bootm_headers_t *images, int flag)
 		(ulong) kernel_entry);
 	bootstage_mark(BOOTSTAGE_ID_RUN_OS);
 
-	announce_and_cleanup(fake);
+	announce_and_cleanup(images, fake);
 
 	if (!fake) {
 #ifdef CONFIG_ARMV8_PSCI
@@ -354,7 +364,7 @@ static void boot_jump_linux(bootm_headers_t *images, int flag)
 	debug("## Transferring control to Linux (at address %08lx)" \
 		"...\n", (ulong) kernel_entry);
 	bootstage_mark(BOOTSTAGE_ID_RUN_OS);
-	announce_and_cleanup(fake);
+	announce_and_cleanup(images, fake);
 
 	if (CONFIG_IS_ENABLED(OF_LIBFDT) && images->ft_len)
 		r2 = (unsigned long)images->ft_addr;
@@ -354,34 +354,34 @@ static int ft_fixup_atf(void *new_blob)
 	return ret;
 }
 
-static int disable_node_by_compatible(void *blob, const char *compatible,
-				      uint32_t *phandle)
+static int disable_node_by_compatible(struct fdt_batch *fb,
+				      const char *compatible, uint32_t *phandle)
 {
 	const char *node_name;
 	int nodeoff, ret;
 
-	nodeoff = fdt_node_offset_by_compatible(blob, -1, compatible);
+	nodeoff = fdt_batch_node_by_compatible(fb, -1, compatible);
 	if (nodeoff < 0) {
 		pr_err("Failed to get a node based on compatible string '%s' (%s)\n",
 		       compatible, fdt_strerror(nodeoff));
 		return nodeoff;
 	}
 
-	node_name = fdt_get_name(blob, nodeoff, NULL);
-	ret = fdt_set_node_status(blob, nodeoff, FDT_STATUS_DISABLED);
+	node_name = fdt_get_name(fb->fdt, nodeoff, NULL);
+	ret = fdt_batch_set_status(fb, nodeoff, FDT_STATUS_DISABLED);
 	if (ret) {
 		pr_err("Failed to disable '%s' node\n", node_name);
 		return ret;
 	}
 
-	*phandle = fdt_get_phandle(blob, nodeoff);
+	*phandle = fdt_get_phandle(fb->fdt, nodeoff);
 	if (!*phandle) {
 		pr_warn("The node '%s' is not referenced by any other nodes.",
 			node_name);
 		return 0;
 	}
 
-	ret = fdt_delprop(blob, nodeoff, "phandle");
+	ret = fdt_batch_delprop(fb, nodeoff, "phandle");
 	if (ret) {
 		pr_err("Failed to remove phandle property of '%s' node: %s\n",
 		       node_name, fdt_strerror(ret));
@@ -391,25 +391,33 @@ static int disable_node_by_compatible(void *blob, const char *compatible,
 	return 0;
 }
 
-static int enable_scmi_protocol(void *blob, const char *path, uint32_t phandle)
+static int enable_scmi_protocol(struct fdt_batch *fb, const char *path,
+				uint32_t phandle)
 {
 	int nodeoff, ret;
 
-	nodeoff = fdt_path_offset(blob, path);
+	nodeoff = fdt_batch_path_offset(fb, path);
 	if (nodeoff < 0) {
 		pr_err("Failed to get offset of '%s' node\n", path);
 		return nodeoff;
 	}
 
+	/*
+	 * The phandle is still on the node it is taken from until the batch
+	 * is applied, so fdt_set_phandle() cannot be used here
+	 */
 	if (phandle) {
-		ret = fdt_set_phandle(blob, nodeoff, phandle);
+		ret = fdt_batch_setprop_u32(fb, nodeoff, "phandle", phandle);
+		if (!ret)
+			ret = fdt_batch_setprop_u32(fb, nodeoff,
+						    "linux,phandle", phandle);
 		if (ret) {
 			pr_err("Failed to set phandle property of '%s' node\n", path);
 			return ret;
 		}
 	}
 
-	ret = fdt_set_node_status(blob, nodeoff, FDT_STATUS_OKAY);
+	ret = fdt_batch_set_status(fb, nodeoff, FDT_STATUS_OKAY);
 	if (ret) {
 		pr_err("Failed to enable '%s' node\n", path);
 		return ret;
@@ -418,23 +426,23 @@ static int enable_scmi_protocol(void *blob, const char *path, uint32_t phandle)
 	return 0;
 }
 
-static int enable_scmi_gpio_node(void *blob, uint32_t phandle)
+static int enable_scmi_gpio_node(struct fdt_batch *fb, uint32_t phandle)
 {
-	return enable_scmi_protocol(blob, scmi_gpio_node_path, phandle);
+	return enable_scmi_protocol(fb, scmi_gpio_node_path, phandle);
 }
 
-static int enable_scmi_nvmem_node(void *blob, uint32_t phandle)
+static int enable_scmi_nvmem_node(struct fdt_batch *fb, uint32_t phandle)
 {
-	return enable_scmi_protocol(blob, scmi_nvmem_node_path, phandle);
+	return enable_scmi_protocol(fb, scmi_nvmem_node_path, phandle);
 }
 
-static int disable_siul2_gpio_node(void *blob, uint32_t *phandle)
+static int disable_siul2_gpio_node(struct fdt_batch *fb, uint32_t *phandle)
 {
-	return disable_node_by_compatible(blob, s32cc_gpio_compatible,
+	return disable_node_by_compatible(fb, s32cc_gpio_compatible,
 					  phandle);
 }
 
-static int enable_scmi_gpio(void *blob)
+static int enable_scmi_gpio(struct fdt_batch *fb)
 {
 	ofnode node;
 	u32 phandle;
@@ -462,11 +470,11 @@ static int enable_scmi_gpio(void *blob)
 	if (ofnode_is_available(node))
 		return 0;
 
-	ret = disable_siul2_gpio_node(blob, &phandle);
+	ret = disable_siul2_gpio_node(fb, &phandle);
 	if (ret)
 		return ret;
 
-	ret = enable_scmi_gpio_node(blob, phandle);
+	ret = enable_scmi_gpio_node(fb, phandle);
 	if (ret)
 		return ret;
 
@@ -491,20 +499,20 @@ static int fdt_node_offset_by_prop_found(const void *fdt, int startoffset,
 	return offset; /* error from fdt_next_node() */
 }
 
-static int find_nvmem_scmi_node(void *blob, int *nodeoff,
+static int find_nvmem_scmi_node(struct fdt_batch *fb, int *nodeoff,
 				const u32 **phandles)
 {
 	int scmi_nvmem_nodeoff;
 	const u32 *scmi_nvmem_phandles;
 
-	scmi_nvmem_nodeoff = fdt_path_offset(blob, scmi_nvmem_node_path);
+	scmi_nvmem_nodeoff = fdt_batch_path_offset(fb, scmi_nvmem_node_path);
 	if (scmi_nvmem_nodeoff < 0) {
 		pr_err("Failed to get NVMEM SCMI node with path '%s' (%s)\n",
 		       scmi_nvmem_node_path, fdt_strerror(scmi_nvmem_nodeoff));
 		return scmi_nvmem_nodeoff;
 	}
 
-	scmi_nvmem_phandles = fdt_getprop(blob, scmi_nvmem_nodeoff,
+	scmi_nvmem_phandles = fdt_getprop(fb->fdt, scmi_nvmem_nodeoff,
 					  "nvmem-cells", NULL);
 	if (!scmi_nvmem_phandles) {
 		pr_err("Failed to get 'nvmem-cells' property of '%s' node\n",
@@ -555,10 +563,12 @@ static int find_nvmem_consumer_node(void *blob, int nodeoff_scmi, int *nodeoff,
 	return 0;
 }
 
-static int update_nvmem_consumer_phandles(void *blob, int nodeoff_consumer,
+static int update_nvmem_consumer_phandles(struct fdt_batch *fb,
+					  int nodeoff_consumer,
 					  int num_phandles, int nodeoff_scmi,
 					  const u32 *phandles_scmi)
 {
+	void *blob = fb->fdt;
 	int ret, i, idx;
 	const char *cell_name;
 	static u32 new_phandles[S32CC_MAX_NVMEM_CELLS_PER_NODE];
@@ -593,8 +603,8 @@ static int update_nvmem_consumer_phandles(void *blob, int nodeoff_consumer,
 		new_phandles[i] = phandles_scmi[idx];
 	}
 
-	ret = fdt_setprop_inplace(blob, nodeoff_consumer, "nvmem-cells",
-				  new_phandles, num_phandles * sizeof(u32));
+	ret = fdt_batch_setprop(fb, nodeoff_consumer, "nvmem-cells",
+				new_phandles, num_phandles * sizeof(u32));
 	if (ret) {
 		pr_err("Failed to update 'nvmem-cells' property of '%s' (%s)\n",
 		       fdt_get_name(blob, nodeoff_consumer, NULL),
@@ -605,12 +615,13 @@ static int update_nvmem_consumer_phandles(void *blob, int nodeoff_consumer,
 	return 0;
 }
 
-static int ft_fixup_scmi_nvmem(void *blob)
+static int ft_fixup_scmi_nvmem(struct fdt_batch *fb)
 {
 	int ret, nodeoff_scmi, nodeoff_consumer, num_phandles;
 	const u32 *phandles_scmi;
+	void *blob = fb->fdt;
 
-	ret = find_nvmem_scmi_node(blob, &nodeoff_scmi, &phandles_scmi);
+	ret = find_nvmem_scmi_node(fb, &nodeoff_scmi, &phandles_scmi);
 	if (ret)
 		return ret;
 
@@ -623,7 +634,7 @@ static int ft_fixup_scmi_nvmem(void *blob)
 						&nodeoff_consumer,
 						&num_phandles))) {
 		/* Update node NVMEM phandles to point to NVMEM SCMI cells */
-		ret = update_nvmem_consumer_phandles(blob, nodeoff_consumer,
+		ret = update_nvmem_consumer_phandles(fb, nodeoff_consumer,
 						     num_phandles, nodeoff_scmi,
 						     phandles_scmi);
 		if (ret)
@@ -637,11 +648,13 @@ static int ft_fixup_scmi_nvmem(void *blob)
 		return -EINVAL;
 	}
 
-	return enable_scmi_nvmem_node(blob, 0);
+	return enable_scmi_nvmem_node(fb, 0);
 }
 
-static bool apply_pfe_sgmii_phy_fixup(void *fdt, int nodeoff, u32 phy_addr)
+static bool apply_pfe_sgmii_phy_fixup(struct fdt_batch *fb, int nodeoff,
+				      u32 phy_addr)
 {
+	void *fdt = fb->fdt;
 	const char *phy_mode, *sgmii_mode;
 	int off, len = 0;
 	const u32 *php;
@@ -659,11 +672,11 @@ static bool apply_pfe_sgmii_phy_fixup(void *fdt, int nodeoff, u32 phy_addr)
 	if (!php || len != sizeof(*php))
 		return false;
 
-	off = fdt_node_offset_by_phandle(fdt, fdt32_to_cpu(*php));
+	off = fdt_batch_node_by_phandle(fb, fdt32_to_cpu(*php));
 	if (off < 0)
 		return false;
 
-	err = fdt_setprop_u32(fdt, off, "reg", phy_addr);
+	err = fdt_batch_setprop_u32(fb, off, "reg", phy_addr);
 	if (err) {
 		pr_err("failed to apply PFE SGMII PHY addr fixup (0x%x)\n",
 		       phy_addr);
@@ -673,8 +686,9 @@ static bool apply_pfe_sgmii_phy_fixup(void *fdt, int nodeoff, u32 phy_addr)
 	return true;
 }
 
-static void ft_fixup_enet_pfe(void *fdt)
+static void ft_fixup_enet_pfe(struct fdt_batch *fb)
 {
+	void *fdt = fb->fdt;
 	char phy_envname[32], *phy_addr_str;
 	const char *ifname;
 	int i, nlen = 0;
@@ -682,7 +696,7 @@ static void ft_fixup_enet_pfe(void *fdt)
 	char *ep = NULL;
 	int ret;
 
-	fdt_for_each_node_by_compatible(i, fdt, -1, s32g_pfe_compatible) {
+	fdt_batch_for_each_compatible(i, fb, s32g_pfe_compatible) {
 		ifname = fdt_getprop(fdt, i, "nxp,pfeng-if-name", &nlen);
 		if (!ifname || !nlen)
 			continue;
@@ -706,12 +720,52 @@ static void ft_fixup_enet_pfe(void *fdt)
 			continue;
 		}
 
-		if (apply_pfe_sgmii_phy_fixup(fdt, i, phy_addr))
+		if (apply_pfe_sgmii_phy_fixup(fb, i, phy_addr))
 			printf("   fixup: %s: update phy addr to 0x%lx\n",
 			       ifname, phy_addr);
 	}
 }
 
+/*
+ * These fixups only change properties, so they are queued and made in one
+ * pass. None of them depends on the hwconfig fixups, which add nodes.
+ */
+static int ft_fixup_props(void *blob)
+{
+	struct fdt_batch fb;
+	int ret;
+
+	ret = fdt_batch_init(&fb, blob);
+	if (ret) {
+		pr_err("Could not index device tree: %s\n", fdt_strerror(ret));
+		return ret;
+	}
+
+	if (CONFIG_IS_ENABLED(NXP_PFENG))
+		ft_fixup_enet_pfe(&fb);
+
+	if (CONFIG_IS_ENABLED(S32CC_SCMI_GPIO_FIXUP)) {
+		ret = enable_scmi_gpio(&fb);
+		if (ret)
+			goto out;
+	}
+
+	if (CONFIG_IS_ENABLED(S32CC_SCMI_NVMEM_FIXUP)) {
+		ret = ft_fixup_scmi_nvmem(&fb);
+		if (ret)
+			goto out;
+	}
+
+	ret = fdt_batch_apply(&fb);
+	if (ret)
+		pr_err("Could not apply device tree fixups: %s\n",
+		       fdt_strerror(ret));
+out:
+	fdt_batch_uninit(&fb);
+
+	return ret;
+}
+
 int ft_system_setup(void *blob, struct bd_info *bd)
 {
 	int ret;
@@ -748,24 +802,11 @@ int ft_system_setup(void *blob, struct bd_info *bd)
 	if (ret)
 		goto exit;
 
-	if (CONFIG_IS_ENABLED(NXP_PFENG))
-		ft_fixup_enet_pfe(blob);
-
-	ret = apply_fdt_hwconfig_fixups(blob);
+	ret = ft_fixup_props(blob);
 	if (ret)
 		goto exit;
 
-	if (CONFIG_IS_ENABLED(S32CC_SCMI_GPIO_FIXUP)) {
-		ret = enable_scmi_gpio(blob);
-		if (ret)
-			return ret;
-	}
-
-	if (CONFIG_IS_ENABLED(S32CC_SCMI_NVMEM_FIXUP)) {
-		ret = ft_fixup_scmi_nvmem(blob);
-		if (ret)
-			return ret;
-	}
+	ret = apply_fdt_hwconfig_fixups(blob);
 exit:
 	return ret;
 }
@@ -5,12 +5,22 @@
  */
 
 #include <common.h>
+#include <cpu_func.h>
 #include <fdt_support.h>
+#include <log.h>
 #include <malloc.h>
+#include <memalign.h>
+#include <mp_job.h>
+#include <time.h>
+#include <asm/global_data.h>
+#include <asm/system.h>
 #include <dm/uclass.h>
 #include <linux/psci.h>
+#include <linux/sizes.h>
 #include <s32-cc/fdt_wrapper.h>
 
+DECLARE_GLOBAL_DATA_PTR;
+
 #define CLUSTER_SHIFT	8U
 #define CLUSTER_MASK	GENMASK(11, CLUSTER_SHIFT)
 
@@ -179,6 +189,8 @@ int cpu_release(u32 nr, int argc, char * const argv[])
 	cpu = get_cpu(nr);
 	if (!cpu)
 		return -EINVAL;
+	if (cpu->on)
+		return -EBUSY;
 
 	boot_addr = simple_strtoull(argv[0], NULL, 16);
 
@@ -193,3 +205,162 @@ int cpu_release(u32 nr, int argc, char * const argv[])
 
 	return 0;
 }
+
+#if CONFIG_IS_ENABLED(MP_JOB)
+
+#define S32_MP_JOB_STACK_SIZE	SZ_32K
+#define S32_MP_JOB_OFF_TIMEOUT	100	/* ms */
+
+/*
+ * Start-up state for a core running jobs. The first fields are used by
+ * s32_mp_job_entry() with the MMU off, so keep them in sync with
+ * mp_job_entry.S.
+ */
+struct s32_mp_boot {
+	u64 sp;
+	u64 gd_ptr;
+	u64 vbar;
+	u64 mair;
+	u64 tcr;
+	u64 ttbr;
+	u64 sctlr;
+	struct mp_worker *worker;
+	struct cpu_desc *cpu;
+	void *stack;
+};
+
+#define read_sysreg_el(reg, el) ({					\
+	u64 __val;							\
+	if ((el) == 2)							\
+		asm volatile("mrs %0, " #reg "_el2" : "=r" (__val));	\
+	else								\
+		asm volatile("mrs %0, " #reg "_el1" : "=r" (__val));	\
+	__val;								\
+})
+
+void s32_mp_job_entry(void);
+void s32_mp_job_main(struct s32_mp_boot *boot);
+
+void s32_mp_job_main(struct s32_mp_boot *boot)
+{
+	mp_job_worker(boot->worker);
+
+	/* This only returns on failure, leaving the core in wfi */
+	invoke_psci_fn(PSCI_0_2_FN_CPU_OFF, 0, 0, 0);
+}
+
+static void s32_mp_boot_free(struct s32_mp_boot *boot)
+{
+	free(boot->stack);
+	free(boot);
+}
+
+static struct s32_mp_boot *s32_mp_boot_alloc(struct mp_worker *worker,
+					     struct cpu_desc *cpu)
+{
+	unsigned int el = current_el();
+	struct s32_mp_boot *boot;
+
+	boot = malloc_cache_aligned(ALIGN(sizeof(*boot), ARCH_DMA_MINALIGN));
+	if (!boot)
+		return NULL;
+	boot->stack = malloc(S32_MP_JOB_STACK_SIZE);
+	if (!boot->stack) {
+		free(boot);
+		return NULL;
+	}
+
+	boot->sp = ALIGN_DOWN((ulong)boot->stack + S32_MP_JOB_STACK_SIZE, 16);
+	boot->gd_ptr = (ulong)gd;
+	boot->vbar = read_sysreg_el(vbar, el);
+	boot->mair = read_sysreg_el(mair, el);
+	boot->tcr = read_sysreg_el(tcr, el);
+	boot->ttbr = read_sysreg_el(ttbr0, el);
+	boot->sctlr = get_sctlr();
+	boot->worker = worker;
+	boot->cpu = cpu;
+
+	/* The core reads this before turning on its MMU and caches */
+	flush_dcache_range((ulong)boot,
+			   (ulong)boot + ALIGN(sizeof(*boot), ARCH_DMA_MINALIGN));
+
+	return boot;
+}
+
+int arch_mp_job_start(struct mp_worker *workers, int max)
+{
+	struct s32_mp_boot *boot;
+	unsigned long psci_ret;
+	struct cpu_desc *cpu;
+	struct udevice *dev;
+	int i, count = 0;
+
+	if (uclass_get_device_by_name(UCLASS_FIRMWARE, "psci", &dev) ||
+	    initialize_cpus_data())
+		return 0;
+
+	for (i = 0; i < n_cpus && count < max; i++) {
+		cpu = get_cpu(i);
+		/* Skip the boot core and any released by 'cpu N release' */
+		if (cpu->on)
+			continue;
+
+		boot = s32_mp_boot_alloc(&workers[count], cpu);
+		if (!boot)
+			break;
+
+		psci_ret = invoke_psci_fn(PSCI_0_2_FN64_CPU_ON, cpu->psci_id,
+					  (ulong)s32_mp_job_entry, (ulong)boot);
+		if (psci_ret) {
+			log_debug("Cannot start CPU %d: %ld\n", i,
+				  (long)psci_ret);
+			s32_mp_boot_free(boot);
+			continue;
+		}
+
+		cpu->on = true;
+		workers[count].priv = boot;
+		count++;
+	}
+
+	return count;
+}
+
+void arch_mp_job_stop(struct mp_worker *workers, int count)
+{
+	struct s32_mp_boot *boot;
+	unsigned long state;
+	ulong start;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		boot = workers[i].priv;
+		start = get_timer(0);
+		do {
+			state = invoke_psci_fn(PSCI_0_2_FN64_AFFINITY_INFO,
+					       boot->cpu->psci_id, 0, 0);
+		} while (state != PSCI_0_2_AFFINITY_LEVEL_OFF &&
+			 get_timer(start) < S32_MP_JOB_OFF_TIMEOUT);
+
+		/* Leave the memory alone if the core may still be using it */
+		if (state != PSCI_0_2_AFFINITY_LEVEL_OFF) {
+			log_err("CPU %#x did not power off\n",
+				boot->cpu->psci_id);
+			continue;
+		}
+		boot->cpu->on = false;
+		s32_mp_boot_free(boot);
+	}
+}
+
+void arch_mp_job_idle(void)
+{
+	asm volatile("wfe" : : : "memory");
+}
+
+void arch_mp_job_notify(void)
+{
+	asm volatile("dsb ishst\n\tsev" : : : "memory");
+}
+
+#endif
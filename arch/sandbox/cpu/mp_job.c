@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Sandbox support for running jobs on secondary CPUs, using host threads
+ *
+ * Copyright 2023 NXP
+ */
+
+#include <common.h>
+#include <mp_job.h>
+#include <os.h>
+
+static void *sandbox_mp_job_thread(void *arg)
+{
+	mp_job_worker(arg);
+
+	return NULL;
+}
+
+int arch_mp_job_start(struct mp_worker *workers, int max)
+{
+	int i;
+
+	for (i = 0; i < max; i++) {
+		if (os_thread_create(&workers[i].priv, sandbox_mp_job_thread,
+				     &workers[i]))
+			break;
+	}
+
+	return i;
+}
+
+void arch_mp_job_stop(struct mp_worker *workers, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		/* Don't hang on a thread which is stuck in a job */
+		if (!__atomic_load_n(&workers[i].running, __ATOMIC_ACQUIRE))
+			os_thread_join(workers[i].priv);
+	}
+}
+
+void arch_mp_job_idle(void)
+{
+	os_usleep(50);
+}
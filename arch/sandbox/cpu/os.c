@@ -9,6 +9,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
+#include <pthread.h>
 #include <setjmp.h>
 #include <signal.h>
 #include <stdio.h>
@@ -400,6 +401,40 @@ void os_usleep(unsigned long usec)
 	usleep(usec);
 }
 
+int os_thread_create(void **threadp, void *(*func)(void *arg), void *arg)
+{
+	sigset_t set, old;
+	pthread_t *thread;
+	int ret;
+
+	thread = os_malloc(sizeof(*thread));
+	if (!thread)
+		return -ENOMEM;
+
+	/* Leave signals to the main thread */
+	sigfillset(&set);
+	pthread_sigmask(SIG_SETMASK, &set, &old);
+	ret = pthread_create(thread, NULL, func, arg);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (ret) {
+		os_free(thread);
+		return -ret;
+	}
+	*threadp = thread;
+
+	return 0;
+}
+
+int os_thread_join(void *thread)
+{
+	int ret;
+
+	ret = pthread_join(*(pthread_t *)thread, NULL);
+	os_free(thread);
+
+	return -ret;
+}
+
 uint64_t __attribute__((no_instrument_function)) os_get_nsec(void)
 {
 #if defined(CLOCK_MONOTONIC) && defined(_POSIX_MONOTONIC_CLOCK)
@@ -409,6 +409,15 @@ static int sandbox_cmdline_cb_autoboot_keyed(struct sandbox_state *state,
 }
 SANDBOX_CMDLINE_OPT(autoboot_keyed, 0, "Allow keyed autoboot");
 
+static int sandbox_cmdline_cb_boottrace(struct sandbox_state *state,
+					const char *arg)
+{
+	state->boottrace_fname = arg;
+
+	return 0;
+}
+SANDBOX_CMDLINE_OPT(boottrace, 1, "Write boot timeline to file on exit");
+
 static void setup_ram_buf(struct sandbox_state *state)
 {
 	/* Zero the RAM buffer if we didn't read it, to keep valgrind happy */
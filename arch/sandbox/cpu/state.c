@@ -6,6 +6,7 @@
 #include <common.h>
 #include <autoboot.h>
 #include <bloblist.h>
+#include <boottrace.h>
 #include <errno.h>
 #include <fdtdec.h>
 #include <log.h>
@@ -417,6 +418,26 @@ int state_init(void)
 	return 0;
 }
 
+#if CONFIG_IS_ENABLED(BOOTTRACE)
+static int write_boottrace(const char *fname)
+{
+	size_t size;
+	void *buf;
+	int ret;
+
+	boottrace_export(NULL, 0, &size);
+	buf = os_malloc(size);
+	if (!buf)
+		return -ENOMEM;
+	ret = boottrace_export(buf, size, &size);
+	if (!ret)
+		ret = os_write_file(fname, buf, size);
+	os_free(buf);
+
+	return ret;
+}
+#endif
+
 int state_uninit(void)
 {
 	int err;
@@ -435,6 +456,14 @@ int state_uninit(void)
 		}
 	}
 
+#if CONFIG_IS_ENABLED(BOOTTRACE)
+	if (state->boottrace_fname) {
+		err = write_boottrace(state->boottrace_fname);
+		if (err)
+			printf("Failed to write boot trace\n");
+	}
+#endif
+
 	if (state->write_state) {
 		if (sandbox_write_state(state, state->state_fname)) {
 			printf("Failed to write sandbox state\n");
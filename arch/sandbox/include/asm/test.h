@@ -211,6 +211,55 @@ void sandbox_set_allow_beep(struct udevice *dev, bool allow);
  */
 int sandbox_get_beep_frequency(struct udevice *dev);
 
+/**
+ * sandbox_mmc_set_cqe() - Set up the command queue of a sandbox MMC
+ *
+ * The emulated card is an SD card, so this pretends that it reported a
+ * command queue. The maximum transfer size is also set, to make reads use
+ * more tasks.
+ *
+ * @dev: MMC device to change
+ * @depth: Command queue depth to report, 0 to disable the queue
+ * @b_max: Maximum number of blocks in each transfer
+ */
+void sandbox_mmc_set_cqe(struct udevice *dev, uint depth, uint b_max);
+
+/**
+ * sandbox_nvme_hold_io() - Stop a sandbox NVMe controller completing I/O
+ *
+ * While held, I/O commands are accepted but never completed, as if the
+ * controller had hung.
+ *
+ * @dev: NVMe device to change
+ * @hold: true to hold I/O commands, false to carry them out
+ */
+void sandbox_nvme_hold_io(struct udevice *dev, bool hold);
+
+/**
+ * sandbox_nvme_get_io_resets() - Get the number of I/O queue deletions
+ *
+ * @dev: NVMe device to check
+ * Return: number of times the I/O submission queue has been deleted
+ */
+int sandbox_nvme_get_io_resets(struct udevice *dev);
+
+/**
+ * sandbox_mmc_get_cqe_tasks() - Get the number of queued tasks completed
+ *
+ * @dev: MMC device to check
+ * Return: number of command queue tasks completed since the device was probed
+ */
+uint sandbox_mmc_get_cqe_tasks(struct udevice *dev);
+
+/**
+ * sandbox_mmc_get_cqe_enables() - Get the number of times the queue was enabled
+ *
+ * @dev: MMC device to check
+ * Return: number of times the command queue was enabled since the device was
+ *	probed
+ */
+uint sandbox_mmc_get_cqe_enables(struct udevice *dev);
+
 /**
  * sandbox_spi_get_speed() - Get current speed setting of a sandbox spi bus
  *
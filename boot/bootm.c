@@ -683,6 +683,11 @@ int do_bootm_states(struct cmd_tbl *cmdtp, int flag, int argc,
 	if (!ret && (states & BOOTM_STATE_FINDOTHER))
 		ret = bootm_find_other(cmdtp, flag, argc, argv);
 
+	/* All images are found, so hashes started for them are not needed */
+	if (CONFIG_IS_ENABLED(FIT) &&
+	    (states & (BOOTM_STATE_FINDOS | BOOTM_STATE_FINDOTHER)))
+		fit_image_hash_drop();
+
 	/* Load the OS */
 	if (!ret && (states & BOOTM_STATE_LOADOS)) {
 		iflag = bootm_disable_interrupts();
@@ -0,0 +1,820 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Streaming loader for FIT images with external data
+ *
+ * The FDT part of the FIT is read into memory, then the data of each image
+ * is read in chunks. Each chunk is hashed and decompressed as it arrives,
+ * so the image is read from storage once and written straight to its load
+ * address. The output is wiped again if the hashes turn out to be bad.
+ */
+
+#define LOG_CATEGORY LOGC_BOOT
+
+#include <common.h>
+#include <blk.h>
+#include <errno.h>
+#include <fs.h>
+#include <gzip.h>
+#include <hash.h>
+#include <image.h>
+#include <log.h>
+#include <malloc.h>
+#include <mapmem.h>
+#include <memalign.h>
+#include <watchdog.h>
+#include <asm/global_data.h>
+#include <linux/kernel.h>
+#include <linux/sizes.h>
+#include <linux/zstd.h>
+#include <u-boot/zlib.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+#ifndef CONFIG_SYS_BOOTM_LEN
+/* use 8MByte as default max gunzip size */
+#define CONFIG_SYS_BOOTM_LEN	0x800000
+#endif
+
+/* Maximum number of hash nodes checked for an image */
+#define FIT_STREAM_MAX_HASHES	4
+
+/* Chunk size for data already in memory, small enough to stay in cache */
+#define FIT_STREAM_MEM_CHUNK	SZ_64K
+
+/**
+ * struct fit_stream_hash - progressive hash of an image
+ *
+ * @algo:	Hash algorithm
+ * @ctx:	Hash context
+ * @noffset:	Offset of the hash node
+ */
+struct fit_stream_hash {
+	struct hash_algo *algo;
+	void *ctx;
+	int noffset;
+};
+
+static long fit_stream_read_mem(struct fit_stream *st, ulong offset,
+				void *buf, ulong size)
+{
+	memcpy(buf, st->priv + offset, size);
+
+	return size;
+}
+
+void fit_stream_init_mem(struct fit_stream *st, const void *buf)
+{
+	memset(st, '\0', sizeof(*st));
+	st->read = fit_stream_read_mem;
+	st->priv = (void *)buf;
+	st->chunk_size = CONFIG_FIT_STREAM_CHUNK_SIZE;
+}
+
+static long fit_stream_read_blk(struct fit_stream *st, ulong offset,
+				void *buf, ulong size)
+{
+	struct blk_desc *desc = st->blk;
+	ulong blksz = desc->blksz;
+	ulong done = 0;
+
+	while (done < size) {
+		lbaint_t lba = st->start + offset / blksz;
+		ulong skip = offset % blksz;
+		ulong len;
+
+		if (skip || size - done < blksz) {
+			/* partial block, read it via the bounce buffer */
+			if (!st->priv) {
+				st->priv = malloc_cache_aligned(blksz);
+				if (!st->priv)
+					return -ENOMEM;
+			}
+			if (blk_dread(desc, lba, 1, st->priv) != 1)
+				return -EIO;
+			len = min(blksz - skip, size - done);
+			memcpy(buf + done, st->priv + skip, len);
+		} else {
+			lbaint_t blkcnt = (size - done) / blksz;
+
+			if (blk_dread(desc, lba, blkcnt, buf + done) != blkcnt)
+				return -EIO;
+			len = blkcnt * blksz;
+		}
+		done += len;
+		offset += len;
+	}
+
+	return done;
+}
+
+void fit_stream_init_blk(struct fit_stream *st, struct blk_desc *desc,
+			 ulong start)
+{
+	memset(st, '\0', sizeof(*st));
+	st->read = fit_stream_read_blk;
+	st->blk = desc;
+	st->start = start;
+	st->chunk_size = CONFIG_FIT_STREAM_CHUNK_SIZE;
+}
+
+static long fit_stream_read_fs(struct fit_stream *st, ulong offset,
+			       void *buf, ulong size)
+{
+	loff_t actread;
+	int ret;
+
+	/* fs_read() closes the device, so select it again each time */
+	ret = fs_set_blk_dev(st->ifname, st->dev_part, FS_TYPE_ANY);
+	if (ret)
+		return -ENODEV;
+	ret = fs_read(st->filename, map_to_sysmem(buf), offset, size,
+		      &actread);
+	if (ret)
+		return -EIO;
+
+	return actread;
+}
+
+void fit_stream_init_fs(struct fit_stream *st, const char *ifname,
+			const char *dev_part, const char *filename)
+{
+	memset(st, '\0', sizeof(*st));
+	st->read = fit_stream_read_fs;
+	st->ifname = ifname;
+	st->dev_part = dev_part;
+	st->filename = filename;
+	st->chunk_size = CONFIG_FIT_STREAM_CHUNK_SIZE;
+}
+
+static int fit_stream_read(struct fit_stream *st, ulong offset, void *buf,
+			   ulong size)
+{
+	long ret;
+
+	ret = st->read(st, offset, buf, size);
+	if (ret < 0)
+		return ret;
+	if (ret != size)
+		return -EIO;
+
+	return 0;
+}
+
+int fit_stream_open(struct fit_stream *st)
+{
+	struct fdt_header hdr;
+	ulong size;
+	int ret;
+
+	ret = fit_stream_read(st, 0, &hdr, sizeof(hdr));
+	if (ret)
+		return ret;
+	if (fdt_check_header(&hdr))
+		return -ENOEXEC;
+
+	size = fdt_totalsize(&hdr);
+	st->fit = malloc(size);
+	if (!st->fit)
+		return -ENOMEM;
+	ret = fit_stream_read(st, 0, st->fit, size);
+	if (ret)
+		goto err;
+	ret = fit_check_format(st->fit, size);
+	if (ret)
+		goto err;
+
+	return 0;
+err:
+	free(st->fit);
+	st->fit = NULL;
+
+	return ret;
+}
+
+void fit_stream_close(struct fit_stream *st)
+{
+	free(st->fit);
+	st->fit = NULL;
+	if (st->blk) {
+		free(st->priv);
+		st->priv = NULL;
+	}
+}
+
+/**
+ * fit_stream_need_buffer() - check if an image must be verified in one piece
+ *
+ * Signatures are checked over the whole of the data, as are hashes with
+ * algorithms that have no progressive support.
+ *
+ * @fit:	FIT to check
+ * @noffset:	Offset of the image node
+ * Return: true if the data must be read into memory before it is checked
+ */
+static bool fit_stream_need_buffer(const void *fit, int noffset)
+{
+	const void *blob = gd_fdt_blob();
+	int node;
+
+	if (FIT_IMAGE_ENABLE_VERIFY && blob) {
+		int sig_node = fdt_subnode_offset(blob, 0, FIT_SIG_NODENAME);
+
+		fdt_for_each_subnode(node, blob, sig_node) {
+			const char *required;
+
+			required = fdt_getprop(blob, node, FIT_KEY_REQUIRED,
+					       NULL);
+			if (required && !strcmp(required, "image"))
+				return true;
+		}
+	}
+
+	fdt_for_each_subnode(node, fit, noffset) {
+		const char *name = fit_get_name(fit, node, NULL);
+		struct hash_algo *algo;
+		const char *algo_name;
+
+		if (!strncmp(name, FIT_SIG_NODENAME,
+			     strlen(FIT_SIG_NODENAME)))
+			return true;
+		if (strncmp(name, FIT_HASH_NODENAME,
+			    strlen(FIT_HASH_NODENAME)))
+			continue;
+		if (fit_image_hash_get_algo(fit, node, &algo_name))
+			return true;
+		/*
+		 * The progressive crc32 result is in CPU order, unlike
+		 * calculate_hash(), so only stream the SHA algorithms
+		 */
+		if (strncmp(algo_name, "sha", 3) ||
+		    hash_progressive_lookup_algo(algo_name, &algo))
+			return true;
+	}
+
+	return false;
+}
+
+static void fit_stream_hash_abort(struct fit_stream_hash *hashes, int count)
+{
+	uint8_t value[FIT_MAX_HASH_LEN];
+	int i;
+
+	for (i = 0; i < count; i++)
+		hashes[i].algo->hash_finish(hashes[i].algo, hashes[i].ctx,
+					    value, sizeof(value));
+}
+
+static int fit_stream_hash_init(const void *fit, int noffset,
+				struct fit_stream_hash *hashes)
+{
+	int count = 0;
+	int node;
+
+	fdt_for_each_subnode(node, fit, noffset) {
+		const char *name = fit_get_name(fit, node, NULL);
+		struct fit_stream_hash *hash;
+		const fdt32_t *ignore;
+		const char *algo_name;
+
+		if (strncmp(name, FIT_HASH_NODENAME,
+			    strlen(FIT_HASH_NODENAME)))
+			continue;
+		ignore = fdt_getprop(fit, node, FIT_IGNORE_PROP, NULL);
+		if (ignore && fdt32_to_cpu(*ignore))
+			continue;
+		if (count == FIT_STREAM_MAX_HASHES) {
+			log_err("Too many hash nodes\n");
+			fit_stream_hash_abort(hashes, count);
+			return -E2BIG;
+		}
+		hash = &hashes[count];
+		fit_image_hash_get_algo(fit, node, &algo_name);
+		hash_progressive_lookup_algo(algo_name, &hash->algo);
+		if (hash->algo->hash_init(hash->algo, &hash->ctx)) {
+			fit_stream_hash_abort(hashes, count);
+			return -ENOMEM;
+		}
+		hash->noffset = node;
+		count++;
+	}
+
+	return count;
+}
+
+static int fit_stream_hash_update(struct fit_stream_hash *hashes, int count,
+				  const void *buf, ulong size, bool last)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		struct fit_stream_hash *hash = &hashes[i];
+
+		if (hash->algo->hash_update(hash->algo, hash->ctx, buf, size,
+					    last))
+			return -EIO;
+	}
+
+	return 0;
+}
+
+/**
+ * fit_stream_hash_finish() - finish the hashes and check their values
+ *
+ * This frees all hash contexts, including those after a failed one.
+ *
+ * Return: 0 if OK, -EBADMSG if a hash value did not match
+ */
+static int fit_stream_hash_finish(const void *fit,
+				  struct fit_stream_hash *hashes, int count)
+{
+	int ret = 0;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		struct fit_stream_hash *hash = &hashes[i];
+		uint8_t value[FIT_MAX_HASH_LEN];
+		uint8_t *fit_value;
+		int fit_value_len;
+
+		if (hash->algo->hash_finish(hash->algo, hash->ctx, value,
+					    sizeof(value))) {
+			ret = -EIO;
+			continue;
+		}
+		printf("%s", hash->algo->name);
+		if (fit_image_hash_get_value(fit, hash->noffset, &fit_value,
+					     &fit_value_len) ||
+		    fit_value_len != hash->algo->digest_size ||
+		    memcmp(value, fit_value, fit_value_len)) {
+			printf("- ");
+			ret = -EBADMSG;
+			continue;
+		}
+		printf("+ ");
+	}
+
+	return ret;
+}
+
+/**
+ * fit_stream_can_decomp() - check if data can be decompressed as it arrives
+ *
+ * @comp:	Compression of the image (IH_COMP_...)
+ * Return: true if the data can be passed to the decompressor in chunks
+ */
+static bool fit_stream_can_decomp(int comp)
+{
+	return comp == IH_COMP_NONE ||
+	       (comp == IH_COMP_GZIP && CONFIG_IS_ENABLED(GZIP)) ||
+	       (comp == IH_COMP_ZSTD && CONFIG_IS_ENABLED(ZSTD));
+}
+
+/**
+ * struct fit_stream_out - decompressor fed with each chunk once it is hashed
+ *
+ * @comp:	Compression of the data (IH_COMP_...)
+ * @dst:	Output buffer
+ * @size:	Size of @dst
+ * @len:	Number of bytes of @dst written so far, which are wiped if the
+ *		data turns out to be bad
+ * @started:	true once the decompressor is set up
+ * @ended:	true once the end of the gzip data has been seen
+ * @s:		zlib stream, for gzip
+ * @zs:		zstd stream
+ */
+struct fit_stream_out {
+	int comp;
+	void *dst;
+	ulong size;
+	ulong len;
+	bool started;
+	bool ended;
+	z_stream s;
+	struct zstd_stream zs;
+};
+
+/**
+ * fit_stream_inflate() - pass a chunk of gzip data to the decompressor
+ *
+ * @s:		zlib stream, with output set up
+ * @buf:	Chunk of compressed data
+ * @size:	Size of chunk
+ * Return: 1 when the end of the compressed data is reached, 0 if more is
+ *	needed, -ve on error
+ */
+static int fit_stream_inflate(z_stream *s, const void *buf, ulong size)
+{
+	int r;
+
+	if (!size)
+		return 0;
+	s->next_in = (void *)buf;
+	s->avail_in = size;
+	do {
+		r = inflate(s, Z_SYNC_FLUSH);
+		if (r == Z_STREAM_END)
+			return 1;
+		if (!s->avail_out) {
+			log_err("Image too large: increase CONFIG_SYS_BOOTM_LEN\n");
+			return -ENOSPC;
+		}
+		if (r != Z_OK) {
+			log_err("inflate() returned %d\n", r);
+			return -EIO;
+		}
+	} while (s->avail_in);
+
+	return 0;
+}
+
+static int fit_stream_out_feed(struct fit_stream_out *out, const void *buf,
+			       ulong size)
+{
+	int hdr, ret;
+
+	switch (out->comp) {
+	case IH_COMP_NONE:
+		if (size > out->size - out->len)
+			return -ENOSPC;
+		if (buf != out->dst + out->len)
+			memcpy(out->dst + out->len, buf, size);
+		out->len += size;
+		return 0;
+	case IH_COMP_ZSTD:
+		if (!out->started) {
+			ret = zstd_stream_init(&out->zs, out->dst, out->size);
+			if (ret)
+				return ret;
+			out->started = true;
+		}
+		ret = zstd_stream_feed(&out->zs, buf, size);
+		out->len = out->zs.pos;
+		if (ret == -ENOSPC)
+			log_err("Image too large: increase CONFIG_SYS_BOOTM_LEN\n");
+		/* a block which failed may have been partly written */
+		if (ret)
+			out->len = min_t(ulong, out->size,
+					 out->len + ZSTD_BLOCKSIZE_ABSOLUTEMAX);
+		return ret;
+	case IH_COMP_GZIP:
+		if (out->ended)
+			return 0;
+		if (!out->started) {
+			hdr = gzip_parse_header(buf, size);
+			memset(&out->s, '\0', sizeof(out->s));
+			out->s.zalloc = gzalloc;
+			out->s.zfree = gzfree;
+			out->s.next_out = out->dst;
+			out->s.avail_out = out->size;
+			if (hdr < 0 ||
+			    inflateInit2(&out->s, -MAX_WBITS) != Z_OK) {
+				log_err("Bad gzip header\n");
+				return -EINVAL;
+			}
+			out->started = true;
+			buf += hdr;
+			size -= hdr;
+		}
+		ret = fit_stream_inflate(&out->s, buf, size);
+		out->len = out->s.total_out;
+		if (ret < 0)
+			return ret;
+		out->ended = ret;
+		return 0;
+	}
+
+	return -ENOSYS;
+}
+
+/**
+ * fit_stream_out_finish() - finish decompressing
+ *
+ * This releases the decompressor, so must be called even after an error.
+ *
+ * Return: length of the output, or -ve if the compressed data was cut short
+ */
+static long fit_stream_out_finish(struct fit_stream_out *out)
+{
+	bool started = out->started;
+
+	out->started = false;
+	switch (out->comp) {
+	case IH_COMP_ZSTD:
+		if (!started)
+			return -EINVAL;
+		return zstd_stream_finish(&out->zs);
+	case IH_COMP_GZIP:
+		if (started)
+			inflateEnd(&out->s);
+		if (!out->ended) {
+			log_err("Truncated gzip data\n");
+			return -EINVAL;
+		}
+		return out->s.total_out;
+	}
+
+	return out->len;
+}
+
+/**
+ * fit_stream_load_chunks() - hash and decompress the data of an image
+ *
+ * Each chunk is passed to the hash algorithms of the image just after it is
+ * read, then to the decompressor while it is still in cache, so the data is
+ * only walked once. The output is wiped again if the data turns out to be
+ * bad, or cannot be decompressed. Data in memory is used where it is.
+ *
+ * @st:		Stream to read from
+ * @noffset:	Offset of the image node
+ * @pos:	Position of the data within the stream
+ * @size:	Size of the data
+ * @comp:	Compression of the image (IH_COMP_...)
+ * @dst:	Buffer for the output
+ * @dst_size:	Size of @dst
+ * @lenp:	Returns length of the output
+ * Return: 0 if OK, -EBADMSG if a hash value did not match, other -ve on
+ *	error
+ */
+static int fit_stream_load_chunks(struct fit_stream *st, int noffset,
+				  ulong pos, ulong size, int comp, void *dst,
+				  ulong dst_size, ulong *lenp)
+{
+	struct fit_stream_hash hashes[FIT_STREAM_MAX_HASHES];
+	bool mem = st->read == fit_stream_read_mem;
+	ulong chunk = st->chunk_size;
+	struct fit_stream_out out;
+	int dec_ret = 0;
+	void *buf = NULL;
+	long out_len;
+	ulong done;
+	int count;
+	int ret;
+
+	memset(&out, '\0', sizeof(out));
+	out.comp = comp;
+	out.dst = dst;
+	out.size = dst_size;
+	if (comp == IH_COMP_NONE && size > dst_size)
+		return -ENOSPC;
+
+	count = fit_stream_hash_init(st->fit, noffset, hashes);
+	if (count < 0)
+		return count;
+
+	/* compressed data read from storage needs a place of its own */
+	if (comp != IH_COMP_NONE && !mem) {
+		buf = malloc(chunk);
+		if (!buf) {
+			fit_stream_hash_abort(hashes, count);
+			return -ENOMEM;
+		}
+	}
+
+	for (done = 0; done < size; done += chunk) {
+		ulong len = min(chunk, size - done);
+		void *ptr;
+
+		WATCHDOG_RESET();
+		if (mem) {
+			ptr = st->priv + pos + done;
+		} else {
+			ptr = buf ? buf : dst + done;
+			ret = fit_stream_read(st, pos + done, ptr, len);
+			if (ret) {
+				if (!buf)
+					out.len = done + len;
+				goto err;
+			}
+		}
+		ret = fit_stream_hash_update(hashes, count, ptr, len,
+					     done + len == size);
+		if (ret)
+			goto err;
+
+		/*
+		 * Corrupt data usually upsets the decompressor, but keep
+		 * hashing so that this is reported as a bad hash
+		 */
+		if (!dec_ret)
+			dec_ret = fit_stream_out_feed(&out, ptr, len);
+	}
+	free(buf);
+
+	out_len = fit_stream_out_finish(&out);
+	ret = fit_stream_hash_finish(st->fit, hashes, count);
+	if (!ret)
+		ret = dec_ret;
+	if (!ret && out_len < 0)
+		ret = out_len;
+	if (ret) {
+		memset(dst, '\0', out.len);
+		return ret;
+	}
+	*lenp = out_len;
+
+	return 0;
+err:
+	free(buf);
+	fit_stream_out_finish(&out);
+	fit_stream_hash_abort(hashes, count);
+	memset(dst, '\0', out.len);
+
+	return ret;
+}
+
+/**
+ * fit_stream_decomp() - move verified data to the load address
+ *
+ * @st:		Stream being loaded
+ * @noffset:	Offset of the image node
+ * @data:	Data of the image, already verified
+ * @size:	Size of the data
+ * @comp:	Compression of the image (IH_COMP_...)
+ * @load:	Address to load to
+ * @lenp:	Returns length of loaded image
+ * Return: 0 if OK, -ve on error
+ */
+static int fit_stream_decomp(struct fit_stream *st, int noffset,
+			     const void *data, ulong size, int comp,
+			     ulong load, ulong *lenp)
+{
+	ulong load_end;
+	uint8_t type;
+	int ret;
+
+	if (fit_image_get_type(st->fit, noffset, &type))
+		type = IH_TYPE_INVALID;
+	ret = image_decomp(comp, load, map_to_sysmem(data), type,
+			   map_sysmem(load, 0), (void *)data, size,
+			   CONFIG_SYS_BOOTM_LEN, &load_end);
+	if (ret)
+		return -EIO;
+	*lenp = load_end - load;
+
+	return 0;
+}
+
+bool fit_stream_can_hash(const void *fit, int noffset)
+{
+	uint8_t comp;
+
+	if (fdt_subnode_offset(fit, noffset, FIT_CIPHER_NODENAME) >= 0)
+		return false;
+	if (fit_image_get_comp(fit, noffset, &comp))
+		comp = IH_COMP_NONE;
+
+	return fit_stream_can_decomp(comp) &&
+	       !fit_stream_need_buffer(fit, noffset);
+}
+
+int fit_stream_decomp_hashed(const void *fit, int noffset, const void *data,
+			     ulong size, void *dst, ulong dst_size,
+			     ulong *lenp)
+{
+	struct fit_stream st;
+	uint8_t comp;
+	int ret;
+
+	if (fit_image_get_comp(fit, noffset, &comp))
+		comp = IH_COMP_NONE;
+	fit_stream_init_mem(&st, data);
+	st.fit = (void *)fit;
+	st.chunk_size = FIT_STREAM_MEM_CHUNK;
+
+	puts("   Verifying Hash Integrity ... ");
+	ret = fit_stream_load_chunks(&st, noffset, 0, size, comp, dst,
+				     dst_size, lenp);
+	if (ret)
+		puts(ret == -EBADMSG ? "Bad Data Hash\n" : "error!\n");
+	else
+		puts("OK\n");
+
+	return ret;
+}
+
+int fit_stream_load_image(struct fit_stream *st, int noffset, ulong load,
+			  ulong *lenp)
+{
+	const void *fit = st->fit;
+	const void *data;
+	size_t data_size;
+	int pos, offset, len;
+	ulong size;
+	uint8_t comp;
+	void *buf;
+	int ret;
+
+	if (fdt_subnode_offset(fit, noffset, FIT_CIPHER_NODENAME) >= 0)
+		return -ENOTSUPP;
+	if (fit_image_get_comp(fit, noffset, &comp))
+		comp = IH_COMP_NONE;
+	if (load == -1UL && fit_image_get_load(fit, noffset, &load)) {
+		log_err("Can't get load address of '%s'\n",
+			fit_get_name(fit, noffset, NULL));
+		return -EINVAL;
+	}
+
+	if (!fit_image_get_data_position(fit, noffset, &pos)) {
+		offset = pos;
+	} else if (!fit_image_get_data_offset(fit, noffset, &offset)) {
+		offset += ALIGN(fdt_totalsize(fit), 4);
+	} else {
+		/* embedded data, which is already in memory */
+		if (fit_image_get_data(fit, noffset, &data, &data_size))
+			return -ENOENT;
+		puts("   Verifying Hash Integrity ... ");
+		if (fit_image_verify_with_data(fit, noffset, gd_fdt_blob(),
+					       data, data_size) != 1)
+			return -EBADMSG;
+		puts("OK\n");
+
+		return fit_stream_decomp(st, noffset, data, data_size, comp,
+					 load, lenp);
+	}
+	if (fit_image_get_data_size(fit, noffset, &len))
+		return -ENOENT;
+	size = len;
+
+	if (fit_stream_can_hash(fit, noffset)) {
+		puts("   Verifying Hash Integrity ... ");
+		ret = fit_stream_load_chunks(st, noffset, offset, size, comp,
+					     map_sysmem(load, 0),
+					     CONFIG_SYS_BOOTM_LEN, lenp);
+		if (ret)
+			puts(ret == -EBADMSG ? "Bad hash value\n" : "error!\n");
+		else
+			puts("OK\n");
+
+		return ret;
+	}
+
+	/*
+	 * Otherwise the data is checked in one piece. Compressed data is only
+	 * passed to the decompressor once its hashes are known to be good,
+	 * so it is read into a buffer of its own. An uncompressed image is
+	 * read straight to the load address and wiped again if it is bad.
+	 */
+	log_debug("Reading '%s' into memory\n",
+		  fit_get_name(fit, noffset, NULL));
+	if (comp == IH_COMP_NONE) {
+		buf = map_sysmem(load, size);
+	} else {
+		buf = malloc(size);
+		if (!buf)
+			return -ENOMEM;
+	}
+
+	ret = fit_stream_read(st, offset, buf, size);
+	if (!ret) {
+		puts("   Verifying Hash Integrity ... ");
+		if (fit_image_verify_with_data(fit, noffset, gd_fdt_blob(), buf,
+					       size) != 1)
+			ret = -EBADMSG;
+		else
+			puts("OK\n");
+	}
+
+	if (!ret)
+		ret = fit_stream_decomp(st, noffset, buf, size, comp, load,
+					lenp);
+	else if (comp == IH_COMP_NONE)
+		memset(buf, '\0', size);
+	if (comp != IH_COMP_NONE)
+		free(buf);
+
+	return ret;
+}
+
+int fit_stream_load(struct fit_stream *st, const char *conf_uname,
+		    const char *prop_name, ulong load, ulong *lenp)
+{
+	const void *fit = st->fit;
+	int cfg_noffset, noffset;
+
+	cfg_noffset = fit_conf_get_node(fit, conf_uname);
+	if (cfg_noffset < 0) {
+		puts("Could not find configuration node\n");
+		return -ENOENT;
+	}
+	printf("   Using '%s' configuration\n",
+	       fdt_get_name(fit, cfg_noffset, NULL));
+
+	if (FIT_IMAGE_ENABLE_VERIFY) {
+		puts("   Verifying Hash Integrity ... ");
+		if (fit_config_verify(fit, cfg_noffset)) {
+			puts("Bad Data Hash\n");
+			return -EACCES;
+		}
+		puts("OK\n");
+	}
+
+	noffset = fit_conf_get_prop_node(fit, cfg_noffset, prop_name);
+	if (noffset < 0) {
+		printf("Could not find subimage node type '%s'\n", prop_name);
+		return -ENOENT;
+	}
+	printf("   Trying '%s' %s subimage\n",
+	       fit_get_name(fit, noffset, NULL), prop_name);
+
+	return fit_stream_load_image(st, noffset, load, lenp);
+}
@@ -28,7 +28,10 @@
 #ifdef CONFIG_DM_HASH
 #include <dm.h>
 #include <u-boot/hash.h>
+#else
+#include <hash.h>
 #endif
+#include <mp_job.h>
 DECLARE_GLOBAL_DATA_PTR;
 #endif /* !USE_HOSTCC*/
 
@@ -1260,6 +1263,299 @@ int calculate_hash(const void *data, int data_len, const char *name,
 	return 0;
 }
 
+#if !defined(USE_HOSTCC) && CONFIG_IS_ENABLED(MP_JOB) && \
+	!defined(CONFIG_DM_HASH)
+/**
+ * struct fit_hash_job - A hash being calculated ahead of time on another CPU
+ *
+ * @job: Job which calculates the hash
+ * @fit: FIT containing the hash node
+ * @noffset: Offset of the hash node
+ * @data: Image data being hashed
+ * @size: Size of image data
+ * @algo: Hash algorithm
+ * @ctx: Hash context, allocated up front since jobs cannot use malloc(), or
+ *	NULL once the result has been collected
+ */
+struct fit_hash_job {
+	struct mp_job job;
+	const void *fit;
+	int noffset;
+	const void *data;
+	size_t size;
+	struct hash_algo *algo;
+	void *ctx;
+};
+
+/*
+ * Hashes started ahead of time, by fit_all_image_verify() or by
+ * fit_image_load() for the images of a configuration
+ */
+static struct fit_hash_job *fit_hash_jobs;
+static int fit_hash_count;
+static int fit_hash_max;
+
+static void fit_hash_end(void);
+
+static int fit_hash_job_run(void *arg)
+{
+	struct fit_hash_job *hj = arg;
+
+	return hj->algo->hash_update(hj->algo, hj->ctx, hj->data, hj->size, 1);
+}
+
+static bool fit_hash_job_init(struct fit_hash_job *hj, const void *fit,
+			      int noffset, const void *data, size_t size)
+{
+	const char *name = fit_get_name(fit, noffset, NULL);
+	struct hash_algo *algo;
+	const char *algo_name;
+	int ignore;
+
+	if (strncmp(name, FIT_HASH_NODENAME, strlen(FIT_HASH_NODENAME)) ||
+	    fit_image_hash_get_algo(fit, noffset, &algo_name))
+		return false;
+	fit_image_hash_get_ignore(fit, noffset, &ignore);
+	if (ignore)
+		return false;
+
+	/*
+	 * Only SHA has a progressive form giving the same result as
+	 * calculate_hash(); the rest are left to the boot CPU
+	 */
+	if (strncmp(algo_name, "sha", 3) ||
+	    hash_lookup_algo(algo_name, &algo) || !algo->hash_init ||
+	    algo->hash_init(algo, &hj->ctx))
+		return false;
+
+	hj->job.func = fit_hash_job_run;
+	hj->job.arg = hj;
+	hj->fit = fit;
+	hj->noffset = noffset;
+	hj->data = data;
+	hj->size = size;
+	hj->algo = algo;
+
+	return true;
+}
+
+/* Drop any earlier hashes and make room for @max new ones */
+static bool fit_hash_alloc(int max)
+{
+	fit_hash_end();
+	if (max < 2 || mp_job_cpus() < 2)
+		return false;
+
+	fit_hash_jobs = calloc(max, sizeof(*fit_hash_jobs));
+	if (!fit_hash_jobs)
+		return false;
+	fit_hash_max = max;
+
+	return true;
+}
+
+/* Start calculating the hashes of an image, one job per hash node */
+static void fit_hash_start_image(const void *fit, int image)
+{
+	const void *data;
+	size_t size;
+	int noffset, i;
+
+	if (fit_image_get_data_and_size(fit, image, &data, &size))
+		return;
+	fdt_for_each_subnode(noffset, fit, image) {
+		struct fit_hash_job *hj = &fit_hash_jobs[fit_hash_count];
+
+		/* A configuration may name the same image more than once */
+		for (i = 0; i < fit_hash_count; i++) {
+			if (fit_hash_jobs[i].noffset == noffset)
+				break;
+		}
+		if (i < fit_hash_count || fit_hash_count == fit_hash_max)
+			continue;
+		if (fit_hash_job_init(hj, fit, noffset, data, size)) {
+			mp_job_submit(&hj->job);
+			fit_hash_count++;
+		}
+	}
+}
+
+/*
+ * Start calculating the hashes of all images in parallel, so that the
+ * results are ready (or nearly so) when fit_image_check_hash() gets to them
+ */
+static void fit_hash_start(const void *fit, int images_noffset)
+{
+	int image, noffset, max = 0;
+
+	fdt_for_each_subnode(image, fit, images_noffset) {
+		fdt_for_each_subnode(noffset, fit, image)
+			max++;
+	}
+	if (!fit_hash_alloc(max))
+		return;
+
+	fdt_for_each_subnode(image, fit, images_noffset)
+		fit_hash_start_image(fit, image);
+}
+
+/*
+ * Count the hash nodes of the images named by a configuration, or start
+ * calculating them if @start is true
+ */
+static int fit_hash_conf_images(const void *fit, int cfg_noffset, bool start)
+{
+	int prop, image, noffset, len, max = 0;
+	const char *name, *end;
+
+	fdt_for_each_property_offset(prop, fit, cfg_noffset) {
+		name = fdt_getprop_by_offset(fit, prop, NULL, &len);
+		if (!name)
+			continue;
+		/* Image names are strings, which may form a list */
+		for (end = name + len; name < end; name += strlen(name) + 1) {
+			image = fit_image_get_node(fit, name);
+			if (image < 0)
+				continue;
+			if (start) {
+				fit_hash_start_image(fit, image);
+				continue;
+			}
+			fdt_for_each_subnode(noffset, fit, image)
+				max++;
+		}
+	}
+
+	return max;
+}
+
+/*
+ * Start calculating the hashes of every image a configuration uses, so that
+ * the kernel, FDT and ramdisk are checked at the same time
+ */
+static void fit_hash_start_conf(const void *fit, int cfg_noffset)
+{
+	if (fit_hash_alloc(fit_hash_conf_images(fit, cfg_noffset, false)))
+		fit_hash_conf_images(fit, cfg_noffset, true);
+}
+
+static int fit_hash_collect(struct fit_hash_job *hj, uint8_t *value,
+			    int *value_lenp)
+{
+	int ret;
+
+	ret = mp_job_wait(&hj->job);
+	ret |= hj->algo->hash_finish(hj->algo, hj->ctx, value,
+				     FIT_MAX_HASH_LEN);
+	hj->ctx = NULL;
+	if (ret)
+		return -EIO;
+	*value_lenp = hj->algo->digest_size;
+
+	return 0;
+}
+
+/* Get the result of a hash started by fit_hash_start(), if there is one */
+static int fit_hash_get(const void *fit, int noffset, const void *data,
+			size_t size, uint8_t *value, int *value_lenp)
+{
+	struct fit_hash_job *hj;
+	int i;
+
+	for (i = 0; i < fit_hash_count; i++) {
+		hj = &fit_hash_jobs[i];
+		if (hj->ctx && hj->fit == fit && hj->noffset == noffset &&
+		    hj->data == data && hj->size == size)
+			return fit_hash_collect(hj, value, value_lenp);
+	}
+
+	return -ENOENT;
+}
+
+/* Check if the hashes of an image were started by fit_hash_start() */
+static bool fit_hash_started(const void *fit, int image_noffset)
+{
+	struct fit_hash_job *hj;
+	int noffset, i;
+
+	fdt_for_each_subnode(noffset, fit, image_noffset) {
+		for (i = 0; i < fit_hash_count; i++) {
+			hj = &fit_hash_jobs[i];
+			if (hj->ctx && hj->fit == fit && hj->noffset == noffset)
+				return true;
+		}
+	}
+
+	return false;
+}
+
+/* Wait for and drop any hashes which were not used */
+static void fit_hash_end(void)
+{
+	uint8_t value[FIT_MAX_HASH_LEN];
+	int value_len, i;
+
+	for (i = 0; i < fit_hash_count; i++) {
+		if (fit_hash_jobs[i].ctx)
+			fit_hash_collect(&fit_hash_jobs[i], value, &value_len);
+	}
+	free(fit_hash_jobs);
+	fit_hash_jobs = NULL;
+	fit_hash_count = 0;
+	fit_hash_max = 0;
+}
+
+int fit_image_hash_pending(void)
+{
+	int count = 0;
+	int i;
+
+	for (i = 0; i < fit_hash_count; i++) {
+		if (fit_hash_jobs[i].ctx)
+			count++;
+	}
+
+	return count;
+}
+
+void fit_image_hash_drop(void)
+{
+	fit_hash_end();
+}
+#else
+static inline void fit_hash_start(const void *fit, int images_noffset)
+{
+}
+
+static inline void fit_hash_start_conf(const void *fit, int cfg_noffset)
+{
+}
+
+static inline int fit_hash_get(const void *fit, int noffset, const void *data,
+			       size_t size, uint8_t *value, int *value_lenp)
+{
+	return -ENOENT;
+}
+
+static inline bool fit_hash_started(const void *fit, int image_noffset)
+{
+	return false;
+}
+
+static inline void fit_hash_end(void)
+{
+}
+
+int fit_image_hash_pending(void)
+{
+	return 0;
+}
+
+void fit_image_hash_drop(void)
+{
+}
+#endif
+
 static int fit_image_check_hash(const void *fit, int noffset, const void *data,
 				size_t size, char **err_msgp)
 {
@@ -1292,7 +1588,8 @@ static int fit_image_check_hash(const void *fit, int noffset, const void *data,
 		return -1;
 	}
 
-	if (calculate_hash(data, size, algo, value, &value_len)) {
+	if (fit_hash_get(fit, noffset, data, size, value, &value_len) &&
+	    calculate_hash(data, size, algo, value, &value_len)) {
 		*err_msgp = "Unsupported hash algorithm";
 		return -1;
 	}
@@ -1445,6 +1742,7 @@ int fit_all_image_verify(const void *fit)
 	/* Process all image subnodes, check hashes for each */
 	printf("## Checking hash(es) for FIT Image at %08lx ...\n",
 	       (ulong)fit);
+	fit_hash_start(fit, images_noffset);
 	for (ndepth = 0, count = 0,
 	     noffset = fdt_next_node(fit, images_noffset, &ndepth);
 			(noffset >= 0) && (ndepth > 0);
@@ -1458,11 +1756,15 @@ int fit_all_image_verify(const void *fit)
 			       fit_get_name(fit, noffset, NULL));
 			count++;
 
-			if (!fit_image_verify(fit, noffset))
+			if (!fit_image_verify(fit, noffset)) {
+				fit_hash_end();
 				return 0;
+			}
 			printf("\n");
 		}
 	}
+	fit_hash_end();
+
 	return 1;
 }
 
@@ -2012,6 +2314,7 @@ int fit_image_load(bootm_headers_t *images, ulong addr,
 	ulong load, load_end, data, len;
 	uint8_t os, comp;
 	const char *prop_name;
+	bool hashed;
 	int ret;
 
 	fit = map_sysmem(addr, 0);
@@ -2072,6 +2375,14 @@ int fit_image_load(bootm_headers_t *images, ulong addr,
 			puts("OK\n");
 		}
 
+		/*
+		 * The other images of the configuration are loaded next, so
+		 * hash them all now on other CPUs. Later calls pick up the
+		 * results until bootm drops them with fit_image_hash_drop().
+		 */
+		if (image_type == IH_TYPE_KERNEL && images->verify)
+			fit_hash_start_conf(fit, cfg_noffset);
+
 		bootstage_mark(BOOTSTAGE_ID_FIT_CONFIG);
 
 		noffset = fit_conf_get_prop_node(fit, cfg_noffset,
@@ -2086,7 +2397,24 @@ int fit_image_load(bootm_headers_t *images, ulong addr,
 
 	printf("   Trying '%s' %s subimage\n", fit_uname, prop_name);
 
-	ret = fit_image_select(fit, noffset, images->verify);
+	/*
+	 * Kernel images get decompressed later in bootm_load_os(). Others
+	 * are decompressed below, where they can be hashed at the same time,
+	 * so that their data is only walked once, unless another CPU is
+	 * already hashing them.
+	 */
+	if (fit_image_get_comp(fit, noffset, &comp))
+		comp = IH_COMP_NONE;
+	hashed = !tools_build() && CONFIG_IS_ENABLED(FIT_STREAM) &&
+		 images->verify && comp != IH_COMP_NONE &&
+		 !IS_ENABLED(CONFIG_FIT_IMAGE_POST_PROCESS) &&
+		 image_type != IH_TYPE_KERNEL &&
+		 image_type != IH_TYPE_KERNEL_NOLOAD &&
+		 image_type != IH_TYPE_RAMDISK &&
+		 fit_stream_can_hash(fit, noffset) &&
+		 !fit_hash_started(fit, noffset);
+
+	ret = fit_image_select(fit, noffset, images->verify && !hashed);
 	if (ret) {
 		bootstage_error(bootstage_id + BOOTSTAGE_SUB_HASH);
 		return ret;
@@ -2203,11 +2531,8 @@ int fit_image_load(bootm_headers_t *images, ulong addr,
 		load = data;	/* No load address specified */
 	}
 
-	comp = IH_COMP_NONE;
 	loadbuf = buf;
-	/* Kernel images get decompressed later in bootm_load_os(). */
-	if (!fit_image_get_comp(fit, noffset, &comp) &&
-	    comp != IH_COMP_NONE &&
+	if (comp != IH_COMP_NONE &&
 	    !(image_type == IH_TYPE_KERNEL ||
 	      image_type == IH_TYPE_KERNEL_NOLOAD ||
 	      image_type == IH_TYPE_RAMDISK)) {
@@ -2218,13 +2543,23 @@ int fit_image_load(bootm_headers_t *images, ulong addr,
 		} else {
 			loadbuf = map_sysmem(load, max_decomp_len);
 		}
-		if (image_decomp(comp, load, data, image_type,
+		if (hashed) {
+			ret = fit_stream_decomp_hashed(fit, noffset, buf, len,
+						       loadbuf, max_decomp_len,
+						       &len);
+			if (ret) {
+				bootstage_error(bootstage_id +
+						BOOTSTAGE_SUB_HASH);
+				return ret == -EBADMSG ? -EACCES : -ENOEXEC;
+			}
+		} else if (image_decomp(comp, load, data, image_type,
 				loadbuf, buf, len, max_decomp_len, &load_end)) {
 			printf("Error decompressing %s\n", prop_name);
 
 			return -ENOEXEC;
+		} else {
+			len = load_end - load;
 		}
-		len = load_end - load;
 	} else if (load != data) {
 		loadbuf = map_sysmem(load, len);
 		memcpy(loadbuf, buf, len);
@@ -7,43 +7,84 @@
 #include <command.h>
 #include <config.h>
 #include <common.h>
+#include <blk.h>
 #include <malloc.h>
 #include <part.h>
 
 static int blkc_show(struct cmd_tbl *cmdtp, int flag,
 		     int argc, char *const argv[])
 {
+	struct block_cache_dev_stats dev_stats;
 	struct block_cache_stats stats;
+	int i;
+
+	/* per-device counters are reset by blkcache_stats(), so show first */
+	for (i = 0; !blkcache_dev_stats(i, &dev_stats); i++)
+		printf("%s %d: hits: %u, misses: %u, read-aheads: %u\n",
+		       blk_get_if_type_name(dev_stats.iftype),
+		       dev_stats.devnum, dev_stats.hits, dev_stats.misses,
+		       dev_stats.readaheads);
+
 	blkcache_stats(&stats);
 
 	printf("hits: %u\n"
 	       "misses: %u\n"
 	       "entries: %u\n"
+	       "used: %lu of %lu bytes\n"
 	       "max blocks/entry: %u\n"
-	       "max cache entries: %u\n",
+	       "read-ahead blocks: %u\n"
+	       "policy: %s\n",
 	       stats.hits, stats.misses, stats.entries,
-	       stats.max_blocks_per_entry, stats.max_entries);
+	       stats.used, stats.size,
+	       stats.max_blocks_per_entry, stats.readahead,
+	       stats.policy);
 	return 0;
 }
 
 static int blkc_configure(struct cmd_tbl *cmdtp, int flag,
 			  int argc, char *const argv[])
 {
-	unsigned blocks_per_entry, max_entries;
+	unsigned blocks_per_entry;
+	ulong max_bytes;
 	if (argc != 3)
 		return CMD_RET_USAGE;
 
 	blocks_per_entry = simple_strtoul(argv[1], 0, 0);
-	max_entries = simple_strtoul(argv[2], 0, 0);
-	blkcache_configure(blocks_per_entry, max_entries);
-	printf("changed to max of %u entries of %u blocks each\n",
-	       max_entries, blocks_per_entry);
+	max_bytes = simple_strtoul(argv[2], 0, 0);
+	blkcache_configure_bytes(blocks_per_entry, max_bytes);
+	printf("changed to max of %lu bytes, caching reads of up to %u blocks\n",
+	       max_bytes, blocks_per_entry);
+	return 0;
+}
+
+static int blkc_policy(struct cmd_tbl *cmdtp, int flag,
+		       int argc, char *const argv[])
+{
+	if (argc != 2)
+		return CMD_RET_USAGE;
+
+	if (blkcache_set_policy(argv[1])) {
+		printf("unknown policy '%s'\n", argv[1]);
+		return CMD_RET_FAILURE;
+	}
+	return 0;
+}
+
+static int blkc_readahead(struct cmd_tbl *cmdtp, int flag,
+			  int argc, char *const argv[])
+{
+	if (argc != 2)
+		return CMD_RET_USAGE;
+
+	blkcache_set_readahead(simple_strtoul(argv[1], 0, 0));
 	return 0;
 }
 
 static struct cmd_tbl cmd_blkc_sub[] = {
 	U_BOOT_CMD_MKENT(show, 0, 0, blkc_show, "", ""),
 	U_BOOT_CMD_MKENT(configure, 3, 0, blkc_configure, "", ""),
+	U_BOOT_CMD_MKENT(policy, 2, 0, blkc_policy, "", ""),
+	U_BOOT_CMD_MKENT(readahead, 2, 0, blkc_readahead, "", ""),
 };
 
 static __maybe_unused void blkc_reloc(void)
@@ -83,6 +124,9 @@ U_BOOT_CMD(
 	blkcache, 4, 0, do_blkcache,
 	"block cache diagnostics and control",
 	"show - show and reset statistics\n"
-	"blkcache configure <blocks> <entries> "
-	"- set max blocks per entry and max cache entries\n"
+	"blkcache configure <blocks> <bytes> "
+	"- set max blocks per cached read and cache size in bytes\n"
+	"blkcache policy lru|arc - select the replacement policy\n"
+	"blkcache readahead <blocks> "
+	"- set blocks read ahead on sequential access\n"
 );
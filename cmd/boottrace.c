@@ -0,0 +1,65 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Boot timeline command
+ *
+ * Copyright 2023 NXP
+ */
+
+#include <common.h>
+#include <boottrace.h>
+#include <command.h>
+#include <env.h>
+#include <mapmem.h>
+
+static int do_boottrace_stats(struct cmd_tbl *cmdtp, int flag, int argc,
+			      char *const argv[])
+{
+	boottrace_print_stats();
+
+	return 0;
+}
+
+static int do_boottrace_clear(struct cmd_tbl *cmdtp, int flag, int argc,
+			      char *const argv[])
+{
+	boottrace_clear();
+
+	return 0;
+}
+
+static int do_boottrace_export(struct cmd_tbl *cmdtp, int flag, int argc,
+			       char *const argv[])
+{
+	ulong addr, size;
+	size_t needed;
+	void *buf;
+	int ret;
+
+	if (argc != 3)
+		return CMD_RET_USAGE;
+	addr = hextoul(argv[1], NULL);
+	size = hextoul(argv[2], NULL);
+
+	buf = map_sysmem(addr, size);
+	ret = boottrace_export(buf, size, &needed);
+	unmap_sysmem(buf);
+	if (ret) {
+		printf("Error: %#zx bytes needed\n", needed);
+		return CMD_RET_FAILURE;
+	}
+	printf("Boot trace written to %08lx, size %#zx\n", addr, needed);
+	env_set_hex("filesize", needed);
+
+	return 0;
+}
+
+static char boottrace_help_text[] =
+	"- boot timeline\n\n"
+	"boottrace stats                - show how full the buffer is\n"
+	"boottrace clear                - drop all events\n"
+	"boottrace export <addr> <size> - write events for proftool";
+
+U_BOOT_CMD_WITH_SUBCMDS(boottrace, "Boot timeline", boottrace_help_text,
+	U_BOOT_SUBCMD_MKENT(stats, 1, 1, do_boottrace_stats),
+	U_BOOT_SUBCMD_MKENT(clear, 1, 0, do_boottrace_clear),
+	U_BOOT_SUBCMD_MKENT(export, 3, 0, do_boottrace_export));
@@ -56,6 +56,18 @@ int do_ext4_ls(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
 	return do_ls(cmdtp, flag, argc, argv, FS_TYPE_EXT);
 }
 
+static int do_ext4_stats(struct cmd_tbl *cmdtp, int flag, int argc,
+			 char *const argv[])
+{
+	struct ext4fs_read_stats stats;
+
+	ext4fs_read_stats(&stats);
+	printf("runs: %lu, holes: %lu, device reads: %lu, coalesced: %lu\n",
+	       stats.runs, stats.holes, stats.reads, stats.coalesced);
+
+	return 0;
+}
+
 #if defined(CONFIG_CMD_EXT4_WRITE)
 int do_ext4_write(struct cmd_tbl *cmdtp, int flag, int argc,
 		  char *const argv[])
@@ -84,6 +96,12 @@ U_BOOT_CMD(ext4ls, 4, 1, do_ext4_ls,
 	   "<interface> <dev[:part]> [directory]\n"
 	   "    - list files from 'dev' on 'interface' in a 'directory'");
 
+U_BOOT_CMD(ext4stats, 1, 0, do_ext4_stats,
+	   "show and reset ext4 read statistics",
+	   "\n"
+	   "    - show how many runs of blocks file reads were split into and\n"
+	   "      how many device reads they needed, then reset the counts");
+
 U_BOOT_CMD(ext4load, 7, 0, do_ext4_load,
 	   "load binary file from a Ext4 filesystem",
 	   "<interface> [<dev[:part]> [addr [filename [bytes [pos]]]]]\n"
@@ -10,6 +10,7 @@
 #include <common.h>
 #include <command.h>
 #include <env.h>
+#include <fdt_index.h>
 #include <image.h>
 #include <linux/ctype.h>
 #include <linux/types.h>
@@ -181,6 +182,9 @@ static int do_fdt(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
 		return CMD_RET_FAILURE;
 	}
 
+	/* Changes to the control devicetree may not alter its size */
+	fdt_index_changed(working_fdt);
+
 	/*
 	 * Move the working_fdt
 	 */
@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Load an image from a FIT on a filesystem, hashing it as it is read
+ */
+
+#include <common.h>
+#include <command.h>
+#include <env.h>
+#include <image.h>
+
+static int do_fitload(struct cmd_tbl *cmdtp, int flag, int argc,
+		      char *const argv[])
+{
+	const char *conf = NULL;
+	struct fit_stream st;
+	ulong load = -1UL;
+	ulong len;
+	int ret;
+
+	if (argc < 5)
+		return CMD_RET_USAGE;
+	if (argc > 5 && strcmp(argv[5], "-"))
+		load = hextoul(argv[5], NULL);
+	if (argc > 6)
+		conf = argv[6];
+
+	fit_stream_init_fs(&st, argv[1], argv[2], argv[3]);
+	ret = fit_stream_open(&st);
+	if (ret) {
+		printf("Cannot read FIT '%s' (err=%d)\n", argv[3], ret);
+		return CMD_RET_FAILURE;
+	}
+
+	ret = fit_stream_load(&st, conf, argv[4], load, &len);
+	if (ret) {
+		printf("Cannot load %s image (err=%d)\n", argv[4], ret);
+		goto out;
+	}
+	printf("%lu bytes loaded\n", len);
+	env_set_hex("filesize", len);
+out:
+	fit_stream_close(&st);
+
+	return ret ? CMD_RET_FAILURE : CMD_RET_SUCCESS;
+}
+
+U_BOOT_CMD(
+	fitload,	7,	0,	do_fitload,
+	"load an image from a FIT file",
+	"<interface> <dev[:part]> <filename> <type> [addr [config]]\n"
+	"    - Load the image named by property 'type' (e.g. kernel, fdt)\n"
+	"      of configuration 'config', or of the default configuration,\n"
+	"      from the FIT in file 'filename' on partition 'part' of device\n"
+	"      type 'interface' instance 'dev', checking its hashes as it is\n"
+	"      read. If 'addr' is omitted or '-', the load address of the\n"
+	"      image is used."
+);
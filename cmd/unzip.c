@@ -4,12 +4,42 @@
  * Wolfgang Denk, DENX Software Engineering, wd@denx.de.
  */
 
+#include <abuf.h>
 #include <common.h>
 #include <command.h>
 #include <env.h>
 #include <gzip.h>
 #include <mapmem.h>
 #include <part.h>
+#include <asm/unaligned.h>
+#include <linux/zstd.h>
+
+/*
+ * The input length is not given, so take all the zstd frames which follow
+ * one another from @src
+ */
+static int unzip_zstd(void *dst, ulong dst_len, void *src, ulong *lenp)
+{
+	struct abuf in, out;
+	size_t len = 0, n;
+	int ret;
+
+	while (ZSTD_isFrame(src + len, sizeof(u32))) {
+		n = ZSTD_findFrameCompressedSize(src + len, SIZE_MAX - len);
+		if (ZSTD_isError(n))
+			return -EINVAL;
+		len += n;
+	}
+
+	abuf_init_set(&in, src, len);
+	abuf_init_set(&out, dst, dst_len);
+	ret = zstd_decompress(&in, &out);
+	if (ret < 0)
+		return ret;
+	*lenp = ret;
+
+	return 0;
+}
 
 static int do_unzip(struct cmd_tbl *cmdtp, int flag, int argc,
 		    char *const argv[])
@@ -29,9 +59,20 @@ static int do_unzip(struct cmd_tbl *cmdtp, int flag, int argc,
 			return CMD_RET_USAGE;
 	}
 
-	if (gunzip(map_sysmem(dst, dst_len), dst_len, map_sysmem(src, 0),
-		   &src_len) != 0)
+	if (CONFIG_IS_ENABLED(ZSTD) &&
+	    get_unaligned_le32(map_sysmem(src, 0)) == ZSTD_MAGICNUMBER) {
+		int ret = unzip_zstd(map_sysmem(dst, dst_len), dst_len,
+				     map_sysmem(src, 0), &src_len);
+
+		if (ret) {
+			printf("Error: zstd decompression failed (err %d)\n",
+			       ret);
+			return 1;
+		}
+	} else if (gunzip(map_sysmem(dst, dst_len), dst_len,
+			  map_sysmem(src, 0), &src_len) != 0) {
 		return 1;
+	}
 
 	printf("Uncompressed size: %lu = 0x%lX\n", src_len, src_len);
 	env_set_hex("filesize", src_len);
@@ -41,7 +82,7 @@ static int do_unzip(struct cmd_tbl *cmdtp, int flag, int argc,
 
 U_BOOT_CMD(
 	unzip,	4,	1,	do_unzip,
-	"unzip a memory region",
+	"unzip a memory region (gzip, or zstd if enabled)",
 	"srcaddr dstaddr [dstsize]"
 );
 
@@ -12,6 +12,7 @@
 #include <common.h>
 #include <api.h>
 #include <bootstage.h>
+#include <boottrace.h>
 #include <cpu_func.h>
 #include <exports.h>
 #include <flash.h>
@@ -29,6 +30,7 @@
 #include <dm.h>
 #include <env.h>
 #include <env_internal.h>
+#include <fdt_index.h>
 #include <fdtdec.h>
 #include <ide.h>
 #include <init.h>
@@ -229,6 +231,22 @@ static int initr_of_live(void)
 	return 0;
 }
 
+static int initr_of_index(void)
+{
+	int ret;
+
+	/* The flat tree is not used for lookups once there is a live tree */
+	if (of_live_active())
+		return 0;
+
+	/* Lookups work without the index, so this is not fatal */
+	ret = fdt_index_init();
+	if (ret)
+		log_warning("Cannot index devicetree (err=%d)\n", ret);
+
+	return 0;
+}
+
 #ifdef CONFIG_DM
 static int initr_dm(void)
 {
@@ -281,6 +299,19 @@ static int initr_bootstage(void)
 	return 0;
 }
 
+#ifdef CONFIG_BOOTTRACE
+static int initr_boottrace(void)
+{
+	int ret;
+
+	ret = boottrace_init();
+	if (ret)
+		printf("boottrace: Cannot start (err=%d)\n", ret);
+
+	return 0;
+}
+#endif
+
 __weak int power_init_board(void)
 {
 	return 0;
@@ -617,6 +648,9 @@ static init_fnc_t init_sequence_r[] = {
 	initr_malloc,
 	log_init,
 	initr_bootstage,	/* Needs malloc() but has its own timer */
+#ifdef CONFIG_BOOTTRACE
+	initr_boottrace,
+#endif
 #if defined(CONFIG_CONSOLE_RECORD)
 	console_record_init,
 #endif
@@ -624,6 +658,7 @@ static init_fnc_t init_sequence_r[] = {
 	noncached_init,
 #endif
 	initr_of_live,
+	initr_of_index,
 #ifdef CONFIG_DM
 	initr_dm,
 #endif
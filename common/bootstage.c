@@ -13,6 +13,7 @@
 
 #include <common.h>
 #include <bootstage.h>
+#include <boottrace.h>
 #include <hang.h>
 #include <log.h>
 #include <malloc.h>
@@ -127,6 +128,10 @@ ulong bootstage_add_record(enum bootstage_id id, const char *name,
 	if (flags & BOOTSTAGEF_ALLOC)
 		id = data->next_id++;
 
+	boottrace_add_boot_us(TRACE_EV_MARK,
+			      flags & BOOTSTAGEF_ERROR ? TRACE_EVF_ERROR : 0,
+			      id, mark);
+
 	/* Only record the first event for each */
 	rec = find_id(data, id);
 	if (!rec) {
@@ -206,6 +211,7 @@ uint32_t bootstage_start(enum bootstage_id id, const char *name)
 		rec->start_us = start_us;
 		rec->name = name;
 	}
+	boottrace_add_boot_us(TRACE_EV_STAGE_START, 0, id, start_us);
 
 	return start_us;
 }
@@ -214,11 +220,13 @@ uint32_t bootstage_accum(enum bootstage_id id)
 {
 	struct bootstage_data *data = gd->bootstage;
 	struct bootstage_record *rec = ensure_id(data, id);
+	ulong now = timer_get_boot_us();
 	uint32_t duration;
 
+	boottrace_add_boot_us(TRACE_EV_STAGE_END, 0, id, now);
 	if (!rec)
 		return 0;
-	duration = (uint32_t)timer_get_boot_us() - rec->start_us;
+	duration = (uint32_t)now - rec->start_us;
 	rec->time_us += duration;
 
 	return duration;
@@ -245,6 +253,22 @@ static const char *get_record_name(char *buf, int len,
 	return buf;
 }
 
+int bootstage_get_record(uint i, char *buf, int len, enum bootstage_id *idp,
+			 const char **namep, ulong *time_usp)
+{
+	struct bootstage_data *data = gd->bootstage;
+	struct bootstage_record *rec;
+
+	if (!data || i >= data->rec_count)
+		return -ENOENT;
+	rec = &data->record[i];
+	*idp = rec->id;
+	*namep = get_record_name(buf, len, rec);
+	*time_usp = rec->time_us;
+
+	return rec->start_us ? 1 : 0;
+}
+
 static uint32_t print_time_record(struct bootstage_record *rec, uint32_t prev)
 {
 	char buf[20];
@@ -0,0 +1,243 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Timeline of boot events
+ *
+ * Bootstage marks, traced function calls and block and network transfers go
+ * into one buffer, so that proftool can show all of them against the same
+ * time axis. Times are those of timer_get_boot_us(), as used by bootstage.
+ *
+ * Copyright 2023 NXP
+ */
+
+#define LOG_CATEGORY	LOGC_BOOT
+
+#include <common.h>
+#include <bootstage.h>
+#include <boottrace.h>
+#include <dm.h>
+#include <fdt_support.h>
+#include <log.h>
+#include <malloc.h>
+#include <mapmem.h>
+#include <time.h>
+#include <linux/libfdt.h>
+
+/**
+ * struct boottrace_data - The event buffer
+ *
+ * This is in the data section since boottrace_add() may be called before
+ * relocation, when BSS cannot be used.
+ *
+ * @ev: Events, in the order they happened
+ * @size: Number of events there is room for
+ * @count: Number of events recorded
+ * @dropped: Number of events lost because the buffer was full
+ * @offset_us: Difference between timer_get_boot_us() and timer_get_us()
+ */
+struct boottrace_data {
+	struct trace_output_event *ev;
+	uint size;
+	uint count;
+	uint dropped;
+	ulong offset_us;
+};
+
+static struct boottrace_data bt __section(".data");
+
+static void notrace add_event(ulong time_us, enum trace_event_type type,
+			      uint flags, uint dev, u32 id, u32 arg)
+{
+	struct trace_output_event *ev;
+
+	if (bt.count == bt.size) {
+		bt.dropped++;
+		return;
+	}
+	ev = &bt.ev[bt.count++];
+	ev->time_us = time_us;
+	ev->type = type;
+	ev->flags = flags;
+	ev->dev = dev;
+	ev->id = id;
+	ev->arg = arg;
+}
+
+/*
+ * This is called from the function-trace hooks. The timer may be
+ * instrumented, but the hooks do not record calls made while they are
+ * recording one, so this cannot recurse
+ */
+void notrace boottrace_add(enum trace_event_type type, uint flags, uint dev,
+			   u32 id, u32 arg)
+{
+	if (!bt.ev)
+		return;
+	add_event(timer_get_us() + bt.offset_us, type, flags, dev, id, arg);
+}
+
+void boottrace_add_boot_us(enum trace_event_type type, uint flags, u32 id,
+			   ulong time_us)
+{
+	if (!bt.ev)
+		return;
+	add_event(time_us, type, flags, 0, id, 0);
+}
+
+int boottrace_init(void)
+{
+	struct trace_output_event *ev;
+	enum bootstage_id id;
+	const char *name;
+	ulong time_us;
+	char buf[20];
+	uint i;
+	int ret;
+
+	ev = malloc(CONFIG_BOOTTRACE_SIZE);
+	if (!ev)
+		return log_msg_ret("buf", -ENOMEM);
+	bt.offset_us = timer_get_boot_us() - timer_get_us();
+	bt.size = CONFIG_BOOTTRACE_SIZE / sizeof(*ev);
+	bt.count = 0;
+	bt.dropped = 0;
+	bt.ev = ev;
+
+	/* Start with the marks made so far, as bootstage_report() does */
+	for (i = 0;; i++) {
+		ret = bootstage_get_record(i, buf, sizeof(buf), &id, &name,
+					   &time_us);
+		if (ret == -ENOENT)
+			break;
+		if (!ret && (time_us || id == BOOTSTAGE_ID_AWAKE))
+			add_event(time_us, TRACE_EV_MARK, 0, 0, id, 0);
+	}
+
+	return 0;
+}
+
+void boottrace_clear(void)
+{
+	bt.count = 0;
+	bt.dropped = 0;
+}
+
+void boottrace_print_stats(void)
+{
+	if (!bt.ev) {
+		printf("Boot trace is not running\n");
+		return;
+	}
+	printf("Events:  %u of %u", bt.count, bt.size);
+	if (bt.dropped)
+		printf(", %u dropped", bt.dropped);
+	printf("\n");
+}
+
+/*
+ * Write data to the buffer if there is space. Whether there is space or not,
+ * the buffer pointer is advanced.
+ */
+static void append_data(char **ptrp, char *end, const void *data, size_t size)
+{
+	char *ptr = *ptrp;
+
+	*ptrp += size;
+	if (*ptrp > end)
+		return;
+
+	memcpy(ptr, data, size);
+}
+
+static void append_name(char **ptrp, char *end, enum trace_event_type type,
+			u32 id, const char *name)
+{
+	static const char pad[4];
+	struct trace_output_name out;
+	size_t len = strlen(name) + 1;
+
+	out.type = type;
+	out.len = ALIGN(len, 4);
+	out.id = id;
+	append_data(ptrp, end, &out, sizeof(out));
+	append_data(ptrp, end, name, len);
+	append_data(ptrp, end, pad, out.len - len);
+}
+
+int boottrace_export(void *buf, size_t size, size_t *needed)
+{
+	char *ptr = buf, *end = ptr + size, *names;
+	struct trace_output_hdr hdr;
+	enum bootstage_id id;
+	struct udevice *dev;
+	struct uclass *uc;
+	const char *name;
+	ulong time_us;
+	char tmp[20];
+	uint i;
+
+	hdr.type = TRACE_CHUNK_EVENTS;
+	hdr.rec_count = bt.count;
+	append_data(&ptr, end, &hdr, sizeof(hdr));
+	append_data(&ptr, end, bt.ev, bt.count * sizeof(*bt.ev));
+
+	/* The header is written once the names are counted */
+	names = ptr;
+	ptr += sizeof(hdr);
+	hdr.type = TRACE_CHUNK_NAMES;
+	hdr.rec_count = 0;
+	for (i = 0; bootstage_get_record(i, tmp, sizeof(tmp), &id, &name,
+					 &time_us) != -ENOENT; i++) {
+		append_name(&ptr, end, TRACE_EV_MARK, id, name);
+		hdr.rec_count++;
+	}
+	if (IS_ENABLED(CONFIG_BLK)) {
+		uclass_id_foreach_dev(UCLASS_BLK, dev, uc) {
+			append_name(&ptr, end, TRACE_EV_BLK_START, dev_seq(dev),
+				    dev->name);
+			hdr.rec_count++;
+		}
+	}
+	append_data(&names, end, &hdr, sizeof(hdr));
+
+	*needed = ptr - (char *)buf;
+	if (ptr > end)
+		return -ENOSPC;
+
+	return 0;
+}
+
+int boottrace_stash(void *fdt, ulong addr, size_t size)
+{
+	struct boottrace_stash_hdr *hdr;
+	size_t needed;
+	int chosen;
+	int ret;
+
+	if (!addr)
+		return log_msg_ret("adr", -EINVAL);
+	if (size < sizeof(*hdr))
+		return -ENOSPC;
+	hdr = map_sysmem(addr, size);
+	ret = boottrace_export(hdr + 1, size - sizeof(*hdr), &needed);
+	if (!ret) {
+		hdr->magic = BOOTTRACE_MAGIC;
+		hdr->size = needed;
+	}
+	unmap_sysmem(hdr);
+	if (ret)
+		return log_msg_ret("exp", ret);
+	if (!fdt)
+		return 0;
+
+	needed += sizeof(*hdr);
+	chosen = fdt_find_or_add_subnode(fdt, 0, "chosen");
+	if (chosen < 0)
+		return log_msg_ret("cho", -EINVAL);
+	fdt_delprop(fdt, chosen, "u-boot,boottrace");
+	if (fdt_appendprop_addrrange(fdt, 0, chosen, "u-boot,boottrace", addr,
+				     needed) ||
+	    fdt_add_mem_rsv(fdt, addr, needed))
+		return log_msg_ret("fdt", -ENOSPC);
+
+	return 0;
+}
@@ -0,0 +1,522 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Batched device tree fixups
+ *
+ * The nodes are indexed once by name, phandle and compatible string. Changes
+ * are queued against node offsets in the unchanged tree and made together by
+ * fdt_batch_apply(), which grows the tree once and writes out a new structure
+ * block in a single pass, rather than moving the rest of the tree for each.
+ *
+ * Copyright 2023 NXP
+ */
+
+#include <common.h>
+#include <fdt_index.h>
+#include <fdt_support.h>
+#include <malloc.h>
+#include <sort.h>
+#include <linux/log2.h>
+#include <linux/libfdt.h>
+
+/* Deepest nesting of nodes which can be indexed */
+#define FDT_BATCH_MAX_DEPTH	32
+
+/* FNV-1a of the node name without its unit address, mixed with the parent */
+static uint fdt_batch_hash_name(struct fdt_batch *fb, int parent,
+				const char *name, int len)
+{
+	u32 hash = 2166136261U ^ parent;
+
+	while (len--) {
+		hash ^= (u8)*name++;
+		hash *= 16777619;
+	}
+
+	return hash & (fb->hash_size - 1);
+}
+
+static uint fdt_batch_hash_phandle(struct fdt_batch *fb, u32 phandle)
+{
+	return (phandle * 2654435761U) & (fb->hash_size - 1);
+}
+
+int fdt_batch_init(struct fdt_batch *fb, void *fdt)
+{
+	int parents[FDT_BATCH_MAX_DEPTH];
+	struct fdt_batch_node *node;
+	int offset, depth, count;
+	const char *at;
+	uint hash;
+	int i, ret;
+
+	memset(fb, '\0', sizeof(*fb));
+	fb->fdt = fdt;
+	ret = fdt_check_header(fdt);
+	if (ret)
+		return ret;
+
+	/* The depth drops below zero at the end of the root node */
+	count = 0;
+	for (offset = 0, depth = 0; offset >= 0 && depth >= 0;
+	     offset = fdt_next_node(fdt, offset, &depth)) {
+		if (depth >= FDT_BATCH_MAX_DEPTH)
+			return -FDT_ERR_BADSTRUCTURE;
+		count++;
+	}
+	if (offset < 0)
+		return offset;
+
+	fb->hash_size = __roundup_pow_of_two(count * 2);
+	fb->nodes = calloc(count, sizeof(*fb->nodes));
+	fb->name_hash = malloc(fb->hash_size * sizeof(int));
+	fb->phandle_hash = malloc(fb->hash_size * sizeof(int));
+	if (!fb->nodes || !fb->name_hash || !fb->phandle_hash) {
+		fdt_batch_uninit(fb);
+		return -FDT_ERR_NOSPACE;
+	}
+	memset(fb->name_hash, 0xff, fb->hash_size * sizeof(int));
+	memset(fb->phandle_hash, 0xff, fb->hash_size * sizeof(int));
+	fb->node_count = count;
+
+	for (offset = 0, depth = 0, i = 0; i < count;
+	     offset = fdt_next_node(fdt, offset, &depth), i++) {
+		node = &fb->nodes[i];
+		node->offset = offset;
+		node->parent = depth ? parents[depth - 1] : -1;
+		parents[depth] = i;
+		node->phandle = fdt_get_phandle(fdt, offset);
+		node->name = fdt_get_name(fdt, offset, NULL);
+		at = strchrnul(node->name, '@');
+		node->basename_len = at - node->name;
+		node->compat = fdt_getprop(fdt, offset, "compatible",
+					   &node->compat_len);
+	}
+
+	/* Build the buckets backwards so that each lists nodes in tree order */
+	for (i = count - 1; i >= 0; i--) {
+		node = &fb->nodes[i];
+		hash = fdt_batch_hash_name(fb, node->parent, node->name,
+					   node->basename_len);
+		node->next_name = fb->name_hash[hash];
+		fb->name_hash[hash] = i;
+		node->next_phandle = -1;
+		if (node->phandle) {
+			hash = fdt_batch_hash_phandle(fb, node->phandle);
+			node->next_phandle = fb->phandle_hash[hash];
+			fb->phandle_hash[hash] = i;
+		}
+	}
+
+	return 0;
+}
+
+void fdt_batch_uninit(struct fdt_batch *fb)
+{
+	int i;
+
+	for (i = 0; i < fb->edit_count; i++)
+		free(fb->edits[i].name);
+	free(fb->edits);
+	free(fb->phandle_hash);
+	free(fb->name_hash);
+	free(fb->nodes);
+	memset(fb, '\0', sizeof(*fb));
+}
+
+/* Find the index entry for a node offset */
+static int fdt_batch_index(struct fdt_batch *fb, int offset)
+{
+	int lo = 0, hi = fb->node_count - 1, mid;
+
+	while (lo <= hi) {
+		mid = (lo + hi) / 2;
+		if (fb->nodes[mid].offset == offset)
+			return mid;
+		if (fb->nodes[mid].offset < offset)
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+
+	return -FDT_ERR_BADOFFSET;
+}
+
+/* Find a child by name, matching as fdt_subnode_offset_namelen() does */
+static int fdt_batch_subnode(struct fdt_batch *fb, int parent,
+			     const char *name, int namelen)
+{
+	const char *at = memchr(name, '@', namelen);
+	struct fdt_batch_node *node;
+	int i;
+
+	i = fb->name_hash[fdt_batch_hash_name(fb, parent, name,
+					      at ? at - name : namelen)];
+	for (; i >= 0; i = node->next_name) {
+		node = &fb->nodes[i];
+		if (node->parent != parent ||
+		    strncmp(node->name, name, namelen))
+			continue;
+		if (!node->name[namelen] || (!at && node->name[namelen] == '@'))
+			return i;
+	}
+
+	return -FDT_ERR_NOTFOUND;
+}
+
+int fdt_batch_path_offset(struct fdt_batch *fb, const char *path)
+{
+	const char *end = path + strlen(path);
+	const char *p = path, *q;
+	int node = 0, offset;
+
+	if (*path != '/') {
+		q = strchrnul(p, '/');
+		p = fdt_get_alias_namelen(fb->fdt, p, q - p);
+		if (!p)
+			return -FDT_ERR_BADPATH;
+		offset = fdt_batch_path_offset(fb, p);
+		if (offset < 0)
+			return offset;
+		node = fdt_batch_index(fb, offset);
+		p = q;
+	}
+
+	while (p < end) {
+		while (*p == '/')
+			p++;
+		if (!*p)
+			break;
+		q = strchrnul(p, '/');
+		node = fdt_batch_subnode(fb, node, p, q - p);
+		if (node < 0)
+			return node;
+		p = q;
+	}
+
+	return fb->nodes[node].offset;
+}
+
+int fdt_batch_node_by_phandle(struct fdt_batch *fb, u32 phandle)
+{
+	int i;
+
+	if (!phandle || phandle == (u32)-1)
+		return -FDT_ERR_BADPHANDLE;
+
+	i = fb->phandle_hash[fdt_batch_hash_phandle(fb, phandle)];
+	for (; i >= 0; i = fb->nodes[i].next_phandle) {
+		if (fb->nodes[i].phandle == phandle)
+			return fb->nodes[i].offset;
+	}
+
+	return -FDT_ERR_NOTFOUND;
+}
+
+int fdt_batch_node_by_compatible(struct fdt_batch *fb, int startoffset,
+				 const char *compat)
+{
+	struct fdt_batch_node *node;
+	int i = 0;
+
+	if (startoffset >= 0) {
+		i = fdt_batch_index(fb, startoffset);
+		if (i < 0)
+			return i;
+		i++;
+	}
+
+	for (; i < fb->node_count; i++) {
+		node = &fb->nodes[i];
+		if (node->compat &&
+		    fdt_stringlist_contains(node->compat, node->compat_len,
+					    compat))
+			return node->offset;
+	}
+
+	return -FDT_ERR_NOTFOUND;
+}
+
+/* Queue a change, with @len = -1 to delete the property */
+static int fdt_batch_queue(struct fdt_batch *fb, int nodeoffset,
+			   const char *name, const void *val, int len)
+{
+	struct fdt_batch_edit *edit;
+	int name_len = strlen(name) + 1;
+
+	if (nodeoffset < 0)
+		return nodeoffset;
+
+	if (fb->edit_count == fb->edit_max) {
+		int max = fb->edit_max ? fb->edit_max * 2 : 16;
+
+		edit = realloc(fb->edits, max * sizeof(*edit));
+		if (!edit)
+			return -FDT_ERR_NOSPACE;
+		fb->edits = edit;
+		fb->edit_max = max;
+	}
+
+	edit = &fb->edits[fb->edit_count];
+	edit->name = malloc(name_len + max(len, 0));
+	if (!edit->name)
+		return -FDT_ERR_NOSPACE;
+	memcpy(edit->name, name, name_len);
+	if (len > 0)
+		memcpy(edit->name + name_len, val, len);
+	edit->offset = nodeoffset;
+	edit->seq = fb->edit_count++;
+	edit->len = len;
+
+	/* Enough for a new property with a new name */
+	if (len >= 0)
+		fb->space += sizeof(struct fdt_property) +
+			ALIGN(len, FDT_TAGSIZE) + name_len;
+
+	return 0;
+}
+
+int fdt_batch_setprop(struct fdt_batch *fb, int nodeoffset, const char *name,
+		      const void *val, int len)
+{
+	return fdt_batch_queue(fb, nodeoffset, name, val, len);
+}
+
+int fdt_batch_delprop(struct fdt_batch *fb, int nodeoffset, const char *name)
+{
+	return fdt_batch_queue(fb, nodeoffset, name, NULL, -1);
+}
+
+int fdt_batch_set_status(struct fdt_batch *fb, int nodeoffset,
+			 enum fdt_status status)
+{
+	switch (status) {
+	case FDT_STATUS_OKAY:
+		return fdt_batch_setprop_string(fb, nodeoffset, "status",
+						"okay");
+	case FDT_STATUS_DISABLED:
+		return fdt_batch_setprop_string(fb, nodeoffset, "status",
+						"disabled");
+	case FDT_STATUS_FAIL:
+		return fdt_batch_setprop_string(fb, nodeoffset, "status",
+						"fail");
+	default:
+		printf("Invalid fdt status: %x\n", status);
+		return -1;
+	}
+}
+
+void fdt_batch_fixup_by_path(struct fdt_batch *fb, const char *path,
+			     const char *prop, const void *val, int len,
+			     int create)
+{
+	int offset = fdt_batch_path_offset(fb, path);
+	int rc = offset;
+
+	if (offset >= 0) {
+		rc = 0;
+		if (create || fdt_get_property(fb->fdt, offset, prop, NULL))
+			rc = fdt_batch_setprop(fb, offset, prop, val, len);
+	}
+	if (rc)
+		printf("Unable to update property %s:%s, err=%s\n",
+		       path, prop, fdt_strerror(rc));
+}
+
+void fdt_batch_fixup_by_compat(struct fdt_batch *fb, const char *compat,
+			       const char *prop, const void *val, int len,
+			       int create)
+{
+	int off;
+
+	fdt_batch_for_each_compatible(off, fb, compat)
+		if (create || fdt_get_property(fb->fdt, off, prop, NULL))
+			fdt_batch_setprop(fb, off, prop, val, len);
+}
+
+/* Sort by offset, keeping the queue order within each node */
+static int fdt_batch_edit_cmp(const void *a, const void *b)
+{
+	const struct fdt_batch_edit *ea = a, *eb = b;
+
+	if (ea->offset != eb->offset)
+		return ea->offset < eb->offset ? -1 : 1;
+
+	return ea->seq - eb->seq;
+}
+
+/* A property of a node being rewritten by fdt_batch_apply() */
+struct fdt_batch_prop {
+	const char *name;
+	int nameoff;		/* -1 if not yet in the strings block */
+	const void *val;
+	int len;
+};
+
+/* Find a string in the strings block, adding it if needed, as libfdt does */
+static int fdt_batch_string(void *fdt, const char *str)
+{
+	char *strtab = (char *)fdt + fdt_off_dt_strings(fdt);
+	int size = fdt_size_dt_strings(fdt);
+	int len = strlen(str) + 1;
+	const char *p;
+
+	for (p = strtab; p <= strtab + size - len; p++) {
+		if (!memcmp(p, str, len))
+			return p - strtab;
+	}
+
+	/* The tree has been grown to leave room after the strings block */
+	memcpy(strtab + size, str, len);
+	fdt_set_size_dt_strings(fdt, size + len);
+
+	return size;
+}
+
+/*
+ * Write the properties starting at @offset, which belong to the node the
+ * @count edits are for, with the edits made. The result is the same as
+ * making the edits with fdt_setprop() and fdt_delprop(): a property which is
+ * changed keeps its place and a new one goes before the others.
+ *
+ * Return: offset of the first tag after the properties, or -ve on error
+ */
+static int fdt_batch_node(struct fdt_batch *fb, int offset,
+			  struct fdt_batch_edit *edit, int count, char **outp)
+{
+	const struct fdt_property *fp;
+	struct fdt_batch_prop *props;
+	int nprops = 0, next, end, tag, pos, i;
+	void *fdt = fb->fdt;
+	char *out = *outp;
+
+	/* Properties come before subnodes, so stop at the first other tag */
+	for (next = offset; (tag = fdt_next_tag(fdt, next, &end)) == FDT_PROP ||
+	     tag == FDT_NOP; next = end)
+		nprops += tag == FDT_PROP;
+	if (end < 0)
+		return end;
+
+	props = malloc((nprops + count) * sizeof(*props));
+	if (!props)
+		return -FDT_ERR_NOSPACE;
+	for (pos = offset, i = 0; pos < next; pos = end) {
+		if (fdt_next_tag(fdt, pos, &end) != FDT_PROP)
+			continue;
+		fp = fdt_get_property_by_offset(fdt, pos, NULL);
+		props[i].nameoff = fdt32_to_cpu(fp->nameoff);
+		props[i].name = fdt_string(fdt, props[i].nameoff);
+		props[i].val = fp->data;
+		props[i++].len = fdt32_to_cpu(fp->len);
+	}
+
+	for (; count--; edit++) {
+		for (i = 0; i < nprops; i++) {
+			if (!strcmp(props[i].name, edit->name))
+				break;
+		}
+		if (edit->len < 0) {
+			if (i < nprops)
+				memmove(&props[i], &props[i + 1],
+					(--nprops - i) * sizeof(*props));
+			continue;
+		}
+		if (i == nprops) {
+			memmove(&props[1], props, nprops++ * sizeof(*props));
+			i = 0;
+			props[i].name = edit->name;
+			props[i].nameoff = -1;
+		}
+		props[i].val = edit->name + strlen(edit->name) + 1;
+		props[i].len = edit->len;
+	}
+
+	for (i = 0; i < nprops; i++) {
+		struct fdt_property *prop = (struct fdt_property *)out;
+		int len = props[i].len;
+
+		if (props[i].nameoff < 0)
+			props[i].nameoff = fdt_batch_string(fdt, props[i].name);
+		prop->tag = cpu_to_fdt32(FDT_PROP);
+		prop->len = cpu_to_fdt32(len);
+		prop->nameoff = cpu_to_fdt32(props[i].nameoff);
+		memcpy(prop->data, props[i].val, len);
+		memset(prop->data + len, '\0', ALIGN(len, FDT_TAGSIZE) - len);
+		out += sizeof(*prop) + ALIGN(len, FDT_TAGSIZE);
+	}
+	free(props);
+	*outp = out;
+
+	return next;
+}
+
+int fdt_batch_apply(struct fdt_batch *fb)
+{
+	struct fdt_batch_edit *edit, *end;
+	int offset, next, tag, size, count;
+	void *fdt = fb->fdt;
+	char *buf, *out;
+	int ret, first = 0;
+
+	if (!fb->edit_count)
+		return 0;
+
+	fdt_index_changed(fdt);
+
+	/* This also puts the strings block last, with the free space after */
+	ret = fdt_increase_size(fdt, fb->space);
+	if (ret)
+		return ret;
+
+	buf = malloc(fdt_size_dt_struct(fdt) + fb->space);
+	if (!buf)
+		return -FDT_ERR_NOSPACE;
+	qsort(fb->edits, fb->edit_count, sizeof(*fb->edits),
+	      fdt_batch_edit_cmp);
+
+	/* Copy the structure block, rewriting the nodes which have edits */
+	edit = fb->edits;
+	end = edit + fb->edit_count;
+	out = buf;
+	for (offset = 0; ; offset = next) {
+		tag = fdt_next_tag(fdt, offset, &next);
+		if (next < 0) {
+			free(buf);
+			return next;
+		}
+		memcpy(out, fdt_offset_ptr(fdt, offset, 0), next - offset);
+		out += next - offset;
+		if (tag == FDT_END)
+			break;
+		if (tag != FDT_BEGIN_NODE)
+			continue;
+
+		/* Edits of offsets which are not nodes cannot be made */
+		for (; edit < end && edit->offset < offset; edit++)
+			first = first ?: -FDT_ERR_BADOFFSET;
+		for (count = 0; edit + count < end &&
+		     edit[count].offset == offset; count++)
+			;
+		if (!count)
+			continue;
+
+		next = fdt_batch_node(fb, next, edit, count, &out);
+		if (next < 0) {
+			free(buf);
+			return next;
+		}
+		edit += count;
+	}
+	if (edit < end)
+		first = first ?: -FDT_ERR_BADOFFSET;
+
+	/* Move the strings block to follow the new structure block */
+	size = out - buf;
+	memmove(fdt + fdt_off_dt_struct(fdt) + size,
+		fdt + fdt_off_dt_strings(fdt), fdt_size_dt_strings(fdt));
+	memcpy(fdt + fdt_off_dt_struct(fdt), buf, size);
+	fdt_set_off_dt_strings(fdt, fdt_off_dt_struct(fdt) + size);
+	fdt_set_size_dt_struct(fdt, size);
+	free(buf);
+
+	return first;
+}
@@ -11,6 +11,7 @@
 #include <binman_sym.h>
 #include <bootstage.h>
 #include <dm.h>
+#include <fdt_index.h>
 #include <handoff.h>
 #include <hang.h>
 #include <init.h>
@@ -514,6 +515,10 @@ static int spl_common_init(bool setup_malloc)
 			debug("fdtdec_setup() returned error %d\n", ret);
 			return ret;
 		}
+		/* Lookups work without the index, so this is not fatal */
+		ret = fdt_index_init();
+		if (ret)
+			debug("fdt_index_init() returned error %d\n", ret);
 	}
 	if (CONFIG_IS_ENABLED(DM)) {
 		bootstage_start(BOOTSTAGE_ID_ACCUM_DM_SPL,
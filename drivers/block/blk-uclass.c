@@ -8,10 +8,13 @@
 
 #include <common.h>
 #include <blk.h>
+#include <boottrace.h>
 #include <dm.h>
 #include <log.h>
 #include <malloc.h>
+#include <memalign.h>
 #include <part.h>
+#include <watchdog.h>
 #include <dm/device-internal.h>
 #include <dm/lists.h>
 #include <dm/uclass-internal.h>
@@ -436,12 +439,72 @@ int blk_get_device(int if_type, int devnum, struct udevice **devp)
 	return device_probe(*devp);
 }
 
+/* Transfer with the driver, recording it in the boot timeline */
+static ulong blk_do_read(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
+			 void *buffer)
+{
+	ulong ret;
+
+	boottrace_add(TRACE_EV_BLK_START, 0, dev_seq(dev), start, blkcnt);
+	ret = blk_get_ops(dev)->read(dev, start, blkcnt, buffer);
+	boottrace_add(TRACE_EV_BLK_END, ret != blkcnt ? TRACE_EVF_ERROR : 0,
+		      dev_seq(dev), start, blkcnt);
+
+	return ret;
+}
+
+static ulong blk_do_write(struct udevice *dev, lbaint_t start,
+			  lbaint_t blkcnt, const void *buffer)
+{
+	ulong ret;
+
+	boottrace_add(TRACE_EV_BLK_START, TRACE_EVF_WRITE, dev_seq(dev), start,
+		      blkcnt);
+	ret = blk_get_ops(dev)->write(dev, start, blkcnt, buffer);
+	boottrace_add(TRACE_EV_BLK_END, TRACE_EVF_WRITE |
+		      (ret != blkcnt ? TRACE_EVF_ERROR : 0), dev_seq(dev),
+		      start, blkcnt);
+
+	return ret;
+}
+
+/*
+ * Read @blkcnt blocks into @buffer along with the @ra blocks following
+ * them, handing everything to the block cache so that a sequential reader
+ * finds its next blocks there
+ */
+static int blk_dread_ahead(struct blk_desc *block_dev, lbaint_t start,
+			   lbaint_t blkcnt, lbaint_t ra, void *buffer)
+{
+	struct udevice *dev = block_dev->bdev;
+	ulong blks_read;
+	void *rabuf;
+
+	rabuf = malloc_cache_aligned((blkcnt + ra) * block_dev->blksz);
+	if (!rabuf)
+		return -ENOMEM;
+
+	blks_read = blk_do_read(dev, start, blkcnt + ra, rabuf);
+	if (blks_read != blkcnt + ra) {
+		free(rabuf);
+		return -EIO;
+	}
+
+	memcpy(buffer, rabuf, blkcnt * block_dev->blksz);
+	blkcache_fill(block_dev->if_type, block_dev->devnum, start,
+		      blks_read, block_dev->blksz, rabuf);
+	free(rabuf);
+
+	return 0;
+}
+
 unsigned long blk_dread(struct blk_desc *block_dev, lbaint_t start,
 			lbaint_t blkcnt, void *buffer)
 {
 	struct udevice *dev = block_dev->bdev;
 	const struct blk_ops *ops = blk_get_ops(dev);
 	ulong blks_read;
+	lbaint_t ra;
 
 	if (!ops->read)
 		return -ENOSYS;
@@ -449,7 +512,14 @@ unsigned long blk_dread(struct blk_desc *block_dev, lbaint_t start,
 	if (blkcache_read(block_dev->if_type, block_dev->devnum,
 			  start, blkcnt, block_dev->blksz, buffer))
 		return blkcnt;
-	blks_read = ops->read(dev, start, blkcnt, buffer);
+
+	ra = blkcache_readahead(block_dev->if_type, block_dev->devnum,
+				start, blkcnt);
+	if (ra && start + blkcnt + ra <= block_dev->lba &&
+	    !blk_dread_ahead(block_dev, start, blkcnt, ra, buffer))
+		return blkcnt;
+
+	blks_read = blk_do_read(dev, start, blkcnt, buffer);
 	if (blks_read == blkcnt)
 		blkcache_fill(block_dev->if_type, block_dev->devnum,
 			      start, blkcnt, block_dev->blksz, buffer);
@@ -467,7 +537,7 @@ unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 		return -ENOSYS;
 
 	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
-	return ops->write(dev, start, blkcnt, buffer);
+	return blk_do_write(dev, start, blkcnt, buffer);
 }
 
 unsigned long blk_derase(struct blk_desc *block_dev, lbaint_t start,
@@ -483,6 +553,117 @@ unsigned long blk_derase(struct blk_desc *block_dev, lbaint_t start,
 	return ops->erase(dev, start, blkcnt);
 }
 
+void blk_req_init(struct blk_req *req, enum blk_req_op op, lbaint_t start,
+		  lbaint_t blkcnt, void *buffer)
+{
+	memset(req, '\0', sizeof(*req));
+	req->op = op;
+	req->start = start;
+	req->sg_one.buffer = buffer;
+	req->sg_one.blkcnt = blkcnt;
+	req->sg = &req->sg_one;
+	req->sg_count = 1;
+}
+
+void blk_req_complete(struct blk_req *req, long result)
+{
+	req->result = result;
+	req->complete = true;
+	if (req->done)
+		req->done(req);
+}
+
+/* Carry out a request with read() / write() for drivers without a queue */
+static int blk_submit_sync(struct blk_desc *block_dev, struct blk_req *req)
+{
+	struct udevice *dev = block_dev->bdev;
+	const struct blk_ops *ops = blk_get_ops(dev);
+	lbaint_t start = req->start;
+	long done = 0;
+	ulong ret;
+	int i;
+
+	if (req->op == BLK_REQ_READ ? !ops->read : !ops->write)
+		return -ENOSYS;
+
+	for (i = 0; i < req->sg_count; i++) {
+		struct blk_sg *sg = &req->sg[i];
+
+		if (req->op == BLK_REQ_READ)
+			ret = blk_do_read(dev, start, sg->blkcnt, sg->buffer);
+		else
+			ret = blk_do_write(dev, start, sg->blkcnt,
+					   sg->buffer);
+		if (IS_ERR_VALUE(ret)) {
+			if (!done)
+				done = ret;
+			break;
+		}
+		done += ret;
+		if (ret != sg->blkcnt)
+			break;
+		start += sg->blkcnt;
+	}
+	blk_req_complete(req, done);
+
+	return 0;
+}
+
+int blk_submit(struct blk_desc *block_dev, struct blk_req *req)
+{
+	struct udevice *dev = block_dev->bdev;
+	const struct blk_ops *ops = blk_get_ops(dev);
+	int ret;
+
+	req->result = 0;
+	req->complete = false;
+	req->pending = 0;
+	if (req->op == BLK_REQ_WRITE)
+		blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+
+	if (!ops->submit)
+		return blk_submit_sync(block_dev, req);
+
+	do {
+		ret = ops->submit(dev, req);
+		if (ret == -EBUSY) {
+			ret = blk_poll(block_dev);
+			if (ret < 0)
+				return ret;
+			ret = -EBUSY;
+		}
+	} while (ret == -EBUSY);
+
+	return ret;
+}
+
+int blk_poll(struct blk_desc *block_dev)
+{
+	struct udevice *dev = block_dev->bdev;
+	const struct blk_ops *ops = blk_get_ops(dev);
+
+	if (!ops->poll)
+		return 0;
+
+	return ops->poll(dev);
+}
+
+int blk_wait(struct blk_desc *block_dev, struct blk_req *req)
+{
+	int ret;
+
+	while (!req->complete) {
+		ret = blk_poll(block_dev);
+		if (ret < 0)
+			return ret;
+		WATCHDOG_RESET();
+	}
+	if (req->result < 0)
+		return req->result;
+
+	return req->result == blk_req_blkcnt(req) ? 0 : -EIO;
+}
+
 int blk_get_from_parent(struct udevice *parent, struct udevice **devp)
 {
 	struct udevice *dev;
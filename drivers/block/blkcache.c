@@ -3,188 +3,654 @@
  * Copyright (C) Nelson Integration, LLC 2016
  * Author: Eric Nelson<eric@nelint.com>
  *
+ * The cache holds individual blocks, hashed on (interface type, device
+ * number, LBA), within a byte budget. Which blocks are dropped when the
+ * budget is exhausted is decided by a replacement policy (LRU or ARC).
+ * Short sequential reads on a device trigger read-ahead, so that walking
+ * filesystem metadata mostly hits the cache.
  */
 #include <common.h>
 #include <blk.h>
+#include <env.h>
 #include <log.h>
 #include <malloc.h>
 #include <part.h>
 #include <asm/global_data.h>
 #include <linux/ctype.h>
 #include <linux/list.h>
+#include <linux/log2.h>
 
 #ifdef CONFIG_NEEDS_MANUAL_RELOC
 DECLARE_GLOBAL_DATA_PTR;
 #endif
 
+/* Lists used by the replacement policies, see struct block_cache */
+enum {
+	BLKC_T1,		/* LRU: all resident blocks; ARC: seen once */
+	BLKC_T2,		/* ARC: resident blocks seen more than once */
+	BLKC_B1,		/* ARC: ghosts evicted from T1 */
+	BLKC_B2,		/* ARC: ghosts evicted from T2 */
+
+	BLKC_LIST_COUNT,
+	BLKC_LIST_NONE = BLKC_LIST_COUNT,
+};
+
+/**
+ * struct block_cache_node - a single cached block
+ *
+ * @lh: Position in the policy list given by @list
+ * @hn: Position in the hash bucket
+ * @iftype: IF_TYPE_x of the device
+ * @devnum: Device number within @iftype
+ * @lba: Block number on the device
+ * @blksz: Size of the block in bytes
+ * @list: Policy list this node is on (BLKC_...)
+ * @data: Block contents, or NULL for a ghost entry that only remembers
+ *	that the block was recently evicted
+ */
 struct block_cache_node {
 	struct list_head lh;
+	struct hlist_node hn;
 	int iftype;
 	int devnum;
-	lbaint_t start;
-	lbaint_t blkcnt;
+	lbaint_t lba;
 	unsigned long blksz;
-	char *cache;
+	int list;
+	char *data;
+};
+
+/**
+ * struct block_cache_dev - per-device state
+ *
+ * @lh: Position in the device list
+ * @iftype: IF_TYPE_x of the device
+ * @devnum: Device number within @iftype
+ * @next: Block following the last read, used to detect sequential access
+ * @stats: Counters reported by 'blkcache show'
+ */
+struct block_cache_dev {
+	struct list_head lh;
+	int iftype;
+	int devnum;
+	lbaint_t next;
+	struct block_cache_dev_stats stats;
 };
 
-static LIST_HEAD(block_cache);
+/**
+ * struct block_cache_policy - a block replacement policy
+ *
+ * @name: Name used to select the policy
+ * @access: Called when a resident block is read from the cache
+ * @admit: Called before a block is filled. The node is either new or a
+ *	ghost; the policy may adjust its state and trim its ghost lists
+ * @evict: Return the resident block to drop to make room for @node. The
+ *	policy may either move it to a ghost list or unlink it completely,
+ *	in which case it is freed. Returns NULL if nothing can be evicted
+ * @place: Called once @node holds data, to put it on a resident list
+ */
+struct block_cache_policy {
+	const char *name;
+	void (*access)(struct block_cache_node *node);
+	void (*admit)(struct block_cache_node *node);
+	struct block_cache_node *(*evict)(struct block_cache_node *node);
+	void (*place)(struct block_cache_node *node);
+};
+
+/**
+ * struct block_cache - state of the block cache
+ *
+ * @hash: Hash buckets, allocated on first use
+ * @hash_bits: log2 of the number of hash buckets
+ * @list: Lists used by the policy, MRU first
+ * @list_size: Total size in bytes of the blocks on each list
+ * @target: ARC target size of T1 in bytes
+ * @policy: Replacement policy in use
+ * @devs: List of struct block_cache_dev
+ * @stats: Global statistics and configuration
+ */
+struct block_cache {
+	struct hlist_head *hash;
+	uint hash_bits;
+	struct list_head list[BLKC_LIST_COUNT];
+	ulong list_size[BLKC_LIST_COUNT];
+	ulong target;
+	const struct block_cache_policy *policy;
+	struct list_head devs;
+	struct block_cache_stats stats;
+};
+
+static struct block_cache cache = {
+	.stats = {
+		.max_blocks_per_entry = CONFIG_BLOCK_CACHE_MAX_BLOCKS,
+		.readahead = CONFIG_BLOCK_CACHE_READAHEAD,
+	},
+};
+
+static void cache_list_move(struct block_cache_node *node, int list)
+{
+	if (node->list != BLKC_LIST_NONE) {
+		list_del(&node->lh);
+		cache.list_size[node->list] -= node->blksz;
+	}
+	node->list = list;
+	if (list != BLKC_LIST_NONE) {
+		list_add(&node->lh, &cache.list[list]);
+		cache.list_size[list] += node->blksz;
+	}
+}
+
+static struct block_cache_node *cache_list_lru(int list)
+{
+	if (list_empty(&cache.list[list]))
+		return NULL;
+
+	return list_last_entry(&cache.list[list], struct block_cache_node, lh);
+}
+
+static uint cache_hash(int iftype, int devnum, lbaint_t lba)
+{
+	u64 key = ((u64)lba << 8) ^ (iftype << 4) ^ devnum;
+
+	return (key * 0x9e3779b97f4a7c15ULL) >> (64 - cache.hash_bits);
+}
+
+static struct block_cache_node *cache_find(int iftype, int devnum,
+					   lbaint_t lba, unsigned long blksz)
+{
+	struct block_cache_node *node;
+	struct hlist_node *pos;
+	struct hlist_head *head;
+
+	if (!cache.hash)
+		return NULL;
+
+	head = &cache.hash[cache_hash(iftype, devnum, lba)];
+	hlist_for_each_entry(node, pos, head, hn)
+		if (node->lba == lba && node->devnum == devnum &&
+		    node->iftype == iftype && node->blksz == blksz)
+			return node;
+
+	return NULL;
+}
+
+/* Remove a node, resident or ghost, from the cache and free it */
+static void cache_drop(struct block_cache_node *node)
+{
+	cache_list_move(node, BLKC_LIST_NONE);
+	hlist_del(&node->hn);
+	if (node->data) {
+		free(node->data);
+		cache.stats.used -= node->blksz;
+		cache.stats.entries--;
+	}
+	free(node);
+}
+
+static void lru_access(struct block_cache_node *node)
+{
+	cache_list_move(node, BLKC_T1);
+}
+
+static void lru_admit(struct block_cache_node *node)
+{
+}
+
+static struct block_cache_node *lru_evict(struct block_cache_node *node)
+{
+	struct block_cache_node *victim = cache_list_lru(BLKC_T1);
+
+	if (victim)
+		cache_list_move(victim, BLKC_LIST_NONE);
+
+	return victim;
+}
+
+static void lru_place(struct block_cache_node *node)
+{
+	cache_list_move(node, BLKC_T1);
+}
+
+#if CONFIG_IS_ENABLED(BLOCK_CACHE_ARC)
+/*
+ * Adaptive Replacement Cache, as described by Megiddo and Modha, with all
+ * sizes counted in bytes so that devices with different block sizes can
+ * share the cache.
+ */
+static void arc_access(struct block_cache_node *node)
+{
+	cache_list_move(node, BLKC_T2);
+}
+
+static void arc_admit(struct block_cache_node *node)
+{
+	ulong *size = cache.list_size;
+	ulong c = cache.stats.size;
+	ulong delta;
+
+	switch (node->list) {
+	case BLKC_B1:
+		delta = max(size[BLKC_B2] / max(size[BLKC_B1], 1UL), 1UL);
+		cache.target = min(c, cache.target + delta * node->blksz);
+		break;
+	case BLKC_B2:
+		delta = max(size[BLKC_B1] / max(size[BLKC_B2], 1UL), 1UL);
+		delta *= node->blksz;
+		cache.target = cache.target > delta ? cache.target - delta : 0;
+		break;
+	default:
+		/* Keep each of the ghost directories within the cache size */
+		while (size[BLKC_T1] + size[BLKC_B1] >= c &&
+		       !list_empty(&cache.list[BLKC_B1]))
+			cache_drop(cache_list_lru(BLKC_B1));
+		while (size[BLKC_T1] + size[BLKC_T2] + size[BLKC_B1] +
+		       size[BLKC_B2] >= 2 * c &&
+		       !list_empty(&cache.list[BLKC_B2]))
+			cache_drop(cache_list_lru(BLKC_B2));
+		break;
+	}
+}
+
+static struct block_cache_node *arc_evict(struct block_cache_node *node)
+{
+	ulong t1 = cache.list_size[BLKC_T1];
+	struct block_cache_node *victim;
+
+	if (t1 && (t1 > cache.target ||
+		   (node->list == BLKC_B2 && t1 == cache.target) ||
+		   list_empty(&cache.list[BLKC_T2]))) {
+		victim = cache_list_lru(BLKC_T1);
+		cache_list_move(victim, BLKC_B1);
+	} else {
+		victim = cache_list_lru(BLKC_T2);
+		if (victim)
+			cache_list_move(victim, BLKC_B2);
+	}
+
+	return victim;
+}
+
+static void arc_place(struct block_cache_node *node)
+{
+	/* A ghost hit means the block is wanted again: treat as frequent */
+	if (node->list == BLKC_B1 || node->list == BLKC_B2)
+		cache_list_move(node, BLKC_T2);
+	else
+		cache_list_move(node, BLKC_T1);
+}
+#endif
 
-static struct block_cache_stats _stats = {
-	.max_blocks_per_entry = 8,
-	.max_entries = 32
+static struct block_cache_policy cache_policies[] = {
+	{
+		.name = "lru",
+		.access = lru_access,
+		.admit = lru_admit,
+		.evict = lru_evict,
+		.place = lru_place,
+	},
+#if CONFIG_IS_ENABLED(BLOCK_CACHE_ARC)
+	{
+		.name = "arc",
+		.access = arc_access,
+		.admit = arc_admit,
+		.evict = arc_evict,
+		.place = arc_place,
+	},
+#endif
 };
 
+static const struct block_cache_policy *cache_find_policy(const char *name)
+{
+	int i;
+
+	if (!name)
+		return NULL;
+
+	for (i = 0; i < ARRAY_SIZE(cache_policies); i++)
+		if (!strcmp(cache_policies[i].name, name))
+			return &cache_policies[i];
+
+	return NULL;
+}
+
 #ifdef CONFIG_NEEDS_MANUAL_RELOC
 int blkcache_init(void)
 {
-	struct list_head *head = &block_cache;
+	struct block_cache_policy *policy;
+	int i;
 
-	head->next = (uintptr_t)head->next + gd->reloc_off;
-	head->prev = (uintptr_t)head->prev + gd->reloc_off;
+	for (i = 0; i < ARRAY_SIZE(cache_policies); i++) {
+		policy = &cache_policies[i];
+		policy->name += gd->reloc_off;
+		policy->access += gd->reloc_off;
+		policy->admit += gd->reloc_off;
+		policy->evict += gd->reloc_off;
+		policy->place += gd->reloc_off;
+	}
 
 	return 0;
 }
 #endif
 
-static struct block_cache_node *cache_find(int iftype, int devnum,
-					   lbaint_t start, lbaint_t blkcnt,
-					   unsigned long blksz)
+/*
+ * Pick up the initial size and policy. These may be overridden by the
+ * 'blkcache_size' and 'blkcache_policy' environment variables, or later with
+ * the 'blkcache' command.
+ */
+static void cache_load_config(void)
 {
-	struct block_cache_node *node;
+	INIT_LIST_HEAD(&cache.devs);
+	cache.stats.size = CONFIG_BLOCK_CACHE_SIZE;
+	cache.policy = cache_find_policy(CONFIG_BLOCK_CACHE_POLICY);
+#if !defined(CONFIG_SPL_BUILD) || CONFIG_IS_ENABLED(ENV_SUPPORT)
+	cache.stats.size = env_get_hex("blkcache_size", cache.stats.size);
+	if (cache_find_policy(env_get("blkcache_policy")))
+		cache.policy = cache_find_policy(env_get("blkcache_policy"));
+#endif
+	if (!cache.policy)
+		cache.policy = &cache_policies[0];
+}
+
+/*
+ * Set up the hash table and lists for the current configuration. This is
+ * done on first use and then again each time the configuration changes.
+ */
+static int cache_setup(void)
+{
+	ulong buckets;
+	int i;
+
+	if (!cache.policy)
+		cache_load_config();
+
+	for (i = 0; i < BLKC_LIST_COUNT; i++)
+		INIT_LIST_HEAD(&cache.list[i]);
+
+	/* Allow for ghost entries of the smallest likely block size */
+	buckets = roundup_pow_of_two(max(cache.stats.size / 512, 16UL));
+	cache.hash_bits = ilog2(buckets);
+	cache.hash = calloc(buckets, sizeof(*cache.hash));
+	if (!cache.hash)
+		return -ENOMEM;
 
-	list_for_each_entry(node, &block_cache, lh)
-		if ((node->iftype == iftype) &&
-		    (node->devnum == devnum) &&
-		    (node->blksz == blksz) &&
-		    (node->start <= start) &&
-		    (node->start + node->blkcnt >= start + blkcnt)) {
-			if (block_cache.next != &node->lh) {
-				/* maintain MRU ordering */
-				list_del(&node->lh);
-				list_add(&node->lh, &block_cache);
-			}
-			return node;
-		}
 	return 0;
 }
 
+/* Check that the cache has been set up, doing so on first use */
+static inline bool cache_ready(void)
+{
+	return cache.hash || !cache_setup();
+}
+
+static struct block_cache_dev *cache_get_dev(int iftype, int devnum)
+{
+	struct block_cache_dev *bdev;
+
+	list_for_each_entry(bdev, &cache.devs, lh)
+		if (bdev->iftype == iftype && bdev->devnum == devnum)
+			return bdev;
+
+	bdev = calloc(1, sizeof(*bdev));
+	if (!bdev)
+		return NULL;
+	bdev->iftype = iftype;
+	bdev->devnum = devnum;
+	list_add_tail(&bdev->lh, &cache.devs);
+
+	return bdev;
+}
+
+static void cache_fill_block(int iftype, int devnum, lbaint_t lba,
+			     unsigned long blksz, const void *src)
+{
+	const struct block_cache_policy *policy = cache.policy;
+	struct block_cache_node *node, *victim;
+	char *spare = NULL;
+
+	node = cache_find(iftype, devnum, lba, blksz);
+	if (node && node->data) {
+		memcpy(node->data, src, blksz);
+		return;
+	}
+
+	if (!node) {
+		node = calloc(1, sizeof(*node));
+		if (!node)
+			return;
+		node->iftype = iftype;
+		node->devnum = devnum;
+		node->lba = lba;
+		node->blksz = blksz;
+		node->list = BLKC_LIST_NONE;
+		hlist_add_head(&node->hn,
+			       &cache.hash[cache_hash(iftype, devnum, lba)]);
+	}
+
+	policy->admit(node);
+	while (cache.stats.used + blksz > cache.stats.size) {
+		victim = policy->evict(node);
+		if (!victim)
+			break;
+		debug("drop: lba " LBAF "\n", victim->lba);
+		/* Reuse the buffer of a same-sized victim */
+		if (!spare && victim->blksz == blksz)
+			spare = victim->data;
+		else
+			free(victim->data);
+		victim->data = NULL;
+		cache.stats.used -= victim->blksz;
+		cache.stats.entries--;
+		if (victim->list == BLKC_LIST_NONE)
+			cache_drop(victim);
+	}
+
+	if (cache.stats.used + blksz > cache.stats.size)
+		goto err;
+
+	node->data = spare ? spare : malloc(blksz);
+	if (!node->data)
+		goto err;
+	memcpy(node->data, src, blksz);
+	cache.stats.used += blksz;
+	cache.stats.entries++;
+	policy->place(node);
+
+	return;
+err:
+	free(spare);
+	cache_drop(node);
+}
+
 int blkcache_read(int iftype, int devnum,
 		  lbaint_t start, lbaint_t blkcnt,
 		  unsigned long blksz, void *buffer)
 {
-	struct block_cache_node *node = cache_find(iftype, devnum, start,
-						   blkcnt, blksz);
-	if (node) {
-		const char *src = node->cache + (start - node->start) * blksz;
-		memcpy(buffer, src, blksz * blkcnt);
-		debug("hit: start " LBAF ", count " LBAFU "\n",
+	struct block_cache_node *node;
+	struct block_cache_dev *bdev;
+	lbaint_t i;
+
+	if (blkcnt > cache.stats.max_blocks_per_entry || !cache_ready())
+		return 0;
+
+	bdev = cache_get_dev(iftype, devnum);
+	for (i = 0; i < blkcnt; i++) {
+		node = cache_find(iftype, devnum, start + i, blksz);
+		if (!node || !node->data)
+			break;
+	}
+
+	if (i < blkcnt) {
+		debug("miss: start " LBAF ", count " LBAFU "\n",
 		      start, blkcnt);
-		++_stats.hits;
-		return 1;
+		++cache.stats.misses;
+		if (bdev)
+			++bdev->stats.misses;
+		return 0;
 	}
 
-	debug("miss: start " LBAF ", count " LBAFU "\n",
+	for (i = 0; i < blkcnt; i++) {
+		node = cache_find(iftype, devnum, start + i, blksz);
+		memcpy(buffer + i * blksz, node->data, blksz);
+		cache.policy->access(node);
+	}
+	debug("hit: start " LBAF ", count " LBAFU "\n",
 	      start, blkcnt);
-	++_stats.misses;
-	return 0;
+	++cache.stats.hits;
+	if (bdev) {
+		++bdev->stats.hits;
+		bdev->next = start + blkcnt;
+	}
+
+	return 1;
+}
+
+lbaint_t blkcache_readahead(int iftype, int devnum,
+			    lbaint_t start, lbaint_t blkcnt)
+{
+	struct block_cache_dev *bdev;
+	bool sequential;
+
+	if (!cache.stats.readahead || !cache.stats.size ||
+	    blkcnt > cache.stats.max_blocks_per_entry || !cache_ready())
+		return 0;
+
+	bdev = cache_get_dev(iftype, devnum);
+	if (!bdev)
+		return 0;
+
+	sequential = start && start == bdev->next;
+	bdev->next = start + blkcnt;
+	if (!sequential)
+		return 0;
+
+	bdev->stats.readaheads++;
+
+	return cache.stats.readahead;
 }
 
 void blkcache_fill(int iftype, int devnum,
 		   lbaint_t start, lbaint_t blkcnt,
 		   unsigned long blksz, void const *buffer)
 {
-	lbaint_t bytes;
-	struct block_cache_node *node;
+	lbaint_t i;
 
 	/* don't cache big stuff */
-	if (blkcnt > _stats.max_blocks_per_entry)
+	if (blkcnt > cache.stats.max_blocks_per_entry + cache.stats.readahead)
 		return;
 
-	if (_stats.max_entries == 0)
+	if (!cache.stats.size || !cache_ready())
 		return;
 
-	bytes = blksz * blkcnt;
-	if (_stats.max_entries <= _stats.entries) {
-		/* pop LRU */
-		node = (struct block_cache_node *)block_cache.prev;
-		list_del(&node->lh);
-		_stats.entries--;
-		debug("drop: start " LBAF ", count " LBAFU "\n",
-		      node->start, node->blkcnt);
-		if (node->blkcnt * node->blksz < bytes) {
-			free(node->cache);
-			node->cache = 0;
-		}
-	} else {
-		node = malloc(sizeof(*node));
-		if (!node)
-			return;
-		node->cache = 0;
-	}
-
-	if (!node->cache) {
-		node->cache = malloc(bytes);
-		if (!node->cache) {
-			free(node);
-			return;
-		}
-	}
-
 	debug("fill: start " LBAF ", count " LBAFU "\n",
 	      start, blkcnt);
 
-	node->iftype = iftype;
-	node->devnum = devnum;
-	node->start = start;
-	node->blkcnt = blkcnt;
-	node->blksz = blksz;
-	memcpy(node->cache, buffer, bytes);
-	list_add(&node->lh, &block_cache);
-	_stats.entries++;
+	for (i = 0; i < blkcnt; i++)
+		cache_fill_block(iftype, devnum, start + i, blksz,
+				 buffer + i * blksz);
 }
 
 void blkcache_invalidate(int iftype, int devnum)
 {
-	struct list_head *entry, *n;
-	struct block_cache_node *node;
+	struct block_cache_node *node, *n;
+	struct block_cache_dev *bdev;
+	int i;
 
-	list_for_each_safe(entry, n, &block_cache) {
-		node = (struct block_cache_node *)entry;
-		if ((node->iftype == iftype) &&
-		    (node->devnum == devnum)) {
-			list_del(entry);
-			free(node->cache);
-			free(node);
-			--_stats.entries;
-		}
+	if (!cache.hash)
+		return;
+
+	for (i = 0; i < BLKC_LIST_COUNT; i++)
+		list_for_each_entry_safe(node, n, &cache.list[i], lh)
+			if (node->iftype == iftype && node->devnum == devnum)
+				cache_drop(node);
+
+	list_for_each_entry(bdev, &cache.devs, lh)
+		if (bdev->iftype == iftype && bdev->devnum == devnum)
+			bdev->next = 0;
+}
+
+static void cache_flush(void)
+{
+	struct block_cache_node *node, *n;
+	int i;
+
+	for (i = 0; i < BLKC_LIST_COUNT; i++)
+		list_for_each_entry_safe(node, n, &cache.list[i], lh)
+			cache_drop(node);
+	cache.target = 0;
+	free(cache.hash);
+	cache.hash = NULL;
+}
+
+void blkcache_configure_bytes(unsigned blocks, ulong max_bytes)
+{
+	if (!cache_ready())
+		return;
+
+	cache.stats.max_blocks_per_entry = blocks;
+
+	/* the hash table is sized for the budget, so start again */
+	if (max_bytes != cache.stats.size) {
+		cache_flush();
+		cache.stats.size = max_bytes;
+		cache_setup();
 	}
+
+	cache.stats.hits = 0;
+	cache.stats.misses = 0;
 }
 
-void blkcache_configure(unsigned blocks, unsigned entries)
+int blkcache_set_policy(const char *name)
 {
-	struct block_cache_node *node;
-	if ((blocks != _stats.max_blocks_per_entry) ||
-	    (entries != _stats.max_entries)) {
-		/* invalidate cache */
-		while (!list_empty(&block_cache)) {
-			node = (struct block_cache_node *)block_cache.next;
-			list_del(&node->lh);
-			free(node->cache);
-			free(node);
-		}
-		_stats.entries = 0;
+	const struct block_cache_policy *policy = cache_find_policy(name);
+
+	if (!policy)
+		return -EINVAL;
+	if (!cache_ready())
+		return -ENOMEM;
+
+	if (policy != cache.policy) {
+		cache_flush();
+		cache.policy = policy;
+		if (cache_setup())
+			return -ENOMEM;
 	}
 
-	_stats.max_blocks_per_entry = blocks;
-	_stats.max_entries = entries;
+	return 0;
+}
 
-	_stats.hits = 0;
-	_stats.misses = 0;
+void blkcache_set_readahead(unsigned blocks)
+{
+	cache.stats.readahead = blocks;
 }
 
 void blkcache_stats(struct block_cache_stats *stats)
 {
-	memcpy(stats, &_stats, sizeof(*stats));
-	_stats.hits = 0;
-	_stats.misses = 0;
+	struct block_cache_dev *bdev;
+
+	cache_ready();
+	memcpy(stats, &cache.stats, sizeof(*stats));
+	stats->policy = cache.policy ? cache.policy->name : "";
+	cache.stats.hits = 0;
+	cache.stats.misses = 0;
+	if (cache.policy)
+		list_for_each_entry(bdev, &cache.devs, lh)
+			memset(&bdev->stats, '\0', sizeof(bdev->stats));
+}
+
+int blkcache_dev_stats(int index, struct block_cache_dev_stats *stats)
+{
+	struct block_cache_dev *bdev;
+
+	if (!cache.policy)
+		return -ENOENT;
+
+	list_for_each_entry(bdev, &cache.devs, lh) {
+		if (!index--) {
+			memcpy(stats, &bdev->stats, sizeof(*stats));
+			stats->iftype = bdev->iftype;
+			stats->devnum = bdev->devnum;
+			return 0;
+		}
+	}
+
+	return -ENOENT;
 }
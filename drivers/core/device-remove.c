@@ -254,7 +254,8 @@ int device_remove(struct udevice *dev, uint flags)
 
 	device_free(dev);
 
-	dev_bic_flags(dev, DM_FLAG_ACTIVATED);
+	dev_bic_flags(dev, DM_FLAG_ACTIVATED | DM_FLAG_PROBE_POLL |
+		      DM_FLAG_PROBE_PENDING);
 
 	return 0;
 
@@ -32,6 +32,7 @@
 #include <linux/err.h>
 #include <linux/list.h>
 #include <power-domain.h>
+#include <watchdog.h>
 
 DECLARE_GLOBAL_DATA_PTR;
 
@@ -482,15 +483,17 @@ static int device_get_dma_constraints(struct udevice *dev)
 	return 0;
 }
 
-int device_probe(struct udevice *dev)
+/*
+ * Start probing a device, up to and including its probe() method. If this
+ * succeeds, DM_FLAG_PROBE_PENDING is set and device_probe_finish() must be
+ * called, after waiting for the device with device_probe_poll().
+ */
+static int device_probe_start(struct udevice *dev)
 {
 	const struct driver *drv;
 	int ret;
 	int seq;
 
-	if (!dev)
-		return -EINVAL;
-
 	if (dev_get_flags(dev) & DM_FLAG_ACTIVATED)
 		return 0;
 
@@ -524,6 +527,7 @@ int device_probe(struct udevice *dev)
 			goto fail;
 		}
 		dev->seq_ = seq;
+		uclass_index_update(dev);
 	}
 
 	dev_or_flags(dev, DM_FLAG_ACTIVATED);
@@ -595,7 +599,51 @@ int device_probe(struct udevice *dev)
 		if (ret)
 			goto fail;
 	}
+	dev_or_flags(dev, DM_FLAG_PROBE_PENDING);
+#if CONFIG_IS_ENABLED(DM_ASYNC_PROBE)
+	if (drv->probe_poll)
+		dev_or_flags(dev, DM_FLAG_PROBE_POLL);
+#endif
+
+	return 0;
+fail:
+	dev_bic_flags(dev, DM_FLAG_ACTIVATED);
+
+	device_free(dev);
+
+	return ret;
+}
+
+/*
+ * Check whether a device is ready, returning -EAGAIN if not. If the driver's
+ * probe_poll() method fails, the probe is abandoned.
+ */
+static int device_probe_poll(struct udevice *dev)
+{
+	int ret = 0;
+
+#if CONFIG_IS_ENABLED(DM_ASYNC_PROBE)
+	if (!(dev_get_flags(dev) & DM_FLAG_PROBE_POLL))
+		return 0;
+	ret = dev->driver->probe_poll(dev);
+	if (ret == -EAGAIN)
+		return ret;
+	dev_bic_flags(dev, DM_FLAG_PROBE_POLL);
+	if (ret) {
+		dev_bic_flags(dev, DM_FLAG_PROBE_PENDING | DM_FLAG_ACTIVATED);
+		device_free(dev);
+	}
+#endif
+
+	return ret;
+}
+
+/* Finish probing a device once it is ready */
+static int device_probe_finish(struct udevice *dev)
+{
+	int ret;
 
+	dev_bic_flags(dev, DM_FLAG_PROBE_PENDING);
 	ret = uclass_post_probe_device(dev);
 	if (ret)
 		goto fail_uclass;
@@ -613,7 +661,6 @@ fail_uclass:
 		dm_warn("%s: Device '%s' failed to remove on error path\n",
 			__func__, dev->name);
 	}
-fail:
 	dev_bic_flags(dev, DM_FLAG_ACTIVATED);
 
 	device_free(dev);
@@ -621,6 +668,78 @@ fail:
 	return ret;
 }
 
+int device_probe(struct udevice *dev)
+{
+	int ret;
+
+	if (!dev)
+		return -EINVAL;
+
+	ret = device_probe_start(dev);
+	if (ret)
+		return ret;
+
+	/*
+	 * This also finishes a device which is waiting in
+	 * device_probe_async(), if another device needs it
+	 */
+	if (!(dev_get_flags(dev) & DM_FLAG_PROBE_PENDING))
+		return 0;
+	while ((ret = device_probe_poll(dev)) == -EAGAIN)
+		WATCHDOG_RESET();
+	if (ret)
+		return ret;
+
+	return device_probe_finish(dev);
+}
+
+#if CONFIG_IS_ENABLED(DM_ASYNC_PROBE)
+int device_probe_async(struct udevice *const devs[], int count)
+{
+	int i, ret, pending;
+	int err = 0;
+
+	for (i = 0; i < count; i++) {
+		ret = device_probe_start(devs[i]);
+		if (ret) {
+			log_debug("Device '%s' failed to probe: %d\n",
+				  devs[i]->name, ret);
+			if (!err)
+				err = ret;
+		}
+	}
+
+	do {
+		pending = 0;
+		for (i = 0; i < count; i++) {
+			if (!(dev_get_flags(devs[i]) & DM_FLAG_PROBE_POLL))
+				continue;
+			ret = device_probe_poll(devs[i]);
+			if (ret == -EAGAIN) {
+				pending++;
+			} else if (ret) {
+				log_debug("Device '%s' failed to probe: %d\n",
+					  devs[i]->name, ret);
+				if (!err)
+					err = ret;
+			}
+		}
+		WATCHDOG_RESET();
+	} while (pending);
+
+	/* Finish in the order given, so that sequence numbers are stable */
+	for (i = 0; i < count; i++) {
+		if (!(dev_get_flags(devs[i]) & DM_FLAG_PROBE_PENDING))
+			continue;
+		ret = device_probe_finish(devs[i]);
+		if (ret && !err)
+			err = ret;
+	}
+
+	return err;
+}
+#endif
+
 void *dev_get_plat(const struct udevice *dev)
 {
 	if (!dev) {
@@ -834,9 +953,21 @@ static struct udevice *_device_find_global_by_ofnode(struct udevice *parent,
 	return NULL;
 }
 
+static struct udevice *find_global_by_ofnode(ofnode ofnode)
+{
+	struct udevice *dev;
+	int ret;
+
+	ret = uclass_index_find_by_ofnode(UCLASS_INVALID, ofnode, &dev);
+	if (ret != -ENOSYS)
+		return ret ? NULL : dev;
+
+	return _device_find_global_by_ofnode(gd->dm_root, ofnode);
+}
+
 int device_find_global_by_ofnode(ofnode ofnode, struct udevice **devp)
 {
-	*devp = _device_find_global_by_ofnode(gd->dm_root, ofnode);
+	*devp = find_global_by_ofnode(ofnode);
 
 	return *devp ? 0 : -ENOENT;
 }
@@ -845,7 +976,7 @@ int device_get_global_by_ofnode(ofnode ofnode, struct udevice **devp)
 {
 	struct udevice *dev;
 
-	dev = _device_find_global_by_ofnode(gd->dm_root, ofnode);
+	dev = find_global_by_ofnode(ofnode);
 	return device_get_device_tail(dev, dev ? 0 : -ENOENT, devp);
 }
 
@@ -1084,6 +1215,7 @@ int device_set_name(struct udevice *dev, const char *name)
 		return -ENOMEM;
 	dev->name = name;
 	device_set_name_alloced(dev);
+	uclass_index_update(dev);
 
 	return 0;
 }
@@ -181,6 +181,12 @@ int dm_init(bool of_live)
 		fix_devices();
 	}
 
+	if (CONFIG_IS_ENABLED(DM_INDEX) && (gd->flags & GD_FLG_RELOC)) {
+		ret = uclass_index_init();
+		if (ret)
+			return ret;
+	}
+
 	if (CONFIG_IS_ENABLED(OF_PLATDATA_INST)) {
 		ret = dm_setup_inst();
 		if (ret) {
@@ -192,8 +198,10 @@ int dm_init(bool of_live)
 					  &DM_ROOT_NON_CONST);
 		if (ret)
 			return ret;
-		if (CONFIG_IS_ENABLED(OF_CONTROL))
+		if (CONFIG_IS_ENABLED(OF_CONTROL)) {
 			dev_set_ofnode(DM_ROOT_NON_CONST, ofnode_root());
+			uclass_index_update(DM_ROOT_NON_CONST);
+		}
 		ret = device_probe(DM_ROOT_NON_CONST);
 		if (ret)
 			return ret;
@@ -209,6 +217,7 @@ int dm_uninit(void)
 	device_remove(dm_root(), DM_REMOVE_NORMAL);
 	device_unbind(dm_root());
 	gd->dm_root = NULL;
+	uclass_index_uninit();
 
 	return 0;
 }
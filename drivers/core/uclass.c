@@ -23,20 +23,268 @@
 
 DECLARE_GLOBAL_DATA_PTR;
 
+#if CONFIG_IS_ENABLED(DM_INDEX)
+/* Number of hash buckets in each device index is 1 << DM_INDEX_BITS */
+#define DM_INDEX_BITS	8
+
+/**
+ * struct dm_index - Indexes of uclasses and devices
+ *
+ * Devices are added to the end of their hash chains, so that where several
+ * devices match, the first one bound is found, as with a walk of the uclass.
+ * Devices without a sequence number, devicetree node or phandle are not
+ * added to the corresponding index.
+ *
+ * @uclass: Uclass for each ID, or NULL if not looked up yet
+ * @seq: Devices hashed by uclass ID and sequence number
+ * @name: Devices hashed by uclass ID and name
+ * @ofnode: Devices hashed by devicetree node
+ * @phandle: Devices hashed by the phandle of their devicetree node
+ */
+struct dm_index {
+	struct uclass *uclass[UCLASS_COUNT];
+	struct hlist_head seq[1 << DM_INDEX_BITS];
+	struct hlist_head name[1 << DM_INDEX_BITS];
+	struct hlist_head ofnode[1 << DM_INDEX_BITS];
+	struct hlist_head phandle[1 << DM_INDEX_BITS];
+};
+
+static uint index_hash(uint val)
+{
+	/* Multiplicative hashing, as used by Linux's hash_32() */
+	return (val * 0x61c88647) >> (32 - DM_INDEX_BITS);
+}
+
+static uint index_hash_seq(enum uclass_id id, int seq)
+{
+	return index_hash(id << 16 ^ seq);
+}
+
+static uint index_hash_name(enum uclass_id id, const char *name)
+{
+	uint val = id;
+
+	while (*name)
+		val = val * 31 + *name++;
+
+	return index_hash(val);
+}
+
+static uint index_hash_ofnode(ofnode node)
+{
+	return index_hash(node.of_offset);
+}
+
+static struct uclass **index_uclass(enum uclass_id id)
+{
+	struct dm_index *idx = gd_dm_index();
+
+	if (!idx || id < 0 || id >= UCLASS_COUNT)
+		return NULL;
+
+	return &idx->uclass[id];
+}
+
+static void index_add_tail(struct hlist_node *node, struct hlist_head *head)
+{
+	struct hlist_node *last = head->first;
+
+	if (!last) {
+		hlist_add_head(node, head);
+		return;
+	}
+	while (last->next)
+		last = last->next;
+	hlist_add_after(last, node);
+}
+
+static void index_add(struct udevice *dev)
+{
+	struct dm_index *idx = gd_dm_index();
+	enum uclass_id id;
+	ofnode node;
+	uint phandle;
+
+	if (!idx)
+		return;
+	id = device_get_uclass_id(dev);
+	if (dev->seq_ != -1)
+		index_add_tail(&dev->seq_node,
+			       &idx->seq[index_hash_seq(id, dev->seq_)]);
+	index_add_tail(&dev->name_node,
+		       &idx->name[index_hash_name(id, dev->name)]);
+	node = dev_ofnode(dev);
+	if (CONFIG_IS_ENABLED(OF_REAL) && ofnode_valid(node)) {
+		index_add_tail(&dev->ofnode_node,
+			       &idx->ofnode[index_hash_ofnode(node)]);
+		phandle = dev_read_phandle(dev);
+		if (phandle)
+			index_add_tail(&dev->phandle_node,
+				       &idx->phandle[index_hash(phandle)]);
+	}
+}
+
+static void index_del(struct udevice *dev)
+{
+	hlist_del_init(&dev->seq_node);
+	hlist_del_init(&dev->name_node);
+	hlist_del_init(&dev->ofnode_node);
+	hlist_del_init(&dev->phandle_node);
+}
+
+int uclass_index_init(void)
+{
+	struct dm_index *idx = gd_dm_index();
+
+	if (idx) {
+		memset(idx, '\0', sizeof(*idx));
+		return 0;
+	}
+	idx = calloc(1, sizeof(*idx));
+	if (!idx)
+		return -ENOMEM;
+	gd_set_dm_index(idx);
+
+	return 0;
+}
+
+void uclass_index_uninit(void)
+{
+	free(gd_dm_index());
+	gd_set_dm_index(NULL);
+}
+
+void uclass_index_update(struct udevice *dev)
+{
+	/* Every indexed device is in the name index */
+	if (hlist_unhashed(&dev->name_node))
+		return;
+	index_del(dev);
+	index_add(dev);
+}
+
+int uclass_index_find_by_ofnode(enum uclass_id id, ofnode node,
+				struct udevice **devp)
+{
+	struct dm_index *idx = gd_dm_index();
+	struct hlist_node *pos;
+	struct udevice *dev;
+
+	if (!idx)
+		return -ENOSYS;
+	hlist_for_each_entry(dev, pos, &idx->ofnode[index_hash_ofnode(node)],
+			     ofnode_node) {
+		if (ofnode_equal(dev_ofnode(dev), node) &&
+		    (id == UCLASS_INVALID || device_get_uclass_id(dev) == id)) {
+			*devp = dev;
+			return 0;
+		}
+	}
+
+	return -ENODEV;
+}
+
+static int index_find_by_seq(enum uclass_id id, int seq,
+			     struct udevice **devp)
+{
+	struct dm_index *idx = gd_dm_index();
+	struct hlist_node *pos;
+	struct udevice *dev;
+
+	if (!idx)
+		return -ENOSYS;
+	hlist_for_each_entry(dev, pos, &idx->seq[index_hash_seq(id, seq)],
+			     seq_node) {
+		if (dev->seq_ == seq && device_get_uclass_id(dev) == id) {
+			*devp = dev;
+			return 0;
+		}
+	}
+
+	return -ENODEV;
+}
+
+static int index_find_by_name(enum uclass_id id, const char *name,
+			      struct udevice **devp)
+{
+	struct dm_index *idx = gd_dm_index();
+	struct hlist_node *pos;
+	struct udevice *dev;
+
+	if (!idx)
+		return -ENOSYS;
+	hlist_for_each_entry(dev, pos, &idx->name[index_hash_name(id, name)],
+			     name_node) {
+		if (!strcmp(dev->name, name) &&
+		    device_get_uclass_id(dev) == id) {
+			*devp = dev;
+			return 0;
+		}
+	}
+
+	return -ENODEV;
+}
+
+static int index_find_by_phandle(enum uclass_id id, uint phandle,
+				 struct udevice **devp)
+{
+	struct dm_index *idx = gd_dm_index();
+	struct hlist_node *pos;
+	struct udevice *dev;
+
+	if (!idx)
+		return -ENOSYS;
+	hlist_for_each_entry(dev, pos, &idx->phandle[index_hash(phandle)],
+			     phandle_node) {
+		if (device_get_uclass_id(dev) == id &&
+		    dev_read_phandle(dev) == phandle) {
+			*devp = dev;
+			return 0;
+		}
+	}
+
+	return -ENODEV;
+}
+#else
+static struct uclass **index_uclass(enum uclass_id id) { return NULL; }
+static void index_add(struct udevice *dev) {}
+static void index_del(struct udevice *dev) {}
+
+static int index_find_by_seq(enum uclass_id id, int seq,
+			     struct udevice **devp)
+{
+	return -ENOSYS;
+}
+
+static int index_find_by_name(enum uclass_id id, const char *name,
+			      struct udevice **devp)
+{
+	return -ENOSYS;
+}
+
+static int index_find_by_phandle(enum uclass_id id, uint phandle,
+				 struct udevice **devp)
+{
+	return -ENOSYS;
+}
+#endif
+
 struct uclass *uclass_find(enum uclass_id key)
 {
+	struct uclass **slot;
 	struct uclass *uc;
 
 	if (!gd->dm_root)
 		return NULL;
-	/*
-	 * TODO(sjg@chromium.org): Optimise this, perhaps moving the found
-	 * node to the start of the list, or creating a linear array mapping
-	 * id to node.
-	 */
+	slot = index_uclass(key);
+	if (slot && *slot)
+		return *slot;
 	list_for_each_entry(uc, gd->uclass_root, sibling_node) {
-		if (uc->uc_drv->id == key)
+		if (uc->uc_drv->id == key) {
+			if (slot)
+				*slot = uc;
 			return uc;
+		}
 	}
 
 	return NULL;
@@ -111,6 +359,7 @@ fail_mem:
 int uclass_destroy(struct uclass *uc)
 {
 	struct uclass_driver *uc_drv;
+	struct uclass **slot;
 	struct udevice *dev;
 	int ret;
 
@@ -134,6 +383,9 @@ int uclass_destroy(struct uclass *uc)
 	uc_drv = uc->uc_drv;
 	if (uc_drv->destroy)
 		uc_drv->destroy(uc);
+	slot = index_uclass(uc_drv->id);
+	if (slot)
+		*slot = NULL;
 	list_del(&uc->sibling_node);
 	if (uc_drv->priv_auto)
 		free(uclass_get_priv(uc));
@@ -286,6 +538,9 @@ int uclass_find_device_by_name(enum uclass_id id, const char *name,
 	ret = uclass_get(id, &uc);
 	if (ret)
 		return ret;
+	ret = index_find_by_name(id, name, devp);
+	if (ret != -ENOSYS)
+		return ret;
 
 	uclass_foreach_dev(dev, uc) {
 		if (!strcmp(dev->name, name)) {
@@ -333,6 +588,9 @@ int uclass_find_device_by_seq(enum uclass_id id, int seq, struct udevice **devp)
 	ret = uclass_get(id, &uc);
 	if (ret)
 		return ret;
+	ret = index_find_by_seq(id, seq, devp);
+	if (ret != -ENOSYS)
+		return ret;
 
 	uclass_foreach_dev(dev, uc) {
 		log_debug("   - seq_=%d name='%s'\n", dev->seq_, dev->name);
@@ -420,6 +678,9 @@ int uclass_find_device_by_ofnode(enum uclass_id id, ofnode node,
 	ret = uclass_get(id, &uc);
 	if (ret)
 		return ret;
+	ret = uclass_index_find_by_ofnode(id, node, devp);
+	if (ret != -ENOSYS)
+		goto done;
 
 	uclass_foreach_dev(dev, uc) {
 		log(LOGC_DM, LOGL_DEBUG_CONTENT, "      - checking %s\n",
@@ -453,6 +714,9 @@ int uclass_find_device_by_phandle(enum uclass_id id, struct udevice *parent,
 	ret = uclass_get(id, &uc);
 	if (ret)
 		return ret;
+	ret = index_find_by_phandle(id, find_phandle, devp);
+	if (ret != -ENOSYS)
+		return ret;
 
 	uclass_foreach_dev(dev, uc) {
 		uint phandle;
@@ -574,6 +838,9 @@ int uclass_get_device_by_phandle_id(enum uclass_id id, uint phandle_id,
 	ret = uclass_get(id, &uc);
 	if (ret)
 		return ret;
+	ret = index_find_by_phandle(id, phandle_id, &dev);
+	if (ret != -ENOSYS)
+		return uclass_get_device_tail(dev, ret, devp);
 
 	uclass_foreach_dev(dev, uc) {
 		uint phandle;
@@ -715,6 +982,7 @@ int uclass_bind_device(struct udevice *dev)
 
 	uc = dev->uclass;
 	list_add_tail(&dev->uclass_node, &uc->dev_head);
+	index_add(dev);
 
 	if (dev->parent) {
 		struct uclass_driver *uc_drv = dev->parent->uclass->uc_drv;
@@ -729,6 +997,7 @@ int uclass_bind_device(struct udevice *dev)
 	return 0;
 err:
 	/* There is no need to undo the parent's post_bind call */
+	index_del(dev);
 	list_del(&dev->uclass_node);
 
 	return ret;
@@ -752,6 +1021,7 @@ int uclass_pre_unbind_device(struct udevice *dev)
 
 int uclass_unbind_device(struct udevice *dev)
 {
+	index_del(dev);
 	list_del(&dev->uclass_node);
 
 	return 0;
@@ -842,6 +1112,36 @@ int uclass_probe_all(enum uclass_id id)
 	return 0;
 }
 
+int uclass_probe_all_async(enum uclass_id id)
+{
+	struct udevice **devs;
+	struct udevice *dev;
+	struct uclass *uc;
+	int count, i, ret;
+
+	ret = uclass_get(id, &uc);
+	if (ret)
+		return ret;
+
+	count = 0;
+	uclass_foreach_dev(dev, uc)
+		count++;
+	if (!count)
+		return 0;
+
+	devs = calloc(count, sizeof(*devs));
+	if (!devs)
+		return -ENOMEM;
+	i = 0;
+	uclass_foreach_dev(dev, uc)
+		devs[i++] = dev;
+
+	ret = device_probe_async(devs, count);
+	free(devs);
+
+	return ret;
+}
+
 int uclass_id_count(enum uclass_id id)
 {
 	struct udevice *dev;
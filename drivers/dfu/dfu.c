@@ -7,6 +7,7 @@
  */
 
 #include <common.h>
+#include <div64.h>
 #include <env.h>
 #include <errno.h>
 #include <log.h>
@@ -15,6 +16,8 @@
 #include <fat.h>
 #include <dfu.h>
 #include <hash.h>
+#include <time.h>
+#include <watchdog.h>
 #include <linux/list.h>
 #include <linux/compiler.h>
 
@@ -182,8 +185,142 @@ static unsigned char *dfu_buf;
 static unsigned long dfu_buf_size;
 static enum dfu_device_type dfu_buf_device_type;
 
+/**
+ * struct dfu_write_back - A buffer being written while the next one fills
+ *
+ * With CONFIG_DFU_WRITE_BACK two buffers of dfu_buf_size are allocated. When
+ * one is full it is handed over here and dfu_write() carries on with the
+ * other. The full one is written out in steps by dfu_write_poll(), so that
+ * USB requests are still handled while the medium is busy.
+ *
+ * @dfu: Entity being written, or NULL if no write is pending
+ * @buf: Data to write
+ * @offset: Offset of @buf in the medium
+ * @len: Number of bytes in @buf
+ * @done: Number of bytes written so far
+ * @ret: Error from a failed write, reported by the next dfu_write() or
+ *	dfu_flush()
+ * @start: Time the first buffer of this transfer was handed over, in ms
+ * @bytes: Number of bytes handed over in this transfer
+ * @busy_us: Time spent writing to the medium
+ * @stall_us: Time spent waiting for a buffer to become free
+ */
+static struct dfu_write_back {
+	struct dfu_entity *dfu;
+	u8 *buf;
+	u64 offset;
+	long len;
+	long done;
+	int ret;
+	ulong start;
+	u64 bytes;
+	ulong busy_us;
+	ulong stall_us;
+} dfu_wb;
+
+static void dfu_write_back_cancel(void)
+{
+	memset(&dfu_wb, '\0', sizeof(dfu_wb));
+}
+
+/* Write the next part of the pending buffer */
+static int dfu_write_back_step(void)
+{
+	struct dfu_entity *dfu = dfu_wb.dfu;
+	long len = dfu_wb.len - dfu_wb.done;
+	ulong start;
+	int ret;
+
+	start = timer_get_us();
+	if (dfu->write_medium_step) {
+		ret = dfu->write_medium_step(dfu, dfu_wb.offset + dfu_wb.done,
+					     dfu_wb.buf + dfu_wb.done, &len);
+		if (!ret && len <= 0)
+			ret = -EIO;
+	} else {
+		ret = dfu->write_medium(dfu, dfu_wb.offset, dfu_wb.buf, &len);
+		len = dfu_wb.len;
+	}
+	dfu_wb.busy_us += timer_get_us() - start;
+
+	dfu_wb.done += min(len, dfu_wb.len - dfu_wb.done);
+	if (ret) {
+		debug("%s: Write error!\n", __func__);
+		dfu_wb.ret = ret;
+		dfu_wb.dfu = NULL;
+	} else if (dfu_wb.done == dfu_wb.len) {
+		dfu_wb.dfu = NULL;
+		puts("#");
+	}
+
+	return ret;
+}
+
+/* Finish the pending write, returning any error seen since the last call */
+static int dfu_write_back_wait(void)
+{
+	ulong start = timer_get_us();
+	int ret;
+
+	while (dfu_wb.dfu) {
+		WATCHDOG_RESET();
+		dfu_write_back_step();
+	}
+	dfu_wb.stall_us += timer_get_us() - start;
+	ret = dfu_wb.ret;
+	dfu_wb.ret = 0;
+
+	return ret;
+}
+
+/* Hand over the full buffer and carry on with the other one */
+static int dfu_write_back_queue(struct dfu_entity *dfu, long len)
+{
+	u8 *next;
+	int ret;
+
+	ret = dfu_write_back_wait();
+	if (ret)
+		return ret;
+
+	if (!dfu_wb.bytes)
+		dfu_wb.start = get_timer(0);
+	dfu_wb.dfu = dfu;
+	dfu_wb.buf = dfu->i_buf_start;
+	dfu_wb.offset = dfu->offset;
+	dfu_wb.len = len;
+	dfu_wb.done = 0;
+	dfu_wb.bytes += len;
+	dfu->offset += len;
+
+	next = dfu->i_buf_start == dfu_buf ? dfu_buf + dfu_buf_size : dfu_buf;
+	dfu->i_buf_start = next;
+	dfu->i_buf = next;
+	dfu->i_buf_end = next + dfu_buf_size;
+
+	return 0;
+}
+
+static void dfu_write_back_stats(void)
+{
+	ulong ms = max(get_timer(dfu_wb.start), 1UL);
+
+	if (!dfu_wb.bytes)
+		return;
+	printf("\nDFU wrote %llu bytes in %lu ms (%llu KiB/s), medium busy %lu ms, waited %lu ms\n",
+	       dfu_wb.bytes, ms, lldiv(dfu_wb.bytes * 1000, ms * 1024),
+	       dfu_wb.busy_us / 1000, dfu_wb.stall_us / 1000);
+}
+
+void dfu_write_poll(void)
+{
+	if (dfu_wb.dfu)
+		dfu_write_back_step();
+}
+
 unsigned char *dfu_free_buf(void)
 {
+	dfu_write_back_cancel();
 	free(dfu_buf);
 	dfu_buf = NULL;
 	return dfu_buf;
@@ -215,7 +352,13 @@ unsigned char *dfu_get_buf(struct dfu_entity *dfu)
 	if (dfu->max_buf_size && dfu_buf_size > dfu->max_buf_size)
 		dfu_buf_size = dfu->max_buf_size;
 
-	dfu_buf = memalign(CONFIG_SYS_CACHELINE_SIZE, dfu_buf_size);
+	if (IS_ENABLED(CONFIG_DFU_WRITE_BACK)) {
+		/* Keep the second buffer aligned too */
+		dfu_buf_size = ALIGN(dfu_buf_size, CONFIG_SYS_CACHELINE_SIZE);
+		dfu_buf = memalign(CONFIG_SYS_CACHELINE_SIZE, dfu_buf_size * 2);
+	} else {
+		dfu_buf = memalign(CONFIG_SYS_CACHELINE_SIZE, dfu_buf_size);
+	}
 	if (dfu_buf == NULL)
 		printf("%s: Could not memalign 0x%lx bytes\n",
 		       __func__, dfu_buf_size);
@@ -255,6 +398,9 @@ static int dfu_write_buffer_drain(struct dfu_entity *dfu)
 		dfu_hash_algo->hash_update(dfu_hash_algo, &dfu->crc,
 					   dfu->i_buf_start, w_size, 0);
 
+	if (IS_ENABLED(CONFIG_DFU_WRITE_BACK))
+		return dfu_write_back_queue(dfu, w_size);
+
 	ret = dfu->write_medium(dfu, dfu->offset, dfu->i_buf_start, &w_size);
 	if (ret)
 		debug("%s: Write error!\n", __func__);
@@ -273,6 +419,7 @@ static int dfu_write_buffer_drain(struct dfu_entity *dfu)
 void dfu_transaction_cleanup(struct dfu_entity *dfu)
 {
 	/* clear everything */
+	dfu_write_back_cancel();
 	dfu->crc = 0;
 	dfu->offset = 0;
 	dfu->i_blk_seq_num = 0;
@@ -318,6 +465,8 @@ int dfu_flush(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 	int ret = 0;
 
 	ret = dfu_write_buffer_drain(dfu);
+	if (!ret)
+		ret = dfu_write_back_wait();
 	if (ret)
 		return ret;
 
@@ -327,6 +476,7 @@ int dfu_flush(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 	if (dfu_hash_algo)
 		printf("\nDFU complete %s: 0x%08x\n", dfu_hash_algo->name,
 		       dfu->crc);
+	dfu_write_back_stats();
 
 	dfu_flush_callback(dfu);
 
@@ -371,6 +521,14 @@ int dfu_write(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 	/* handle rollover */
 	dfu->i_blk_seq_num = (dfu->i_blk_seq_num + 1) & 0xffff;
 
+	/* report a failure to write out an earlier buffer */
+	if (dfu_wb.ret) {
+		ret = dfu_wb.ret;
+		dfu_transaction_cleanup(dfu);
+		dfu_error_callback(dfu, "DFU write error");
+		return ret;
+	}
+
 	/* flush buffer if overflow */
 	if ((dfu->i_buf + size) > dfu->i_buf_end) {
 		ret = dfu_write_buffer_drain(dfu);
@@ -396,6 +554,13 @@ int dfu_write(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 	/* if end or if buffer full flush */
 	if (size == 0 || (dfu->i_buf + size) > dfu->i_buf_end) {
 		ret = dfu_write_buffer_drain(dfu);
+		/*
+		 * f_thor receives straight into the DFU buffer, so that must
+		 * be written out before the caller fills it again
+		 */
+		if (!ret && dfu_buf && (u8 *)buf >= dfu_buf &&
+		    (u8 *)buf < dfu_buf + dfu_buf_size * 2)
+			ret = dfu_write_back_wait();
 		if (ret) {
 			dfu_transaction_cleanup(dfu);
 			dfu_error_callback(dfu, "DFU write error");
@@ -17,6 +17,10 @@
 #include <mmc.h>
 #include <part.h>
 #include <command.h>
+#include <linux/sizes.h>
+
+/* Amount written by each write-back step */
+#define DFU_MMC_STEP_SIZE	SZ_1M
 
 static unsigned char *dfu_file_buf;
 static u64 dfu_file_buf_len;
@@ -221,6 +225,15 @@ int dfu_write_medium_mmc(struct dfu_entity *dfu,
 	return ret;
 }
 
+static int dfu_write_medium_step_mmc(struct dfu_entity *dfu,
+				     u64 offset, void *buf, long *len)
+{
+	if (*len > DFU_MMC_STEP_SIZE)
+		*len = DFU_MMC_STEP_SIZE;
+
+	return mmc_block_op(DFU_OP_WRITE, dfu, offset, buf, len);
+}
+
 int dfu_flush_medium_mmc(struct dfu_entity *dfu)
 {
 	int ret = 0;
@@ -452,6 +465,8 @@ int dfu_fill_entity_mmc(struct dfu_entity *dfu, char *devstr, char **argv, int a
 	dfu->get_medium_size = dfu_get_medium_size_mmc;
 	dfu->read_medium = dfu_read_medium_mmc;
 	dfu->write_medium = dfu_write_medium_mmc;
+	if (dfu->layout == DFU_RAW_ADDR)
+		dfu->write_medium_step = dfu_write_medium_step_mmc;
 	dfu->flush_medium = dfu_flush_medium_mmc;
 	dfu->inited = 0;
 	dfu->free_entity = dfu_free_entity_mmc;
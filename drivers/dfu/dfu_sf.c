@@ -14,6 +14,10 @@
 #include <jffs2/load_kernel.h>
 #include <linux/mtd/mtd.h>
 #include <linux/ctype.h>
+#include <linux/sizes.h>
+
+/* Amount programmed by each write-back step */
+#define DFU_SF_STEP_SIZE	SZ_16K
 
 static int dfu_get_medium_size_sf(struct dfu_entity *dfu, u64 *size)
 {
@@ -64,6 +68,30 @@ static int dfu_write_medium_sf(struct dfu_entity *dfu,
 	return 0;
 }
 
+static int dfu_write_medium_step_sf(struct dfu_entity *dfu,
+				    u64 offset, void *buf, long *len)
+{
+	struct spi_flash *dev = dfu->data.sf.dev;
+	u64 pos = dfu->data.sf.start + offset;
+	u64 sector = find_sector(dfu, dfu->data.sf.start, offset);
+	int ret;
+
+	/*
+	 * Steps stop at the end of each sector, so a step which starts a
+	 * sector erases it first
+	 */
+	if (!offset || pos == sector) {
+		ret = spi_flash_erase(dev, sector, dev->sector_size);
+		if (ret)
+			return ret;
+	}
+
+	*len = min_t(u64, min_t(long, *len, DFU_SF_STEP_SIZE),
+		     sector + dev->sector_size - pos);
+
+	return spi_flash_write(dev, pos, *len, buf);
+}
+
 static int dfu_flush_medium_sf(struct dfu_entity *dfu)
 {
 	u64 off, length;
@@ -229,6 +257,7 @@ int dfu_fill_entity_sf(struct dfu_entity *dfu, char *devstr, char **argv, int ar
 	dfu->get_medium_size = dfu_get_medium_size_sf;
 	dfu->read_medium = dfu_read_medium_sf;
 	dfu->write_medium = dfu_write_medium_sf;
+	dfu->write_medium_step = dfu_write_medium_step_sf;
 	dfu->flush_medium = dfu_flush_medium_sf;
 	dfu->poll_timeout = dfu_polltimeout_sf;
 	dfu->free_entity = dfu_free_entity_sf;
@@ -11,6 +11,7 @@
 #include <fb_mmc.h>
 #include <fb_nand.h>
 #include <flash.h>
+#include <image-sparse.h>
 #include <part.h>
 #include <stdlib.h>
 
@@ -19,6 +20,23 @@
  */
 static u32 image_size;
 
+#if CONFIG_IS_ENABLED(FASTBOOT_CMD_OEM_STREAM)
+/**
+ * stream_part - partition which sparse images are written to as they arrive
+ */
+static char stream_part[PART_NAME_LEN];
+
+/**
+ * stream_active - true if the current or last download is being streamed
+ */
+static bool stream_active;
+
+/**
+ * stream_response - result of the streamed download, reported by flash
+ */
+static char stream_response[FASTBOOT_RESPONSE_LEN];
+#endif
+
 /**
  * fastboot_bytes_received - number of bytes received in the current download
  */
@@ -48,6 +66,9 @@ static void oem_partconf(char *, char *);
 #if CONFIG_IS_ENABLED(FASTBOOT_CMD_OEM_BOOTBUS)
 static void oem_bootbus(char *, char *);
 #endif
+#if CONFIG_IS_ENABLED(FASTBOOT_CMD_OEM_STREAM)
+static void oem_stream(char *, char *);
+#endif
 
 #if CONFIG_IS_ENABLED(FASTBOOT_UUU_SUPPORT)
 static void run_ucmd(char *, char *);
@@ -122,6 +143,12 @@ static const struct {
 		.dispatch = oem_bootbus,
 	},
 #endif
+#if CONFIG_IS_ENABLED(FASTBOOT_CMD_OEM_STREAM)
+	[FASTBOOT_COMMAND_OEM_STREAM] = {
+		.command = "oem stream",
+		.dispatch = oem_stream,
+	},
+#endif
 #if CONFIG_IS_ENABLED(FASTBOOT_UUU_SUPPORT)
 	[FASTBOOT_COMMAND_UCMD] = {
 		.command = "UCmd",
@@ -193,6 +220,79 @@ static void getvar(char *cmd_parameter, char *response)
 	fastboot_getvar(cmd_parameter, response);
 }
 
+/**
+ * stream_start() - Get ready for a download which may be streamed
+ *
+ * Return: true if the image may be larger than the download buffer
+ */
+static bool stream_start(void)
+{
+#if CONFIG_IS_ENABLED(FASTBOOT_CMD_OEM_STREAM)
+	stream_active = false;
+
+	return stream_part[0];
+#else
+	return false;
+#endif
+}
+
+/**
+ * stream_data() - Write downloaded data if it is being streamed
+ *
+ * Only sparse images are streamed. Others are kept in the download buffer as
+ * usual, if they fit. An error is reported by the flash command which
+ * follows, so the rest of the image is dropped.
+ *
+ * @data: Pointer to received fastboot data
+ * @len: Length of received fastboot data
+ * Return: true if the data was dealt with, false to buffer it
+ */
+static bool stream_data(const void *data, unsigned int len)
+{
+#if CONFIG_IS_ENABLED(FASTBOOT_CMD_OEM_STREAM)
+	if (!fastboot_bytes_received && stream_part[0]) {
+		stream_response[0] = '\0';
+		stream_active = len >= sizeof(sparse_header_t) &&
+			is_sparse_image((void *)data);
+		if (stream_active) {
+			fastboot_mmc_stream_start(stream_part,
+						  fastboot_buf_addr,
+						  fastboot_buf_size,
+						  stream_response);
+		} else if (fastboot_bytes_expected > fastboot_buf_size) {
+			stream_active = true;
+			fastboot_fail("image too large to buffer",
+				      stream_response);
+		}
+	}
+	if (!stream_active)
+		return false;
+	if (!stream_response[0])
+		fastboot_mmc_stream_write(data, len, stream_response);
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+/**
+ * stream_complete() - Write out the rest of a streamed download
+ *
+ * Return: true if the download was streamed
+ */
+static bool stream_complete(void)
+{
+#if CONFIG_IS_ENABLED(FASTBOOT_CMD_OEM_STREAM)
+	if (stream_active && !stream_response[0])
+		fastboot_mmc_stream_finish(stream_response);
+
+	return stream_active;
+#else
+	return false;
+#endif
+}
+
 /**
  * fastboot_download() - Start a download transfer from the client
  *
@@ -201,12 +301,14 @@ static void getvar(char *cmd_parameter, char *response)
  */
 static void download(char *cmd_parameter, char *response)
 {
+	bool stream;
 	char *tmp;
 
 	if (!cmd_parameter) {
 		fastboot_fail("Expected command parameter", response);
 		return;
 	}
+	stream = stream_start();
 	fastboot_bytes_received = 0;
 	fastboot_bytes_expected = hextoul(cmd_parameter, &tmp);
 	if (fastboot_bytes_expected == 0) {
@@ -219,7 +321,7 @@ static void download(char *cmd_parameter, char *response)
 	 *
 	 * where cmd_parameter is an 8 digit hexadecimal number
 	 */
-	if (fastboot_bytes_expected > fastboot_buf_size) {
+	if (fastboot_bytes_expected > fastboot_buf_size && !stream) {
 		fastboot_fail(cmd_parameter, response);
 	} else {
 		printf("Starting download of %d bytes\n",
@@ -267,8 +369,9 @@ void fastboot_data_download(const void *fastboot_data,
 		return;
 	}
 	/* Download data to fastboot_buf_addr */
-	memcpy(fastboot_buf_addr + fastboot_bytes_received,
-	       fastboot_data, fastboot_data_len);
+	if (!stream_data(fastboot_data, fastboot_data_len))
+		memcpy(fastboot_buf_addr + fastboot_bytes_received,
+		       fastboot_data, fastboot_data_len);
 
 	pre_dot_num = fastboot_bytes_received / BYTES_PER_DOT;
 	fastboot_bytes_received += fastboot_data_len;
@@ -295,6 +398,9 @@ void fastboot_data_complete(char *response)
 	fastboot_okay(NULL, response);
 	printf("\ndownloading of %d bytes finished\n", fastboot_bytes_received);
 	image_size = fastboot_bytes_received;
+	/* A streamed image is not in the buffer */
+	if (stream_complete())
+		image_size = 0;
 	env_set_hex("filesize", image_size);
 	fastboot_bytes_expected = 0;
 	fastboot_bytes_received = 0;
@@ -312,6 +418,19 @@ void fastboot_data_complete(char *response)
  */
 static void flash(char *cmd_parameter, char *response)
 {
+#if CONFIG_IS_ENABLED(FASTBOOT_CMD_OEM_STREAM)
+	/* The image is written already */
+	if (stream_active) {
+		stream_active = false;
+		if (!cmd_parameter || strcmp(cmd_parameter, stream_part))
+			fastboot_fail("image was streamed to another partition",
+				      response);
+		else
+			strlcpy(response, stream_response,
+				FASTBOOT_RESPONSE_LEN);
+		return;
+	}
+#endif
 #if CONFIG_IS_ENABLED(FASTBOOT_FLASH_MMC)
 	fastboot_mmc_flash_write(cmd_parameter, fastboot_buf_addr, image_size,
 				 response);
@@ -514,3 +633,24 @@ static void oem_bootbus(char *cmd_parameter, char *response)
 		fastboot_okay(NULL, response);
 }
 #endif
+
+#if CONFIG_IS_ENABLED(FASTBOOT_CMD_OEM_STREAM)
+/**
+ * oem_stream() - Execute the OEM stream command
+ *
+ * @cmd_parameter: Pointer to command parameter
+ * @response: Pointer to fastboot response buffer
+ *
+ * Sparse images downloaded after this are written to the partition named by
+ * cmd_parameter as they arrive. Without a parameter, images are buffered
+ * again.
+ */
+static void oem_stream(char *cmd_parameter, char *response)
+{
+	if (cmd_parameter)
+		strlcpy(stream_part, cmd_parameter, sizeof(stream_part));
+	else
+		stream_part[0] = '\0';
+	fastboot_okay(NULL, response);
+}
+#endif
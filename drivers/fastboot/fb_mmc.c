@@ -633,6 +633,64 @@ void fastboot_mmc_flash_write(const char *cmd, void *download_buffer,
 	}
 }
 
+#if CONFIG_IS_ENABLED(FASTBOOT_CMD_OEM_STREAM)
+static struct {
+	struct sparse_stream ss;
+	struct sparse_storage sparse;
+	struct fb_mmc_sparse priv;
+	char part_name[PART_NAME_LEN];
+} fb_mmc_stream;
+
+int fastboot_mmc_stream_start(const char *cmd, void *buffer, u32 size,
+			      char *response)
+{
+	struct sparse_storage *sparse = &fb_mmc_stream.sparse;
+	struct disk_partition info = {0};
+	struct blk_desc *dev_desc;
+	int ret;
+
+	ret = fastboot_mmc_get_part_info(cmd, &dev_desc, &info, response);
+	if (ret < 0)
+		return ret;
+
+	fb_mmc_stream.priv.dev_desc = dev_desc;
+	strlcpy(fb_mmc_stream.part_name, cmd, sizeof(fb_mmc_stream.part_name));
+
+	sparse->blksz = info.blksz;
+	sparse->start = info.start;
+	sparse->size = info.size;
+	sparse->write = fb_mmc_sparse_write;
+	sparse->reserve = fb_mmc_sparse_reserve;
+	sparse->mssg = fastboot_fail;
+	sparse->priv = &fb_mmc_stream.priv;
+
+	printf("Streaming sparse image to offset " LBAFU "\n", sparse->start);
+
+	ret = sparse_stream_init(&fb_mmc_stream.ss, sparse, buffer, size);
+	if (ret) {
+		fastboot_fail("download buffer too small", response);
+		return ret;
+	}
+
+	return 0;
+}
+
+int fastboot_mmc_stream_write(const void *data, u32 len, char *response)
+{
+	if (sparse_stream_write(&fb_mmc_stream.ss, data, len, response))
+		return -EIO;
+
+	return 0;
+}
+
+void fastboot_mmc_stream_finish(char *response)
+{
+	if (!sparse_stream_finish(&fb_mmc_stream.ss, fb_mmc_stream.part_name,
+				  response))
+		fastboot_okay(NULL, response);
+}
+#endif
+
 /**
  * fastboot_mmc_flash_erase() - Erase eMMC for fastboot
  *
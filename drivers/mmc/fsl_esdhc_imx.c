@@ -142,6 +142,7 @@ struct esdhc_soc_data {
  * @tuning_step: tuning step setting in tuning_ctrl register
  * @start_tuning_tap: the start point for tuning in tuning_ctrl register
  * @strobe_dll_delay_target: settings in strobe_dllctrl
+ * @manual_tuning: clktunectrlstatus value chosen by the last manual tuning
  * @signal_voltage: indicating the current voltage
  * @signal_voltage_switch_extra_delay_ms: extra delay for IO voltage switch
  * @cd_gpio: gpio for card detection
@@ -165,6 +166,7 @@ struct fsl_esdhc_priv {
 	u32 tuning_step;
 	u32 tuning_start_tap;
 	u32 strobe_dll_delay_target;
+	u32 manual_tuning;
 	u32 signal_voltage;
 	u32 signal_voltage_switch_extra_delay_ms;
 	struct udevice *vqmmc_dev;
@@ -827,6 +829,18 @@ static void esdhc_cfg_delay_chain(struct fsl_esdhc *regs, uint32_t val)
 	esdhc_reset(regs, SYSCTL_FIFO);
 }
 
+/* Select the sampling point and let the hardware track it from there */
+static void fsl_s32cc_set_delay(struct fsl_esdhc *regs, u32 val)
+{
+	u32 r;
+
+	esdhc_write32(&regs->clktunectrlstatus, val);
+	readl_poll_timeout(&regs->clktunectrlstatus, r,
+			   TAP_SEL(r) == DLY_CELL_SET(r), 0);
+
+	esdhc_setbits32(&regs->mixctrl, MIX_CTRL_AUTO_TUNE_EN);
+}
+
 static int fsl_s32cc_manual_tuning(struct udevice *dev, uint32_t opcode)
 {
 	struct fsl_esdhc_plat *plat = dev_get_plat(dev);
@@ -883,11 +897,8 @@ static int fsl_s32cc_manual_tuning(struct udevice *dev, uint32_t opcode)
 	}
 
 	r = ((r - 0x300) | 0x33);
-	esdhc_write32(&regs->clktunectrlstatus, r);
-	readl_poll_timeout(&regs->clktunectrlstatus, r,
-			   TAP_SEL(r) == DLY_CELL_SET(r), 0);
-
-	esdhc_setbits32(&regs->mixctrl, MIX_CTRL_AUTO_TUNE_EN);
+	fsl_s32cc_set_delay(regs, r);
+	priv->manual_tuning = r;
 
 	return 0;
 }
@@ -905,6 +916,15 @@ static void esdhc_stop_tuning(struct mmc *mmc)
 
 static struct esdhc_soc_data usdhc_s32cc_data;
 
+static bool fsl_esdhc_manual_tuning(struct udevice *dev)
+{
+	struct esdhc_soc_data *soc_data =
+		(struct esdhc_soc_data *)dev_get_driver_data(dev);
+
+	return soc_data == &usdhc_s32cc_data &&
+	       (soc_data->flags & ESDHC_FLAG_MAN_TUNING);
+}
+
 static int fsl_esdhc_execute_tuning(struct udevice *dev, uint32_t opcode)
 {
 	struct fsl_esdhc_plat *plat = dev_get_plat(dev);
@@ -915,12 +935,9 @@ static int fsl_esdhc_execute_tuning(struct udevice *dev, uint32_t opcode)
 	u32 irqsigen = esdhc_read32(&regs->irqsigen);
 	int i, err, ret = -ETIMEDOUT;
 	u32 val, mixctrl, tmp;
-	struct esdhc_soc_data *soc_data =
-		(struct esdhc_soc_data *)dev_get_driver_data(dev);
 
-	if (soc_data == &usdhc_s32cc_data)
-		if (soc_data->flags & ESDHC_FLAG_MAN_TUNING)
-			return fsl_s32cc_manual_tuning(dev, opcode);
+	if (fsl_esdhc_manual_tuning(dev))
+		return fsl_s32cc_manual_tuning(dev, opcode);
 
 	/* clock tuning is not needed for upto 52MHz */
 	if (mmc->clock <= 52000000)
@@ -996,6 +1013,41 @@ static int fsl_esdhc_execute_tuning(struct udevice *dev, uint32_t opcode)
 
 	return ret;
 }
+
+#if CONFIG_IS_ENABLED(MMC_BUS_MODE_CACHE)
+static int fsl_esdhc_get_tuning(struct udevice *dev, u32 *val)
+{
+	struct fsl_esdhc_priv *priv = dev_get_priv(dev);
+
+	if (!fsl_esdhc_manual_tuning(dev) || !priv->manual_tuning)
+		return -ENOSYS;
+
+	*val = priv->manual_tuning;
+
+	return 0;
+}
+
+static int fsl_esdhc_set_tuning(struct udevice *dev, uint opcode, u32 val)
+{
+	struct fsl_esdhc_priv *priv = dev_get_priv(dev);
+	struct fsl_esdhc *regs = priv->esdhc_regs;
+
+	if (!fsl_esdhc_manual_tuning(dev) || !val)
+		return fsl_esdhc_execute_tuning(dev, opcode);
+
+	/* Same end state as fsl_s32cc_manual_tuning(), without the search */
+	esdhc_clrbits32(&regs->tuning_ctrl, ESDHC_STD_TUNING_EN);
+	esdhc_clrbits32(&regs->vendorspec, VENDORSPEC_FRC_SDCLK_ON);
+	esdhc_clrbits32(&regs->mixctrl,
+			MIX_CTRL_FBCLK_SEL | MIX_CTRL_EXE_TUNE);
+	esdhc_reset(regs, SYSCTL_RSTA);
+	esdhc_setbits32(&regs->mixctrl, MIX_CTRL_SMPCLK_SEL);
+	fsl_s32cc_set_delay(regs, val);
+	priv->manual_tuning = val;
+
+	return 0;
+}
+#endif
 #endif
 
 static int esdhc_set_ios_common(struct fsl_esdhc_priv *priv, struct mmc *mmc)
@@ -1697,6 +1749,10 @@ static const struct dm_mmc_ops fsl_esdhc_ops = {
 	.set_ios	= fsl_esdhc_set_ios,
 #ifdef MMC_SUPPORTS_TUNING
 	.execute_tuning	= fsl_esdhc_execute_tuning,
+#if CONFIG_IS_ENABLED(MMC_BUS_MODE_CACHE)
+	.get_tuning	= fsl_esdhc_get_tuning,
+	.set_tuning	= fsl_esdhc_set_tuning,
+#endif
 #endif
 #if CONFIG_IS_ENABLED(MMC_HS400_ES_SUPPORT)
 	.set_enhanced_strobe = fsl_esdhc_set_enhanced_strobe,
@@ -52,6 +52,12 @@ static int dm_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 
 int mmc_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd, struct mmc_data *data)
 {
+	int ret;
+
+	ret = mmc_cqe_leave(mmc);
+	if (ret)
+		return ret;
+
 	return dm_mmc_send_cmd(mmc->dev, cmd, data);
 }
 
@@ -123,7 +129,21 @@ static int dm_mmc_execute_tuning(struct udevice *dev, uint opcode)
 
 int mmc_execute_tuning(struct mmc *mmc, uint opcode)
 {
+#if CONFIG_IS_ENABLED(MMC_BUS_MODE_CACHE)
+	struct dm_mmc_ops *ops = mmc_get_ops(mmc->dev);
+	int ret;
+
+	if (mmc->tuning_cached && ops->set_tuning)
+		return ops->set_tuning(mmc->dev, opcode, mmc->tuning);
+
+	ret = dm_mmc_execute_tuning(mmc->dev, opcode);
+	if (!ret && ops->get_tuning && ops->get_tuning(mmc->dev, &mmc->tuning))
+		mmc->tuning = 0;
+
+	return ret;
+#else
 	return dm_mmc_execute_tuning(mmc->dev, opcode);
+#endif
 }
 #endif
 
@@ -144,6 +164,45 @@ int mmc_set_enhanced_strobe(struct mmc *mmc)
 }
 #endif
 
+#if CONFIG_IS_ENABLED(MMC_CQE)
+int mmc_cqe_enable(struct mmc *mmc, uint depth)
+{
+	struct dm_mmc_ops *ops = mmc_get_ops(mmc->dev);
+
+	if (!ops->cqe_enable)
+		return -ENOSYS;
+	return ops->cqe_enable(mmc->dev, depth);
+}
+
+int mmc_cqe_disable(struct mmc *mmc)
+{
+	struct dm_mmc_ops *ops = mmc_get_ops(mmc->dev);
+
+	if (!ops->cqe_disable)
+		return -ENOSYS;
+	return ops->cqe_disable(mmc->dev);
+}
+
+int mmc_cqe_request(struct mmc *mmc, uint tag, struct mmc_data *data,
+		    u32 addr)
+{
+	struct dm_mmc_ops *ops = mmc_get_ops(mmc->dev);
+
+	if (!ops->cqe_request)
+		return -ENOSYS;
+	return ops->cqe_request(mmc->dev, tag, data, addr);
+}
+
+int mmc_cqe_wait(struct mmc *mmc, u32 *done, int timeout_us)
+{
+	struct dm_mmc_ops *ops = mmc_get_ops(mmc->dev);
+
+	if (!ops->cqe_wait)
+		return -ENOSYS;
+	return ops->cqe_wait(mmc->dev, done, timeout_us);
+}
+#endif
+
 static int dm_mmc_hs400_prepare_ddr(struct udevice *dev)
 {
 	struct dm_mmc_ops *ops = mmc_get_ops(dev);
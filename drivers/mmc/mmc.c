@@ -10,8 +10,10 @@
 #include <config.h>
 #include <common.h>
 #include <blk.h>
+#include <bootstage.h>
 #include <command.h>
 #include <dm.h>
+#include <env.h>
 #include <log.h>
 #include <dm/device-internal.h>
 #include <errno.h>
@@ -19,6 +21,7 @@
 #include <part.h>
 #include <linux/bitops.h>
 #include <linux/delay.h>
+#include <asm/global_data.h>
 #include <power/regulator.h>
 #include <malloc.h>
 #include <memalign.h>
@@ -26,6 +29,8 @@
 #include <div64.h>
 #include "mmc_private.h"
 
+DECLARE_GLOBAL_DATA_PTR;
+
 #define DEFAULT_CMD6_TIMEOUT_MS  500
 
 static int mmc_set_signal_voltage(struct mmc *mmc, uint signal_voltage);
@@ -484,13 +489,22 @@ ulong mmc_bread(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt,
 		return 0;
 	}
 
+	b_max = mmc_get_b_max(mmc, dst, blkcnt);
+
+	/* Before CMD16, which would take the device out of the queue mode */
+	err = mmc_cqe_read(mmc, dst, start, blkcnt, b_max);
+	if (!err)
+		return blkcnt;
+	if (err != -ENOTSUPP) {
+		pr_debug("%s: Failed to read blocks (err %d)\n", __func__, err);
+		return 0;
+	}
+
 	if (mmc_set_blocklen(mmc, mmc->read_bl_len)) {
 		pr_debug("%s: Failed to set blocklen\n", __func__);
 		return 0;
 	}
 
-	b_max = mmc_get_b_max(mmc, dst, blkcnt);
-
 	do {
 		cur = (blocks_todo > b_max) ? b_max : blocks_todo;
 		if (mmc_read_blocks(mmc, dst, start, cur) != cur) {
@@ -2061,6 +2075,198 @@ static int mmc_select_hs400es(struct mmc *mmc)
 	    ecbv++) \
 		if ((ddr == ecbv->is_ddr) && (caps & ecbv->cap))
 
+/*
+ * Switch the card and host to one mode and width, check that transfers work
+ * and fall back to legacy 1-bit mode if they do not.
+ */
+static int mmc_select_mode_width(struct mmc *mmc,
+				 const struct mode_width_tuning *mwt,
+				 const struct ext_csd_bus_width *ecbw)
+{
+	enum mmc_voltage old_voltage;
+	int err;
+
+	pr_debug("trying mode %s width %d (at %d MHz)\n",
+		 mmc_mode_name(mwt->mode),
+		 bus_width(ecbw->cap),
+		 mmc_mode2freq(mmc, mwt->mode) / 1000000);
+	old_voltage = mmc->signal_voltage;
+	err = mmc_set_lowest_voltage(mmc, mwt->mode,
+				     MMC_ALL_SIGNAL_VOLTAGE);
+	if (err)
+		return err;
+
+	/* configure the bus width (card + host) */
+	err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL,
+			 EXT_CSD_BUS_WIDTH,
+			 ecbw->ext_csd_bits & ~EXT_CSD_DDR_FLAG);
+	if (err)
+		goto error;
+	mmc_set_bus_width(mmc, bus_width(ecbw->cap));
+
+	if (mwt->mode == MMC_HS_400) {
+		err = mmc_select_hs400(mmc);
+		if (err) {
+			printf("Select HS400 failed %d\n", err);
+			goto error;
+		}
+	} else if (mwt->mode == MMC_HS_400_ES) {
+		err = mmc_select_hs400es(mmc);
+		if (err) {
+			printf("Select HS400ES failed %d\n", err);
+			goto error;
+		}
+	} else {
+		/* configure the bus speed (card) */
+		err = mmc_set_card_speed(mmc, mwt->mode, false);
+		if (err)
+			goto error;
+
+		/*
+		 * configure the bus width AND the ddr mode (card). The host
+		 * side will be taken care of in the next step
+		 */
+		if (ecbw->ext_csd_bits & EXT_CSD_DDR_FLAG) {
+			err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL,
+					 EXT_CSD_BUS_WIDTH,
+					 ecbw->ext_csd_bits);
+			if (err)
+				goto error;
+		}
+
+		/* configure the bus mode (host) */
+		mmc_select_mode(mmc, mwt->mode);
+		mmc_set_clock(mmc, mmc->tran_speed, MMC_CLK_ENABLE);
+#ifdef MMC_SUPPORTS_TUNING
+
+		/* execute tuning if needed */
+		if (mwt->tuning) {
+			err = mmc_execute_tuning(mmc, mwt->tuning);
+			if (err) {
+				pr_debug("tuning failed : %d\n", err);
+				goto error;
+			}
+		}
+#endif
+	}
+
+	/* do a transfer to check the configuration */
+	err = mmc_read_and_compare_ext_csd(mmc);
+	if (!err)
+		return 0;
+error:
+	mmc_set_signal_voltage(mmc, old_voltage);
+	/* if an error occurred, revert to a safer bus mode */
+	mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL,
+		   EXT_CSD_BUS_WIDTH, EXT_CSD_BUS_WIDTH_1);
+	mmc_select_mode(mmc, MMC_LEGACY);
+	mmc_set_bus_width(mmc, 1);
+
+	return err;
+}
+
+#if CONFIG_IS_ENABLED(MMC_BUS_MODE_CACHE)
+/*
+ * The mode, bus width and tuning result selected for a card are kept in the
+ * environment variable mmc<N>_bus as "<cid0>:<cid1>:<cid2>:<cid3>:<mode>:
+ * <width>:<tuning>", all in hex.
+ */
+#define MMC_BUS_RECORD_FIELDS	7
+
+static void mmc_bus_record_name(struct mmc *mmc, char *name, int size)
+{
+	snprintf(name, size, "mmc%d_bus", mmc_get_blk_desc(mmc)->devnum);
+}
+
+/*
+ * Look up the record for this card. Return 0 and fill in @mode, @width and
+ * mmc->tuning if there is one, -ve if not.
+ */
+static int mmc_bus_record_get(struct mmc *mmc, uint *mode, uint *width)
+{
+	ulong val[MMC_BUS_RECORD_FIELDS];
+	const char *str;
+	char name[16];
+	char *end;
+	int i;
+
+	mmc_bus_record_name(mmc, name, sizeof(name));
+	str = env_get(name);
+	if (!str)
+		return -ENOENT;
+
+	for (i = 0; i < MMC_BUS_RECORD_FIELDS; i++) {
+		val[i] = simple_strtoul(str, &end, 16);
+		if (end == str ||
+		    *end != (i == MMC_BUS_RECORD_FIELDS - 1 ? '\0' : ':'))
+			return -EINVAL;
+		str = end + 1;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(mmc->cid); i++) {
+		if (val[i] != mmc->cid[i])
+			return -ESTALE;
+	}
+	*mode = val[4];
+	*width = val[5];
+	mmc->tuning = val[6];
+
+	return 0;
+}
+
+static void mmc_bus_record_set(struct mmc *mmc, uint width)
+{
+	char name[16], val[80];
+	const char *old;
+
+	if (!(gd->flags & GD_FLG_ENV_READY))
+		return;
+
+	mmc_bus_record_name(mmc, name, sizeof(name));
+	snprintf(val, sizeof(val), "%x:%x:%x:%x:%x:%x:%x", mmc->cid[0],
+		 mmc->cid[1], mmc->cid[2], mmc->cid[3], mmc->selected_mode,
+		 width, mmc->tuning);
+	old = env_get(name);
+	if (!old || strcmp(old, val))
+		env_set(name, val);
+}
+
+/*
+ * Try the mode and width recorded for this card, restoring the tuning result
+ * rather than tuning again. Return 0 if the card works in that mode, -ve if
+ * there is no record or it is no longer usable.
+ */
+static int mmc_select_recorded_mode(struct mmc *mmc, uint card_caps)
+{
+	const struct mode_width_tuning *mwt;
+	const struct ext_csd_bus_width *ecbw;
+	uint mode, width;
+	int err;
+
+	err = mmc_bus_record_get(mmc, &mode, &width);
+	if (err)
+		return err;
+
+	for_each_mmc_mode_by_pref(card_caps, mwt) {
+		if (mwt->mode != mode)
+			continue;
+		for_each_supported_width(card_caps & mwt->widths,
+					 mmc_is_mode_ddr(mwt->mode), ecbw) {
+			if (bus_width(ecbw->cap) != width)
+				continue;
+			mmc->tuning_cached = true;
+			err = mmc_select_mode_width(mmc, mwt, ecbw);
+			mmc->tuning_cached = false;
+			if (err)
+				pr_debug("recorded mode failed: %d\n", err);
+			return err;
+		}
+	}
+
+	return -ENOENT;
+}
+#endif
+
 static int mmc_select_mode_and_width(struct mmc *mmc, uint card_caps)
 {
 	int err = 0;
@@ -2107,94 +2313,34 @@ static int mmc_select_mode_and_width(struct mmc *mmc, uint card_caps)
 #endif
 		mmc_set_clock(mmc, mmc->legacy_speed, MMC_CLK_ENABLE);
 
+#if CONFIG_IS_ENABLED(MMC_BUS_MODE_CACHE)
+	bootstage_start(BOOTSTAGE_ID_ACCUM_MMC_BUS, "mmc_bus_mode");
+	err = mmc_select_recorded_mode(mmc, card_caps);
+	if (!err) {
+		bootstage_accum(BOOTSTAGE_ID_ACCUM_MMC_BUS);
+		return 0;
+	}
+	mmc->tuning = 0;
+#endif
+
 	for_each_mmc_mode_by_pref(card_caps, mwt) {
 		for_each_supported_width(card_caps & mwt->widths,
 					 mmc_is_mode_ddr(mwt->mode), ecbw) {
-			enum mmc_voltage old_voltage;
-			pr_debug("trying mode %s width %d (at %d MHz)\n",
-				 mmc_mode_name(mwt->mode),
-				 bus_width(ecbw->cap),
-				 mmc_mode2freq(mmc, mwt->mode) / 1000000);
-			old_voltage = mmc->signal_voltage;
-			err = mmc_set_lowest_voltage(mmc, mwt->mode,
-						     MMC_ALL_SIGNAL_VOLTAGE);
-			if (err)
-				continue;
-
-			/* configure the bus width (card + host) */
-			err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL,
-				    EXT_CSD_BUS_WIDTH,
-				    ecbw->ext_csd_bits & ~EXT_CSD_DDR_FLAG);
-			if (err)
-				goto error;
-			mmc_set_bus_width(mmc, bus_width(ecbw->cap));
-
-			if (mwt->mode == MMC_HS_400) {
-				err = mmc_select_hs400(mmc);
-				if (err) {
-					printf("Select HS400 failed %d\n", err);
-					goto error;
-				}
-			} else if (mwt->mode == MMC_HS_400_ES) {
-				err = mmc_select_hs400es(mmc);
-				if (err) {
-					printf("Select HS400ES failed %d\n",
-					       err);
-					goto error;
-				}
-			} else {
-				/* configure the bus speed (card) */
-				err = mmc_set_card_speed(mmc, mwt->mode, false);
-				if (err)
-					goto error;
-
-				/*
-				 * configure the bus width AND the ddr mode
-				 * (card). The host side will be taken care
-				 * of in the next step
-				 */
-				if (ecbw->ext_csd_bits & EXT_CSD_DDR_FLAG) {
-					err = mmc_switch(mmc,
-							 EXT_CSD_CMD_SET_NORMAL,
-							 EXT_CSD_BUS_WIDTH,
-							 ecbw->ext_csd_bits);
-					if (err)
-						goto error;
-				}
-
-				/* configure the bus mode (host) */
-				mmc_select_mode(mmc, mwt->mode);
-				mmc_set_clock(mmc, mmc->tran_speed,
-					      MMC_CLK_ENABLE);
-#ifdef MMC_SUPPORTS_TUNING
-
-				/* execute tuning if needed */
-				if (mwt->tuning) {
-					err = mmc_execute_tuning(mmc,
-								 mwt->tuning);
-					if (err) {
-						pr_debug("tuning failed : %d\n", err);
-						goto error;
-					}
-				}
+			err = mmc_select_mode_width(mmc, mwt, ecbw);
+			if (!err) {
+#if CONFIG_IS_ENABLED(MMC_BUS_MODE_CACHE)
+				mmc_bus_record_set(mmc, bus_width(ecbw->cap));
+				bootstage_accum(BOOTSTAGE_ID_ACCUM_MMC_BUS);
 #endif
-			}
-
-			/* do a transfer to check the configuration */
-			err = mmc_read_and_compare_ext_csd(mmc);
-			if (!err)
 				return 0;
-error:
-			mmc_set_signal_voltage(mmc, old_voltage);
-			/* if an error occurred, revert to a safer bus mode */
-			mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL,
-				   EXT_CSD_BUS_WIDTH, EXT_CSD_BUS_WIDTH_1);
-			mmc_select_mode(mmc, MMC_LEGACY);
-			mmc_set_bus_width(mmc, 1);
+			}
 		}
 	}
 
 	pr_err("unable to select a mode : %d\n", err);
+#if CONFIG_IS_ENABLED(MMC_BUS_MODE_CACHE)
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_MMC_BUS);
+#endif
 
 	return -ENOTSUPP;
 }
@@ -2399,6 +2545,8 @@ static int mmc_startup_v4(struct mmc *mmc)
 
 	mmc->wr_rel_set = ext_csd[EXT_CSD_WR_REL_SET];
 
+	mmc_cqe_init(mmc, ext_csd);
+
 	return 0;
 error:
 	if (mmc->ext_csd) {
@@ -2941,12 +3089,14 @@ int mmc_init(struct mmc *mmc)
 		return 0;
 
 	start = get_timer(0);
+	bootstage_start(BOOTSTAGE_ID_ACCUM_MMC, "mmc_init");
 
 	if (!mmc->init_in_progress)
 		err = mmc_start_init(mmc);
 
 	if (!err)
 		err = mmc_complete_init(mmc);
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_MMC);
 	if (err)
 		pr_info("%s: %d, time %lu\n", __func__, err, get_timer(start));
 
@@ -0,0 +1,163 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Command queued reads for eMMC 5.1 devices
+ *
+ * Copyright 2023 NXP
+ */
+
+#include <common.h>
+#include <log.h>
+#include <mmc.h>
+#include <linux/bitops.h>
+#include <linux/kernel.h>
+#include "mmc_private.h"
+
+/* Limits of the task descriptor in the eMMC 5.1 host interface */
+#define MMC_CQE_MAX_DEPTH	32
+#define MMC_CQE_MAX_BLOCKS	0xffff
+
+#define MMC_CQE_TIMEOUT_US	(5 * 1000 * 1000)
+
+/* Argument of CMD48 to discard all tasks in the queue of the device */
+#define MMC_CQE_DISCARD_QUEUE	1
+
+static int mmc_cqe_discard(struct mmc *mmc)
+{
+	struct mmc_cmd cmd;
+
+	cmd.cmdidx = MMC_CMD_CMDQ_TASK_MGMT;
+	cmd.cmdarg = MMC_CQE_DISCARD_QUEUE;
+	cmd.resp_type = MMC_RSP_R1b;
+
+	return mmc_send_cmd(mmc, &cmd, NULL);
+}
+
+void mmc_cqe_init(struct mmc *mmc, const u8 *ext_csd)
+{
+	mmc->cqe_depth = 0;
+	if (mmc->version < MMC_VERSION_5_1 ||
+	    !(ext_csd[EXT_CSD_CMDQ_SUPPORT] & BIT(0)))
+		return;
+
+	mmc->cqe_depth = (ext_csd[EXT_CSD_CMDQ_DEPTH] & 0x1f) + 1;
+	pr_debug("%s: command queue depth %u\n", mmc->cfg->name,
+		 mmc->cqe_depth);
+}
+
+/*
+ * Take the host and then the device out of command queue mode, discarding
+ * the tasks in @busy first
+ */
+static int mmc_cqe_off(struct mmc *mmc, u32 busy)
+{
+	int ret, err;
+
+	mmc->cqe_tags = 0;
+	ret = mmc_cqe_disable(mmc);
+	if (busy) {
+		log_debug("%s: discarding tasks %#x\n", mmc->cfg->name, busy);
+		mmc_cqe_discard(mmc);
+	}
+	err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_CMDQ_MODE_EN, 0);
+
+	return ret ? ret : err;
+}
+
+static int mmc_cqe_on(struct mmc *mmc)
+{
+	int ret;
+
+	if (mmc->cqe_tags)
+		return 0;
+
+	ret = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_CMDQ_MODE_EN, 1);
+	if (ret)
+		return ret;
+
+	ret = mmc_cqe_enable(mmc, min_t(uint, mmc->cqe_depth,
+					 MMC_CQE_MAX_DEPTH));
+	if (ret < 2) {
+		if (ret >= 0) {
+			mmc_cqe_disable(mmc);
+			ret = -ENOTSUPP;
+		}
+		mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_CMDQ_MODE_EN,
+			   0);
+		return ret;
+	}
+	mmc->cqe_tags = ret;
+
+	return 0;
+}
+
+int mmc_cqe_leave(struct mmc *mmc)
+{
+	if (!mmc->cqe_tags)
+		return 0;
+
+	return mmc_cqe_off(mmc, 0);
+}
+
+int mmc_cqe_read(struct mmc *mmc, void *dst, lbaint_t start, lbaint_t blkcnt,
+		 uint b_max)
+{
+	struct mmc_data data[MMC_CQE_MAX_DEPTH];
+	u32 busy = 0, done;
+	uint depth, tag;
+	lbaint_t cur;
+	int ret;
+
+	if (mmc->cqe_depth < 2 || !mmc->high_capacity ||
+	    mmc_get_blk_desc(mmc)->hwpart == MMC_PART_RPMB)
+		return -ENOTSUPP;
+
+	b_max = min_t(uint, b_max, MMC_CQE_MAX_BLOCKS);
+	if (blkcnt <= b_max)
+		return -ENOTSUPP;
+
+	ret = mmc_cqe_on(mmc);
+	if (ret)
+		goto unsupported;
+	depth = mmc->cqe_tags;
+
+	while (blkcnt || busy) {
+		for (tag = 0; blkcnt && tag < depth; tag++) {
+			if (busy & BIT(tag))
+				continue;
+
+			cur = min_t(lbaint_t, blkcnt, b_max);
+			data[tag].dest = dst;
+			data[tag].blocks = cur;
+			data[tag].blocksize = mmc->read_bl_len;
+			data[tag].flags = MMC_DATA_READ;
+			ret = mmc_cqe_request(mmc, tag, &data[tag], start);
+			if (ret)
+				goto out;
+
+			busy |= BIT(tag);
+			blkcnt -= cur;
+			start += cur;
+			dst += cur * mmc->read_bl_len;
+		}
+
+		ret = mmc_cqe_wait(mmc, &done, MMC_CQE_TIMEOUT_US);
+		if (ret)
+			goto out;
+		busy &= ~done;
+	}
+
+out:
+	/* Leave the queue on for the next read, unless something failed */
+	if (ret)
+		mmc_cqe_off(mmc, busy);
+
+	return ret;
+
+unsupported:
+	/* Do not try again until the device is initialised again */
+	log_debug("%s: command queue not usable (err %d)\n", mmc->cfg->name,
+		  ret);
+	mmc->cqe_depth = 0;
+
+	return -ENOTSUPP;
+}
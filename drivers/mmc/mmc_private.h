@@ -132,4 +132,59 @@ int mmc_switch_part(struct mmc *mmc, unsigned int part_num);
  */
 int mmc_switch(struct mmc *mmc, u8 set, u8 index, u8 value);
 
+#if CONFIG_IS_ENABLED(MMC_CQE)
+/**
+ * mmc_cqe_init() - Get the command queue depth of a device
+ *
+ * @mmc:	MMC device
+ * @ext_csd:	EXT_CSD of the device
+ */
+void mmc_cqe_init(struct mmc *mmc, const u8 *ext_csd);
+
+/**
+ * mmc_cqe_read() - Read blocks using the command queue
+ *
+ * This splits the read into tasks of up to @b_max blocks and keeps as many of
+ * them queued as the device and host allow. Command queue mode is entered on
+ * the first such read and left on afterwards, until mmc_cqe_leave() is called
+ * or a task fails.
+ *
+ * @mmc:	MMC device, with the hardware partition already selected
+ * @dst:	Destination buffer
+ * @start:	First block to read
+ * @blkcnt:	Number of blocks to read
+ * @b_max:	Maximum number of blocks in a transfer
+ * Return: 0 if OK, -ENOTSUPP if the command queue cannot be used for this
+ *	read and nothing was done, other -ve on error
+ */
+int mmc_cqe_read(struct mmc *mmc, void *dst, lbaint_t start, lbaint_t blkcnt,
+		 uint b_max);
+
+/**
+ * mmc_cqe_leave() - Leave command queue mode
+ *
+ * This must be called before any command is sent with send_cmd(), since the
+ * device does not accept most of them in command queue mode.
+ *
+ * @mmc:	MMC device
+ * Return: 0 if OK or not in command queue mode, -ve on error
+ */
+int mmc_cqe_leave(struct mmc *mmc);
+#else
+static inline void mmc_cqe_init(struct mmc *mmc, const u8 *ext_csd)
+{
+}
+
+static inline int mmc_cqe_read(struct mmc *mmc, void *dst, lbaint_t start,
+			       lbaint_t blkcnt, uint b_max)
+{
+	return -ENOTSUPP;
+}
+
+static inline int mmc_cqe_leave(struct mmc *mmc)
+{
+	return 0;
+}
+#endif
+
 #endif /* _MMC_PRIVATE_H_ */
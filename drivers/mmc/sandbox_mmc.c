@@ -25,10 +25,21 @@ struct sandbox_mmc_plat {
 #define MMC_BL_LEN		BIT(MMC_BL_LEN_SHIFT)
 #define SIZE_MULTIPLE		((1 << (MMC_CMULT + 2)) * MMC_BL_LEN)
 
+#define MMC_CQE_DEPTH		8
+
 struct sandbox_mmc_priv {
 	char *buf;
 	int csize;	/* CSIZE value to report */
 	int size;
+	bool cmdq;	/* command queue mode enabled with CMD6 */
+#if CONFIG_IS_ENABLED(MMC_CQE)
+	uint cqe_depth;	/* tags in use, 0 if the queue is disabled */
+	u32 cqe_pending;
+	struct mmc_data *cqe_data[MMC_CQE_DEPTH];
+	u32 cqe_addr[MMC_CQE_DEPTH];
+	uint cqe_tasks;	/* number of tasks completed */
+	uint cqe_enables; /* number of times the queue was enabled */
+#endif
 };
 
 /**
@@ -44,6 +55,12 @@ static int sandbox_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 	struct mmc *mmc = mmc_get_mmc_dev(dev);
 	static ulong erase_start, erase_end;
 
+#if CONFIG_IS_ENABLED(MMC_CQE)
+	/* Only the queue can be used while it is enabled */
+	if (priv->cqe_depth)
+		return -EBUSY;
+#endif
+
 	switch (cmd->cmdidx) {
 	case MMC_CMD_ALL_SEND_CID:
 		memset(cmd->response, '\0', sizeof(cmd->response));
@@ -56,7 +73,7 @@ static int sandbox_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 		cmd->response[0] = 0xaa;
 		break;
 	case MMC_CMD_SEND_STATUS:
-		cmd->response[0] = MMC_STATUS_RDY_FOR_DATA;
+		cmd->response[0] = MMC_STATUS_RDY_FOR_DATA | MMC_STATE_TRANS;
 		break;
 	case MMC_CMD_SELECT_CARD:
 		break;
@@ -68,8 +85,13 @@ static int sandbox_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 		cmd->response[3] = 0;
 		break;
 	case SD_CMD_SWITCH_FUNC: {
-		if (!data)
+		/* An eMMC switch; only the command queue mode is emulated */
+		if (!data) {
+			if (((cmd->cmdarg >> 16) & 0xff) ==
+			    EXT_CSD_CMDQ_MODE_EN)
+				priv->cmdq = (cmd->cmdarg >> 8) & 1;
 			break;
+		}
 		u32 *resp = (u32 *)data->dest;
 		resp[3] = 0;
 		resp[7] = cpu_to_be32(SD_HIGHSPEED_BUSY);
@@ -79,15 +101,20 @@ static int sandbox_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 	}
 	case MMC_CMD_READ_SINGLE_BLOCK:
 	case MMC_CMD_READ_MULTIPLE_BLOCK:
+		if (priv->cmdq)
+			return -EPERM;
 		memcpy(data->dest, &priv->buf[cmd->cmdarg * data->blocksize],
 		       data->blocks * data->blocksize);
 		break;
 	case MMC_CMD_WRITE_SINGLE_BLOCK:
 	case MMC_CMD_WRITE_MULTIPLE_BLOCK:
+		if (priv->cmdq)
+			return -EPERM;
 		memcpy(&priv->buf[cmd->cmdarg * data->blocksize], data->src,
 		       data->blocks * data->blocksize);
 		break;
 	case MMC_CMD_STOP_TRANSMISSION:
+	case MMC_CMD_CMDQ_TASK_MGMT:
 		break;
 	case SD_CMD_ERASE_WR_BLK_START:
 		erase_start = cmd->cmdarg;
@@ -133,10 +160,117 @@ static int sandbox_mmc_get_cd(struct udevice *dev)
 	return 1;
 }
 
+#if CONFIG_IS_ENABLED(MMC_CQE)
+/*
+ * The command queue is emulated by doing the transfers when waiting for them,
+ * one per call and most recently queued first, so that the caller sees tasks
+ * complete out of order.
+ */
+static int sandbox_mmc_cqe_enable(struct udevice *dev, uint depth)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+
+	if (!priv->cmdq)
+		return -EPERM;
+	priv->cqe_depth = min_t(uint, depth, MMC_CQE_DEPTH);
+	priv->cqe_pending = 0;
+	priv->cqe_enables++;
+
+	return priv->cqe_depth;
+}
+
+static int sandbox_mmc_cqe_disable(struct udevice *dev)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+
+	priv->cqe_depth = 0;
+	priv->cqe_pending = 0;
+
+	return 0;
+}
+
+static int sandbox_mmc_cqe_request(struct udevice *dev, uint tag,
+				   struct mmc_data *data, u32 addr)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+
+	if (tag >= priv->cqe_depth || priv->cqe_pending & BIT(tag))
+		return -EINVAL;
+	priv->cqe_data[tag] = data;
+	priv->cqe_addr[tag] = addr;
+	priv->cqe_pending |= BIT(tag);
+
+	return 0;
+}
+
+static int sandbox_mmc_cqe_wait(struct udevice *dev, u32 *done,
+				int timeout_us)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+	struct mmc_data *data;
+	char *ptr;
+	uint tag;
+
+	if (!priv->cqe_pending)
+		return -ETIMEDOUT;
+
+	tag = fls(priv->cqe_pending) - 1;
+	data = priv->cqe_data[tag];
+	ptr = &priv->buf[priv->cqe_addr[tag] * data->blocksize];
+	if (data->flags == MMC_DATA_READ)
+		memcpy(data->dest, ptr, data->blocks * data->blocksize);
+	else
+		memcpy(ptr, data->src, data->blocks * data->blocksize);
+	priv->cqe_pending &= ~BIT(tag);
+	priv->cqe_tasks++;
+	*done = BIT(tag);
+
+	return 0;
+}
+#endif
+
+void sandbox_mmc_set_cqe(struct udevice *dev, uint depth, uint b_max)
+{
+	struct sandbox_mmc_plat *plat = dev_get_plat(dev);
+
+#if CONFIG_IS_ENABLED(MMC_CQE)
+	plat->mmc.cqe_depth = depth;
+#endif
+	plat->cfg.b_max = b_max;
+}
+
+uint sandbox_mmc_get_cqe_tasks(struct udevice *dev)
+{
+#if CONFIG_IS_ENABLED(MMC_CQE)
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+
+	return priv->cqe_tasks;
+#else
+	return 0;
+#endif
+}
+
+uint sandbox_mmc_get_cqe_enables(struct udevice *dev)
+{
+#if CONFIG_IS_ENABLED(MMC_CQE)
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+
+	return priv->cqe_enables;
+#else
+	return 0;
+#endif
+}
+
 static const struct dm_mmc_ops sandbox_mmc_ops = {
 	.send_cmd = sandbox_mmc_send_cmd,
 	.set_ios = sandbox_mmc_set_ios,
 	.get_cd = sandbox_mmc_get_cd,
+#if CONFIG_IS_ENABLED(MMC_CQE)
+	.cqe_enable = sandbox_mmc_cqe_enable,
+	.cqe_disable = sandbox_mmc_cqe_disable,
+	.cqe_request = sandbox_mmc_cqe_request,
+	.cqe_wait = sandbox_mmc_cqe_wait,
+#endif
 };
 
 static int sandbox_mmc_of_to_plat(struct udevice *dev)
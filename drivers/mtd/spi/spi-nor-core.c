@@ -348,26 +348,40 @@ static int spansion_write_any_reg(struct spi_nor *nor, u32 addr, u8 val)
 }
 #endif
 
-static ssize_t spi_nor_read_data(struct spi_nor *nor, loff_t from, size_t len,
-				 u_char *buf)
+static void spi_nor_setup_read_op(struct spi_nor *nor, struct spi_mem_op *op,
+				  loff_t from, size_t len, u_char *buf)
 {
-	struct spi_mem_op op =
+	struct spi_mem_op read_op =
 			SPI_MEM_OP(SPI_MEM_OP_CMD(nor->read_opcode, 0),
 				   SPI_MEM_OP_ADDR(nor->addr_width, from, 0),
 				   SPI_MEM_OP_DUMMY(nor->read_dummy, 0),
 				   SPI_MEM_OP_DATA_IN(len, buf, 0));
-	size_t remaining = len;
-	int ret;
 
-	spi_nor_setup_op(nor, &op, nor->read_proto);
+	*op = read_op;
+	spi_nor_setup_op(nor, op, nor->read_proto);
 
 	/* convert the dummy cycles to the number of bytes */
-	op.dummy.nbytes = (nor->read_dummy * op.dummy.buswidth) / 8;
+	op->dummy.nbytes = (nor->read_dummy * op->dummy.buswidth) / 8;
 #ifndef CONFIG_SPI_FLASH_MX25UW51245G
 	if (spi_nor_protocol_is_dtr(nor->read_proto))
-		op.dummy.nbytes *= 2;
+		op->dummy.nbytes *= 2;
+#endif
+}
+
+static ssize_t spi_nor_read_data(struct spi_nor *nor, loff_t from, size_t len,
+				 u_char *buf)
+{
+	struct spi_mem_op op;
+	size_t remaining = len;
+	int ret;
+
+#if CONFIG_IS_ENABLED(SPI_DIRMAP)
+	if (nor->dirmap.rdesc)
+		return spi_mem_dirmap_read(nor->dirmap.rdesc, from, len, buf);
 #endif
 
+	spi_nor_setup_read_op(nor, &op, from, len, buf);
+
 	while (remaining) {
 		op.data.nbytes = remaining < UINT_MAX ? remaining : UINT_MAX;
 		ret = spi_mem_adjust_op_size(nor->spi, &op);
@@ -3816,8 +3830,39 @@ out:
 }
 #endif /* CONFIG_SPI_FLASH_SOFT_RESET */
 
+#if CONFIG_IS_ENABLED(SPI_DIRMAP) && !defined(CONFIG_SPI_FLASH_BAR)
+/*
+ * Map the whole flash for reads with the read operation chosen by
+ * spi_nor_scan(). This must be done once the flash is in its final mode.
+ */
+static int spi_nor_create_read_dirmap(struct spi_nor *nor)
+{
+	struct spi_mem_dirmap_info info = {
+		.offset = 0,
+		.length = nor->mtd.size,
+	};
+	struct spi_mem_dirmap_desc *desc;
+
+	spi_nor_setup_read_op(nor, &info.op_tmpl, 0, 0, NULL);
+	desc = spi_mem_dirmap_create(nor->spi, &info);
+	if (IS_ERR(desc))
+		return PTR_ERR(desc);
+
+	nor->dirmap.rdesc = desc;
+
+	return 0;
+}
+#endif
+
 int spi_nor_remove(struct spi_nor *nor)
 {
+#if CONFIG_IS_ENABLED(SPI_DIRMAP)
+	if (nor->dirmap.rdesc) {
+		spi_mem_dirmap_destroy(nor->dirmap.rdesc);
+		nor->dirmap.rdesc = NULL;
+	}
+#endif
+
 #ifdef CONFIG_SPI_FLASH_SOFT_RESET
 	if (nor->info->flags & SPI_NOR_OCTAL_DTR_READ &&
 	    nor->flags & SNOR_F_SOFT_RESET)
@@ -4034,6 +4079,13 @@ int spi_nor_scan(struct spi_nor *nor)
 	if (ret)
 		return ret;
 
+	/* A bank address register does not fit with a direct mapping */
+#if CONFIG_IS_ENABLED(SPI_DIRMAP) && !defined(CONFIG_SPI_FLASH_BAR)
+	ret = spi_nor_create_read_dirmap(nor);
+	if (ret)
+		dev_dbg(nor->dev, "no read mapping (err=%d)\n", ret);
+#endif
+
 	nor->rdsr_dummy = params.rdsr_dummy;
 	nor->rdsr_addr_nbytes = params.rdsr_addr_nbytes;
 	nor->name = info->name;
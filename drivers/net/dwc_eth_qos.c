@@ -224,24 +224,13 @@ struct eqos_tegra186_regs {
 #define EQOS_AUTO_CAL_STATUS_ACTIVE			BIT(31)
 
 /* Descriptors */
-#define EQOS_DESCRIPTORS_TX	4
-#define EQOS_DESCRIPTORS_RX	4
-#define EQOS_DESCRIPTORS_NUM	(EQOS_DESCRIPTORS_TX + EQOS_DESCRIPTORS_RX)
+#define EQOS_DESCRIPTORS_MIN	4
+#define EQOS_DESCRIPTORS_MAX	1024
 #define EQOS_BUFFER_ALIGN	ARCH_DMA_MINALIGN
 #define EQOS_MAX_PACKET_SIZE	ALIGN(1568, ARCH_DMA_MINALIGN)
-#define EQOS_RX_BUFFER_SIZE	(EQOS_DESCRIPTORS_RX * EQOS_MAX_PACKET_SIZE)
 
-struct eqos_desc {
-	u32 des0;
-	u32 des1;
-	u32 des2;
-	u32 des3;
-};
-
-#define EQOS_DESC3_OWN		BIT(31)
-#define EQOS_DESC3_FD		BIT(29)
-#define EQOS_DESC3_LD		BIT(28)
-#define EQOS_DESC3_BUF1V	BIT(24)
+/* Most RX descriptors to invalidate and check at once */
+#define EQOS_RX_SCAN_MAX	ETH_PACKETS_BATCH_RECV
 
 #define EQOS_AXI_WIDTH_32	4
 #define EQOS_AXI_WIDTH_128	16
@@ -277,13 +266,6 @@ static void eqos_free_descs(void *descs)
 	free(descs);
 }
 
-static struct eqos_desc *eqos_get_desc(struct eqos_priv *eqos,
-				       unsigned int num, bool rx)
-{
-	return eqos->descs +
-		((rx ? EQOS_DESCRIPTORS_TX : 0) + num) * eqos->desc_size;
-}
-
 void eqos_inval_desc_generic(void *desc)
 {
 	unsigned long start = (unsigned long)desc;
@@ -1001,8 +983,10 @@ static int eqos_start(struct udevice *dev)
 
 	debug("%s(dev=%p):\n", __func__, dev);
 
-	eqos->tx_desc_idx = 0;
-	eqos->rx_desc_idx = 0;
+	eqos->tx_ring.next = 0;
+	eqos->rx_ring.next = 0;
+	eqos->rx_ring.ready = 0;
+	eqos->rx_ring.dirty = 0;
 
 	ret = eqos->config->ops->eqos_start_resets(dev);
 	if (ret < 0) {
@@ -1275,35 +1259,33 @@ static int eqos_start(struct udevice *dev)
 
 	/* Set up descriptors */
 
-	memset(eqos->descs, 0, eqos->desc_size * EQOS_DESCRIPTORS_NUM);
+	memset(eqos->descs, 0, eqos->desc_size *
+	       (eqos->tx_ring.num + eqos->rx_ring.num));
 
-	for (i = 0; i < EQOS_DESCRIPTORS_TX; i++) {
-		struct eqos_desc *tx_desc = eqos_get_desc(eqos, i, false);
-		eqos->config->ops->eqos_flush_desc(tx_desc);
-	}
-
-	for (i = 0; i < EQOS_DESCRIPTORS_RX; i++) {
-		struct eqos_desc *rx_desc = eqos_get_desc(eqos, i, true);
+	for (i = 0; i < eqos->rx_ring.num; i++) {
+		struct eqos_desc *rx_desc = eqos_ring_desc(&eqos->rx_ring, i);
 		rx_desc->des0 = (u32)(ulong)(eqos->rx_dma_buf +
 					     (i * EQOS_MAX_PACKET_SIZE));
 		rx_desc->des3 = EQOS_DESC3_OWN | EQOS_DESC3_BUF1V;
-		mb();
-		eqos->config->ops->eqos_flush_desc(rx_desc);
-		eqos->config->ops->eqos_inval_buffer(eqos->rx_dma_buf +
-						(i * EQOS_MAX_PACKET_SIZE),
-						EQOS_MAX_PACKET_SIZE);
 	}
+	mb();
+
+	/* Both rings are contiguous, so flush them in one go */
+	eqos->config->ops->eqos_flush_buffer(eqos->descs, eqos->desc_size *
+				(eqos->tx_ring.num + eqos->rx_ring.num));
+	eqos->config->ops->eqos_inval_buffer(eqos->rx_dma_buf,
+				eqos->rx_ring.num * EQOS_MAX_PACKET_SIZE);
 
 	writel(0, &eqos->dma_regs->ch0_txdesc_list_haddress);
-	writel((ulong)eqos_get_desc(eqos, 0, false),
+	writel((ulong)eqos_ring_desc(&eqos->tx_ring, 0),
 		&eqos->dma_regs->ch0_txdesc_list_address);
-	writel(EQOS_DESCRIPTORS_TX - 1,
+	writel(eqos->tx_ring.num - 1,
 	       &eqos->dma_regs->ch0_txdesc_ring_length);
 
 	writel(0, &eqos->dma_regs->ch0_rxdesc_list_haddress);
-	writel((ulong)eqos_get_desc(eqos, 0, true),
+	writel((ulong)eqos_ring_desc(&eqos->rx_ring, 0),
 		&eqos->dma_regs->ch0_rxdesc_list_address);
-	writel(EQOS_DESCRIPTORS_RX - 1,
+	writel(eqos->rx_ring.num - 1,
 	       &eqos->dma_regs->ch0_rxdesc_ring_length);
 
 	/* Enable everything */
@@ -1321,7 +1303,8 @@ static int eqos_start(struct udevice *dev)
 	 * that's not distinguishable from none of the descriptors being
 	 * available.
 	 */
-	last_rx_desc = (ulong)eqos_get_desc(eqos, EQOS_DESCRIPTORS_RX - 1, true);
+	last_rx_desc = (ulong)eqos_ring_desc(&eqos->rx_ring,
+					     eqos->rx_ring.num - 1);
 	writel(last_rx_desc, &eqos->dma_regs->ch0_rxdesc_tail_pointer);
 
 	eqos->started = true;
@@ -1338,6 +1321,25 @@ err:
 	return ret;
 }
 
+/*
+ * Wait for the DMA to finish with a TX descriptor, and so with its buffer.
+ * Return 0 once it has, or -ETIMEDOUT.
+ */
+static int eqos_tx_wait(struct eqos_priv *eqos, unsigned int idx)
+{
+	struct eqos_desc *tx_desc = eqos_ring_desc(&eqos->tx_ring, idx);
+	int i;
+
+	for (i = 0; i < 1000000; i++) {
+		eqos->config->ops->eqos_inval_desc(tx_desc);
+		if (!(readl(&tx_desc->des3) & EQOS_DESC3_OWN))
+			return 0;
+		udelay(1);
+	}
+
+	return -ETIMEDOUT;
+}
+
 static void eqos_stop(struct udevice *dev)
 {
 	struct eqos_priv *eqos = dev_get_priv(dev);
@@ -1350,6 +1352,13 @@ static void eqos_stop(struct udevice *dev)
 	eqos->started = false;
 	eqos->reg_access_ok = false;
 
+	/*
+	 * Frames may still be queued, since eqos_send() does not wait. The DMA
+	 * sends them in order, so waiting for the last one is enough.
+	 */
+	eqos_tx_wait(eqos, eqos_ring_add(&eqos->tx_ring, eqos->tx_ring.next,
+					 -1));
+
 	/* Disable TX DMA */
 	clrbits_le32(&eqos->dma_regs->ch0_tx_control,
 		     EQOS_DMA_CH0_TX_CONTROL_ST);
@@ -1391,23 +1400,34 @@ static void eqos_stop(struct udevice *dev)
 	debug("%s: OK\n", __func__);
 }
 
+/*
+ * Each TX descriptor has its own buffer, so queue the frame and return
+ * without waiting for it to be sent. The wait happens when the descriptor
+ * comes round again, by which time the DMA has usually finished with it.
+ */
 static int eqos_send(struct udevice *dev, void *packet, int length)
 {
 	struct eqos_priv *eqos = dev_get_priv(dev);
+	struct eqos_ring *tx = &eqos->tx_ring;
 	struct eqos_desc *tx_desc;
-	int i;
+	void *buf;
 
 	debug("%s(dev=%p, packet=%p, length=%d):\n", __func__, dev, packet,
 	      length);
 
-	memcpy(eqos->tx_dma_buf, packet, length);
-	eqos->config->ops->eqos_flush_buffer(eqos->tx_dma_buf, length);
+	if (eqos_tx_wait(eqos, tx->next)) {
+		debug("%s: TX timeout\n", __func__);
+		return -ETIMEDOUT;
+	}
+
+	buf = eqos->tx_dma_buf + tx->next * EQOS_MAX_PACKET_SIZE;
+	memcpy(buf, packet, length);
+	eqos->config->ops->eqos_flush_buffer(buf, length);
 
-	tx_desc = eqos_get_desc(eqos, eqos->tx_desc_idx, false);
-	eqos->tx_desc_idx++;
-	eqos->tx_desc_idx %= EQOS_DESCRIPTORS_TX;
+	tx_desc = eqos_ring_desc(tx, tx->next);
+	tx->next = eqos_ring_add(tx, tx->next, 1);
 
-	tx_desc->des0 = (ulong)eqos->tx_dma_buf;
+	tx_desc->des0 = (ulong)buf;
 	tx_desc->des1 = 0;
 	tx_desc->des2 = length;
 	/*
@@ -1418,47 +1438,69 @@ static int eqos_send(struct udevice *dev, void *packet, int length)
 	tx_desc->des3 = EQOS_DESC3_OWN | EQOS_DESC3_FD | EQOS_DESC3_LD | length;
 	eqos->config->ops->eqos_flush_desc(tx_desc);
 
-	writel((ulong)eqos_get_desc(eqos, eqos->tx_desc_idx, false),
+	writel((ulong)eqos_ring_desc(tx, tx->next),
 		&eqos->dma_regs->ch0_txdesc_tail_pointer);
 
-	for (i = 0; i < 1000000; i++) {
-		eqos->config->ops->eqos_inval_desc(tx_desc);
-		if (!(readl(&tx_desc->des3) & EQOS_DESC3_OWN))
-			return 0;
-		udelay(1);
-	}
+	return 0;
+}
 
-	debug("%s: TX timeout\n", __func__);
+/*
+ * Flush the RX descriptors which eqos_free_pkt() has given back, all in one
+ * go, then let the DMA use them by moving the tail pointer past them.
+ */
+static void eqos_rx_refill(struct eqos_priv *eqos)
+{
+	struct eqos_ring *rx = &eqos->rx_ring;
 
-	return -ETIMEDOUT;
+	if (!rx->dirty)
+		return;
+
+	eqos_ring_sync(rx, eqos_ring_add(rx, rx->next, -rx->dirty), rx->dirty,
+		       eqos->config->ops->eqos_flush_buffer);
+	rx->dirty = 0;
+
+	writel((ulong)eqos_ring_desc(rx, eqos_ring_add(rx, rx->next, -1)),
+	       &eqos->dma_regs->ch0_rxdesc_tail_pointer);
 }
 
 static int eqos_recv(struct udevice *dev, int flags, uchar **packetp)
 {
 	struct eqos_priv *eqos = dev_get_priv(dev);
+	struct eqos_ring *rx = &eqos->rx_ring;
 	struct eqos_desc *rx_desc;
+	unsigned int n;
 	int length;
-	int n;
 
 	debug("%s(dev=%p, flags=%x):\n", __func__, dev, flags);
 
-	rx_desc = eqos_get_desc(eqos, eqos->rx_desc_idx, true);
-	eqos->config->ops->eqos_inval_desc(rx_desc);
-	if (rx_desc->des3 & EQOS_DESC3_OWN) {
-		n = (eqos->rx_desc_idx + 1) % EQOS_DESCRIPTORS_RX;
-		rx_desc = eqos_get_desc(eqos, n, true);
-		eqos->config->ops->eqos_inval_desc(rx_desc);
-
-		if (rx_desc->des3 & EQOS_DESC3_OWN) {
-			debug("%s: RX packet not available\n", __func__);
-			return -EAGAIN;
+	/*
+	 * Look at a batch of descriptors with a single invalidate, so that the
+	 * following calls can return the frames already found without touching
+	 * the cache again.
+	 */
+	if (!rx->ready) {
+		eqos_rx_refill(eqos);
+
+		n = min_t(unsigned int, rx->num, EQOS_RX_SCAN_MAX);
+		eqos_ring_sync(rx, rx->next, n,
+			       eqos->config->ops->eqos_inval_buffer);
+		rx->ready = eqos_ring_scan(rx, n);
+
+		/* The DMA may have skipped a descriptor, so check the next */
+		if (!rx->ready) {
+			rx->next = eqos_ring_add(rx, rx->next, 1);
+			rx->ready = eqos_ring_scan(rx, n - 1);
+			if (!rx->ready) {
+				rx->next = eqos_ring_add(rx, rx->next, -1);
+				debug("%s: RX packet not available\n",
+				      __func__);
+				return -EAGAIN;
+			}
 		}
-
-		eqos->rx_desc_idx = n;
 	}
 
-	*packetp = eqos->rx_dma_buf +
-		(eqos->rx_desc_idx * EQOS_MAX_PACKET_SIZE);
+	rx_desc = eqos_ring_desc(rx, rx->next);
+	*packetp = eqos->rx_dma_buf + (rx->next * EQOS_MAX_PACKET_SIZE);
 	length = rx_desc->des3 & 0x7fff;
 	debug("%s: *packetp=%p, length=%d\n", __func__, *packetp, length);
 
@@ -1470,13 +1512,13 @@ static int eqos_recv(struct udevice *dev, int flags, uchar **packetp)
 static int eqos_free_pkt(struct udevice *dev, uchar *packet, int length)
 {
 	struct eqos_priv *eqos = dev_get_priv(dev);
+	struct eqos_ring *rx = &eqos->rx_ring;
 	uchar *packet_expected;
 	struct eqos_desc *rx_desc;
 
 	debug("%s(packet=%p, length=%d)\n", __func__, packet, length);
 
-	packet_expected = eqos->rx_dma_buf +
-		(eqos->rx_desc_idx * EQOS_MAX_PACKET_SIZE);
+	packet_expected = eqos->rx_dma_buf + (rx->next * EQOS_MAX_PACKET_SIZE);
 	if (packet != packet_expected) {
 		debug("%s: Unexpected packet (expected %p)\n", __func__,
 		      packet_expected);
@@ -1485,12 +1527,12 @@ static int eqos_free_pkt(struct udevice *dev, uchar *packet, int length)
 
 	eqos->config->ops->eqos_inval_buffer(packet, length);
 
-	rx_desc = eqos_get_desc(eqos, eqos->rx_desc_idx, true);
-
-	rx_desc->des0 = 0;
-	mb();
-	eqos->config->ops->eqos_flush_desc(rx_desc);
-	eqos->config->ops->eqos_inval_buffer(packet, length);
+	/*
+	 * The DMA does not look at this descriptor until it is flushed and the
+	 * tail pointer moves past it, which eqos_rx_refill() does for a batch
+	 * at a time.
+	 */
+	rx_desc = eqos_ring_desc(rx, rx->next);
 	rx_desc->des0 = (u32)(ulong)packet;
 	rx_desc->des1 = 0;
 	rx_desc->des2 = 0;
@@ -1500,12 +1542,10 @@ static int eqos_free_pkt(struct udevice *dev, uchar *packet, int length)
 	 */
 	mb();
 	rx_desc->des3 = EQOS_DESC3_OWN | EQOS_DESC3_BUF1V;
-	eqos->config->ops->eqos_flush_desc(rx_desc);
 
-	writel((ulong)rx_desc, &eqos->dma_regs->ch0_rxdesc_tail_pointer);
-
-	eqos->rx_desc_idx++;
-	eqos->rx_desc_idx %= EQOS_DESCRIPTORS_RX;
+	eqos_ring_consume(rx);
+	if (eqos_ring_refill_due(rx))
+		eqos_rx_refill(eqos);
 
 	return 0;
 }
@@ -1517,14 +1557,21 @@ static int eqos_probe_resources_core(struct udevice *dev)
 
 	debug("%s(dev=%p):\n", __func__, dev);
 
-	eqos->descs = eqos_alloc_descs(eqos, EQOS_DESCRIPTORS_NUM);
+	eqos->descs = eqos_alloc_descs(eqos, eqos->tx_ring.num +
+				       eqos->rx_ring.num);
 	if (!eqos->descs) {
 		debug("%s: eqos_alloc_descs() failed\n", __func__);
 		ret = -ENOMEM;
 		goto err;
 	}
+	eqos_ring_init(&eqos->tx_ring, eqos->descs, eqos->desc_size,
+		       eqos->tx_ring.num);
+	eqos_ring_init(&eqos->rx_ring,
+		       eqos->descs + eqos->tx_ring.num * eqos->desc_size,
+		       eqos->desc_size, eqos->rx_ring.num);
 
-	eqos->tx_dma_buf = memalign(EQOS_BUFFER_ALIGN, EQOS_MAX_PACKET_SIZE);
+	eqos->tx_dma_buf = memalign(EQOS_BUFFER_ALIGN,
+				    eqos->tx_ring.num * EQOS_MAX_PACKET_SIZE);
 	if (!eqos->tx_dma_buf) {
 		debug("%s: memalign(tx_dma_buf) failed\n", __func__);
 		ret = -ENOMEM;
@@ -1532,7 +1579,8 @@ static int eqos_probe_resources_core(struct udevice *dev)
 	}
 	debug("%s: tx_dma_buf=%p\n", __func__, eqos->tx_dma_buf);
 
-	eqos->rx_dma_buf = memalign(EQOS_BUFFER_ALIGN, EQOS_RX_BUFFER_SIZE);
+	eqos->rx_dma_buf = memalign(EQOS_BUFFER_ALIGN,
+				    eqos->rx_ring.num * EQOS_MAX_PACKET_SIZE);
 	if (!eqos->rx_dma_buf) {
 		debug("%s: memalign(rx_dma_buf) failed\n", __func__);
 		ret = -ENOMEM;
@@ -1549,7 +1597,7 @@ static int eqos_probe_resources_core(struct udevice *dev)
 	debug("%s: rx_pkt=%p\n", __func__, eqos->rx_pkt);
 
 	eqos->config->ops->eqos_inval_buffer(eqos->rx_dma_buf,
-			EQOS_MAX_PACKET_SIZE * EQOS_DESCRIPTORS_RX);
+			EQOS_MAX_PACKET_SIZE * eqos->rx_ring.num);
 
 	debug("%s: OK\n", __func__);
 	return 0;
@@ -1809,6 +1857,21 @@ static int eqos_remove_resources_stm32(struct udevice *dev)
 	return 0;
 }
 
+/* Read a ring size from the device tree, falling back to @def */
+static unsigned int eqos_ring_size(struct udevice *dev, const char *prop,
+				   unsigned int def)
+{
+	u32 num = dev_read_u32_default(dev, prop, def);
+
+	if (num < EQOS_DESCRIPTORS_MIN || num > EQOS_DESCRIPTORS_MAX) {
+		pr_warn("%s: %s %u out of range, using %u\n", dev->name, prop,
+			num, def);
+		return def;
+	}
+
+	return num;
+}
+
 static int eqos_probe(struct udevice *dev)
 {
 	struct eqos_priv *eqos = dev_get_priv(dev);
@@ -1829,6 +1892,11 @@ static int eqos_probe(struct udevice *dev)
 	eqos->dma_regs = (void *)(eqos->regs + EQOS_DMA_REGS_BASE);
 	eqos->tegra186_regs = (void *)(eqos->regs + EQOS_TEGRA186_REGS_BASE);
 
+	eqos->tx_ring.num = eqos_ring_size(dev, "u-boot,tx-ring-size",
+					   CONFIG_DWC_ETH_QOS_TX_DESCRIPTORS);
+	eqos->rx_ring.num = eqos_ring_size(dev, "u-boot,rx-ring-size",
+					   CONFIG_DWC_ETH_QOS_RX_DESCRIPTORS);
+
 	ret = eqos_probe_resources_core(dev);
 	if (ret < 0) {
 		pr_err("eqos_probe_resources_core() failed: %d", ret);
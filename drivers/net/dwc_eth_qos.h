@@ -7,6 +7,8 @@
 #include <phy_interface.h>
 #include <linux/bitops.h>
 
+#include "dwc_eth_qos_ring.h"
+
 #define EQOS_DMA_MODE_SWR				BIT(0)
 
 #define EQOS_MAC_RXQ_CTRL0_RXQ0EN_ENABLED_DCB		2
@@ -86,7 +88,8 @@ struct eqos_priv {
 	struct phy pcs;
 	u32 max_speed;
 	void *descs;
-	int tx_desc_idx, rx_desc_idx;
+	struct eqos_ring tx_ring;
+	struct eqos_ring rx_ring;
 	unsigned int desc_size;
 	void *tx_dma_buf;
 	void *rx_dma_buf;
@@ -0,0 +1,161 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Descriptor ring bookkeeping for the Synopsys DWC Ethernet QOS driver
+ *
+ * This only does index arithmetic and looks at the OWN bits, leaving register
+ * writes and cache maintenance to the driver, so that it can be tested
+ * without the hardware.
+ *
+ * Copyright 2023 NXP
+ */
+
+#ifndef __DWC_ETH_QOS_RING_H
+#define __DWC_ETH_QOS_RING_H
+
+#include <linux/bitops.h>
+#include <linux/kernel.h>
+#include <linux/types.h>
+
+struct eqos_desc {
+	u32 des0;
+	u32 des1;
+	u32 des2;
+	u32 des3;
+};
+
+#define EQOS_DESC3_OWN		BIT(31)
+#define EQOS_DESC3_FD		BIT(29)
+#define EQOS_DESC3_LD		BIT(28)
+#define EQOS_DESC3_BUF1V	BIT(24)
+
+/**
+ * struct eqos_ring - A ring of DMA descriptors
+ *
+ * Descriptors are @desc_size apart, which is a whole number of cache lines, so
+ * each can be flushed or invalidated without touching its neighbours and a
+ * run of them can be handled with a single range operation.
+ *
+ * @descs: First descriptor
+ * @desc_size: Distance between descriptors in bytes
+ * @num: Number of descriptors
+ * @next: Next descriptor for the CPU to use
+ * @ready: Number of descriptors from @next which the DMA has finished with and
+ *	whose cache lines are already invalidated (RX only)
+ * @dirty: Number of descriptors before @next which have been given back to the
+ *	DMA in the cache but not yet flushed (RX only)
+ */
+struct eqos_ring {
+	void *descs;
+	unsigned int desc_size;
+	unsigned int num;
+	unsigned int next;
+	unsigned int ready;
+	unsigned int dirty;
+};
+
+static inline void eqos_ring_init(struct eqos_ring *ring, void *descs,
+				  unsigned int desc_size, unsigned int num)
+{
+	ring->descs = descs;
+	ring->desc_size = desc_size;
+	ring->num = num;
+	ring->next = 0;
+	ring->ready = 0;
+	ring->dirty = 0;
+}
+
+/* Index @n descriptors after @idx, which may be negative */
+static inline unsigned int eqos_ring_add(const struct eqos_ring *ring,
+					 unsigned int idx, int n)
+{
+	return (idx + ring->num + n % (int)ring->num) % ring->num;
+}
+
+static inline struct eqos_desc *eqos_ring_desc(const struct eqos_ring *ring,
+					       unsigned int idx)
+{
+	return ring->descs + idx * ring->desc_size;
+}
+
+/**
+ * eqos_ring_sync() - Do cache maintenance on a run of descriptors
+ *
+ * The run may wrap past the end of the ring, in which case @op is called
+ * twice, otherwise once.
+ *
+ * @ring: Ring to use
+ * @first: Index of first descriptor
+ * @count: Number of descriptors, at most the ring size
+ * @op: Cache operation on a byte range, e.g. eqos_ops->eqos_inval_buffer
+ */
+static inline void eqos_ring_sync(const struct eqos_ring *ring,
+				  unsigned int first, unsigned int count,
+				  void (*op)(void *buf, size_t size))
+{
+	unsigned int n;
+
+	while (count) {
+		n = min(count, ring->num - first);
+		op(eqos_ring_desc(ring, first), n * ring->desc_size);
+		first = 0;
+		count -= n;
+	}
+}
+
+/**
+ * eqos_ring_scan() - Count the descriptors the DMA has finished with
+ *
+ * This looks at descriptors from @next, wrapping if needed, and stops at the
+ * first one still owned by the DMA. The caller must have invalidated them.
+ *
+ * @ring: Ring to use
+ * @max: Maximum number of descriptors to look at
+ * Return: number of descriptors from @next not owned by the DMA
+ */
+static inline unsigned int eqos_ring_scan(const struct eqos_ring *ring,
+					  unsigned int max)
+{
+	unsigned int i;
+
+	for (i = 0; i < max; i++) {
+		if (eqos_ring_desc(ring, eqos_ring_add(ring, ring->next, i))->des3 &
+		    EQOS_DESC3_OWN)
+			break;
+	}
+
+	return i;
+}
+
+/**
+ * eqos_ring_consume() - Move past a received descriptor
+ *
+ * The caller must already have given the descriptor back to the DMA in the
+ * cache. It is counted in @dirty until the caller flushes it.
+ *
+ * @ring: Ring to use
+ */
+static inline void eqos_ring_consume(struct eqos_ring *ring)
+{
+	ring->next = eqos_ring_add(ring, ring->next, 1);
+	if (ring->ready)
+		ring->ready--;
+	ring->dirty++;
+}
+
+/**
+ * eqos_ring_refill_due() - Check whether to flush given-back descriptors
+ *
+ * Flushing is deferred while more received frames are waiting, so that a
+ * burst of frames costs one flush and one tail pointer write, but not for so
+ * long that the DMA runs short of descriptors.
+ *
+ * @ring: Ring to use
+ * Return: true if the @dirty descriptors should be flushed now
+ */
+static inline bool eqos_ring_refill_due(const struct eqos_ring *ring)
+{
+	return ring->dirty &&
+	       (!ring->ready || ring->dirty >= max(ring->num / 4, 1U));
+}
+
+#endif /* __DWC_ETH_QOS_RING_H */
@@ -61,11 +61,24 @@ struct pfe_hif_wb_bd {
 	u16 seqnum;
 } __packed;
 
+/*
+ * RX: BDs from read_idx are owned by the HIF, of which the first @ready are
+ * known to be written back. BDs from write_idx back to read_idx hold frames
+ * given to the stack, and the @pending BDs before write_idx have been freed
+ * but not yet handed back to the HIF.
+ *
+ * TX: BDs from read_idx to write_idx are queued. Each frame uses two BDs and
+ * one of @bufs, taken in turn by @buf_idx.
+ */
 struct pfe_hif_ring {
 	struct pfe_hif_bd __iomem *bd;
 	struct pfe_hif_wb_bd __iomem *wb_bd;
 	u32 write_idx;
 	u32 read_idx;
+	u32 ready;
+	u32 pending;
+	void *bufs;
+	u32 buf_idx;
 	bool is_rx;
 };
 
@@ -74,6 +87,12 @@ static inline u32 pfe_hif_get_buffer_idx(u32 idx)
 	return idx % RING_LEN;
 }
 
+/* Number of entries from @from up to, but not including, @to */
+static inline u32 pfe_hif_get_count(u32 from, u32 to)
+{
+	return (to + RING_LEN - from) % RING_LEN;
+}
+
 static inline struct pfe_hif_bd *pfe_hif_get_bd(struct pfe_hif_ring *ring, u32 idx)
 {
 	return &ring->bd[idx];
@@ -19,7 +19,15 @@
 #define HIF_SOFT_RESET_TIMEOUT_US 1000000UL
 #define DUMMY_TX_BUF_LEN 64U
 
-static struct pfe_ct_hif_tx_hdr tx_header;
+/* TX frame buffers, each holding the HIF header followed by the frame */
+#define HIF_TX_BUFS		16U
+#define HIF_TX_BUF_SIZE		ALIGN(HIF_HEADER_SIZE + PKTSIZE_ALIGN, ARCH_DMA_MINALIGN)
+
+/* Most TX BDs in flight, two per frame */
+#define HIF_TX_MAX_BDS		min(RING_LEN - 1U, 2U * HIF_TX_BUFS)
+
+/* Most RX BDs to look at in one go */
+#define HIF_RX_BATCH		ETH_PACKETS_BATCH_RECV
 
 void pfe_hw_chnl_print_stats(struct pfe_hw_chnl *chnl)
 {
@@ -149,6 +157,40 @@ static void pfe_hw_inval_d(void *dat, u32 len)
 				roundup((u64)dat + len, ARCH_DMA_MINALIGN));
 }
 
+/*
+ * Do @op on @count consecutive ring entries of @size bytes each, starting at
+ * index @idx, with one call for each side of the end of the ring
+ */
+static void pfe_hif_ring_sync(void *base, size_t size, u32 idx, u32 count,
+			      void (*op)(void *dat, u32 len))
+{
+	u32 n;
+
+	while (count) {
+		n = min(count, RING_LEN - idx);
+		op(base + idx * size, n * size);
+		idx = 0;
+		count -= n;
+	}
+}
+
+static u32 pfe_hw_wb_bd_ctrl(struct pfe_hif_wb_bd *wb_bd)
+{
+	pfe_hw_inval_d(wb_bd, sizeof(*wb_bd));
+
+	return readl(&wb_bd->ctrl);
+}
+
+/* Wait for the HIF to write back a BD */
+static int pfe_hw_wb_bd_wait(struct pfe_hif_wb_bd *wb_bd)
+{
+	u32 wb_ctrl;
+
+	return read_poll_timeout(pfe_hw_wb_bd_ctrl, wb_bd, wb_ctrl,
+				 !(wb_ctrl & RING_WBBD_DESC_EN), 0,
+				 PFE_HW_BD_TIMEOUT_US);
+}
+
 void pfe_hw_chnl_rings_attach(struct pfe_hw_chnl *chnl)
 {
 	dma_addr_t txr = pfe_hw_dma_addr(chnl->tx_ring->bd);
@@ -212,6 +254,15 @@ static struct pfe_hif_ring *pfe_hw_chnl_rings_create(bool is_rx, void *bd, void
 
 	memset_io(ring->wb_bd, 0, size);
 
+	if (!is_rx) {
+		ring->bufs = pfe_hw_dma_alloc(HIF_TX_BUFS * HIF_TX_BUF_SIZE,
+					      ARCH_DMA_MINALIGN);
+		if (!ring->bufs) {
+			log_warning("WARN: HIF TX buffers couldn't be allocated.\n");
+			goto err_with_wb_bd;
+		}
+	}
+
 	ring->is_rx = is_rx;
 	ring->write_idx = 0;
 	ring->read_idx = 0;
@@ -250,6 +301,9 @@ static struct pfe_hif_ring *pfe_hw_chnl_rings_create(bool is_rx, void *bd, void
 
 	return ring;
 
+err_with_wb_bd:
+	if (!wb_db)
+		pfe_hw_dma_free(ring->wb_bd);
 err_with_bd:
 	if (!bd)
 		pfe_hw_dma_free(ring->bd);
@@ -263,6 +317,9 @@ static void pfe_hw_chnl_rings_destroy(struct pfe_hif_ring *ring, bool do_free)
 	if (!ring)
 		return;
 
+	if (ring->bufs)
+		pfe_hw_dma_free(ring->bufs);
+
 	if (do_free) {
 		if (ring->wb_bd)
 			pfe_hw_dma_free(ring->wb_bd);
@@ -374,213 +431,207 @@ void pfe_hw_hif_chnl_enable(struct pfe_hw_chnl *chnl)
 		   RX_BDP_POLL_CNTR_EN | RX_DMA_ENABLE | TX_BDP_POLL_CNTR_EN | TX_DMA_ENABLE);
 }
 
+/*
+ * Take back the TX BDs which the HIF has finished with, waiting until no more
+ * than @keep are still in flight
+ */
+static void pfe_hw_chnl_tx_reclaim(struct pfe_hw_chnl *chnl, u32 keep)
+{
+	struct pfe_hif_ring *ring = chnl->tx_ring;
+	struct pfe_hif_wb_bd *wb_bd;
+	u32 rd_idx = ring->read_idx;
+
+	while (rd_idx != ring->write_idx) {
+		wb_bd = pfe_hif_get_wb_bd(ring, rd_idx);
+		if (pfe_hw_wb_bd_ctrl(wb_bd) & RING_WBBD_DESC_EN) {
+			if (pfe_hif_get_count(rd_idx, ring->write_idx) <= keep)
+				break;
+			if (pfe_hw_wb_bd_wait(wb_bd) < 0)
+				log_debug("Tx BD timeout (%u)\n", rd_idx);
+		}
+
+		pfe_hif_get_bd(ring, rd_idx)->desc_en = 0;
+		rd_idx = pfe_hif_get_buffer_idx(rd_idx + 1);
+	}
+	ring->read_idx = rd_idx;
+}
+
 void pfe_hw_hif_chnl_disable(struct pfe_hw_chnl *chnl)
 {
+	/* Let queued frames go out first */
+	if (chnl->tx_ring)
+		pfe_hw_chnl_tx_reclaim(chnl, 0);
+
 	/* Disable RX & TX DMA engine and polling */
 	clrbits_32(pfe_hw_addr(chnl, HIF_CTRL_CHN(chnl->id)),
 		   RX_BDP_POLL_CNTR_EN | RX_DMA_ENABLE | TX_BDP_POLL_CNTR_EN | TX_DMA_ENABLE);
 }
 
-int pfe_hw_chnl_xmit(struct pfe_hw_chnl *chnl, bool is_ihc, u8 phyif, void *packet, int length)
+/* Queue one TX BD, which the HIF may start on straight away */
+static void pfe_hw_chnl_tx_bd(struct pfe_hif_ring *ring, void *data, u32 len,
+			      bool lifm)
 {
-	struct pfe_hif_ring *ring = chnl->tx_ring;
-	struct pfe_hif_bd *bd_hd, *bd_pkt, *bp_rd;
-	struct pfe_hif_wb_bd *wb_bd_hd, *wb_bd_pkt, *wb_bp_rd;
-	u32 wr_idx, wr_idx_1, rd_idx;
-	int ret;
-
-	if (length < 0)
-		return -EINVAL;
-
-	wr_idx = pfe_hif_get_buffer_idx(ring->write_idx);
-	wr_idx_1 = pfe_hif_get_buffer_idx(wr_idx + 1);
+	u32 wr_idx = ring->write_idx;
+	struct pfe_hif_bd *bd = pfe_hif_get_bd(ring, wr_idx);
+	struct pfe_hif_wb_bd *wb_bd = pfe_hif_get_wb_bd(ring, wr_idx);
+
+	pfe_hif_set_bd_data(bd, data);
+	bd->buflen = (u16)len;
+	bd->status = 0;
+	bd->lifm = lifm;
+	pfe_hw_inval_d(wb_bd, sizeof(*wb_bd));
+	wb_bd->desc_en = 1;
+	pfe_hw_flush_d(wb_bd, sizeof(*wb_bd));
+	dmb();
+	bd->desc_en = 1;
+	pfe_hw_flush_d(bd, sizeof(*bd));
 
-	/* Get descriptor for header */
-	bd_hd = pfe_hif_get_bd(ring, wr_idx);
-	wb_bd_hd = pfe_hif_get_wb_bd(ring, wr_idx);
+	ring->write_idx = pfe_hif_get_buffer_idx(wr_idx + 1);
+}
 
-	/* Get descriptor for packet */
-	bd_pkt = pfe_hif_get_bd(ring, wr_idx_1);
-	wb_bd_pkt = pfe_hif_get_wb_bd(ring, wr_idx_1);
+/* Get the next TX buffer, with the HIF header filled in */
+static struct pfe_ct_hif_tx_hdr *pfe_hw_chnl_tx_buf(struct pfe_hw_chnl *chnl,
+						    u8 flags, u8 phyif)
+{
+	struct pfe_hif_ring *ring = chnl->tx_ring;
+	struct pfe_ct_hif_tx_hdr *tx_hdr;
 
-	pfe_hw_inval_d(bd_hd, sizeof(struct pfe_hif_bd));
-	pfe_hw_inval_d(bd_pkt, sizeof(struct pfe_hif_bd));
+	tx_hdr = ring->bufs + (ring->buf_idx % HIF_TX_BUFS) * HIF_TX_BUF_SIZE;
+	ring->buf_idx++;
 
-	if (pfe_hif_get_bd_desc_en(bd_hd))
-		log_debug("Invalid Tx desc state (%u)\n", wr_idx);
-	else if (pfe_hif_get_bd_desc_en(bd_pkt))
-		log_debug("Invalid Tx desc state (%u)\n", wr_idx_1);
+	memset(tx_hdr, 0, HIF_HEADER_SIZE);
+	tx_hdr->flags = flags;
+	tx_hdr->chid = chnl->id;
+	tx_hdr->e_phy_ifs = htonl(1U << phyif);
 
-	/* Flush the data buffer */
-	pfe_hw_flush_d(packet, length);
+	return tx_hdr;
+}
 
-	/* Fill header */
-	memset(&tx_header, 0, HIF_HEADER_SIZE);
+/*
+ * The frame is copied, so this returns once it is queued and the BDs are
+ * taken back on later calls, once the HIF has moved on.
+ */
+int pfe_hw_chnl_xmit(struct pfe_hw_chnl *chnl, bool is_ihc, u8 phyif, void *packet, int length)
+{
+	struct pfe_hif_ring *ring = chnl->tx_ring;
+	struct pfe_ct_hif_tx_hdr *tx_hdr;
+	void *data;
 
-	if (is_ihc)
-		tx_header.flags = HIF_TX_INJECT | HIF_TX_IHC;
-	else
-		tx_header.flags = HIF_TX_INJECT;
+	if (length < 0 || length > PKTSIZE_ALIGN)
+		return -EINVAL;
 
-	tx_header.chid = chnl->id;
-	tx_header.e_phy_ifs = htonl(1U << phyif);
-	pfe_hw_flush_d(&tx_header, HIF_HEADER_SIZE);
+	/* Make room for the header and packet BDs */
+	pfe_hw_chnl_tx_reclaim(chnl, HIF_TX_MAX_BDS - 2);
 
-	pfe_hif_set_bd_data(bd_hd, &tx_header);
-	bd_hd->buflen = HIF_HEADER_SIZE;
-	bd_hd->status = 0;
-	bd_hd->lifm = 0;
-	wb_bd_hd->desc_en = 1;
-	dmb();
-	bd_hd->desc_en = 1;
-	pfe_hw_flush_d(wb_bd_hd, sizeof(*wb_bd_hd));
-	pfe_hw_flush_d(bd_hd, sizeof(*bd_hd));
+	tx_hdr = pfe_hw_chnl_tx_buf(chnl, is_ihc ? HIF_TX_INJECT | HIF_TX_IHC :
+				    HIF_TX_INJECT, phyif);
+	data = (void *)tx_hdr + HIF_HEADER_SIZE;
+	memcpy(data, packet, length);
+	pfe_hw_flush_d(tx_hdr, HIF_HEADER_SIZE + length);
 
-	/* Fill packet */
-	pfe_hif_set_bd_data(bd_pkt, packet);
-	bd_pkt->buflen = (uint16_t)length;
-	bd_pkt->status = 0;
-	bd_pkt->lifm = 1;
-	wb_bd_pkt->desc_en = 1;
-	dmb();
-	bd_pkt->desc_en = 1;
-	pfe_hw_flush_d(wb_bd_pkt, sizeof(*wb_bd_pkt));
-	pfe_hw_flush_d(bd_pkt, sizeof(*bd_pkt));
-
-	/* Increment index for next buffer descriptor */
-	wr_idx = pfe_hif_get_buffer_idx(wr_idx + 2);
-	ring->write_idx = wr_idx;
-	rd_idx = pfe_hif_get_buffer_idx(ring->read_idx);
-
-	/* Tx Confirmation */
-	while (rd_idx != wr_idx) {
-		u32 wb_ctrl = 0;
-
-		bp_rd = pfe_hif_get_bd(ring, rd_idx);
-		wb_bp_rd = pfe_hif_get_wb_bd(ring, rd_idx);
-
-		pfe_hw_inval_d(bp_rd, sizeof(struct pfe_hif_bd));
-		pfe_hw_inval_d(wb_bp_rd, sizeof(struct pfe_hif_wb_bd));
-
-		ret = readl_poll_timeout(&wb_bp_rd->ctrl, wb_ctrl,
-					 !(wb_ctrl & RING_WBBD_DESC_EN),
-					 PFE_HW_BD_TIMEOUT_US);
-		if (ret < 0)
-			log_debug("Tx BD timeout (%d)\n", ret);
-
-		bp_rd->desc_en = 0;
-		wb_bp_rd->desc_en = 0;
-		dmb();
-		rd_idx = pfe_hif_get_buffer_idx(rd_idx + 1);
-		ring->read_idx = rd_idx;
-	}
+	pfe_hw_chnl_tx_bd(ring, tx_hdr, HIF_HEADER_SIZE, false);
+	pfe_hw_chnl_tx_bd(ring, data, length, true);
 
 	return 0;
 }
 
 int pfe_hw_chnl_xmit_dummy(struct pfe_hw_chnl *chnl)
 {
-	struct pfe_hif_ring *ring = chnl->tx_ring;
-	struct pfe_hif_bd *bd_hd, *bp_rd;
-	struct pfe_hif_wb_bd *wb_bd_hd, *wb_bp_rd;
 	struct pfe_ct_hif_tx_hdr *tx_hdr;
-	u32 wr_idx, rd_idx;
-	int ret;
 
-	tx_hdr = pfe_hw_dma_alloc(sizeof(struct pfe_ct_hif_tx_hdr) + DUMMY_TX_BUF_LEN, 8U);
-	if (!tx_hdr)
-		return -ENOMEM;
+	pfe_hw_chnl_tx_reclaim(chnl, HIF_TX_MAX_BDS - 1);
 
-	memset(tx_hdr, 0, sizeof(struct pfe_ct_hif_tx_hdr) + DUMMY_TX_BUF_LEN);
+	tx_hdr = pfe_hw_chnl_tx_buf(chnl, HIF_TX_INJECT | HIF_TX_IHC,
+				    PFE_PHY_IF_ID_HIF0 + chnl->id);
+	memset((void *)tx_hdr + HIF_HEADER_SIZE, 0, DUMMY_TX_BUF_LEN);
+	pfe_hw_flush_d(tx_hdr, HIF_HEADER_SIZE + DUMMY_TX_BUF_LEN);
 
-	tx_hdr->e_phy_ifs = htonl(1U << (PFE_PHY_IF_ID_HIF0 + chnl->id));
-	tx_hdr->flags = HIF_TX_INJECT | HIF_TX_IHC;
-	tx_hdr->chid = chnl->id;
+	pfe_hw_chnl_tx_bd(chnl->tx_ring, tx_hdr,
+			  HIF_HEADER_SIZE + DUMMY_TX_BUF_LEN, true);
 
-	wr_idx = pfe_hif_get_buffer_idx(ring->write_idx);
+	/* The caller expects the frame to be out */
+	pfe_hw_chnl_tx_reclaim(chnl, 0);
 
-	/* Get descriptor for header */
-	bd_hd = pfe_hif_get_bd(ring, wr_idx);
-	wb_bd_hd = pfe_hif_get_wb_bd(ring, wr_idx);
+	return 0;
+}
 
-	pfe_hw_inval_d(bd_hd, sizeof(struct pfe_hif_bd));
+/*
+ * Hand the freed RX BDs back to the HIF, a batch at a time. The write-back
+ * BDs are armed first so that a frame is never reported in a stale one.
+ */
+static void pfe_hw_chnl_rx_refill(struct pfe_hif_ring *ring)
+{
+	u32 first, i;
 
-	if (pfe_hif_get_bd_desc_en(bd_hd))
-		log_debug("Invalid Tx desc state (%u)\n", wr_idx);
+	if (!ring->pending)
+		return;
 
-	pfe_hw_flush_d(tx_hdr, sizeof(struct pfe_ct_hif_tx_hdr) + DUMMY_TX_BUF_LEN);
+	first = pfe_hif_get_buffer_idx(ring->write_idx + RING_LEN - ring->pending);
 
-	pfe_hif_set_bd_data(bd_hd, tx_hdr);
-	bd_hd->buflen = sizeof(struct pfe_ct_hif_tx_hdr) + DUMMY_TX_BUF_LEN;
-	bd_hd->status = 0;
-	bd_hd->lifm = 1;
-	wb_bd_hd->desc_en = 1;
+	pfe_hif_ring_sync(ring->wb_bd, sizeof(*ring->wb_bd), first,
+			  ring->pending, pfe_hw_inval_d);
+	for (i = 0; i < ring->pending; i++)
+		pfe_hif_get_wb_bd(ring, pfe_hif_get_buffer_idx(first + i))->desc_en = 1;
+	pfe_hif_ring_sync(ring->wb_bd, sizeof(*ring->wb_bd), first,
+			  ring->pending, pfe_hw_flush_d);
 	dmb();
-	bd_hd->desc_en = 1;
-	pfe_hw_flush_d(wb_bd_hd, sizeof(*wb_bd_hd));
-	pfe_hw_flush_d(bd_hd, sizeof(*bd_hd));
-
-	/* Increment index for next buffer descriptor */
-	wr_idx = pfe_hif_get_buffer_idx(wr_idx + 1);
-	ring->write_idx = wr_idx;
-	rd_idx = pfe_hif_get_buffer_idx(ring->read_idx);
-
-	/* Tx Confirmation */
-	while (rd_idx != wr_idx) {
-		u32 wb_ctrl = 0;
-
-		bp_rd = pfe_hif_get_bd(ring, rd_idx);
-		wb_bp_rd = pfe_hif_get_wb_bd(ring, rd_idx);
-
-		pfe_hw_inval_d(bp_rd, sizeof(struct pfe_hif_bd));
-		pfe_hw_inval_d(wb_bp_rd, sizeof(struct pfe_hif_wb_bd));
-
-		ret = readl_poll_timeout(&wb_bp_rd->ctrl, wb_ctrl,
-					 !(wb_ctrl & RING_WBBD_DESC_EN),
-					 PFE_HW_BD_TIMEOUT_US);
-		if (ret < 0)
-			log_debug("Tx BD timeout (%d)\n", ret);
-
-		bp_rd->desc_en = 0;
-		wb_bp_rd->desc_en = 0;
-		dmb();
-		rd_idx = pfe_hif_get_buffer_idx(rd_idx + 1);
-		ring->read_idx = rd_idx;
-	}
+	for (i = 0; i < ring->pending; i++)
+		pfe_hif_get_bd(ring, pfe_hif_get_buffer_idx(first + i))->desc_en = 1;
+	pfe_hif_ring_sync(ring->bd, sizeof(*ring->bd), first, ring->pending,
+			  pfe_hw_flush_d);
 
-	pfe_hw_dma_free(tx_hdr);
+	ring->pending = 0;
+}
 
-	return 0;
+/*
+ * Count the RX BDs written back since read_idx, looking at up to a batch of
+ * them with one cache invalidation
+ */
+static u32 pfe_hw_chnl_rx_scan(struct pfe_hif_ring *ring)
+{
+	struct pfe_hif_wb_bd *wb_bd;
+	u32 count, i;
+
+	/* Only BDs the HIF owns can have been written back */
+	count = RING_LEN - pfe_hif_get_count(ring->write_idx, ring->read_idx);
+	count = min_t(u32, count, HIF_RX_BATCH);
+
+	pfe_hif_ring_sync(ring->wb_bd, sizeof(*ring->wb_bd), ring->read_idx,
+			  count, pfe_hw_inval_d);
+	for (i = 0; i < count; i++) {
+		wb_bd = pfe_hif_get_wb_bd(ring, pfe_hif_get_buffer_idx(ring->read_idx + i));
+		if (readl(&wb_bd->ctrl) & RING_WBBD_DESC_EN)
+			break;
+	}
+
+	return i;
 }
 
+/*
+ * The packet is left in the ring buffer, which goes back to the HIF when
+ * pfe_hw_chnl_free_pkt() is called. This does not wait for a frame.
+ */
 int pfe_hw_chnl_receive(struct pfe_hw_chnl *chnl, int flags, bool strip_hdr, uchar **packetp)
 {
 	struct pfe_hif_bd *bd_pkt;
 	struct pfe_hif_wb_bd *wb_bd_pkt;
 	struct pfe_hif_ring *ring = chnl->rx_ring;
-	u32 wb_ctrl = 0;
 	u32 rd_idx;
 	int plen = 0;
 
-	rd_idx = pfe_hif_get_buffer_idx(ring->read_idx);
+	if (!ring->ready) {
+		pfe_hw_chnl_rx_refill(ring);
+		ring->ready = pfe_hw_chnl_rx_scan(ring);
+		if (!ring->ready)
+			return -EAGAIN;
+	}
+
+	rd_idx = ring->read_idx;
 	bd_pkt = pfe_hif_get_bd(ring, rd_idx);
 	wb_bd_pkt = pfe_hif_get_wb_bd(ring, rd_idx);
 
-	pfe_hw_inval_d(bd_pkt, sizeof(struct pfe_hif_bd));
-	pfe_hw_inval_d(wb_bd_pkt, sizeof(struct pfe_hif_wb_bd));
-
-	/* check if we received data */
-	if (readl_poll_timeout(&wb_bd_pkt->ctrl, wb_ctrl,
-			       !(wb_ctrl & RING_WBBD_DESC_EN),
-			       PFE_HW_BD_TIMEOUT_US) < 0)
-		return -EAGAIN;
-
 	/* Give the data to u-boot stack */
 	bd_pkt->desc_en = 0;
-	wb_bd_pkt->desc_en = 1;
-	pfe_hw_flush_d(wb_bd_pkt, sizeof(*wb_bd_pkt));
-	pfe_hw_flush_d(bd_pkt, sizeof(*bd_pkt));
-	dmb();
 	if (strip_hdr) {
 		*packetp = pfe_hif_get_bd_data_strip_hdr(bd_pkt);
 		if (wb_bd_pkt->buflen >= HIF_HEADER_SIZE)
@@ -591,8 +642,8 @@ int pfe_hw_chnl_receive(struct pfe_hw_chnl *chnl, int flags, bool strip_hdr, uch
 	}
 
 	/* Advance read buffer */
-	rd_idx = pfe_hif_get_buffer_idx(rd_idx + 1);
-	ring->read_idx = rd_idx;
+	ring->read_idx = pfe_hif_get_buffer_idx(rd_idx + 1);
+	ring->ready--;
 
 	/* Invalidate the buffer */
 	pfe_hw_inval_d(*packetp, plen);
@@ -606,45 +657,41 @@ int pfe_hw_chnl_receive(struct pfe_hw_chnl *chnl, int flags, bool strip_hdr, uch
 	return plen;
 }
 
+/*
+ * The BD keeps pointing at the same buffer, so freeing just re-arms it. The
+ * HIF only sees it once pfe_hw_chnl_rx_refill() runs, when the batch of
+ * received frames is used up or enough BDs are waiting.
+ */
 int pfe_hw_chnl_free_pkt(struct pfe_hw_chnl *chnl, uchar *packet, int length)
 {
 	struct pfe_hif_ring *ring = chnl->rx_ring;
 	struct pfe_hif_bd *bd_pkt;
-	struct pfe_hif_wb_bd *wb_bd_pkt;
 	u32 wr_idx;
 
 	if (length < 0)
 		return -EINVAL;
 
-	wr_idx = pfe_hif_get_buffer_idx(ring->write_idx);
+	wr_idx = ring->write_idx;
 	bd_pkt = pfe_hif_get_bd(ring, wr_idx);
-	wb_bd_pkt = pfe_hif_get_wb_bd(ring, wr_idx);
-
-	pfe_hw_inval_d(bd_pkt, sizeof(struct pfe_hif_bd));
-	pfe_hw_inval_d(wb_bd_pkt, sizeof(struct pfe_hif_wb_bd));
 
 	if (bd_pkt->desc_en) {
 		log_err("ERR: Can't free buffer since the BD entry is used\n");
 		return -EIO;
 	}
 
-	/* Free buffer */
 	bd_pkt->buflen = PKTSIZE_ALIGN;
 	bd_pkt->status = 0;
 	bd_pkt->lifm = 1;
-	wb_bd_pkt->desc_en = 1;
-	pfe_hw_flush_d(wb_bd_pkt, sizeof(*wb_bd_pkt));
-	dmb();
-	bd_pkt->desc_en = 1;
-	pfe_hw_flush_d(bd_pkt, sizeof(*bd_pkt));
 
 	/* This has to be here for correct HW functionality */
 	pfe_hw_flush_d(packet, length);
 	pfe_hw_inval_d(packet, length);
 
 	/* Advance free pointer */
-	wr_idx = pfe_hif_get_buffer_idx(wr_idx + 1);
-	ring->write_idx = wr_idx;
+	ring->write_idx = pfe_hif_get_buffer_idx(wr_idx + 1);
+	ring->pending++;
+	if (!ring->ready || ring->pending >= max(RING_LEN / 4U, 1U))
+		pfe_hw_chnl_rx_refill(ring);
 
 	return 0;
 }
@@ -6,6 +6,7 @@
  */
 
 #include <common.h>
+#include <time.h>
 #include <dm/device_compat.h>
 #include <linux/delay.h>
 
@@ -23,6 +24,9 @@
 
 #define FLUSH_COUNT_LIMIT (RING_LEN * 4)
 
+/* How long to wait for each IHC frame */
+#define IHC_RX_TIMEOUT_US 1000UL
+
 enum pfe_idex_frame_type {
 	IDEX_FRAME_CTRL_REQUEST,
 	IDEX_FRAME_CTRL_RESPONSE,
@@ -100,6 +104,21 @@ static inline void advance_idex_seqnum(void)
 	idex_seqnum++;
 }
 
+/* Receiving does not wait for a frame, so poll for a little while */
+static int ihc_receive(struct pfe_hw_ext *ext, uchar **packetp)
+{
+	ulong start = timer_get_us();
+	int ret;
+
+	do {
+		ret = pfe_hw_chnl_receive(ext->hw_chnl, 0, false, packetp);
+		if (ret != -EAGAIN)
+			break;
+	} while (timer_get_us() - start < IHC_RX_TIMEOUT_US);
+
+	return ret;
+}
+
 static int idex_rpc(struct pfe_hw_ext *ext, void *ihc_frame, u32 cmd_id, u8 length, int *rpc_ret)
 {
 	struct pfe_idex_rpc_req_hdr *rpc_req = (void *)ihc_frame;
@@ -137,7 +156,7 @@ static int idex_rpc(struct pfe_hw_ext *ext, void *ihc_frame, u32 cmd_id, u8 leng
 	mdelay(500);
 
 	while (retry-- > 0) {
-		ret = pfe_hw_chnl_receive(ext->hw_chnl, 0, false, &rec_buf);
+		ret = ihc_receive(ext, &rec_buf);
 		if (ret < 0 || !rec_buf)
 			continue;
 
@@ -263,7 +282,7 @@ static int hif_channel_grace_reset(struct pfe_hw_ext *ext)
 		udelay(500);
 
 		rec_buf = NULL;
-		ret = pfe_hw_chnl_receive(ext->hw_chnl, 0, false, &rec_buf);
+		ret = ihc_receive(ext, &rec_buf);
 		if (ret < 0 || !rec_buf)
 			break;
 	} while (flush_count < FLUSH_COUNT_LIMIT);
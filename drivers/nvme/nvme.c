@@ -15,9 +15,10 @@
 #include <time.h>
 #include <dm/device-internal.h>
 #include <linux/compat.h>
+#include <linux/time.h>
 #include "nvme.h"
 
-#define NVME_Q_DEPTH		2
+#define NVME_Q_DEPTH		CONFIG_NVME_IO_QUEUE_DEPTH
 #define NVME_AQ_DEPTH		2
 #define NVME_SQ_SIZE(depth)	(depth * sizeof(struct nvme_command))
 #define NVME_CQ_SIZE(depth)	(depth * sizeof(struct nvme_completion))
@@ -25,7 +26,6 @@
 				      ARCH_DMA_MINALIGN)
 #define ADMIN_TIMEOUT		60
 #define IO_TIMEOUT		30
-#define MAX_PRP_POOL		512
 
 static int nvme_wait_ready(struct nvme_dev *dev, bool enabled)
 {
@@ -45,68 +45,38 @@ static int nvme_wait_ready(struct nvme_dev *dev, bool enabled)
 	return -ETIME;
 }
 
-static int nvme_setup_prps(struct nvme_dev *dev, u64 *prp2,
-			   int total_len, u64 dma_addr)
+/*
+ * Fill in the PRP entries of an I/O command. Transfers are limited so that
+ * the PRP list, if one is needed, fits in the page owned by the slot.
+ */
+static void nvme_setup_prps(struct nvme_dev *dev, struct nvme_io_slot *slot,
+			    u64 *prp2, int total_len, u64 dma_addr)
 {
 	u32 page_size = dev->page_size;
 	int offset = dma_addr & (page_size - 1);
-	u64 *prp_pool;
 	int length = total_len;
-	int i, nprps;
-	u32 prps_per_page = page_size >> 3;
-	u32 num_pages;
+	int i = 0;
 
 	length -= (page_size - offset);
 
 	if (length <= 0) {
 		*prp2 = 0;
-		return 0;
+		return;
 	}
 
-	if (length)
-		dma_addr += (page_size - offset);
+	dma_addr += (page_size - offset);
 
 	if (length <= page_size) {
 		*prp2 = dma_addr;
-		return 0;
-	}
-
-	nprps = DIV_ROUND_UP(length, page_size);
-	num_pages = DIV_ROUND_UP(nprps, prps_per_page);
-
-	if (nprps > dev->prp_entry_num) {
-		free(dev->prp_pool);
-		/*
-		 * Always increase in increments of pages.  It doesn't waste
-		 * much memory and reduces the number of allocations.
-		 */
-		dev->prp_pool = memalign(page_size, num_pages * page_size);
-		if (!dev->prp_pool) {
-			printf("Error: malloc prp_pool fail\n");
-			return -ENOMEM;
-		}
-		dev->prp_entry_num = prps_per_page * num_pages;
+		return;
 	}
 
-	prp_pool = dev->prp_pool;
-	i = 0;
-	while (nprps) {
-		if (i == ((page_size >> 3) - 1)) {
-			*(prp_pool + i) = cpu_to_le64((ulong)prp_pool +
-					page_size);
-			i = 0;
-			prp_pool += page_size;
-		}
-		*(prp_pool + i++) = cpu_to_le64(dma_addr);
+	while (length > 0) {
+		slot->prp_list[i++] = cpu_to_le64(dma_addr);
 		dma_addr += page_size;
-		nprps--;
+		length -= page_size;
 	}
-	*prp2 = (ulong)dev->prp_pool;
-
-	flush_dcache_range((ulong)dev->prp_pool, (ulong)dev->prp_pool +
-			   dev->prp_entry_num * sizeof(u64));
-
-	return 0;
+	*prp2 = (ulong)slot->prp_list;
 }
 
 static __le16 nvme_get_cmd_id(void)
@@ -159,6 +129,53 @@ static void nvme_submit_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
 	nvmeq->sq_tail = tail;
 }
 
+/**
+ * nvme_queue_cmd() - copy a command into a queue without ringing the doorbell
+ *
+ * This allows several commands to be handed to the controller with a single
+ * doorbell write by nvme_ring_sq(). Controllers with their own submit_cmd()
+ * method have each command submitted straight away.
+ *
+ * @nvmeq:	The queue to use
+ * @cmd:	The command to send
+ */
+static void nvme_queue_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
+{
+	struct nvme_ops *ops;
+
+	ops = (struct nvme_ops *)nvmeq->dev->udev->driver->ops;
+	if (ops && ops->submit_cmd) {
+		nvme_submit_cmd(nvmeq, cmd);
+		return;
+	}
+
+	memcpy(&nvmeq->sq_cmds[nvmeq->sq_tail], cmd, sizeof(*cmd));
+	if (++nvmeq->sq_tail == nvmeq->q_depth)
+		nvmeq->sq_tail = 0;
+}
+
+/* Make commands added by nvme_queue_cmd() visible to the controller */
+static void nvme_ring_sq(struct nvme_queue *nvmeq, u16 first)
+{
+	struct nvme_ops *ops;
+	u16 last = nvmeq->sq_tail;
+
+	ops = (struct nvme_ops *)nvmeq->dev->udev->driver->ops;
+	if ((ops && ops->submit_cmd) || first == last)
+		return;
+
+	if (first < last) {
+		flush_dcache_range((ulong)&nvmeq->sq_cmds[first],
+				   (ulong)&nvmeq->sq_cmds[last]);
+	} else {
+		flush_dcache_range((ulong)&nvmeq->sq_cmds[first],
+				   (ulong)&nvmeq->sq_cmds[nvmeq->q_depth]);
+		flush_dcache_range((ulong)&nvmeq->sq_cmds[0],
+				   (ulong)&nvmeq->sq_cmds[last]);
+	}
+	writel(last, nvmeq->q_db);
+}
+
 static int nvme_submit_sync_cmd(struct nvme_queue *nvmeq,
 				struct nvme_command *cmd,
 				u32 *result, unsigned timeout)
@@ -719,65 +736,297 @@ static int nvme_blk_probe(struct udevice *udev)
 	return 0;
 }
 
-static ulong nvme_blk_rw(struct udevice *udev, lbaint_t blknr,
-			 lbaint_t blkcnt, void *buffer, bool read)
+/* Set up the I/O slots once the maximum transfer size is known */
+static int nvme_setup_io_slots(struct nvme_dev *dev)
+{
+	struct nvme_ops *ops = (struct nvme_ops *)dev->udev->driver->ops;
+	u32 page_size = dev->page_size;
+	int i;
+
+	/*
+	 * Controllers with their own submission method handle a single
+	 * command at a time
+	 */
+	if (ops && ops->submit_cmd)
+		dev->nr_slots = 1;
+	else
+		dev->nr_slots = dev->queues[NVME_IO_Q]->q_depth - 1;
+
+	dev->slots = calloc(dev->nr_slots, sizeof(*dev->slots));
+	if (!dev->slots)
+		return -ENOMEM;
+
+	/* One page of PRP entries for each slot */
+	dev->prp_pool = memalign(page_size, dev->nr_slots * page_size);
+	if (!dev->prp_pool) {
+		free(dev->slots);
+		return -ENOMEM;
+	}
+	dev->prp_entry_num = page_size >> 3;
+	for (i = 0; i < dev->nr_slots; i++)
+		dev->slots[i].prp_list = dev->prp_pool + i * dev->prp_entry_num;
+
+	return 0;
+}
+
+static void nvme_io_done(struct nvme_dev *dev, struct nvme_io_slot *slot,
+			 int status)
+{
+	struct blk_req *req = slot->req;
+
+	if (req->op == BLK_REQ_READ)
+		invalidate_dcache_range(slot->buf, slot->buf + slot->len);
+	if (status)
+		req->result = status;
+	else if (req->result >= 0)
+		req->result += slot->blkcnt;
+
+	slot->req = NULL;
+	dev->inflight--;
+	if (!--req->pending)
+		blk_req_complete(req, req->result);
+}
+
+/**
+ * nvme_reset_io_queue() - stop the controller working on the I/O queue
+ *
+ * Deleting the submission queue makes the controller complete or abort every
+ * command on it before it reports back, after which the queue is created
+ * again. If the controller does not respond, or the queue cannot be created
+ * again, it is disabled instead, which stops all its DMA but leaves it
+ * unusable.
+ *
+ * @dev:	NVMe device
+ * Return: 0 if the controller no longer accesses the buffers of the commands
+ * in flight, -ve on error, in which case it still might
+ */
+static int nvme_reset_io_queue(struct nvme_dev *dev)
+{
+	struct nvme_queue *nvmeq = dev->queues[NVME_IO_Q];
+	int ret;
+
+	ret = nvme_delete_sq(dev, NVME_IO_Q);
+	if (!ret)
+		ret = nvme_delete_cq(dev, NVME_IO_Q);
+	if (ret) {
+		printf("ERROR: %s: cannot delete I/O queue, disabling\n",
+		       dev->udev->name);
+		return nvme_disable_ctrl(dev);
+	}
+
+	dev->online_queues = NVME_IO_Q;
+	ret = nvme_create_queue(nvmeq, NVME_IO_Q);
+	if (ret) {
+		printf("ERROR: %s: cannot create I/O queue, disabling\n",
+		       dev->udev->name);
+		nvme_disable_ctrl(dev);
+		dev->online_queues = 0;
+		return ret;
+	}
+
+	return 0;
+}
+
+/**
+ * nvme_io_poll() - process I/O completions
+ *
+ * The completion queue is drained and its doorbell written once before any
+ * request callbacks are called, since these may submit more commands.
+ *
+ * @dev:	NVMe device
+ * Return: number of commands completed, or -ETIMEDOUT if outstanding
+ * commands have not completed in time
+ */
+static int nvme_io_poll(struct nvme_dev *dev)
+{
+	struct nvme_queue *nvmeq = dev->queues[NVME_IO_Q];
+	struct nvme_ops *ops = (struct nvme_ops *)dev->udev->driver->ops;
+	u16 head = nvmeq->cq_head;
+	u16 phase = nvmeq->cq_phase;
+	u16 cids[NVME_Q_DEPTH];
+	u16 status[NVME_Q_DEPTH];
+	ulong timeout_us = IO_TIMEOUT * USEC_PER_SEC;
+	int count = 0;
+	int i;
+
+	if (!dev->inflight)
+		return 0;
+
+	while (count < dev->inflight) {
+		status[count] = nvme_read_completion_status(nvmeq, head);
+		if ((status[count] & 0x01) != phase)
+			break;
+		cids[count] = readw(&nvmeq->cqes[head].command_id);
+		if (ops && ops->complete_cmd && cids[count] < dev->nr_slots)
+			ops->complete_cmd(nvmeq, &dev->slots[cids[count]].cmd);
+		if (++head == nvmeq->q_depth) {
+			head = 0;
+			phase = !phase;
+		}
+		count++;
+	}
+
+	if (!count) {
+		if (timer_get_us() - dev->io_time < timeout_us)
+			return 0;
+		printf("ERROR: %s: I/O timeout\n", dev->udev->name);
+
+		/*
+		 * The slots and their PRP pages cannot be reused, nor the
+		 * buffers handed back, while the controller may still write
+		 * to them
+		 */
+		if (nvme_reset_io_queue(dev)) {
+			dev->io_time = timer_get_us();
+			return -ETIMEDOUT;
+		}
+		for (i = 0; i < dev->nr_slots; i++)
+			if (dev->slots[i].req)
+				nvme_io_done(dev, &dev->slots[i], -ETIMEDOUT);
+		return -ETIMEDOUT;
+	}
+
+	writel(head, nvmeq->q_db + dev->db_stride);
+	nvmeq->cq_head = head;
+	nvmeq->cq_phase = phase;
+	dev->io_time = timer_get_us();
+
+	for (i = 0; i < count; i++) {
+		struct nvme_io_slot *slot;
+
+		if (cids[i] >= dev->nr_slots || !dev->slots[cids[i]].req) {
+			printf("ERROR: unexpected command id %x\n", cids[i]);
+			continue;
+		}
+		slot = &dev->slots[cids[i]];
+		status[i] >>= 1;
+		if (status[i])
+			printf("ERROR: status = %x, command id = %x\n",
+			       status[i], cids[i]);
+		nvme_io_done(dev, slot, status[i] ? -EIO : 0);
+	}
+
+	return count;
+}
+
+static struct nvme_io_slot *nvme_get_io_slot(struct nvme_dev *dev,
+					     u16 *first)
+{
+	struct nvme_queue *nvmeq = dev->queues[NVME_IO_Q];
+	int i, ret;
+
+	for (;;) {
+		for (i = 0; i < dev->nr_slots; i++)
+			if (!dev->slots[i].req)
+				return &dev->slots[i];
+
+		/* Queue full: start what we have and wait for a completion */
+		nvme_ring_sq(nvmeq, *first);
+		*first = nvmeq->sq_tail;
+		ret = nvme_io_poll(dev);
+		if (ret < 0)
+			return NULL;
+	}
+}
+
+static int nvme_blk_submit(struct udevice *udev, struct blk_req *req)
 {
 	struct nvme_ns *ns = dev_get_priv(udev);
 	struct nvme_dev *dev = ns->dev;
-	struct nvme_command c;
-	struct blk_desc *desc = dev_get_uclass_plat(udev);
-	int status;
+	struct nvme_queue *nvmeq = dev->queues[NVME_IO_Q];
+	struct nvme_io_slot *slot;
+	struct nvme_command *c;
+	u32 max_len = min(1U << dev->max_transfer_shift,
+			  dev->prp_entry_num * dev->page_size);
+	u16 max_lbas = max_len >> ns->lba_shift;
+	u16 first = nvmeq->sq_tail;
+	u64 slba = req->start;
 	u64 prp2;
-	u64 total_len = blkcnt << desc->log2blksz;
-	u64 temp_len = total_len;
-	uintptr_t temp_buffer = (uintptr_t)buffer;
-
-	u64 slba = blknr;
-	u16 lbas = 1 << (dev->max_transfer_shift - ns->lba_shift);
-	u64 total_lbas = blkcnt;
-
-	flush_dcache_range((unsigned long)buffer,
-			   (unsigned long)buffer + total_len);
-
-	c.rw.opcode = read ? nvme_cmd_read : nvme_cmd_write;
-	c.rw.flags = 0;
-	c.rw.nsid = cpu_to_le32(ns->ns_id);
-	c.rw.control = 0;
-	c.rw.dsmgmt = 0;
-	c.rw.reftag = 0;
-	c.rw.apptag = 0;
-	c.rw.appmask = 0;
-	c.rw.metadata = 0;
-
-	while (total_lbas) {
-		if (total_lbas < lbas) {
-			lbas = (u16)total_lbas;
-			total_lbas = 0;
-		} else {
+	int i;
+
+	if (!dev->inflight)
+		dev->io_time = timer_get_us();
+
+	/* Hold the request open until all its commands are queued */
+	req->pending = 1;
+	for (i = 0; i < req->sg_count; i++) {
+		uintptr_t buf = (uintptr_t)req->sg[i].buffer;
+		u64 total_lbas = req->sg[i].blkcnt;
+		u64 total_len = total_lbas << ns->lba_shift;
+
+		flush_dcache_range(buf, buf + total_len);
+		while (total_lbas) {
+			u16 lbas = min_t(u64, total_lbas, max_lbas);
+
+			slot = nvme_get_io_slot(dev, &first);
+			if (!slot) {
+				req->result = -ETIMEDOUT;
+				goto out;
+			}
+
+			c = &slot->cmd;
+			memset(c, '\0', sizeof(*c));
+			c->rw.opcode = req->op == BLK_REQ_READ ?
+				nvme_cmd_read : nvme_cmd_write;
+			c->rw.command_id = cpu_to_le16(slot - dev->slots);
+			c->rw.nsid = cpu_to_le32(ns->ns_id);
+			c->rw.slba = cpu_to_le64(slba);
+			c->rw.length = cpu_to_le16(lbas - 1);
+			nvme_setup_prps(dev, slot, &prp2,
+					lbas << ns->lba_shift, buf);
+			c->rw.prp1 = cpu_to_le64(buf);
+			c->rw.prp2 = cpu_to_le64(prp2);
+			if (prp2 == (ulong)slot->prp_list)
+				flush_dcache_range((ulong)slot->prp_list,
+						   (ulong)slot->prp_list +
+						   dev->page_size);
+
+			slot->req = req;
+			slot->buf = buf;
+			slot->len = lbas << ns->lba_shift;
+			slot->blkcnt = lbas;
+			req->pending++;
+			dev->inflight++;
+			nvme_queue_cmd(nvmeq, c);
+
+			slba += lbas;
+			buf += slot->len;
 			total_lbas -= lbas;
 		}
-
-		if (nvme_setup_prps(dev, &prp2,
-				    lbas << ns->lba_shift, temp_buffer))
-			return -EIO;
-		c.rw.slba = cpu_to_le64(slba);
-		slba += lbas;
-		c.rw.length = cpu_to_le16(lbas - 1);
-		c.rw.prp1 = cpu_to_le64(temp_buffer);
-		c.rw.prp2 = cpu_to_le64(prp2);
-		status = nvme_submit_sync_cmd(dev->queues[NVME_IO_Q],
-				&c, NULL, IO_TIMEOUT);
-		if (status)
-			break;
-		temp_len -= (u32)lbas << ns->lba_shift;
-		temp_buffer += lbas << ns->lba_shift;
 	}
 
-	if (read)
-		invalidate_dcache_range((unsigned long)buffer,
-					(unsigned long)buffer + total_len);
+out:
+	nvme_ring_sq(nvmeq, first);
+	if (!--req->pending)
+		blk_req_complete(req, req->result);
+
+	return 0;
+}
+
+static int nvme_blk_poll(struct udevice *udev)
+{
+	struct nvme_ns *ns = dev_get_priv(udev);
+
+	return nvme_io_poll(ns->dev);
+}
+
+static ulong nvme_blk_rw(struct udevice *udev, lbaint_t blknr,
+			 lbaint_t blkcnt, void *buffer, bool read)
+{
+	struct nvme_ns *ns = dev_get_priv(udev);
+	struct blk_req req;
+	int ret;
 
-	return (total_len - temp_len) >> desc->log2blksz;
+	blk_req_init(&req, read ? BLK_REQ_READ : BLK_REQ_WRITE, blknr, blkcnt,
+		     buffer);
+	nvme_blk_submit(udev, &req);
+	while (!req.complete) {
+		ret = nvme_io_poll(ns->dev);
+		if (ret < 0)
+			return ret;
+	}
+
+	return req.result;
 }
 
 static ulong nvme_blk_read(struct udevice *udev, lbaint_t blknr,
@@ -795,6 +1044,8 @@ static ulong nvme_blk_write(struct udevice *udev, lbaint_t blknr,
 static const struct blk_ops nvme_blk_ops = {
 	.read	= nvme_blk_read,
 	.write	= nvme_blk_write,
+	.submit	= nvme_blk_submit,
+	.poll	= nvme_blk_poll,
 };
 
 U_BOOT_DRIVER(nvme_blk) = {
@@ -836,21 +1087,19 @@ int nvme_init(struct udevice *udev)
 	if (ret)
 		goto free_queue;
 
-	/* Allocate after the page size is known */
-	ndev->prp_pool = memalign(ndev->page_size, MAX_PRP_POOL);
-	if (!ndev->prp_pool) {
-		ret = -ENOMEM;
-		printf("Error: %s: Out of memory!\n", udev->name);
-		goto free_nvme;
-	}
-	ndev->prp_entry_num = MAX_PRP_POOL >> 3;
-
 	ret = nvme_setup_io_queues(ndev);
 	if (ret)
 		goto free_queue;
 
 	nvme_get_info_from_identify(ndev);
 
+	/* Allocate after the page size is known */
+	ret = nvme_setup_io_slots(ndev);
+	if (ret) {
+		printf("Error: %s: Out of memory!\n", udev->name);
+		goto free_queue;
+	}
+
 	/* Create a blk device for each namespace */
 
 	id = memalign(ndev->page_size, sizeof(struct nvme_id_ns));
@@ -594,6 +594,28 @@ enum {
 	NVME_CSTS_SHST_MASK	= 3 << 2,
 };
 
+/**
+ * struct nvme_io_slot - an I/O command in flight
+ *
+ * Slots are indexed by command ID. Each owns a page of PRP entries in the
+ * device's PRP pool, so that many commands can be outstanding at once.
+ *
+ * @req:	Block request the command belongs to, NULL if the slot is free
+ * @cmd:	The command, kept for controller-specific completion
+ * @prp_list:	PRP list used by the command
+ * @buf:	Start of the data buffer
+ * @len:	Length of the data buffer in bytes
+ * @blkcnt:	Number of blocks transferred by the command
+ */
+struct nvme_io_slot {
+	struct blk_req *req;
+	struct nvme_command cmd;
+	u64 *prp_list;
+	ulong buf;
+	u32 len;
+	u32 blkcnt;
+};
+
 /* Represents an NVM Express device. Each nvme_dev is a PCI function. */
 struct nvme_dev {
 	struct udevice *udev;
@@ -621,6 +643,10 @@ struct nvme_dev {
 	u64 *prp_pool;
 	u32 prp_entry_num;
 	u32 nn;
+	struct nvme_io_slot *slots;
+	u32 nr_slots;
+	u32 inflight;
+	ulong io_time;
 };
 
 /* Admin queue and a single I/O queue. */
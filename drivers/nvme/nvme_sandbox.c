@@ -0,0 +1,238 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Sandbox NVM Express controller, for testing purposes only
+ *
+ * The controller has a single namespace backed by a small RAM disk. Since
+ * sandbox cannot trap register accesses, it uses the controller-specific
+ * submission hook and carries out each command as soon as it is submitted.
+ * Tests must enable memory-mapped I/O with sandbox_set_enable_memio().
+ */
+
+#include <common.h>
+#include <dm.h>
+#include <asm/io.h>
+#include <asm/test.h>
+#include "nvme.h"
+
+#define SANDBOX_NVME_SECTORS	64
+#define SANDBOX_NVME_REGS_SIZE	8192
+
+struct sandbox_nvme_priv {
+	struct nvme_dev ndev;
+	u64 regs[SANDBOX_NVME_REGS_SIZE / sizeof(u64)];
+	u8 disk[SANDBOX_NVME_SECTORS * 512];
+	u16 cq_tail[NVME_Q_NUM];
+	u8 cq_phase[NVME_Q_NUM];
+	bool io_live;
+	bool hold_io;
+	int io_resets;
+};
+
+static void sandbox_nvme_identify(struct sandbox_nvme_priv *priv,
+				  struct nvme_command *cmd)
+{
+	void *buf = (void *)(uintptr_t)le64_to_cpu(cmd->identify.prp1);
+	struct nvme_id_ctrl *ctrl = buf;
+	struct nvme_id_ns *ns = buf;
+
+	memset(buf, '\0', sizeof(struct nvme_id_ctrl));
+	switch (le32_to_cpu(cmd->identify.cns)) {
+	case 0:
+		if (le32_to_cpu(cmd->identify.nsid) != 1)
+			break;
+		ns->nsze = cpu_to_le64(SANDBOX_NVME_SECTORS);
+		ns->ncap = ns->nsze;
+		ns->nuse = ns->nsze;
+		ns->lbaf[0].ds = 9;
+		break;
+	case 1:
+		ctrl->nn = cpu_to_le32(1);
+		memcpy(ctrl->sn, "0123456789", 10);
+		memcpy(ctrl->mn, "sandbox", 7);
+		memcpy(ctrl->fr, "1.0", 3);
+		break;
+	}
+}
+
+static u16 sandbox_nvme_admin(struct sandbox_nvme_priv *priv,
+			      struct nvme_command *cmd)
+{
+	switch (cmd->common.opcode) {
+	case nvme_admin_identify:
+		sandbox_nvme_identify(priv, cmd);
+		return NVME_SC_SUCCESS;
+	case nvme_admin_set_features:
+		/* A single I/O queue pair, reported in the result as 0 */
+		return NVME_SC_SUCCESS;
+	case nvme_admin_create_cq:
+		priv->cq_tail[le16_to_cpu(cmd->create_cq.cqid)] = 0;
+		priv->cq_phase[le16_to_cpu(cmd->create_cq.cqid)] = 1;
+		return NVME_SC_SUCCESS;
+	case nvme_admin_create_sq:
+		priv->io_live = true;
+		return NVME_SC_SUCCESS;
+	case nvme_admin_delete_sq:
+		/* Any commands being held are dropped */
+		priv->io_live = false;
+		priv->io_resets++;
+		return NVME_SC_SUCCESS;
+	case nvme_admin_delete_cq:
+		return NVME_SC_SUCCESS;
+	default:
+		return NVME_SC_INVALID_OPCODE;
+	}
+}
+
+/* Copy data between the RAM disk and the pages given by the PRP entries */
+static void sandbox_nvme_xfer(struct sandbox_nvme_priv *priv,
+			      struct nvme_command *cmd, u8 *disk, ulong len,
+			      bool write)
+{
+	ulong page_size = priv->ndev.page_size;
+	u64 addr = le64_to_cpu(cmd->rw.prp1);
+	u64 prp2 = le64_to_cpu(cmd->rw.prp2);
+	u64 *list = NULL;
+	ulong chunk;
+
+	chunk = min(len, page_size - (ulong)(addr & (page_size - 1)));
+	for (;;) {
+		if (write)
+			memcpy(disk, (void *)(uintptr_t)addr, chunk);
+		else
+			memcpy((void *)(uintptr_t)addr, disk, chunk);
+		disk += chunk;
+		len -= chunk;
+		if (!len)
+			break;
+
+		/* The second PRP is a list if more than one page is left */
+		if (!list && len > page_size)
+			list = (u64 *)(uintptr_t)prp2;
+		addr = list ? le64_to_cpu(*list++) : prp2;
+		chunk = min(len, page_size);
+	}
+}
+
+static u16 sandbox_nvme_io(struct sandbox_nvme_priv *priv,
+			   struct nvme_command *cmd)
+{
+	u64 slba = le64_to_cpu(cmd->rw.slba);
+	u32 nlb = le16_to_cpu(cmd->rw.length) + 1;
+
+	if (le32_to_cpu(cmd->rw.nsid) != 1)
+		return NVME_SC_INVALID_NS;
+	if (slba + nlb > SANDBOX_NVME_SECTORS)
+		return NVME_SC_LBA_RANGE;
+
+	switch (cmd->rw.opcode) {
+	case nvme_cmd_read:
+	case nvme_cmd_write:
+		sandbox_nvme_xfer(priv, cmd, priv->disk + slba * 512,
+				  nlb * 512, cmd->rw.opcode == nvme_cmd_write);
+		return NVME_SC_SUCCESS;
+	default:
+		return NVME_SC_INVALID_OPCODE;
+	}
+}
+
+static int sandbox_nvme_setup_queue(struct nvme_queue *nvmeq)
+{
+	struct nvme_bar *bar = nvmeq->dev->bar;
+
+	/*
+	 * Writes to the configuration register cannot be seen, so report the
+	 * controller as ready once its admin queue is set up, which is just
+	 * before nvme_init() enables it
+	 */
+	if (nvmeq->qid == NVME_ADMIN_Q)
+		bar->csts = NVME_CSTS_RDY;
+
+	return 0;
+}
+
+static void sandbox_nvme_submit_cmd(struct nvme_queue *nvmeq,
+				    struct nvme_command *cmd)
+{
+	struct sandbox_nvme_priv *priv =
+		container_of(nvmeq->dev, struct sandbox_nvme_priv, ndev);
+	struct nvme_completion *cqe;
+	int qid = nvmeq->qid;
+	u16 status;
+
+	if (qid == NVME_ADMIN_Q) {
+		status = sandbox_nvme_admin(priv, cmd);
+	} else {
+		/* Commands which are held never complete */
+		if (!priv->io_live || priv->hold_io)
+			return;
+		status = sandbox_nvme_io(priv, cmd);
+	}
+
+	cqe = &nvmeq->cqes[priv->cq_tail[qid]];
+	memset(cqe, '\0', sizeof(*cqe));
+	cqe->sq_id = cpu_to_le16(qid);
+	cqe->command_id = cmd->common.command_id;
+	cqe->status = cpu_to_le16(status << 1 | priv->cq_phase[qid]);
+	if (++priv->cq_tail[qid] == nvmeq->q_depth) {
+		priv->cq_tail[qid] = 0;
+		priv->cq_phase[qid] = !priv->cq_phase[qid];
+	}
+}
+
+static void sandbox_nvme_complete_cmd(struct nvme_queue *nvmeq,
+				      struct nvme_command *cmd)
+{
+	if (++nvmeq->sq_tail == nvmeq->q_depth)
+		nvmeq->sq_tail = 0;
+}
+
+void sandbox_nvme_hold_io(struct udevice *dev, bool hold)
+{
+	struct sandbox_nvme_priv *priv = dev_get_priv(dev);
+
+	priv->hold_io = hold;
+}
+
+int sandbox_nvme_get_io_resets(struct udevice *dev)
+{
+	struct sandbox_nvme_priv *priv = dev_get_priv(dev);
+
+	return priv->io_resets;
+}
+
+static int sandbox_nvme_probe(struct udevice *dev)
+{
+	struct sandbox_nvme_priv *priv = dev_get_priv(dev);
+	struct nvme_bar *bar = (struct nvme_bar *)priv->regs;
+	int i;
+
+	/* 64 queue entries, 500ms timeout, 4KB pages */
+	bar->cap = cpu_to_le64(63 | 1 << 24);
+	for (i = 0; i < NVME_Q_NUM; i++)
+		priv->cq_phase[i] = 1;
+
+	strcpy(priv->ndev.vendor, "sandbox");
+	priv->ndev.bar = bar;
+
+	return nvme_init(dev);
+}
+
+static const struct nvme_ops sandbox_nvme_ops = {
+	.setup_queue = sandbox_nvme_setup_queue,
+	.submit_cmd = sandbox_nvme_submit_cmd,
+	.complete_cmd = sandbox_nvme_complete_cmd,
+};
+
+static const struct udevice_id sandbox_nvme_ids[] = {
+	{ .compatible = "sandbox,nvme" },
+	{ }
+};
+
+U_BOOT_DRIVER(sandbox_nvme) = {
+	.name	= "sandbox_nvme",
+	.id	= UCLASS_NVME,
+	.of_match = sandbox_nvme_ids,
+	.ops	= &sandbox_nvme_ops,
+	.probe	= sandbox_nvme_probe,
+	.priv_auto	= sizeof(struct sandbox_nvme_priv),
+};
@@ -1073,6 +1073,7 @@ static int pci_uclass_pre_probe(struct udevice *bus)
 		if (ret)
 			return ret;
 		bus->seq_ = uclass_find_next_free_seq(uc);
+		uclass_index_update(bus);
 	}
 
 	/* For bridges, use the top-level PCI controller */
@@ -1899,6 +1900,13 @@ int pci_init(void)
 {
 	struct udevice *bus;
 
+	/*
+	 * Bring up the controllers together so that link training overlaps.
+	 * Errors are ignored here as in the loop below, which picks up the
+	 * bridges found while scanning.
+	 */
+	uclass_probe_all_async(UCLASS_PCI);
+
 	/*
 	 * Enumerate all known controller devices. Enumeration has the side-
 	 * effect of probing them, so PCIe devices will be enumerated too.
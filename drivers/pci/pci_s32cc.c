@@ -19,7 +19,6 @@
 #include <dm/uclass-internal.h>
 #include <dm/uclass.h>
 #include <linux/io.h>
-#include <linux/iopoll.h>
 #include <linux/sizes.h>
 #include <linux/time.h>
 #include <s32-cc/pcie.h>
@@ -415,18 +414,6 @@ static int s32cc_pcie_link_is_up(struct dw_pcie *pcie)
 	return has_data_phy_link(s32cc_pp);
 }
 
-static int wait_phy_data_link(struct s32cc_pcie *s32cc_pp)
-{
-	bool has_link;
-	int ret = read_poll_timeout(has_data_phy_link, s32cc_pp, has_link, has_link,
-			PCIE_LINK_WAIT_US, PCIE_LINK_TIMEOUT_US);
-
-	if (ret)
-		dev_dbg(s32cc_pp->pcie.dev, "Failed to stabilize PHY link\n");
-
-	return ret;
-}
-
 static bool speed_change_completed(struct dw_pcie *pcie)
 {
 	u32 ctrl = dw_pcie_readl_dbi(pcie, PCIE_LINK_WIDTH_SPEED_CONTROL);
@@ -451,16 +438,14 @@ static u32 s32cc_pcie_get_link_width(struct dw_pcie *pcie)
 	return (link_sta & PCI_EXP_LNKSTA_NLW) >> PCI_EXP_LNKSTA_NLW_SHIFT;
 }
 
-static int s32cc_pcie_start_link(struct dw_pcie *pcie)
+/*
+ * Start link training, which s32cc_pcie_poll_link() then waits for. This
+ * takes a while, so the probe can overlap with that of other devices.
+ */
+static void s32cc_pcie_kick_link(struct s32cc_pcie *s32cc_pp)
 {
-	struct s32cc_pcie *s32cc_pp = to_s32cc_from_dw_pcie(pcie);
+	struct dw_pcie *pcie = &s32cc_pp->pcie;
 	u32 tmp, cap_offset;
-	bool speed_set;
-	int ret = 0;
-
-	/* Don't do anything if not Root Complex */
-	if (!is_s32cc_pcie_rc(s32cc_pp->mode))
-		return 0;
 
 	/* Try to (re)establish the link, starting with Gen1 */
 	s32cc_pcie_disable_ltssm(s32cc_pp);
@@ -502,22 +487,66 @@ static int s32cc_pcie_start_link(struct dw_pcie *pcie)
 	dw_pcie_writel_dbi(pcie, PCIE_LINK_WIDTH_SPEED_CONTROL, tmp);
 	dw_pcie_dbi_ro_wr_dis(pcie);
 
-	ret = read_poll_timeout(speed_change_completed, pcie, speed_set,
-				speed_set, PCIE_LINK_WAIT_US,
-				PCIE_LINK_TIMEOUT_US);
+	s32cc_pp->link_state = S32CC_PCIE_LINK_SPEED_CHANGE;
+	s32cc_pp->link_start_us = timer_get_us();
+}
 
-	/* Make sure link training is finished as well! */
-	if (!ret) {
-		ret = wait_phy_data_link(s32cc_pp);
-	} else {
-		dev_err(pcie->dev, "Speed change timeout\n");
-		ret = -EINVAL;
+/*
+ * Check progress of link training started by s32cc_pcie_kick_link(). This
+ * returns -EAGAIN until the link is up or a step times out.
+ */
+static int s32cc_pcie_poll_link(struct s32cc_pcie *s32cc_pp)
+{
+	struct dw_pcie *pcie = &s32cc_pp->pcie;
+	ulong elapsed = timer_get_us() - s32cc_pp->link_start_us;
+
+	switch (s32cc_pp->link_state) {
+	case S32CC_PCIE_LINK_IDLE:
+		return 0;
+	case S32CC_PCIE_LINK_SPEED_CHANGE:
+		if (!speed_change_completed(pcie)) {
+			if (elapsed < PCIE_LINK_TIMEOUT_US)
+				return -EAGAIN;
+			dev_err(pcie->dev, "Speed change timeout\n");
+			s32cc_pp->link_state = S32CC_PCIE_LINK_IDLE;
+			return -EINVAL;
+		}
+
+		/* Make sure link training is finished as well! */
+		s32cc_pp->link_state = S32CC_PCIE_LINK_DATA;
+		s32cc_pp->link_start_us = timer_get_us();
+		elapsed = 0;
+		fallthrough;
+	case S32CC_PCIE_LINK_DATA:
+		if (!has_data_phy_link(s32cc_pp)) {
+			if (elapsed < PCIE_LINK_TIMEOUT_US)
+				return -EAGAIN;
+			dev_dbg(pcie->dev, "Failed to stabilize PHY link\n");
+			s32cc_pp->link_state = S32CC_PCIE_LINK_IDLE;
+			return -ETIMEDOUT;
+		}
+		break;
 	}
 
-	if (!ret)
-		dev_info(pcie->dev, "X%d, Gen%d\n",
-			 s32cc_pcie_get_link_width(pcie),
-			 s32cc_pcie_get_link_speed(pcie));
+	s32cc_pp->link_state = S32CC_PCIE_LINK_IDLE;
+	dev_info(pcie->dev, "X%d, Gen%d\n", s32cc_pcie_get_link_width(pcie),
+		 s32cc_pcie_get_link_speed(pcie));
+
+	return 0;
+}
+
+static int s32cc_pcie_start_link(struct dw_pcie *pcie)
+{
+	struct s32cc_pcie *s32cc_pp = to_s32cc_from_dw_pcie(pcie);
+	int ret;
+
+	/* Don't do anything if not Root Complex */
+	if (!is_s32cc_pcie_rc(s32cc_pp->mode))
+		return 0;
+
+	s32cc_pcie_kick_link(s32cc_pp);
+	while ((ret = s32cc_pcie_poll_link(s32cc_pp)) == -EAGAIN)
+		udelay(PCIE_LINK_WAIT_US);
 
 	return ret;
 }
@@ -866,11 +895,15 @@ static int s32cc_pcie_config_host(struct s32cc_pcie *s32cc_pp)
 
 	dw_pcie_setup_rc(pcie);
 
-	ret = s32cc_pcie_start_link(pcie);
-	if (ret) {
-		dev_info(pcie->dev, "Failed to get link up\n");
-		return 0;
-	}
+	s32cc_pcie_kick_link(s32cc_pp);
+
+	return 0;
+}
+
+/* Set up the host once the link is up */
+static void s32cc_pcie_config_link(struct s32cc_pcie *s32cc_pp)
+{
+	struct dw_pcie *pcie = &s32cc_pp->pcie;
 
 	/* Enable writing dbi registers */
 	dw_pcie_dbi_ro_wr_en(&s32cc_pp->pcie);
@@ -889,8 +922,6 @@ static int s32cc_pcie_config_host(struct s32cc_pcie *s32cc_pp)
 
 	/* Disable writing dbi registers */
 	dw_pcie_dbi_ro_wr_dis(&s32cc_pp->pcie);
-
-	return 0;
 }
 
 struct dw_pcie_ops s32cc_dw_pcie_ops = {
@@ -900,6 +931,23 @@ struct dw_pcie_ops s32cc_dw_pcie_ops = {
 	.write_dbi2 = s32cc_pcie_write,
 };
 
+static int s32cc_pcie_probe_poll(struct udevice *dev)
+{
+	struct s32cc_pcie *s32cc_pp = dev_get_priv(dev);
+	int ret;
+
+	ret = s32cc_pcie_poll_link(s32cc_pp);
+	if (ret == -EAGAIN)
+		return ret;
+	if (ret) {
+		dev_info(dev, "Failed to get link up\n");
+		return 0;
+	}
+	s32cc_pcie_config_link(s32cc_pp);
+
+	return 0;
+}
+
 static int s32cc_pcie_probe(struct udevice *dev)
 {
 	struct s32cc_pcie *s32cc_pp = dev_get_priv(dev);
@@ -922,6 +970,15 @@ static int s32cc_pcie_probe(struct udevice *dev)
 	}
 
 	dw_pcie_dbi_ro_wr_dis(pcie);
+	if (ret)
+		return ret;
+
+	/* Otherwise driver model waits for the link, see probe_poll() */
+	if (!CONFIG_IS_ENABLED(DM_ASYNC_PROBE)) {
+		while ((ret = s32cc_pcie_probe_poll(dev)) == -EAGAIN)
+			udelay(PCIE_LINK_WAIT_US);
+	}
+
 	return ret;
 }
 
@@ -1077,6 +1134,7 @@ U_BOOT_DRIVER(pci_s32cc) = {
 	.ops = &s32cc_dm_pcie_ops,
 	.of_to_plat = s32cc_pcie_dt_init_host,
 	.probe	= s32cc_pcie_probe,
+	DM_PROBE_POLL_PTR(s32cc_pcie_probe_poll)
 	.priv_auto = sizeof(struct s32cc_pcie),
 	.flags = DM_FLAG_SEQ_PARENT_ALIAS,
 };
@@ -64,6 +64,13 @@ struct s32cc_pcie;
 
 enum pcie_link_speed;
 
+/* Progress of link training, see s32cc_pcie_poll_link() */
+enum s32cc_pcie_link_state {
+	S32CC_PCIE_LINK_IDLE,
+	S32CC_PCIE_LINK_SPEED_CHANGE,
+	S32CC_PCIE_LINK_DATA,
+};
+
 struct s32cc_pcie {
 	struct pcie_dw	pcie;
 
@@ -83,6 +90,9 @@ struct s32cc_pcie {
 
 	int atu_out_num;
 	int atu_in_num;
+
+	enum s32cc_pcie_link_state link_state;
+	ulong link_start_us;
 };
 
 struct s32cc_pcie_ep {
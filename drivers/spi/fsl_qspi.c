@@ -26,11 +26,13 @@
 #include <common.h>
 #include <clk.h>
 #include <dm.h>
+#include <dma.h>
 #include <dm/device_compat.h>
 #include <inttypes.h>
 #include <log.h>
 #include <spi.h>
 #include <spi-mem.h>
+#include <asm/cache.h>
 #include <asm/global_data.h>
 #include <linux/bitops.h>
 #include <linux/delay.h>
@@ -49,6 +51,9 @@
 #define	SEQID_LUT			15
 #define	SEQID_LUT_AHB		14
 
+/* Direct-mapped reads of at least this size are copied with DMA, if enabled */
+#define FSL_QSPI_DMA_MIN_LEN		SZ_64K
+
 /* Registers used by the driver */
 #define QUADSPI_MCR			0x00
 #define QUADSPI_MCR_DQS_EXTERNAL	(0x3 << 24)
@@ -427,6 +432,8 @@ struct fsl_qspi {
 	const struct fsl_qspi_devtype_data *devtype_data;
 	int selected;
 	enum spi_nor_protocol proto;
+	struct spi_mem_dirmap_desc *ahb_desc;
+	bool no_dma;
 };
 
 static inline int needs_swap_endian(struct fsl_qspi *q)
@@ -1165,6 +1172,9 @@ static int fsl_qspi_exec_op(struct spi_slave *slave,
 #endif
 	fsl_qspi_prepare_lut(q, op);
 
+	/* The AHB LUT and mode may have changed under a direct mapping */
+	q->ahb_desc = NULL;
+
 	if (is_octal_dtr_op(op))
 		enable_octal_ddr(q);
 
@@ -1344,10 +1354,160 @@ static __maybe_unused int fsl_qspi_clk_en(struct udevice *bus)
 	return ret;
 }
 
+#if CONFIG_IS_ENABLED(SPI_DIRMAP)
+static int fsl_qspi_dirmap_create(struct spi_mem_dirmap_desc *desc)
+{
+	struct fsl_qspi *q = dev_get_priv(desc->slave->dev->parent);
+
+	/* Without the full map, the AHB window only covers one buffer */
+	if (!IS_ENABLED(CONFIG_FSL_QSPI_AHB_FULL_MAP))
+		return -EOPNOTSUPP;
+
+	if (desc->info.offset + desc->info.length > fsl_qspi_memsize_per_cs(q))
+		return -EOPNOTSUPP;
+
+	if (!fsl_qspi_supports_op(desc->slave, &desc->info.op_tmpl))
+		return -EOPNOTSUPP;
+
+	return 0;
+}
+
+static void fsl_qspi_dirmap_destroy(struct spi_mem_dirmap_desc *desc)
+{
+	struct fsl_qspi *q = dev_get_priv(desc->slave->dev->parent);
+
+	if (q->ahb_desc == desc)
+		q->ahb_desc = NULL;
+}
+
+/*
+ * Program the AHB LUT and the controller mode for the read operation of a
+ * mapping. This stays in place until exec_op() is next called, so that
+ * back-to-back reads keep the AHB buffer and its prefetch.
+ */
+static int fsl_qspi_dirmap_setup(struct fsl_qspi *q,
+				 struct spi_mem_dirmap_desc *desc)
+{
+	struct spi_mem_op op = desc->info.op_tmpl;
+	int ret = 0;
+
+	op.data.nbytes = q->devtype_data->ahb_buf_size;
+	fsl_qspi_prepare_lut(q, &op);
+
+	if (is_octal_dtr_op(&op))
+		ret = enable_octal_ddr(q);
+
+	if (is_spi_op(&op))
+		ret = fsl_qspi_default_setup(q);
+
+	if (ret)
+		return ret;
+
+	qspi_writel(q, QUADSPI_RBCT_WMRK_MASK, q->iobase + QUADSPI_RBCT);
+
+	/* Drop anything read into the AHB buffer with the previous LUT */
+	fsl_qspi_invalidate(q);
+	q->ahb_desc = desc;
+
+	return 0;
+}
+
+static bool fsl_qspi_dma_copy(struct fsl_qspi *q, void *dst,
+			      const void __iomem *src, size_t len)
+{
+	int ret;
+
+	ret = dma_memcpy(dst, (void *)src, len);
+	if (ret < 0) {
+		/* Do not look for a DMA device again if there is none */
+		if (ret == -EPROTONOSUPPORT || ret == -ENOSYS)
+			q->no_dma = true;
+		dev_dbg(q->dev, "DMA copy failed (err=%d), using the CPU\n",
+			ret);
+		return false;
+	}
+
+	/* Drop any lines the CPU fetched while the DMA was running */
+	invalidate_dcache_range((unsigned long)dst, (unsigned long)dst + len);
+
+	return true;
+}
+
+static void fsl_qspi_copy_ahb(struct fsl_qspi *q, void *buf,
+			      const void __iomem *src, size_t len)
+{
+	size_t head, body;
+
+	if (IS_ENABLED(CONFIG_FSL_QSPI_DMA) && !q->no_dma &&
+	    len >= FSL_QSPI_DMA_MIN_LEN) {
+		/* The DMA copy must start and end on a cache line */
+		head = PTR_ALIGN(buf, ARCH_DMA_MINALIGN) - buf;
+		body = ALIGN_DOWN(len - head, ARCH_DMA_MINALIGN);
+		memcpy_fromio(buf, src, head);
+		buf += head;
+		src += head;
+		len -= head;
+		if (fsl_qspi_dma_copy(q, buf, src, body)) {
+			buf += body;
+			src += body;
+			len -= body;
+		}
+	}
+
+	memcpy_fromio(buf, src, len);
+}
+
+static ssize_t fsl_qspi_dirmap_read(struct spi_mem_dirmap_desc *desc,
+				    u64 offs, size_t len, void *buf)
+{
+	struct spi_slave *slave = desc->slave;
+	struct fsl_qspi *q = dev_get_priv(slave->dev->parent);
+	void __iomem *src;
+	int ret;
+
+	if (offs >= desc->info.length)
+		return -EINVAL;
+	len = min_t(u64, len, desc->info.length - offs);
+
+	ret = fsl_qspi_readl_poll_tout(q, q->iobase + QUADSPI_SR,
+				       QUADSPI_SR_IP_ACC_MASK |
+				       QUADSPI_SR_AHB_ACC_MASK |
+				       QUADSPI_SR_BUSY, 10, 1000);
+	if (ret)
+		return ret;
+
+	if (q->ahb_desc != desc) {
+		ret = fsl_qspi_dirmap_setup(q, desc);
+		if (ret)
+			return ret;
+	}
+	fsl_qspi_select_mem(q, slave);
+
+	src = q->ahb_addr + q->selected * fsl_qspi_memsize_per_cs(q) +
+		desc->info.offset + offs;
+	/*
+	 * The range must be whole cache lines. Rounding it out is safe since
+	 * the CPU never writes to the AHB window, so no line in it is dirty.
+	 */
+	invalidate_dcache_range(ALIGN_DOWN((unsigned long)src,
+					   ARCH_DMA_MINALIGN),
+				ALIGN((unsigned long)src + len,
+				      ARCH_DMA_MINALIGN));
+	fsl_qspi_copy_ahb(q, buf, src, len);
+
+	return len;
+}
+#endif
+
 static const struct spi_controller_mem_ops fsl_qspi_mem_ops = {
 	.adjust_op_size = fsl_qspi_adjust_op_size,
 	.supports_op = fsl_qspi_supports_op,
 	.exec_op = fsl_qspi_exec_op,
+#if CONFIG_IS_ENABLED(SPI_DIRMAP)
+	.dirmap_create = fsl_qspi_dirmap_create,
+	.dirmap_destroy = fsl_qspi_dirmap_destroy,
+	.dirmap_read = fsl_qspi_dirmap_read,
+#endif
 };
 
 static int fsl_qspi_probe(struct udevice *bus)
@@ -8,51 +8,144 @@
 #include <blk.h>
 #include <dm.h>
 #include <part.h>
+#include <dm/devres.h>
 #include <virtio_types.h>
 #include <virtio.h>
 #include <virtio_ring.h>
 #include "virtio_blk.h"
 
+/*
+ * Each request in flight uses three descriptors: header, data and status.
+ * The header comes first so that virtqueue_get_buf(), which returns the
+ * address of the first buffer, gives us the slot.
+ */
+#define VIRTIO_BLK_DESCS_PER_REQ	3
+
+struct virtio_blk_slot {
+	struct virtio_blk_outhdr out_hdr;
+	u8 status;
+	struct blk_req *req;
+	lbaint_t blkcnt;
+};
+
 struct virtio_blk_priv {
 	struct virtqueue *vq;
+	struct virtio_blk_slot *slots;
+	unsigned int nr_slots;
 };
 
-static ulong virtio_blk_do_req(struct udevice *dev, u64 sector,
-			       lbaint_t blkcnt, void *buffer, u32 type)
+static int virtio_blk_poll(struct udevice *dev)
 {
 	struct virtio_blk_priv *priv = dev_get_priv(dev);
-	unsigned int num_out = 0, num_in = 0;
-	struct virtio_sg *sgs[3];
-	u8 status;
-	int ret;
-
-	struct virtio_blk_outhdr out_hdr = {
-		.type = cpu_to_virtio32(dev, type),
-		.sector = cpu_to_virtio64(dev, sector),
-	};
-	struct virtio_sg hdr_sg = { &out_hdr, sizeof(out_hdr) };
-	struct virtio_sg data_sg = { buffer, blkcnt * 512 };
-	struct virtio_sg status_sg = { &status, sizeof(status) };
+	struct virtio_blk_slot *slot;
+	struct blk_req *req;
+	int count = 0;
+
+	while ((slot = virtqueue_get_buf(priv->vq, NULL))) {
+		req = slot->req;
+		slot->req = NULL;
+		if (slot->status != VIRTIO_BLK_S_OK)
+			req->result = -EIO;
+		else if (req->result >= 0)
+			req->result += slot->blkcnt;
+		if (!--req->pending) {
+			blk_req_complete(req, req->result);
+			count++;
+		}
+	}
+
+	return count;
+}
 
-	sgs[num_out++] = &hdr_sg;
+static struct virtio_blk_slot *virtio_blk_get_slot(struct udevice *dev)
+{
+	struct virtio_blk_priv *priv = dev_get_priv(dev);
+	int i;
 
-	if (type & VIRTIO_BLK_T_OUT)
-		sgs[num_out++] = &data_sg;
-	else
-		sgs[num_out + num_in++] = &data_sg;
+	for (;;) {
+		for (i = 0; i < priv->nr_slots; i++)
+			if (!priv->slots[i].req)
+				return &priv->slots[i];
 
-	sgs[num_out + num_in++] = &status_sg;
+		/* Ring full: start what we have and wait for a completion */
+		virtqueue_kick(priv->vq);
+		virtio_blk_poll(dev);
+	}
+}
 
-	ret = virtqueue_add(priv->vq, sgs, num_out, num_in);
-	if (ret)
-		return ret;
+static int virtio_blk_submit(struct udevice *dev, struct blk_req *req)
+{
+	struct virtio_blk_priv *priv = dev_get_priv(dev);
+	u32 type = req->op == BLK_REQ_WRITE ? VIRTIO_BLK_T_OUT :
+		VIRTIO_BLK_T_IN;
+	struct virtio_blk_slot *slot;
+	struct virtio_sg *sgs[VIRTIO_BLK_DESCS_PER_REQ];
+	struct virtio_sg hdr_sg, data_sg, status_sg;
+	u64 sector = req->start;
+	int i, ret;
+
+	/* Hold the request open until all its parts are queued */
+	req->pending = 1;
+	for (i = 0; i < req->sg_count; i++) {
+		slot = virtio_blk_get_slot(dev);
+		slot->out_hdr.type = cpu_to_virtio32(dev, type);
+		slot->out_hdr.ioprio = 0;
+		slot->out_hdr.sector = cpu_to_virtio64(dev, sector);
+		slot->blkcnt = req->sg[i].blkcnt;
+
+		hdr_sg.addr = &slot->out_hdr;
+		hdr_sg.length = sizeof(slot->out_hdr);
+		data_sg.addr = req->sg[i].buffer;
+		data_sg.length = slot->blkcnt * 512;
+		status_sg.addr = &slot->status;
+		status_sg.length = sizeof(slot->status);
+		sgs[0] = &hdr_sg;
+		sgs[1] = &data_sg;
+		sgs[2] = &status_sg;
+
+		/*
+		 * Claim the slot first: completions reaped while waiting for
+		 * room may call back into here and must not pick it again
+		 */
+		slot->req = req;
+		do {
+			ret = virtqueue_add(priv->vq, sgs,
+					    type == VIRTIO_BLK_T_OUT ? 2 : 1,
+					    type == VIRTIO_BLK_T_OUT ? 1 : 2);
+			if (ret == -ENOSPC) {
+				virtqueue_kick(priv->vq);
+				virtio_blk_poll(dev);
+			}
+		} while (ret == -ENOSPC);
+		if (ret) {
+			slot->req = NULL;
+			req->result = ret;
+			break;
+		}
+
+		req->pending++;
+		sector += slot->blkcnt;
+	}
 
 	virtqueue_kick(priv->vq);
+	if (!--req->pending)
+		blk_req_complete(req, req->result);
+
+	return 0;
+}
 
-	while (!virtqueue_get_buf(priv->vq, NULL))
-		;
+static ulong virtio_blk_do_req(struct udevice *dev, u64 sector,
+			       lbaint_t blkcnt, void *buffer, u32 type)
+{
+	struct blk_req req;
+
+	blk_req_init(&req, type & VIRTIO_BLK_T_OUT ? BLK_REQ_WRITE :
+		     BLK_REQ_READ, sector, blkcnt, buffer);
+	virtio_blk_submit(dev, &req);
+	while (!req.complete)
+		virtio_blk_poll(dev);
 
-	return status == VIRTIO_BLK_S_OK ? blkcnt : -EIO;
+	return req.result == blkcnt ? blkcnt : -EIO;
 }
 
 static ulong virtio_blk_read(struct udevice *dev, lbaint_t start,
@@ -114,6 +207,13 @@ static int virtio_blk_probe(struct udevice *dev)
 	if (ret)
 		return ret;
 
+	priv->nr_slots = virtqueue_get_vring_size(priv->vq) /
+		VIRTIO_BLK_DESCS_PER_REQ;
+	priv->slots = devm_kcalloc(dev, priv->nr_slots, sizeof(*priv->slots),
+				   0);
+	if (!priv->slots)
+		return -ENOMEM;
+
 	desc->blksz = 512;
 	desc->log2blksz = 9;
 	virtio_cread(dev, struct virtio_blk_config, capacity, &cap);
@@ -125,6 +225,8 @@ static int virtio_blk_probe(struct udevice *dev)
 static const struct blk_ops virtio_blk_ops = {
 	.read	= virtio_blk_read,
 	.write	= virtio_blk_write,
+	.submit	= virtio_blk_submit,
+	.poll	= virtio_blk_poll,
 };
 
 U_BOOT_DRIVER(virtio_blk) = {
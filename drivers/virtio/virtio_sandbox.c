@@ -14,6 +14,11 @@
 #include <linux/compat.h>
 #include <linux/err.h>
 #include <linux/io.h>
+#include "virtio_blk.h"
+
+/* Size of the RAM disk behind the emulated block device */
+#define VIRTIO_SANDBOX_BLK_SECTORS	64
+#define VIRTIO_SANDBOX_QUEUE_SIZE	16
 
 struct virtio_sandbox_priv {
 	u8 id;
@@ -23,11 +28,20 @@ struct virtio_sandbox_priv {
 	ulong queue_desc;
 	ulong queue_available;
 	ulong queue_used;
+	u16 last_avail;
+	u8 disk[VIRTIO_SANDBOX_BLK_SECTORS * 512];
 };
 
 static int virtio_sandbox_get_config(struct udevice *udev, unsigned int offset,
 				     void *buf, unsigned int len)
 {
+	struct virtio_blk_config config = {
+		.capacity = cpu_to_le64(VIRTIO_SANDBOX_BLK_SECTORS),
+	};
+
+	if (offset + len <= sizeof(config))
+		memcpy(buf, (u8 *)&config + offset, len);
+
 	return 0;
 }
 
@@ -96,7 +110,8 @@ static struct virtqueue *virtio_sandbox_setup_vq(struct udevice *udev,
 	int err;
 
 	/* Create the vring */
-	vq = vring_create_virtqueue(index, 4, 4096, udev);
+	vq = vring_create_virtqueue(index, VIRTIO_SANDBOX_QUEUE_SIZE, 4096,
+				   udev);
 	if (!vq) {
 		err = -ENOMEM;
 		goto error_new_virtqueue;
@@ -110,6 +125,7 @@ static struct virtqueue *virtio_sandbox_setup_vq(struct udevice *udev,
 
 	addr = virtqueue_get_used_addr(vq);
 	priv->queue_used = addr;
+	priv->last_avail = 0;
 
 	return vq;
 
@@ -124,11 +140,13 @@ static void virtio_sandbox_del_vq(struct virtqueue *vq)
 
 static int virtio_sandbox_del_vqs(struct udevice *udev)
 {
+	struct virtio_sandbox_priv *priv = dev_get_priv(udev);
 	struct virtio_dev_priv *uc_priv = dev_get_uclass_priv(udev);
 	struct virtqueue *vq, *n;
 
 	list_for_each_entry_safe(vq, n, &uc_priv->vqs, list)
 		virtio_sandbox_del_vq(vq);
+	priv->queue_desc = 0;
 
 	return 0;
 }
@@ -149,8 +167,76 @@ static int virtio_sandbox_find_vqs(struct udevice *udev, unsigned int nvqs,
 	return 0;
 }
 
+/*
+ * Carry out a virtio-blk request on the RAM disk. The chain is a header,
+ * any number of data buffers and a status byte.
+ */
+static u32 virtio_sandbox_blk_req(struct virtio_sandbox_priv *priv,
+				  struct udevice *vdev,
+				  struct vring_desc *desc, uint head)
+{
+	struct virtio_blk_outhdr *hdr;
+	struct vring_desc *d = &desc[head];
+	u8 status = VIRTIO_BLK_S_OK;
+	u32 len, total = 0;
+	void *buf;
+	u64 pos;
+
+	hdr = (void *)(uintptr_t)virtio64_to_cpu(vdev, d->addr);
+	pos = virtio64_to_cpu(vdev, hdr->sector) * 512;
+	for (;;) {
+		d = &desc[virtio16_to_cpu(vdev, d->next)];
+		buf = (void *)(uintptr_t)virtio64_to_cpu(vdev, d->addr);
+		len = virtio32_to_cpu(vdev, d->len);
+		if (!(d->flags & cpu_to_virtio16(vdev, VRING_DESC_F_NEXT)))
+			break;
+		if (pos + len > sizeof(priv->disk)) {
+			status = VIRTIO_BLK_S_IOERR;
+		} else if (virtio32_to_cpu(vdev, hdr->type) ==
+			   VIRTIO_BLK_T_OUT) {
+			memcpy(priv->disk + pos, buf, len);
+		} else {
+			memcpy(buf, priv->disk + pos, len);
+			total += len;
+		}
+		pos += len;
+	}
+	*(u8 *)buf = status;
+
+	return total + 1;
+}
+
+/* Complete everything which has been queued, as a block device would */
 static int virtio_sandbox_notify(struct udevice *udev, struct virtqueue *vq)
 {
+	struct virtio_sandbox_priv *priv = dev_get_priv(udev);
+	struct vring_desc *desc = (void *)priv->queue_desc;
+	struct vring_avail *avail = (void *)priv->queue_available;
+	struct vring_used *used = (void *)priv->queue_used;
+	uint num = VIRTIO_SANDBOX_QUEUE_SIZE;
+	struct udevice *vdev;
+	uint head;
+	u16 idx;
+
+	/* The queue may have been deleted already */
+	if (!priv->queue_desc)
+		return 0;
+
+	vdev = vq->vdev;
+
+	while (priv->last_avail != virtio16_to_cpu(vdev, avail->idx)) {
+		head = virtio16_to_cpu(vdev,
+				       avail->ring[priv->last_avail % num]);
+		idx = virtio16_to_cpu(vdev, used->idx);
+		used->ring[idx % num].id = cpu_to_virtio32(vdev, head);
+		used->ring[idx % num].len =
+			cpu_to_virtio32(vdev, virtio_sandbox_blk_req(priv, vdev,
+								     desc,
+								     head));
+		used->idx = cpu_to_virtio16(vdev, idx + 1);
+		priv->last_avail++;
+	}
+
 	return 0;
 }
 
@@ -1995,6 +1995,216 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock,
 	return blknr;
 }
 
+/*
+ * Extent map of the open file, built once by ext4fs_open() so that reading
+ * does not walk the extent tree for every block
+ */
+struct ext4_extent_run {
+	uint32_t lblk;		/* first logical block */
+	uint32_t len;		/* number of blocks */
+	uint64_t pblk;		/* first physical block */
+};
+
+static struct {
+	struct ext4_extent_run *runs;
+	int count;
+	int size;
+	int hint;		/* run found by the last lookup */
+	int ino;		/* inode mapped, or 0 if none */
+} ext4fs_extent_map;
+
+/* Deepest extent tree that ext4 creates */
+#define EXT4_EXT_MAX_DEPTH	5
+
+static void ext4fs_extent_map_free(void)
+{
+	free(ext4fs_extent_map.runs);
+	memset(&ext4fs_extent_map, 0, sizeof(ext4fs_extent_map));
+}
+
+static int ext4fs_extent_map_add(struct ext4_extent *extent)
+{
+	struct ext4_extent_run *run, *runs;
+	uint32_t lblk = le32_to_cpu(extent->ee_block);
+	uint32_t len = le16_to_cpu(extent->ee_len);
+	uint64_t pblk;
+
+	pblk = le16_to_cpu(extent->ee_start_hi);
+	pblk = (pblk << 32) + le32_to_cpu(extent->ee_start_lo);
+	if (!len)
+		return 0;
+
+	/* Extents must come in order */
+	if (ext4fs_extent_map.count) {
+		run = &ext4fs_extent_map.runs[ext4fs_extent_map.count - 1];
+		if (lblk < run->lblk + run->len)
+			return -EINVAL;
+		if (lblk == run->lblk + run->len && pblk == run->pblk + run->len) {
+			run->len += len;
+			return 0;
+		}
+	}
+
+	if (ext4fs_extent_map.count == ext4fs_extent_map.size) {
+		ext4fs_extent_map.size = ext4fs_extent_map.size * 2 ?: 16;
+		runs = realloc(ext4fs_extent_map.runs,
+			       ext4fs_extent_map.size * sizeof(*runs));
+		if (!runs)
+			return -ENOMEM;
+		ext4fs_extent_map.runs = runs;
+	}
+	run = &ext4fs_extent_map.runs[ext4fs_extent_map.count++];
+	run->lblk = lblk;
+	run->len = len;
+	run->pblk = pblk;
+
+	return 0;
+}
+
+static int ext4fs_extent_map_walk(struct ext4_extent_header *ext_block,
+				  int depth)
+{
+	struct ext4_extent_idx *index;
+	struct ext_block_cache cache;
+	int blksz = EXT2_BLOCK_SIZE(ext4fs_root);
+	int log2_blksz = LOG2_BLOCK_SIZE(ext4fs_root) -
+			 get_fs()->dev_desc->log2blksz;
+	unsigned long long block;
+	int entries, i, ret;
+
+	if (le16_to_cpu(ext_block->eh_magic) != EXT4_EXT_MAGIC ||
+	    le16_to_cpu(ext_block->eh_depth) != depth)
+		return -EINVAL;
+
+	entries = le16_to_cpu(ext_block->eh_entries);
+	if (entries > le16_to_cpu(ext_block->eh_max))
+		return -EINVAL;
+
+	if (!depth) {
+		for (i = 0; i < entries; i++) {
+			ret = ext4fs_extent_map_add((struct ext4_extent *)
+						    (ext_block + 1) + i);
+			if (ret)
+				return ret;
+		}
+		return 0;
+	}
+
+	index = (struct ext4_extent_idx *)(ext_block + 1);
+	ext_cache_init(&cache);
+	for (i = 0, ret = 0; i < entries && !ret; i++) {
+		block = le16_to_cpu(index[i].ei_leaf_hi);
+		block = (block << 32) + le32_to_cpu(index[i].ei_leaf_lo);
+		if (!ext_cache_read(&cache, (lbaint_t)block << log2_blksz,
+				    blksz))
+			ret = -EIO;
+		else
+			ret = ext4fs_extent_map_walk((struct ext4_extent_header *)
+						     cache.buf, depth - 1);
+	}
+	ext_cache_fini(&cache);
+
+	return ret;
+}
+
+/**
+ * ext4fs_extent_map_build() - Collect the extents of a file for reading
+ *
+ * If the file does not use extents, or the tree cannot be read, no map is
+ * kept and reads fall back to looking up each block.
+ *
+ * @node: File to map
+ */
+static void ext4fs_extent_map_build(struct ext2fs_node *node)
+{
+	struct ext4_extent_header *ext_block;
+	int depth, ret;
+
+	ext4fs_extent_map_free();
+	if (!(le32_to_cpu(node->inode.flags) & EXT4_EXTENTS_FL))
+		return;
+
+	ext_block = (struct ext4_extent_header *)node->inode.b.blocks.dir_blocks;
+	depth = le16_to_cpu(ext_block->eh_depth);
+	if (depth > EXT4_EXT_MAX_DEPTH)
+		ret = -EINVAL;
+	else
+		ret = ext4fs_extent_map_walk(ext_block, depth);
+	if (ret) {
+		log_debug("Cannot map extents of inode %d: %d\n", node->ino,
+			  ret);
+		ext4fs_extent_map_free();
+		return;
+	}
+	ext4fs_extent_map.ino = node->ino;
+	log_debug("Inode %d has %d extents\n", node->ino,
+		  ext4fs_extent_map.count);
+}
+
+/**
+ * ext4fs_map_blocks() - Find where a run of file blocks is stored
+ *
+ * @node: File to look in
+ * @fileblock: First logical block
+ * @blknr: Returns the first physical block, or 0 for a hole
+ * @cache: Cache for extent blocks, used if there is no extent map
+ * Return: number of following blocks which are contiguous on the disk, or
+ *	which are all in the hole, at least 1; or -ve on error
+ */
+long ext4fs_map_blocks(struct ext2fs_node *node, uint32_t fileblock,
+		       uint64_t *blknr, struct ext_block_cache *cache)
+{
+	struct ext4_extent_run *runs = ext4fs_extent_map.runs;
+	struct ext4_extent_run *run;
+	int lo, hi, mid;
+
+	if (!ext4fs_extent_map.ino || ext4fs_extent_map.ino != node->ino) {
+		long ret = read_allocated_block(&node->inode, fileblock, cache);
+
+		if (ret < 0)
+			return ret;
+		*blknr = ret;
+		return 1;
+	}
+
+	*blknr = 0;
+	if (!ext4fs_extent_map.count)
+		return LONG_MAX;
+
+	/* Reads are mostly sequential, so try the last run first */
+	lo = 0;
+	hi = ext4fs_extent_map.count;
+	mid = ext4fs_extent_map.hint;
+	if (runs[mid].lblk <= fileblock) {
+		lo = mid;
+		if (mid + 1 < hi && runs[mid + 1].lblk > fileblock)
+			hi = mid + 1;
+	}
+	/* Find the last run starting at or before @fileblock */
+	while (hi - lo > 1) {
+		mid = (lo + hi) / 2;
+		if (runs[mid].lblk <= fileblock)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	ext4fs_extent_map.hint = lo;
+
+	run = &runs[lo];
+	if (fileblock < run->lblk)
+		return run->lblk - fileblock;	/* hole before the first run */
+	if (fileblock < run->lblk + run->len) {
+		*blknr = run->pblk + fileblock - run->lblk;
+		return run->lblk + run->len - fileblock;
+	}
+
+	/* Hole after this run */
+	if (lo + 1 < ext4fs_extent_map.count)
+		return run[1].lblk - fileblock;
+
+	return LONG_MAX;
+}
+
 /**
  * ext4fs_reinit_global() - Reinitialize values of ext4 write implementation's
  *			    global pointers
@@ -2040,6 +2250,7 @@ void ext4fs_close(void)
 	}
 
 	ext4fs_reinit_global();
+	ext4fs_extent_map_free();
 }
 
 int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
@@ -2355,6 +2566,7 @@ int ext4fs_open(const char *filename, loff_t *len)
 	}
 	*len = le32_to_cpu(fdiro->inode.size);
 	ext4fs_file = fdiro;
+	ext4fs_extent_map_build(fdiro);
 
 	return 0;
 fail:
@@ -26,12 +26,15 @@
 #include <ext4fs.h>
 #include "ext4_common.h"
 #include <div64.h>
+#include <log.h>
 #include <malloc.h>
 #include <part.h>
 #include <uuid.h>
+#include <linux/sizes.h>
 
 int ext4fs_symlinknest;
 struct ext_filesystem ext_fs;
+static struct ext4fs_read_stats read_stats;
 
 struct ext_filesystem *get_fs(void)
 {
@@ -44,30 +47,39 @@ void ext4fs_free_node(struct ext2fs_node *node, struct ext2fs_node *currroot)
 		free(node);
 }
 
+/* Largest single device read, which must fit in an int */
+#define EXT4_MAX_READ	SZ_1G
+
 /*
  * Taken from openmoko-kernel mailing list: By Andy green
  * Optimized read file API : collects and defers contiguous sector
  * reads into one potentially more efficient larger sequential read action
+ *
+ * Blocks are looked up a run at a time, so each extent of the file costs one
+ * lookup, and runs which follow on from each other on the disk are merged
+ * into a single read straight into @buf.
  */
 int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 		loff_t len, char *buf, loff_t *actread)
 {
 	struct ext_filesystem *fs = get_fs();
-	int i;
-	lbaint_t blockcnt;
 	int log2blksz = fs->dev_desc->log2blksz;
 	int log2_fs_blocksize = LOG2_BLOCK_SIZE(node->data) - log2blksz;
 	int blocksize = (1 << (log2_fs_blocksize + log2blksz));
 	unsigned int filesize = le32_to_cpu(node->inode.size);
-	lbaint_t previous_block_number = -1;
 	lbaint_t delayed_start = 0;
-	lbaint_t delayed_extent = 0;
-	lbaint_t delayed_skipfirst = 0;
 	lbaint_t delayed_next = 0;
+	int delayed_extent = 0;
+	int delayed_skipfirst = 0;
 	char *delayed_buf = NULL;
-	char *start_buf = buf;
-	short status;
 	struct ext_block_cache cache;
+	lbaint_t fileblock, blockcnt;
+	uint64_t blknr;
+	int skipfirst;
+	char *end;
+	long count;
+	int ret = -1;
+	int n;
 
 	ext_cache_init(&cache);
 
@@ -81,106 +93,83 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 	}
 
 	blockcnt = lldiv(((len + pos) + blocksize - 1), blocksize);
+	fileblock = lldiv(pos, blocksize);
+	skipfirst = pos - (loff_t)blocksize * fileblock;
+	end = buf + len;
+
+	while (buf < end) {
+		count = ext4fs_map_blocks(node, fileblock, &blknr, &cache);
+		if (count < 0)
+			goto out;
+		count = min_t(lbaint_t, count, blockcnt - fileblock);
+		count = min_t(long, count, EXT4_MAX_READ / blocksize);
+		n = min_t(loff_t, (loff_t)count * blocksize - skipfirst,
+			  end - buf);
+		read_stats.runs++;
 
-	for (i = lldiv(pos, blocksize); i < blockcnt; i++) {
-		long int blknr;
-		int blockoff = pos - (blocksize * i);
-		int blockend = blocksize;
-		int skipfirst = 0;
-		blknr = read_allocated_block(&node->inode, i, &cache);
-		if (blknr < 0) {
-			ext_cache_fini(&cache);
-			return -1;
-		}
-
-		blknr = blknr << log2_fs_blocksize;
-
-		/* Last block.  */
-		if (i == blockcnt - 1) {
-			blockend = (len + pos) - (blocksize * i);
-
-			/* The last portion is exactly blocksize. */
-			if (!blockend)
-				blockend = blocksize;
-		}
-
-		/* First block. */
-		if (i == lldiv(pos, blocksize)) {
-			skipfirst = blockoff;
-			blockend -= skipfirst;
-		}
 		if (blknr) {
-			int status;
-
-			if (previous_block_number != -1) {
-				if (delayed_next == blknr) {
-					delayed_extent += blockend;
-					delayed_next += blockend >> log2blksz;
-				} else {	/* spill */
-					status = ext4fs_devread(delayed_start,
-							delayed_skipfirst,
-							delayed_extent,
-							delayed_buf);
-					if (status == 0) {
-						ext_cache_fini(&cache);
-						return -1;
-					}
-					previous_block_number = blknr;
-					delayed_start = blknr;
-					delayed_extent = blockend;
-					delayed_skipfirst = skipfirst;
-					delayed_buf = buf;
-					delayed_next = blknr +
-						(blockend >> log2blksz);
-				}
+			lbaint_t sector = blknr << log2_fs_blocksize;
+
+			if (delayed_buf && delayed_next == sector &&
+			    delayed_extent <= EXT4_MAX_READ - n) {
+				delayed_extent += n;
+				read_stats.coalesced++;
 			} else {
-				previous_block_number = blknr;
-				delayed_start = blknr;
-				delayed_extent = blockend;
+				/* spill */
+				if (delayed_buf) {
+					read_stats.reads++;
+					if (!ext4fs_devread(delayed_start,
+							    delayed_skipfirst,
+							    delayed_extent,
+							    delayed_buf))
+						goto out;
+				}
+				delayed_start = sector;
+				delayed_extent = n;
 				delayed_skipfirst = skipfirst;
 				delayed_buf = buf;
-				delayed_next = blknr +
-					(blockend >> log2blksz);
 			}
+			delayed_next = sector + (count << log2_fs_blocksize);
 		} else {
-			int n;
-			int n_left;
-			if (previous_block_number != -1) {
+			if (delayed_buf) {
 				/* spill */
-				status = ext4fs_devread(delayed_start,
-							delayed_skipfirst,
-							delayed_extent,
-							delayed_buf);
-				if (status == 0) {
-					ext_cache_fini(&cache);
-					return -1;
-				}
-				previous_block_number = -1;
+				read_stats.reads++;
+				if (!ext4fs_devread(delayed_start,
+						    delayed_skipfirst,
+						    delayed_extent,
+						    delayed_buf))
+					goto out;
+				delayed_buf = NULL;
 			}
 			/* Zero no more than `len' bytes. */
-			n = blocksize - skipfirst;
-			n_left = len - ( buf - start_buf );
-			if (n > n_left)
-				n = n_left;
 			memset(buf, 0, n);
+			read_stats.holes++;
 		}
-		buf += blocksize - skipfirst;
+		buf += n;
+		fileblock += count;
+		skipfirst = 0;
 	}
-	if (previous_block_number != -1) {
+	if (delayed_buf) {
 		/* spill */
-		status = ext4fs_devread(delayed_start,
-					delayed_skipfirst, delayed_extent,
-					delayed_buf);
-		if (status == 0) {
-			ext_cache_fini(&cache);
-			return -1;
-		}
-		previous_block_number = -1;
+		read_stats.reads++;
+		if (!ext4fs_devread(delayed_start, delayed_skipfirst,
+				    delayed_extent, delayed_buf))
+			goto out;
 	}
 
+	log_debug("%lld bytes, %lu runs, %lu device reads so far\n", len,
+		  read_stats.runs, read_stats.reads);
 	*actread  = len;
+	ret = 0;
+out:
 	ext_cache_fini(&cache);
-	return 0;
+	return ret;
+}
+
+void ext4fs_read_stats(struct ext4fs_read_stats *stats)
+{
+	*stats = read_stats;
+	memset(&read_stats, '\0', sizeof(read_stats));
 }
 
 int ext4fs_ls(const char *dirname)
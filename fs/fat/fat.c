@@ -146,23 +146,135 @@ static void get_name(dir_entry *dirent, char *s_name)
 		*s_name = DELETED_FLAG;
 }
 
-static int flush_dirty_fat_buffer(fsdata *mydata);
+static int flush_fat_window(fsdata *mydata, int slot);
 
 #if !CONFIG_IS_ENABLED(FAT_WRITE)
 /* Stub for read only operation */
-int flush_dirty_fat_buffer(fsdata *mydata)
+int flush_fat_window(fsdata *mydata, int slot)
 {
 	(void)(mydata);
+	(void)(slot);
 	return 0;
 }
 #endif
 
+/*
+ * Allocate an empty FAT cache.
+ * Return 0 on success, -1 otherwise.
+ */
+static int fat_cache_init(fsdata *mydata)
+{
+	int i;
+
+	mydata->fatbuf = malloc_cache_aligned(FATBUFSIZE * FATBUFWINDOWS);
+	if (!mydata->fatbuf) {
+		debug("Error: allocating memory\n");
+		return -1;
+	}
+
+	for (i = 0; i < FATBUFWINDOWS; i++) {
+		mydata->fatwin[i].num = -1;
+		mydata->fatwin[i].dirty = 0;
+		mydata->fatwin[i].used = 0;
+	}
+	mydata->fatlast = -1;
+	mydata->fat_clock = 0;
+
+	return 0;
+}
+
+/*
+ * Find the FAT cache slot holding window 'bufnum'.
+ * Return the slot, or -1 if the window is not cached.
+ */
+static int fat_cache_find(fsdata *mydata, __u32 bufnum)
+{
+	int i;
+
+	for (i = 0; i < FATBUFWINDOWS; i++) {
+		if (mydata->fatwin[i].num == bufnum)
+			return i;
+	}
+
+	return -1;
+}
+
+/*
+ * Get window 'bufnum' of the FAT, that is FATBUFBLOCKS sectors from sector
+ * bufnum * FATBUFBLOCKS, into the FAT cache. On a miss the least recently used
+ * slot is written back if needed and replaced. Up to FATREADAHEAD - 1 following
+ * windows are read along with it, into the following slots as long as these
+ * are clean and have not been used for a while, so that a cluster chain running
+ * through the FAT costs one disk read per FATREADAHEAD windows.
+ * Return a pointer to the window, or NULL on failure.
+ */
+static __u8 *get_fat_window(fsdata *mydata, __u32 bufnum)
+{
+	struct fat_window *win = mydata->fatwin;
+	__u32 nbufs = DIV_ROUND_UP(mydata->fatlength, FATBUFBLOCKS);
+	__u32 startblock, getsize;
+	int slot, i, n;
+
+	slot = mydata->fatlast;
+	if (slot < 0 || win[slot].num != bufnum)
+		slot = fat_cache_find(mydata, bufnum);
+	if (slot >= 0)
+		goto found;
+
+	slot = 0;
+	for (i = 1; i < FATBUFWINDOWS; i++) {
+		if (win[i].used < win[slot].used)
+			slot = i;
+	}
+
+	/* Write back the window to the disk */
+	if (flush_fat_window(mydata, slot) < 0)
+		return NULL;
+
+	for (n = 1; n < FATREADAHEAD && slot + n < FATBUFWINDOWS &&
+	     bufnum + n < nbufs; n++) {
+		struct fat_window *next = &win[slot + n];
+
+		if (next->dirty || fat_cache_find(mydata, bufnum + n) >= 0)
+			break;
+		if (next->num != -1 &&
+		    mydata->fat_clock - next->used < FATBUFWINDOWS / 2)
+			break;
+	}
+
+	startblock = bufnum * FATBUFBLOCKS;
+	getsize = min_t(__u32, n * FATBUFBLOCKS, mydata->fatlength - startblock);
+
+	for (i = 0; i < n; i++)
+		win[slot + i].num = -1;
+
+	startblock += mydata->fat_sect;	/* Offset from start of disk */
+	if (disk_read(startblock, getsize,
+		      mydata->fatbuf + slot * FATBUFSIZE) < 0) {
+		debug("Error reading FAT blocks\n");
+		return NULL;
+	}
+
+	mydata->fat_clock++;
+	for (i = 0; i < n; i++) {
+		win[slot + i].num = bufnum + i;
+		win[slot + i].used = mydata->fat_clock;
+	}
+
+found:
+	win[slot].used = mydata->fat_clock;
+	mydata->fatlast = slot;
+
+	return mydata->fatbuf + slot * FATBUFSIZE;
+}
+
 /*
  * Get the entry at index 'entry' in a FAT (12/16/32) table.
  * On failure 0x00 is returned.
  */
 static __u32 get_fatent(fsdata *mydata, __u32 entry)
 {
+	__u8 *fatbuf;
 	__u32 bufnum;
 	__u32 offset, off8;
 	__u32 ret = 0x00;
@@ -195,41 +307,22 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 	       mydata->fatsize, entry, entry, offset, offset);
 
 	/* Read a new block of FAT entries into the cache. */
-	if (bufnum != mydata->fatbufnum) {
-		__u32 getsize = FATBUFBLOCKS;
-		__u8 *bufptr = mydata->fatbuf;
-		__u32 fatlength = mydata->fatlength;
-		__u32 startblock = bufnum * FATBUFBLOCKS;
-
-		/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
-		if (startblock + getsize > fatlength)
-			getsize = fatlength - startblock;
-
-		startblock += mydata->fat_sect;	/* Offset from start of disk */
-
-		/* Write back the fatbuf to the disk */
-		if (flush_dirty_fat_buffer(mydata) < 0)
-			return -1;
-
-		if (disk_read(startblock, getsize, bufptr) < 0) {
-			debug("Error reading FAT blocks\n");
-			return ret;
-		}
-		mydata->fatbufnum = bufnum;
-	}
+	fatbuf = get_fat_window(mydata, bufnum);
+	if (!fatbuf)
+		return ret;
 
 	/* Get the actual entry from the table */
 	switch (mydata->fatsize) {
 	case 32:
-		ret = FAT2CPU32(((__u32 *) mydata->fatbuf)[offset]);
+		ret = FAT2CPU32(((__u32 *) fatbuf)[offset]);
 		break;
 	case 16:
-		ret = FAT2CPU16(((__u16 *) mydata->fatbuf)[offset]);
+		ret = FAT2CPU16(((__u16 *) fatbuf)[offset]);
 		break;
 	case 12:
 		off8 = (offset * 3) / 2;
 		/* fatbut + off8 may be unaligned, read in byte granularity */
-		ret = mydata->fatbuf[off8] + (mydata->fatbuf[off8 + 1] << 8);
+		ret = fatbuf[off8] + (fatbuf[off8 + 1] << 8);
 
 		if (offset & 0x1)
 			ret >>= 4;
@@ -259,22 +352,39 @@ get_cluster(fsdata *mydata, __u32 clustnum, __u8 *buffer, unsigned long size)
 
 	debug("gc - clustnum: %d, startsect: %d\n", clustnum, startsect);
 
-	if ((unsigned long)buffer & (ARCH_DMA_MINALIGN - 1)) {
-		ALLOC_CACHE_ALIGN_BUFFER(__u8, tmpbuf, mydata->sect_size);
+	if ((unsigned long)buffer & (ARCH_DMA_MINALIGN - 1) &&
+	    size >= mydata->sect_size) {
+		__u32 max_count = MAX_CLUSTSIZE / mydata->sect_size;
+		__u32 sect_count;
+		__u8 *tmpbuf;
 
 		debug("FAT: Misaligned buffer address (%p)\n", buffer);
 
+		/* Bounce up to MAX_CLUSTSIZE bytes at a time */
+		sect_count = min_t(unsigned long, size / mydata->sect_size,
+				   max_count);
+		tmpbuf = malloc_cache_aligned(sect_count * mydata->sect_size);
+		if (!tmpbuf) {
+			debug("Error: allocating buffer\n");
+			return -1;
+		}
+
 		while (size >= mydata->sect_size) {
-			ret = disk_read(startsect++, 1, tmpbuf);
-			if (ret != 1) {
+			sect_count = min_t(unsigned long,
+					   size / mydata->sect_size, max_count);
+			ret = disk_read(startsect, sect_count, tmpbuf);
+			if (ret != sect_count) {
 				debug("Error reading data (got %d)\n", ret);
+				free(tmpbuf);
 				return -1;
 			}
 
-			memcpy(buffer, tmpbuf, mydata->sect_size);
-			buffer += mydata->sect_size;
-			size -= mydata->sect_size;
+			memcpy(buffer, tmpbuf, sect_count * mydata->sect_size);
+			startsect += sect_count;
+			buffer += sect_count * mydata->sect_size;
+			size -= sect_count * mydata->sect_size;
 		}
+		free(tmpbuf);
 	} else if (size >= mydata->sect_size) {
 		__u32 bytes_read;
 		__u32 sect_count = size / mydata->sect_size;
@@ -623,13 +733,8 @@ static int get_fs_info(fsdata *mydata)
 		mydata->root_cluster = 0;
 	}
 
-	mydata->fatbufnum = -1;
-	mydata->fat_dirty = 0;
-	mydata->fatbuf = malloc_cache_aligned(FATBUFSIZE);
-	if (mydata->fatbuf == NULL) {
-		debug("Error: allocating memory\n");
+	if (fat_cache_init(mydata))
 		return -1;
-	}
 
 	debug("FAT%d, fat_sect: %d, fatlength: %d\n",
 	       mydata->fatsize, mydata->fat_sect, mydata->fatlength);
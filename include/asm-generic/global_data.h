@@ -225,6 +225,13 @@ struct global_data {
 	 */
 	void *dm_priv_base;
 # endif
+# if CONFIG_IS_ENABLED(DM_INDEX)
+	/**
+	 * @dm_index: hash tables for looking up uclasses and devices, or NULL
+	 * if not set up
+	 */
+	struct dm_index *dm_index;
+# endif
 #endif
 #ifdef CONFIG_TIMER
 	/**
@@ -248,6 +255,12 @@ struct global_data {
 	 * @fdt_src: Source of FDT
 	 */
 	enum fdt_source_t fdt_src;
+#if CONFIG_IS_ENABLED(OF_FDT_INDEX)
+	/**
+	 * @fdt_index: index of @fdt_blob for faster lookups, or NULL if none
+	 */
+	struct fdt_index *fdt_index;
+#endif
 #if CONFIG_IS_ENABLED(OF_LIVE)
 	/**
 	 * @of_root: root node of the live tree
@@ -502,6 +515,22 @@ static_assert(sizeof(struct global_data) == GD_SIZE);
 #define gd_dm_driver_rt()		NULL
 #endif
 
+#if CONFIG_IS_ENABLED(OF_FDT_INDEX)
+#define gd_set_fdt_index(_idx)		gd->fdt_index = (_idx)
+#define gd_fdt_index()			gd->fdt_index
+#else
+#define gd_set_fdt_index(_idx)
+#define gd_fdt_index()			NULL
+#endif
+
+#if CONFIG_IS_ENABLED(DM_INDEX)
+#define gd_set_dm_index(_idx)		gd->dm_index = (_idx)
+#define gd_dm_index()			gd->dm_index
+#else
+#define gd_set_dm_index(_idx)
+#define gd_dm_index()			NULL
+#endif
+
 #if CONFIG_IS_ENABLED(OF_PLATDATA_RT)
 #define gd_set_dm_udevice_rt(dyn)	gd->dm_udevice_rt = dyn
 #define gd_dm_udevice_rt()		gd->dm_udevice_rt
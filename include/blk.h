@@ -158,6 +158,24 @@ void blkcache_fill(int iftype, int dev,
 		   lbaint_t start, lbaint_t blkcnt,
 		   unsigned long blksz, void const *buffer);
 
+/**
+ * blkcache_readahead() - check whether a read should be extended
+ *
+ * This is called when a read missed the cache. If it continues the
+ * previous read on the same device, the caller should read the returned
+ * number of extra blocks following the request and pass them all to
+ * blkcache_fill().
+ *
+ * @param iftype - IF_TYPE_x for type of device
+ * @param dev - device index of particular type
+ * @param start - starting block number
+ * @param blkcnt - number of blocks requested
+ *
+ * Return: number of blocks to read ahead, 0 for none
+ */
+lbaint_t blkcache_readahead(int iftype, int dev,
+			    lbaint_t start, lbaint_t blkcnt);
+
 /**
  * blkcache_invalidate() - discard the cache for a set of blocks
  * because of a write or device (re)initialization.
@@ -168,12 +186,33 @@ void blkcache_fill(int iftype, int dev,
 void blkcache_invalidate(int iftype, int dev);
 
 /**
- * blkcache_configure() - configure block cache
+ * blkcache_configure_bytes() - configure block cache
+ *
+ * The cache is flushed if its size changes. This replaces
+ * blkcache_configure(), which took a number of entries rather than bytes.
+ *
+ * @param blocks - maximum blocks per read for it to be cached
+ * @param max_bytes - maximum bytes of block data held in the cache,
+ *		 0 to disable the cache
+ */
+void blkcache_configure_bytes(unsigned blocks, ulong max_bytes);
+
+/**
+ * blkcache_set_policy() - select the replacement policy
+ *
+ * The cache is flushed if the policy changes.
+ *
+ * @param name - name of the policy ("lru" or "arc")
+ * Return: 0 if OK, -EINVAL if the policy is unknown
+ */
+int blkcache_set_policy(const char *name);
+
+/**
+ * blkcache_set_readahead() - set the number of blocks read ahead
  *
- * @param blocks - maximum blocks per entry
- * @param entries - maximum entries in cache
+ * @param blocks - blocks to read ahead on sequential access, 0 to disable
  */
-void blkcache_configure(unsigned blocks, unsigned entries);
+void blkcache_set_readahead(unsigned blocks);
 
 /*
  * statistics of the block cache
@@ -181,18 +220,43 @@ void blkcache_configure(unsigned blocks, unsigned entries);
 struct block_cache_stats {
 	unsigned hits;
 	unsigned misses;
-	unsigned entries; /* current entry count */
+	unsigned entries; /* current block count */
 	unsigned max_blocks_per_entry;
-	unsigned max_entries;
+	unsigned readahead;
+	ulong size; /* budget in bytes */
+	ulong used; /* bytes of block data held */
+	const char *policy;
+};
+
+/*
+ * per-device statistics of the block cache
+ */
+struct block_cache_dev_stats {
+	int iftype;
+	int devnum;
+	unsigned hits;
+	unsigned misses;
+	unsigned readaheads;
 };
 
 /**
  * get_blkcache_stats() - return statistics and reset
  *
+ * This resets the per-device statistics as well.
+ *
  * @param stats - statistics are copied here
  */
 void blkcache_stats(struct block_cache_stats *stats);
 
+/**
+ * blkcache_dev_stats() - return statistics for a device
+ *
+ * @param index - index of the device, counting from 0
+ * @param stats - statistics are copied here
+ * Return: 0 if OK, -ENOENT if there is no device with that index
+ */
+int blkcache_dev_stats(int index, struct block_cache_dev_stats *stats);
+
 #else
 
 static inline int blkcache_read(int iftype, int dev,
@@ -206,6 +270,12 @@ static inline void blkcache_fill(int iftype, int dev,
 				 lbaint_t start, lbaint_t blkcnt,
 				 unsigned long blksz, void const *buffer) {}
 
+static inline lbaint_t blkcache_readahead(int iftype, int dev,
+					  lbaint_t start, lbaint_t blkcnt)
+{
+	return 0;
+}
+
 static inline void blkcache_invalidate(int iftype, int dev) {}
 
 #endif
@@ -213,6 +283,95 @@ static inline void blkcache_invalidate(int iftype, int dev) {}
 #if CONFIG_IS_ENABLED(BLK)
 struct udevice;
 
+/* Operation performed by an asynchronous block request */
+enum blk_req_op {
+	BLK_REQ_READ,
+	BLK_REQ_WRITE,
+};
+
+/**
+ * struct blk_sg - an element of a scatter list
+ *
+ * @buffer:	Memory to transfer to or from
+ * @blkcnt:	Number of blocks to transfer
+ */
+struct blk_sg {
+	void *buffer;
+	lbaint_t blkcnt;
+};
+
+struct blk_req;
+
+/**
+ * typedef blk_req_done_t - completion callback of a block request
+ *
+ * This is called from blk_poll() (or blk_submit() for devices which do not
+ * support queueing) once the request has finished. It may submit new
+ * requests.
+ *
+ * @req:	The request, with @result set
+ */
+typedef void (*blk_req_done_t)(struct blk_req *req);
+
+/**
+ * struct blk_req - an asynchronous block request
+ *
+ * The blocks described by the scatter list are contiguous on the device,
+ * starting at @start. The request must remain valid until it completes.
+ *
+ * @op:		Operation to perform
+ * @start:	First block on the device
+ * @sg:		Scatter list of buffers
+ * @sg_count:	Number of elements in @sg
+ * @done:	Completion callback, or NULL
+ * @priv:	Private data for the submitter
+ * @result:	Number of blocks transferred, or -ve error, once complete
+ * @complete:	true once the request has completed
+ * @pending:	For use by the driver, e.g. to count outstanding commands
+ * @sg_one:	Scatter list used by blk_req_init()
+ */
+struct blk_req {
+	enum blk_req_op op;
+	lbaint_t start;
+	struct blk_sg *sg;
+	int sg_count;
+	blk_req_done_t done;
+	void *priv;
+	long result;
+	bool complete;
+	int pending;
+	struct blk_sg sg_one;
+};
+
+/**
+ * blk_req_init() - set up a request for a single buffer
+ *
+ * @req:	Request to set up
+ * @op:		Operation to perform
+ * @start:	First block on the device
+ * @blkcnt:	Number of blocks to transfer
+ * @buffer:	Memory to transfer to or from
+ */
+void blk_req_init(struct blk_req *req, enum blk_req_op op, lbaint_t start,
+		  lbaint_t blkcnt, void *buffer);
+
+/**
+ * blk_req_blkcnt() - get the total number of blocks in a request
+ *
+ * @req:	Request to check
+ * Return: sum of the block counts of the scatter list
+ */
+static inline lbaint_t blk_req_blkcnt(const struct blk_req *req)
+{
+	lbaint_t blkcnt = 0;
+	int i;
+
+	for (i = 0; i < req->sg_count; i++)
+		blkcnt += req->sg[i].blkcnt;
+
+	return blkcnt;
+}
+
 /* Operations on block devices */
 struct blk_ops {
 	/**
@@ -271,6 +430,29 @@ struct blk_ops {
 	 * @return 0 if OK, -ve on error
 	 */
 	int (*select_hwpart)(struct udevice *dev, int hwpart);
+
+	/**
+	 * submit() - queue an asynchronous request
+	 *
+	 * This starts the transfer and returns without waiting for it. The
+	 * driver calls blk_req_complete() from poll() once it is done.
+	 * Drivers without this method have requests carried out
+	 * synchronously with read() and write().
+	 *
+	 * @dev:	Device to access
+	 * @req:	Request to queue
+	 * @return 0 if OK, -EBUSY if there is no room in the queue (poll()
+	 * and try again), other -ve on error
+	 */
+	int (*submit)(struct udevice *dev, struct blk_req *req);
+
+	/**
+	 * poll() - process completed asynchronous requests
+	 *
+	 * @dev:	Device to check
+	 * @return number of requests completed, or -ve on error
+	 */
+	int (*poll)(struct udevice *dev);
 };
 
 #define blk_get_ops(dev)	((struct blk_ops *)(dev)->driver->ops)
@@ -288,6 +470,51 @@ unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 unsigned long blk_derase(struct blk_desc *block_dev, lbaint_t start,
 			 lbaint_t blkcnt);
 
+/**
+ * blk_submit() - start an asynchronous block request
+ *
+ * Several requests may be outstanding at once, up to a limit set by the
+ * driver. If the driver's queue is full, this polls the device until
+ * there is room. For devices which do not support queueing, the request
+ * is carried out and completed before this returns.
+ *
+ * @block_dev:	Block device to access
+ * @req:	Request to start
+ * Return: 0 if OK, -ve on error (in which case the request is not started)
+ */
+int blk_submit(struct blk_desc *block_dev, struct blk_req *req);
+
+/**
+ * blk_poll() - process completed requests
+ *
+ * This calls the completion callback of each request which has finished.
+ *
+ * @block_dev:	Block device to check
+ * Return: number of requests completed, or -ve on error
+ */
+int blk_poll(struct blk_desc *block_dev);
+
+/**
+ * blk_wait() - wait for a request to complete
+ *
+ * @block_dev:	Block device the request was submitted to
+ * @req:	Request to wait for
+ * Return: 0 if all blocks were transferred, -EIO if only some were,
+ * other -ve on error
+ */
+int blk_wait(struct blk_desc *block_dev, struct blk_req *req);
+
+/**
+ * blk_req_complete() - mark a request as complete
+ *
+ * This is for use by drivers. It records the result and calls the
+ * completion callback.
+ *
+ * @req:	Request which has finished
+ * @result:	Number of blocks transferred, or -ve error
+ */
+void blk_req_complete(struct blk_req *req, long result);
+
 /**
  * blk_find_device() - Find a block device
  *
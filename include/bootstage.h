@@ -207,6 +207,8 @@ enum bootstage_id {
 	BOOTSTAGE_ID_ACCUM_FSP_M,
 	BOOTSTAGE_ID_ACCUM_FSP_S,
 	BOOTSTAGE_ID_ACCUM_MMAP_SPI,
+	BOOTSTAGE_ID_ACCUM_MMC,
+	BOOTSTAGE_ID_ACCUM_MMC_BUS,
 
 	/* a few spare for the user, from here */
 	BOOTSTAGE_ID_USER,
@@ -352,6 +354,21 @@ int bootstage_unstash(const void *base, int size);
  */
 int bootstage_get_size(void);
 
+/**
+ * bootstage_get_record() - Get the details of a bootstage record
+ *
+ * @i:		Index of record, from 0
+ * @buf:	Buffer for the name, if the record does not have one
+ * @len:	Size of @buf
+ * @idp:	Returns the bootstage ID
+ * @namep:	Returns the name, which may be in @buf
+ * @time_usp:	Returns the time of the mark, or the accumulated time
+ * Return: 0 if OK, 1 if the record accumulates time rather than marking it,
+ *	-ENOENT if @i is beyond the last record
+ */
+int bootstage_get_record(uint i, char *buf, int len, enum bootstage_id *idp,
+			 const char **namep, ulong *time_usp);
+
 /**
  * bootstage_init() - Prepare bootstage for use
  *
@@ -0,0 +1,108 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Timeline of boot events: bootstage, traced functions, block and network I/O
+ *
+ * Copyright 2023 NXP
+ */
+
+#ifndef __BOOTTRACE_H
+#define __BOOTTRACE_H
+
+#include <linux/types.h>
+#include <trace.h>
+
+#if CONFIG_IS_ENABLED(BOOTTRACE)
+
+/**
+ * boottrace_init() - Allocate the event buffer and start recording
+ *
+ * Bootstage marks made before this are copied into the buffer.
+ *
+ * Return: 0 if OK, -ENOMEM if out of memory
+ */
+int boottrace_init(void);
+
+/**
+ * boottrace_add() - Record an event which happens now
+ *
+ * This does nothing before boottrace_init() or when the buffer is full, in
+ * which case the event is counted as dropped.
+ *
+ * @type:	Type of event
+ * @flags:	Event flags (enum trace_event_flags)
+ * @dev:	Sequence number of the device, if any
+ * @id:		Event ID, see enum trace_event_type
+ * @arg:	Event argument, see enum trace_event_type
+ */
+void boottrace_add(enum trace_event_type type, uint flags, uint dev, u32 id,
+		   u32 arg);
+
+/**
+ * boottrace_add_boot_us() - Record a bootstage event
+ *
+ * @type:	Type of event
+ * @flags:	Event flags (enum trace_event_flags)
+ * @id:		Bootstage ID
+ * @time_us:	Time of the event, as returned by timer_get_boot_us()
+ */
+void boottrace_add_boot_us(enum trace_event_type type, uint flags, u32 id,
+			   ulong time_us);
+
+/**
+ * boottrace_export() - Write out the recorded events
+ *
+ * This writes a TRACE_CHUNK_EVENTS chunk with all events followed by a
+ * TRACE_CHUNK_NAMES chunk, in the format read by proftool.
+ *
+ * @buf:	Buffer to write to, or NULL to just work out the size
+ * @size:	Size of @buf
+ * @needed:	Returns the number of bytes needed, which may exceed @size
+ * Return: 0 if OK, -ENOSPC if @buf is too small
+ */
+int boottrace_export(void *buf, size_t size, size_t *needed);
+
+/**
+ * boottrace_stash() - Write the events where the OS can find them
+ *
+ * The data starts with struct boottrace_stash_hdr. If @fdt is not NULL, the
+ * region is reserved in it and given in the 'u-boot,boottrace' property of
+ * the /chosen node.
+ *
+ * @fdt:	Device tree for the OS, or NULL
+ * @addr:	Address to write to, which must not be 0
+ * @size:	Size of the region at @addr
+ * Return: 0 if OK, -EINVAL if @addr is 0, -ENOSPC if the region is too
+ *	small, other -ve on error
+ */
+int boottrace_stash(void *fdt, ulong addr, size_t size);
+
+/**
+ * boottrace_print_stats() - Show how much of the buffer is in use
+ */
+void boottrace_print_stats(void);
+
+/**
+ * boottrace_clear() - Drop all recorded events
+ */
+void boottrace_clear(void);
+
+#else
+
+static inline int boottrace_init(void)
+{
+	return 0;
+}
+
+static inline void boottrace_add(enum trace_event_type type, uint flags,
+				 uint dev, u32 id, u32 arg)
+{
+}
+
+static inline void boottrace_add_boot_us(enum trace_event_type type,
+					 uint flags, u32 id, ulong time_us)
+{
+}
+
+#endif
+
+#endif /* __BOOTTRACE_H */
@@ -132,6 +132,16 @@ struct dfu_entity {
 	int (*write_medium)(struct dfu_entity *dfu,
 			u64 offset, void *buf, long *len);
 
+	/*
+	 * Optional, for CONFIG_DFU_WRITE_BACK: write the start of @buf, at
+	 * most *len bytes, and set *len to the number written. This is called
+	 * repeatedly until the whole buffer is written, handling USB requests
+	 * in between, so each call should be short. Without it the buffer is
+	 * passed to write_medium() in one go.
+	 */
+	int (*write_medium_step)(struct dfu_entity *dfu,
+				 u64 offset, void *buf, long *len);
+
 	int (*flush_medium)(struct dfu_entity *dfu);
 	unsigned int (*poll_timeout)(struct dfu_entity *dfu);
 
@@ -356,6 +366,16 @@ int dfu_write(struct dfu_entity *de, void *buf, int size, int blk_seq_num);
  */
 int dfu_flush(struct dfu_entity *de, void *buf, int size, int blk_seq_num);
 
+/**
+ * dfu_write_poll() - carry on writing a buffer to the medium
+ *
+ * With CONFIG_DFU_WRITE_BACK, a full buffer is written out while the next
+ * one is received. This does the next part of that write and should be
+ * called whenever the caller would otherwise wait for USB. Any error is
+ * reported by the next call to dfu_write() or dfu_flush().
+ */
+void dfu_write_poll(void);
+
 /**
  * dfu_initiated_callback() - weak callback called on DFU transaction start
  *
@@ -191,6 +191,39 @@ int device_of_to_plat(struct udevice *dev);
  */
 int device_probe(struct udevice *dev);
 
+/**
+ * device_probe_async() - Probe a list of devices, overlapping their waits
+ *
+ * This calls probe() for each device, then calls probe_poll() for each one
+ * in turn until they are all ready, then finishes probing each one in the
+ * order given. This is useful when each device must wait for the hardware
+ * after it is set up, e.g. for link training. If one device needs another
+ * which is still waiting, the other one is finished first.
+ *
+ * Devices which fail to probe are skipped, and the first error is returned
+ * once the others are probed.
+ *
+ * @devs: Devices to probe
+ * @count: Number of devices in @devs
+ * Return: 0 if OK, -ve on error
+ */
+#if CONFIG_IS_ENABLED(DM_ASYNC_PROBE)
+int device_probe_async(struct udevice *const devs[], int count);
+#else
+static inline int device_probe_async(struct udevice *const devs[], int count)
+{
+	int i, ret, err = 0;
+
+	for (i = 0; i < count; i++) {
+		ret = device_probe(devs[i]);
+		if (ret && !err)
+			err = ret;
+	}
+
+	return err;
+}
+#endif
+
 /**
  * device_remove() - Remove a device, de-activating it
  *
@@ -80,6 +80,12 @@ struct driver_info;
  */
 #define DM_FLAG_VITAL			(1 << 14)
 
+/* Driver probe() has been called but its probe_poll() has not yet finished */
+#define DM_FLAG_PROBE_POLL		(1 << 15)
+
+/* Device probe has started but has not yet been finished */
+#define DM_FLAG_PROBE_PENDING		(1 << 16)
+
 /* Some devices which use aliases in device tree and existing in a certain hierarchy
  * (such as PCIe devices) require this flag and need a sequencing
  * scheme that would ensure sequences numbers greater than parent's.
@@ -167,6 +173,10 @@ enum {
  *		automatically when the device is removed / unbound
  * @dma_offset: Offset between the physical address space (CPU's) and the
  *		device's bus address space
+ * @seq_node: Links the device into the index by sequence number
+ * @name_node: Links the device into the index by name
+ * @ofnode_node: Links the device into the index by devicetree node
+ * @phandle_node: Links the device into the index by phandle
  */
 struct udevice {
 	const struct driver *driver;
@@ -196,6 +206,12 @@ struct udevice {
 #if CONFIG_IS_ENABLED(DM_DMA)
 	ulong dma_offset;
 #endif
+#if CONFIG_IS_ENABLED(DM_INDEX)
+	struct hlist_node seq_node;
+	struct hlist_node name_node;
+	struct hlist_node ofnode_node;
+	struct hlist_node phandle_node;
+#endif
 };
 
 /**
@@ -307,6 +323,13 @@ struct udevice_id {
 	ulong data;
 };
 
+/* Allow the probe_poll() method to be optional */
+#if CONFIG_IS_ENABLED(DM_ASYNC_PROBE)
+#define DM_PROBE_POLL_PTR(_ptr)	.probe_poll	= _ptr,
+#else
+#define DM_PROBE_POLL_PTR(_ptr)
+#endif
+
 #if CONFIG_IS_ENABLED(OF_REAL)
 #define of_match_ptr(_ptr)	(_ptr)
 #else
@@ -332,6 +355,11 @@ struct udevice_id {
  * for each.
  * @bind: Called to bind a device to its driver
  * @probe: Called to probe a device, i.e. activate it
+ * @probe_poll: Called after probe() until it returns something other than
+ * -EAGAIN, to wait for the device to become ready without holding up the
+ * probing of other devices (see device_probe_async()). It returns 0 when the
+ * device is ready, or another -ve error if the probe failed, in which case it
+ * must undo what probe() did.
  * @remove: Called to remove a device, i.e. de-activate it
  * @unbind: Called to unbind a device from its driver
  * @of_to_plat: Called before probe to decode device tree data
@@ -367,6 +395,9 @@ struct driver {
 	const struct udevice_id *of_match;
 	int (*bind)(struct udevice *dev);
 	int (*probe)(struct udevice *dev);
+#if CONFIG_IS_ENABLED(DM_ASYNC_PROBE)
+	int (*probe_poll)(struct udevice *dev);
+#endif
 	int (*remove)(struct udevice *dev);
 	int (*unbind)(struct udevice *dev);
 	int (*of_to_plat)(struct udevice *dev);
@@ -38,6 +38,7 @@ enum {
 	DM_TEST_OP_UNBIND,
 	DM_TEST_OP_PROBE,
 	DM_TEST_OP_REMOVE,
+	DM_TEST_OP_PROBE_POLL,
 
 	/* For uclass */
 	DM_TEST_OP_POST_BIND,
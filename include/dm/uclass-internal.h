@@ -269,6 +269,59 @@ static inline int uclass_pre_unbind_device(struct udevice *dev) { return 0; }
 static inline int uclass_unbind_device(struct udevice *dev) { return 0; }
 #endif
 
+#if CONFIG_IS_ENABLED(DM_INDEX)
+/**
+ * uclass_index_init() - Set up the indexes of uclasses and devices
+ *
+ * This is called by dm_init() after relocation. Any existing indexes are
+ * emptied, since the devices in them belong to a driver model which has been
+ * abandoned.
+ *
+ * Return: 0 if OK, -ENOMEM if out of memory
+ */
+int uclass_index_init(void);
+
+/**
+ * uclass_index_uninit() - Free the indexes of uclasses and devices
+ *
+ * After this, lookups walk the lists of uclasses and devices.
+ */
+void uclass_index_uninit(void);
+
+/**
+ * uclass_index_update() - Update the indexes after a device has changed
+ *
+ * This must be called when the sequence number, name or devicetree node of a
+ * bound device is changed. It does nothing if the device is not indexed.
+ *
+ * @dev:	Device which has changed
+ */
+void uclass_index_update(struct udevice *dev);
+
+/**
+ * uclass_index_find_by_ofnode() - Look up a device by its devicetree node
+ *
+ * The device is NOT probed, it is merely returned. If there are several
+ * devices with the node, the first one bound is returned.
+ *
+ * @id:		uclass of the device, or UCLASS_INVALID for any uclass
+ * @node:	Devicetree node to look for
+ * @devp:	Returns pointer to device, if found
+ * Return: 0 if OK, -ENODEV if not found, -ENOSYS if there are no indexes
+ */
+int uclass_index_find_by_ofnode(enum uclass_id id, ofnode node,
+				struct udevice **devp);
+#else
+static inline int uclass_index_init(void) { return 0; }
+static inline void uclass_index_uninit(void) {}
+static inline void uclass_index_update(struct udevice *dev) {}
+static inline int uclass_index_find_by_ofnode(enum uclass_id id, ofnode node,
+					      struct udevice **devp)
+{
+	return -ENOSYS;
+}
+#endif
+
 /**
  * uclass_pre_probe_device() - Deal with a device that is about to be probed
  *
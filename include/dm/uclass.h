@@ -436,6 +436,18 @@ int uclass_resolve_seq(struct udevice *dev);
  */
 int uclass_probe_all(enum uclass_id id);
 
+/**
+ * uclass_probe_all_async() - Probe all devices in a uclass together
+ *
+ * This probes the devices which are in the uclass when it is called with
+ * device_probe_async(), so that the time they spend waiting for hardware
+ * overlaps. Devices bound while this is running are not probed.
+ *
+ * @id: uclass ID to look up
+ * Return: 0 if OK, other -ve on error
+ */
+int uclass_probe_all_async(enum uclass_id id);
+
 /**
  * uclass_id_count() - Count the number of devices in a uclass
  *
@@ -125,6 +125,21 @@ struct ext_block_cache {
 	int size;
 };
 
+/**
+ * struct ext4fs_read_stats - how file data has been read
+ *
+ * @runs:	Runs of blocks mapped, each of which is read or zero-filled
+ * @reads:	Device reads issued
+ * @coalesced:	Runs merged into the device read of the run before them
+ * @holes:	Runs which were holes, so were zero-filled
+ */
+struct ext4fs_read_stats {
+	ulong runs;
+	ulong reads;
+	ulong coalesced;
+	ulong holes;
+};
+
 extern struct ext2_data *ext4fs_root;
 extern struct ext2fs_node *ext4fs_file;
 
@@ -166,4 +181,11 @@ int ext4fs_uuid(char *uuid_str);
 void ext_cache_init(struct ext_block_cache *cache);
 void ext_cache_fini(struct ext_block_cache *cache);
 int ext_cache_read(struct ext_block_cache *cache, lbaint_t block, int size);
+
+/**
+ * ext4fs_read_stats() - return file read statistics and reset them
+ *
+ * @stats:	Statistics are copied here
+ */
+void ext4fs_read_stats(struct ext4fs_read_stats *stats);
 #endif
@@ -31,6 +31,9 @@ struct disk_partition;
 #define FAT16BUFSIZE	(FATBUFSIZE/2)
 #define FAT32BUFSIZE	(FATBUFSIZE/4)
 
+#define FATBUFWINDOWS	CONFIG_VAL(FS_FAT_CACHE_WINDOWS)
+#define FATREADAHEAD	4	/* Windows read at once on a FAT cache miss */
+
 /* Maximum number of entry for long file name according to spec */
 #define MAX_LFN_SLOT	20
 
@@ -161,6 +164,16 @@ typedef struct dir_slot {
 	__u8	name11_12[4];	/* Last 2 characters in name */
 } dir_slot;
 
+/*
+ * One slot of the FAT cache, holding FATBUFBLOCKS sectors of the FAT at
+ * fatbuf + slot * FATBUFSIZE
+ */
+struct fat_window {
+	int	num;		/* Window held, FAT sector / FATBUFBLOCKS, or -1 */
+	__u8	dirty;		/* Set if the window has been modified */
+	__u32	used;		/* Value of fat_clock when last used */
+};
+
 /*
  * Private filesystem parameters
  *
@@ -168,16 +181,17 @@ typedef struct dir_slot {
  * (see FAT32 accesses)
  */
 typedef struct {
-	__u8	*fatbuf;	/* Current FAT buffer */
+	__u8	*fatbuf;	/* FAT cache, FATBUFWINDOWS windows */
 	int	fatsize;	/* Size of FAT in bits */
 	__u32	fatlength;	/* Length of FAT in sectors */
 	__u16	fat_sect;	/* Starting sector of the FAT */
-	__u8	fat_dirty;      /* Set if fatbuf has been modified */
 	__u32	rootdir_sect;	/* Start sector of root directory */
 	__u16	sect_size;	/* Size of sectors in bytes */
 	__u16	clust_size;	/* Size of clusters in sectors */
 	int	data_begin;	/* The sector of the first cluster, can be negative */
-	int	fatbufnum;	/* Used by get_fatent, init to -1 */
+	struct fat_window fatwin[FATBUFWINDOWS];	/* FAT cache slots */
+	int	fatlast;	/* Slot used last, or -1 */
+	__u32	fat_clock;	/* Counts FAT cache misses, for LRU eviction */
 	int	rootdir_size;	/* Size of root dir for non-FAT32 */
 	__u32	root_cluster;	/* First cluster of root dir for FAT32 */
 	u32	total_sect;	/* Number of sectors */
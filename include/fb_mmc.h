@@ -39,4 +39,33 @@ void fastboot_mmc_flash_write(const char *cmd, void *download_buffer,
  * @response: Pointer to fastboot response buffer
  */
 void fastboot_mmc_erase(const char *cmd, char *response);
+
+/**
+ * fastboot_mmc_stream_start() - Start writing a sparse image as it arrives
+ *
+ * @cmd: Named partition to write image to
+ * @buffer: Buffer to gather raw data in
+ * @size: Size of @buffer
+ * @response: Pointer to fastboot response buffer, set on error
+ * Return: 0 if OK, -ve on error
+ */
+int fastboot_mmc_stream_start(const char *cmd, void *buffer, u32 size,
+			      char *response);
+
+/**
+ * fastboot_mmc_stream_write() - Write the next part of a sparse image
+ *
+ * @data: Next part of the image
+ * @len: Length of @data
+ * @response: Pointer to fastboot response buffer, set on error
+ * Return: 0 if OK, -EIO on error
+ */
+int fastboot_mmc_stream_write(const void *data, u32 len, char *response);
+
+/**
+ * fastboot_mmc_stream_finish() - Finish writing a sparse image
+ *
+ * @response: Pointer to fastboot response buffer
+ */
+void fastboot_mmc_stream_finish(char *response);
 #endif
@@ -0,0 +1,126 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Read-only index of the control devicetree, for faster flat-tree lookups
+ *
+ * Copyright 2023 NXP
+ */
+
+#ifndef __FDT_INDEX_H
+#define __FDT_INDEX_H
+
+#include <linux/libfdt.h>
+
+struct fdt_index;
+
+#if CONFIG_IS_ENABLED(OF_FDT_INDEX)
+
+/**
+ * fdt_index_init() - Build the index for the control devicetree
+ *
+ * This indexes gd->fdt_blob by path, phandle and compatible string. Any
+ * existing index is dropped first. The lookup functions below use the index
+ * when asked about gd->fdt_blob and fall back to libfdt otherwise.
+ *
+ * The index is dropped when the blob moves or changes size, or after
+ * fdt_index_changed() is called for it.
+ *
+ * Return: 0 if OK, -ENOMEM if out of memory, -EINVAL if the tree is not valid
+ * or too deep
+ */
+int fdt_index_init(void);
+
+/**
+ * fdt_index_invalidate() - Drop the index for the control devicetree
+ *
+ * Lookups use libfdt from then on, until fdt_index_init() is called again.
+ */
+void fdt_index_invalidate(void);
+
+/**
+ * fdt_index_changed() - Note that a devicetree has been written to
+ *
+ * If @fdt is the control devicetree, this bumps a generation count, so that
+ * the index is dropped the next time it is used. Nothing is freed, so this
+ * is cheap and can be called at any time, for any blob.
+ *
+ * The U-Boot helpers which write to a devicetree call this, since a change
+ * which keeps the size of the tree the same, such as fdt_setprop_inplace(),
+ * is not otherwise noticed. Code which changes the control devicetree with
+ * libfdt directly must call it as well.
+ *
+ * @fdt:	Devicetree blob which is being changed
+ */
+void fdt_index_changed(const void *fdt);
+
+/**
+ * fdt_index_path_offset() - Find a node by path or alias
+ *
+ * This works like fdt_path_offset().
+ *
+ * @fdt:	Devicetree blob
+ * @path:	Full path of the node, or an alias optionally followed by a
+ *		path relative to it
+ * Return: offset of the node, or -ve FDT_ERR_... value on error
+ */
+int fdt_index_path_offset(const void *fdt, const char *path);
+
+/**
+ * fdt_index_node_offset_by_phandle() - Find a node by its phandle
+ *
+ * This works like fdt_node_offset_by_phandle().
+ *
+ * @fdt:	Devicetree blob
+ * @phandle:	Phandle to look for
+ * Return: offset of the node, or -ve FDT_ERR_... value on error
+ */
+int fdt_index_node_offset_by_phandle(const void *fdt, uint32_t phandle);
+
+/**
+ * fdt_index_node_offset_by_compatible() - Find the next compatible node
+ *
+ * This works like fdt_node_offset_by_compatible().
+ *
+ * @fdt:	Devicetree blob
+ * @startoffset: Only look at nodes after this one, -1 to start at the root
+ * @compat:	Compatible string to look for
+ * Return: offset of the node, or -ve FDT_ERR_... value on error
+ */
+int fdt_index_node_offset_by_compatible(const void *fdt, int startoffset,
+					const char *compat);
+
+#else
+
+static inline int fdt_index_init(void)
+{
+	return 0;
+}
+
+static inline void fdt_index_invalidate(void)
+{
+}
+
+static inline void fdt_index_changed(const void *fdt)
+{
+}
+
+static inline int fdt_index_path_offset(const void *fdt, const char *path)
+{
+	return fdt_path_offset(fdt, path);
+}
+
+static inline int fdt_index_node_offset_by_phandle(const void *fdt,
+						   uint32_t phandle)
+{
+	return fdt_node_offset_by_phandle(fdt, phandle);
+}
+
+static inline int fdt_index_node_offset_by_compatible(const void *fdt,
+						      int startoffset,
+						      const char *compat)
+{
+	return fdt_node_offset_by_compatible(fdt, startoffset, compat);
+}
+
+#endif
+
+#endif /* __FDT_INDEX_H */
@@ -367,6 +367,227 @@ int fdt_set_status_by_pathf(void *fdt, enum fdt_status status, const char *fmt,
 #define fdt_status_fail_by_pathf(fdt, fmt, ...) \
 	fdt_set_status_by_pathf((fdt), FDT_STATUS_FAIL, (fmt), ##__VA_ARGS__)
 
+/**
+ * struct fdt_batch_node - Index entry for a node, see struct fdt_batch
+ *
+ * @offset: Offset of the node
+ * @parent: Index of the parent node, -1 for the root
+ * @phandle: Phandle of the node, 0 if none
+ * @name: Name of the node, including any unit address
+ * @basename_len: Length of @name without the unit address
+ * @compat: 'compatible' property, NULL if none
+ * @compat_len: Length of @compat
+ * @next_name: Next node in the same name bucket, -1 if none
+ * @next_phandle: Next node in the same phandle bucket, -1 if none
+ */
+struct fdt_batch_node {
+	int offset;
+	int parent;
+	u32 phandle;
+	const char *name;
+	int basename_len;
+	const char *compat;
+	int compat_len;
+	int next_name;
+	int next_phandle;
+};
+
+/**
+ * struct fdt_batch_edit - A queued property change
+ *
+ * @offset: Offset of the node to change
+ * @seq: Position in the queue, so that edits to a node keep their order
+ * @len: Length of the new value, or -1 to delete the property
+ * @name: Property name, followed by the value
+ */
+struct fdt_batch_edit {
+	int offset;
+	int seq;
+	int len;
+	char *name;
+};
+
+/**
+ * struct fdt_batch - Change many properties of a device tree in one pass
+ *
+ * Fixups which look up nodes one at a time by compatible string or path,
+ * and grow the tree for each change, rescan the tree every time. Instead
+ * this indexes the nodes once, queues the changes and then makes them all
+ * with a single resize of the tree and a single pass over it.
+ *
+ * Nodes are referred to by their offsets in the tree as it was when
+ * fdt_batch_init() was called. The tree must not be changed until
+ * fdt_batch_apply() is called, so lookups and libfdt reads see the
+ * original tree, not the queued changes.
+ *
+ * @fdt: Device tree being changed
+ * @nodes: Index of nodes, in tree order
+ * @node_count: Number of entries in @nodes
+ * @name_hash: Start of each name bucket, indexed by hash
+ * @phandle_hash: Start of each phandle bucket, indexed by hash
+ * @hash_size: Number of buckets in each hash table, a power of two
+ * @edits: Queued changes
+ * @edit_count: Number of entries in @edits
+ * @edit_max: Number of entries allocated in @edits
+ * @space: Number of bytes the queued changes may add to the tree
+ */
+struct fdt_batch {
+	void *fdt;
+	struct fdt_batch_node *nodes;
+	int node_count;
+	int *name_hash;
+	int *phandle_hash;
+	uint hash_size;
+	struct fdt_batch_edit *edits;
+	int edit_count;
+	int edit_max;
+	int space;
+};
+
+/**
+ * fdt_batch_init() - Index a device tree ready for queuing changes
+ *
+ * @fb: Batch to set up
+ * @fdt: Device tree to change
+ * Return: 0 if OK, -FDT_ERR_NOSPACE if out of memory, other -FDT_ERR_...
+ *	if the tree is not valid
+ */
+int fdt_batch_init(struct fdt_batch *fb, void *fdt);
+
+/**
+ * fdt_batch_uninit() - Free a batch, dropping any changes not applied
+ *
+ * @fb: Batch to free
+ */
+void fdt_batch_uninit(struct fdt_batch *fb);
+
+/**
+ * fdt_batch_path_offset() - Find a node by path, as fdt_path_offset() does
+ *
+ * @fb: Batch
+ * @path: Full path of the node, or a path starting with an alias
+ * Return: offset of the node, or -FDT_ERR_NOTFOUND / -FDT_ERR_BADPATH
+ */
+int fdt_batch_path_offset(struct fdt_batch *fb, const char *path);
+
+/**
+ * fdt_batch_node_by_phandle() - Find a node by phandle
+ *
+ * @fb: Batch
+ * @phandle: Phandle to look for
+ * Return: offset of the node, or -FDT_ERR_NOTFOUND
+ */
+int fdt_batch_node_by_phandle(struct fdt_batch *fb, u32 phandle);
+
+/**
+ * fdt_batch_node_by_compatible() - Find the next node with a compatible string
+ *
+ * @fb: Batch
+ * @startoffset: Node to start after, or -1 to start at the root
+ * @compat: Compatible string to look for
+ * Return: offset of the node, or -FDT_ERR_NOTFOUND
+ */
+int fdt_batch_node_by_compatible(struct fdt_batch *fb, int startoffset,
+				 const char *compat);
+
+#define fdt_batch_for_each_compatible(node, fb, compat)			\
+	for (node = fdt_batch_node_by_compatible(fb, -1, compat);	\
+	     node >= 0;							\
+	     node = fdt_batch_node_by_compatible(fb, node, compat))
+
+/**
+ * fdt_batch_setprop() - Queue setting a property
+ *
+ * @fb: Batch
+ * @nodeoffset: Node to change
+ * @name: Property name
+ * @val: Value, which is copied
+ * @len: Length of @val in bytes
+ * Return: 0 if OK, -FDT_ERR_NOSPACE if out of memory
+ */
+int fdt_batch_setprop(struct fdt_batch *fb, int nodeoffset, const char *name,
+		      const void *val, int len);
+
+static inline int fdt_batch_setprop_u32(struct fdt_batch *fb, int nodeoffset,
+					const char *name, u32 val)
+{
+	fdt32_t tmp = cpu_to_fdt32(val);
+
+	return fdt_batch_setprop(fb, nodeoffset, name, &tmp, sizeof(tmp));
+}
+
+static inline int fdt_batch_setprop_string(struct fdt_batch *fb,
+					   int nodeoffset, const char *name,
+					   const char *str)
+{
+	return fdt_batch_setprop(fb, nodeoffset, name, str, strlen(str) + 1);
+}
+
+/**
+ * fdt_batch_delprop() - Queue deleting a property
+ *
+ * It is not an error if the property does not exist when the change is made.
+ *
+ * @fb: Batch
+ * @nodeoffset: Node to change
+ * @name: Property name
+ * Return: 0 if OK, -FDT_ERR_NOSPACE if out of memory
+ */
+int fdt_batch_delprop(struct fdt_batch *fb, int nodeoffset, const char *name);
+
+/**
+ * fdt_batch_set_status() - Queue setting the status of a node
+ *
+ * @fb: Batch
+ * @nodeoffset: Node to change
+ * @status: New status
+ * Return: 0 if OK, -ve on error
+ */
+int fdt_batch_set_status(struct fdt_batch *fb, int nodeoffset,
+			 enum fdt_status status);
+
+/**
+ * fdt_batch_fixup_by_path() - Queued version of do_fixup_by_path()
+ *
+ * @fb: Batch
+ * @path: Path of the node to change
+ * @prop: Property name
+ * @val: Value, which is copied
+ * @len: Length of @val in bytes
+ * @create: true to add the property if it does not exist
+ */
+void fdt_batch_fixup_by_path(struct fdt_batch *fb, const char *path,
+			     const char *prop, const void *val, int len,
+			     int create);
+
+/**
+ * fdt_batch_fixup_by_compat() - Queued version of do_fixup_by_compat()
+ *
+ * @fb: Batch
+ * @compat: Compatible string of the nodes to change
+ * @prop: Property name
+ * @val: Value, which is copied
+ * @len: Length of @val in bytes
+ * @create: true to add the property to nodes which do not have it
+ */
+void fdt_batch_fixup_by_compat(struct fdt_batch *fb, const char *compat,
+			       const char *prop, const void *val, int len,
+			       int create);
+
+/**
+ * fdt_batch_apply() - Make all queued changes
+ *
+ * The tree is grown once to fit all the changes. Then the structure block is
+ * copied once, with the properties of each node which has changes written
+ * out as they would be after the same fdt_setprop() and fdt_delprop() calls,
+ * and the strings block is moved to follow it. The batch cannot be used
+ * afterwards, except to free it.
+ *
+ * @fb: Batch
+ * Return: 0 if OK, -ve -FDT_ERR_... from the first change which failed
+ */
+int fdt_batch_apply(struct fdt_batch *fb);
+
 /* Helper to read a big number; size is in cells (not bytes) */
 static inline u64 fdt_read_number(const fdt32_t *cell, int size)
 {
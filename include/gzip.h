@@ -45,6 +45,27 @@ int gunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp);
 int zunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp,
 	   int stoponerr, int offset);
 
+/**
+ * gzalloc() - Allocate memory for zlib
+ *
+ * This is suitable for the zalloc member of struct z_stream
+ *
+ * @x: Opaque zlib pointer (unused)
+ * @items: Number of items to allocate
+ * @size: Size of each item
+ * Return: pointer to memory, or NULL if out of memory
+ */
+void *gzalloc(void *x, unsigned items, unsigned size);
+
+/**
+ * gzfree() - Free memory allocated by gzalloc()
+ *
+ * @x: Opaque zlib pointer (unused)
+ * @addr: Memory to free
+ * @nb: Number of bytes (unused)
+ */
+void gzfree(void *x, void *addr, unsigned nb);
+
 /**
  * gzwrite progress indicators: defined weak to allow board-specific
  * overrides:
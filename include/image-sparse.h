@@ -40,3 +40,92 @@ static inline int is_sparse_image(void *buf)
 
 int write_sparse_image(struct sparse_storage *info, const char *part_name,
 		       void *data, char *response);
+
+enum sparse_stream_state {
+	SPARSE_STREAM_FILE_HDR,
+	SPARSE_STREAM_CHUNK_HDR,
+	SPARSE_STREAM_RAW,
+	SPARSE_STREAM_FILL,
+	SPARSE_STREAM_SKIP,
+	SPARSE_STREAM_DONE,
+};
+
+/**
+ * struct sparse_stream - State for writing a sparse image as it arrives
+ *
+ * @info: Storage to write to
+ * @state: What is expected next
+ * @header: Sparse image header
+ * @chunk: Header of the current chunk
+ * @pos: Number of bytes of the current header received
+ * @left: Bytes of data left in the current chunk
+ * @fill_val: Value for a CHUNK_TYPE_FILL chunk
+ * @blkcnt: Number of storage blocks in the current chunk
+ * @chunk_num: Number of chunks finished
+ * @blk: Storage block after the data received so far
+ * @total_blocks: Number of sparse blocks received so far
+ * @bytes_written: Number of bytes to be written so far
+ * @buf: Buffer for raw data, which is written out when full
+ * @buf_size: Size of @buf, a multiple of the storage block size
+ * @buf_len: Number of bytes in @buf
+ * @buf_blk: Storage block to write @buf to
+ */
+struct sparse_stream {
+	struct sparse_storage *info;
+	enum sparse_stream_state state;
+	sparse_header_t header;
+	chunk_header_t chunk;
+	uint pos;
+	u64 left;
+	u32 fill_val;
+	lbaint_t blkcnt;
+	uint chunk_num;
+	lbaint_t blk;
+	u32 total_blocks;
+	u64 bytes_written;
+	void *buf;
+	size_t buf_size;
+	size_t buf_len;
+	lbaint_t buf_blk;
+};
+
+/**
+ * sparse_stream_init() - Start writing a sparse image piece by piece
+ *
+ * Raw data is gathered in @buf and written out when it is full, so that
+ * storage is written in large blocks however the image arrives. Fill and
+ * don't-care chunks are dealt with as soon as their headers arrive.
+ *
+ * @ss: Stream state to set up
+ * @info: Storage to write to
+ * @buf: Buffer to use for raw data, suitably aligned for DMA
+ * @size: Size of @buf
+ * Return: 0 if OK, -EINVAL if @buf is smaller than a storage block
+ */
+int sparse_stream_init(struct sparse_stream *ss, struct sparse_storage *info,
+		       void *buf, size_t size);
+
+/**
+ * sparse_stream_write() - Process the next part of a sparse image
+ *
+ * @ss: Stream state
+ * @data: Next part of the image
+ * @len: Length of @data in bytes
+ * @response: Message buffer passed to @info->mssg on error
+ * Return: 0 if OK, -1 on error
+ */
+int sparse_stream_write(struct sparse_stream *ss, const void *data,
+			size_t len, char *response);
+
+/**
+ * sparse_stream_finish() - Write out the rest of a sparse image
+ *
+ * This checks that the whole image was received.
+ *
+ * @ss: Stream state
+ * @part_name: Name of the partition written, for the message shown
+ * @response: Message buffer passed to @info->mssg on error
+ * Return: 0 if OK, -1 on error
+ */
+int sparse_stream_finish(struct sparse_stream *ss, const char *part_name,
+			 char *response);
@@ -605,6 +605,11 @@ int boot_get_fdt_fit(bootm_headers_t *images, ulong addr,
  *
  * The property to look up is defined by image_type.
  *
+ * When a kernel is selected through a configuration and images->verify is
+ * set, the hashes of all the images in that configuration are calculated in
+ * parallel, if CONFIG_MP_JOB is enabled. Later calls for the other images
+ * use these results until fit_image_hash_drop() is called.
+ *
  * @param images	Boot images structure
  * @param addr		Address of FIT in memory
  * @param fit_unamep	On entry this is the requested image name
@@ -630,6 +635,23 @@ int fit_image_load(bootm_headers_t *images, ulong addr,
 		   int arch, int image_type, int bootstage_id,
 		   enum fit_load_op load_op, ulong *datap, ulong *lenp);
 
+/**
+ * fit_image_hash_pending() - count hashes calculated ahead of time
+ *
+ * Return: number of hashes started by fit_image_load() which no image has
+ * used yet
+ */
+int fit_image_hash_pending(void);
+
+/**
+ * fit_image_hash_drop() - drop hashes calculated ahead of time
+ *
+ * This waits for any hashes started by fit_image_load() which are still
+ * running and forgets all results, so that none is used once the FIT may
+ * have changed.
+ */
+void fit_image_hash_drop(void);
+
 /**
  * image_source_script() - Execute a script
  *
@@ -1156,6 +1178,160 @@ int fit_check_ramdisk(const void *fit, int os_noffset,
 int calculate_hash(const void *data, int data_len, const char *algo,
 			uint8_t *value, int *value_len);
 
+struct blk_desc;
+
+/**
+ * struct fit_stream - source of a FIT read in chunks
+ *
+ * @read:	Read @size bytes from @offset within the FIT into @buf.
+ *		Returns the number of bytes read, or -ve on error
+ * @priv:	Private data for @read
+ * @chunk_size:	Number of bytes to read at a time
+ * @fit:	FDT part of the FIT, set up by fit_stream_open()
+ * @blk:	Block device, used by fit_stream_init_blk()
+ * @start:	First block on @blk, used by fit_stream_init_blk()
+ * @ifname:	Interface name, used by fit_stream_init_fs()
+ * @dev_part:	Device and partition, used by fit_stream_init_fs()
+ * @filename:	File name, used by fit_stream_init_fs()
+ */
+struct fit_stream {
+	long (*read)(struct fit_stream *st, ulong offset, void *buf,
+		     ulong size);
+	void *priv;
+	ulong chunk_size;
+	void *fit;
+	struct blk_desc *blk;
+	ulong start;
+	const char *ifname;
+	const char *dev_part;
+	const char *filename;
+};
+
+/**
+ * fit_stream_init_mem() - set up a stream reading a FIT from memory
+ *
+ * @st:		Stream to set up
+ * @buf:	FIT, including its external data
+ */
+void fit_stream_init_mem(struct fit_stream *st, const void *buf);
+
+/**
+ * fit_stream_init_blk() - set up a stream reading a FIT from a block device
+ *
+ * @st:		Stream to set up
+ * @desc:	Block device holding the FIT
+ * @start:	Block where the FIT starts
+ */
+void fit_stream_init_blk(struct fit_stream *st, struct blk_desc *desc,
+			 ulong start);
+
+/**
+ * fit_stream_init_fs() - set up a stream reading a FIT from a file
+ *
+ * The strings must remain valid while the stream is in use.
+ *
+ * @st:		Stream to set up
+ * @ifname:	Interface name, e.g. "mmc"
+ * @dev_part:	Device and partition, e.g. "0:1"
+ * @filename:	Name of the file holding the FIT
+ */
+void fit_stream_init_fs(struct fit_stream *st, const char *ifname,
+			const char *dev_part, const char *filename);
+
+/**
+ * fit_stream_open() - read the FDT part of a FIT
+ *
+ * This reads and checks the FIT structure, without its external data. Use
+ * fit_stream_close() to free it.
+ *
+ * @st:		Stream to read from
+ * Return: 0 if OK, -ENOEXEC if this is not a FIT, other -ve on error
+ */
+int fit_stream_open(struct fit_stream *st);
+
+/**
+ * fit_stream_load_image() - load, verify and decompress an image
+ *
+ * For images with external data this reads the data in chunks of
+ * @st->chunk_size, passing each chunk to the hash algorithms of the image
+ * and then to the decompressor while it is still in cache. The data is thus
+ * read from storage once and written straight to the load address. If the
+ * hashes turn out to be bad, the output is cleared again.
+ *
+ * Images which need their data in one piece (those with signature nodes,
+ * or when the control FDT requires image signatures) and images compressed
+ * with something other than gzip or zstd are read first and then checked as
+ * fit_image_load() does, before they are decompressed.
+ *
+ * This does not check the configuration; use fit_stream_load() for that.
+ *
+ * @st:		Stream, opened with fit_stream_open()
+ * @noffset:	Offset of the image node in @st->fit
+ * @load:	Address to load to, or -1 to use the image's load address
+ * @lenp:	Returns the length of the loaded (decompressed) image
+ * Return: 0 if OK, -EBADMSG if verification failed, -ENOTSUPP for
+ *	encrypted images, other -ve on error
+ */
+int fit_stream_load_image(struct fit_stream *st, int noffset, ulong load,
+			  ulong *lenp);
+
+/**
+ * fit_stream_load() - load an image selected by a configuration
+ *
+ * This picks the configuration, checks its signatures with
+ * fit_config_verify() as fit_image_load() does, then loads the image it
+ * names in @prop_name with fit_stream_load_image().
+ *
+ * @st:		Stream, opened with fit_stream_open()
+ * @conf_uname:	Name of the configuration, or NULL for the default one
+ * @prop_name:	Property naming the image, e.g. FIT_KERNEL_PROP
+ * @load:	Address to load to, or -1 to use the image's load address
+ * @lenp:	Returns the length of the loaded (decompressed) image
+ * Return: 0 if OK, -EACCES if the configuration failed verification,
+ *	-ENOENT if the configuration or image is missing, other -ve on error
+ *	as for fit_stream_load_image()
+ */
+int fit_stream_load(struct fit_stream *st, const char *conf_uname,
+		    const char *prop_name, ulong load, ulong *lenp);
+
+/**
+ * fit_stream_can_hash() - check if an image can be hashed as it is loaded
+ *
+ * @fit:	FIT holding the image
+ * @noffset:	Offset of the image node
+ * Return: true if fit_stream_decomp_hashed() can be used for the image,
+ *	false if its data must be verified in one piece
+ */
+bool fit_stream_can_hash(const void *fit, int noffset);
+
+/**
+ * fit_stream_decomp_hashed() - verify and decompress data in one pass
+ *
+ * This hashes the data of an image in memory and decompresses it in chunks
+ * which stay in cache, instead of walking the data once to verify it and
+ * again to decompress it. If the hashes turn out to be bad, the output is
+ * cleared again.
+ *
+ * @fit:	FIT holding the image, for which fit_stream_can_hash() is true
+ * @noffset:	Offset of the image node
+ * @data:	Data of the image
+ * @size:	Size of @data
+ * @dst:	Buffer for the decompressed data
+ * @dst_size:	Size of @dst
+ * @lenp:	Returns the length of the decompressed data
+ * Return: 0 if OK, -EBADMSG if verification failed, other -ve on error
+ */
+int fit_stream_decomp_hashed(const void *fit, int noffset, const void *data,
+			     ulong size, void *dst, ulong dst_size,
+			     ulong *lenp);
+
+/**
+ * fit_stream_close() - free the FDT part of a FIT
+ *
+ * @st:		Stream to close
+ */
+void fit_stream_close(struct fit_stream *st);
+
 /*
  * At present we only support signing on the host, and verification on the
  * device
@@ -517,6 +517,7 @@ struct spi_flash {
  * @quad_enable:	[FLASH-SPECIFIC] enables SPI NOR quad mode
  * @octal_dtr_enable:	[FLASH-SPECIFIC] enables SPI NOR octal DTR mode.
  * @ready:		[FLASH-SPECIFIC] check if the flash is ready
+ * @dirmap:		direct mapping used for reads, if any
  * @priv:		the private data
  */
 struct spi_nor {
@@ -567,6 +568,12 @@ struct spi_nor {
 	int (*octal_dtr_enable)(struct spi_nor *nor);
 	int (*ready)(struct spi_nor *nor);
 
+#if CONFIG_IS_ENABLED(SPI_DIRMAP)
+	struct {
+		struct spi_mem_dirmap_desc *rdesc;
+	} dirmap;
+#endif
+
 	void *priv;
 	char mtd_name[MTD_NAME_SIZE(MTD_DEV_TYPE_NOR)];
 /* Compatibility for spi_flash, remove once sf layer is merged with mtd */
@@ -1155,4 +1155,71 @@ struct abuf;
  */
 int zstd_decompress(struct abuf *in, struct abuf *out);
 
+/**
+ * struct zstd_stream - Streaming Zstandard decompression
+ *
+ * The input may be fed in chunks of any size. The output is written straight
+ * to its final place, which also serves as the history window, so there is
+ * no window buffer and no copy. The decompression context and a buffer for
+ * input units split across chunks come from a workspace which is kept for
+ * later use.
+ *
+ * @dctx: Decompression context
+ * @dst: Output buffer
+ * @dst_size: Size of output buffer
+ * @pos: Number of bytes decompressed so far
+ * @unit: Buffer for an input unit split across chunks
+ * @staged: Number of bytes in @unit
+ * @frames: Number of frames started
+ * @idle: true if between frames, with no input for the next one yet
+ * @workspace: Workspace holding @dctx and @unit
+ * @own: true if @workspace was allocated for this stream only
+ */
+struct zstd_stream {
+	ZSTD_DCtx *dctx;
+	void *dst;
+	size_t dst_size;
+	size_t pos;
+	void *unit;
+	size_t staged;
+	int frames;
+	bool idle;
+	void *workspace;
+	bool own;
+};
+
+/**
+ * zstd_stream_init() - Start a streaming decompression
+ *
+ * @zs: Stream to set up
+ * @dst: Output buffer, which must be large enough for all the output
+ * @dst_size: Size of output buffer
+ * Return: 0 if OK, -ENOMEM if out of memory
+ */
+int zstd_stream_init(struct zstd_stream *zs, void *dst, size_t dst_size);
+
+/**
+ * zstd_stream_feed() - Decompress the next chunk of input
+ *
+ * The input may contain any number of frames, including skippable ones.
+ *
+ * @zs: Stream to use
+ * @src: Chunk of compressed data
+ * @size: Size of chunk
+ * Return: 0 if OK, -ENOSPC if the output buffer is too small, -EBADMSG if
+ *	the data is corrupt
+ */
+int zstd_stream_feed(struct zstd_stream *zs, const void *src, size_t size);
+
+/**
+ * zstd_stream_finish() - Finish a streaming decompression
+ *
+ * This releases the workspace, so must be called even after an error.
+ *
+ * @zs: Stream to finish
+ * Return: number of bytes decompressed, or -EBADMSG if the input ended part
+ *	way through a frame or held no frames
+ */
+int zstd_stream_finish(struct zstd_stream *zs);
+
 #endif  /* ZSTD_H */
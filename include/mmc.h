@@ -112,6 +112,7 @@ struct bd_info;
 #define MMC_CMD_ERASE_GROUP_START	35
 #define MMC_CMD_ERASE_GROUP_END		36
 #define MMC_CMD_ERASE			38
+#define MMC_CMD_CMDQ_TASK_MGMT		48
 #define MMC_CMD_APP_CMD			55
 #define MMC_CMD_SPI_READ_OCR		58
 #define MMC_CMD_SPI_CRC_ON_OFF		59
@@ -213,6 +214,7 @@ static inline bool mmc_is_tuning_cmd(uint cmdidx)
 /*
  * EXT_CSD fields
  */
+#define EXT_CSD_CMDQ_MODE_EN		15	/* R/W */
 #define EXT_CSD_ENH_START_ADDR		136	/* R/W */
 #define EXT_CSD_ENH_SIZE_MULT		140	/* R/W */
 #define EXT_CSD_GP_SIZE_MULT		143	/* R/W */
@@ -242,6 +244,8 @@ static inline bool mmc_is_tuning_cmd(uint cmdidx)
 #define EXT_CSD_HC_ERASE_GRP_SIZE	224	/* RO */
 #define EXT_CSD_BOOT_MULT		226	/* RO */
 #define EXT_CSD_GENERIC_CMD6_TIME       248     /* RO */
+#define EXT_CSD_CMDQ_DEPTH		307	/* RO */
+#define EXT_CSD_CMDQ_SUPPORT		308	/* RO */
 #define EXT_CSD_BKOPS_SUPPORT		502	/* RO */
 
 /*
@@ -487,6 +491,28 @@ struct dm_mmc_ops {
 	 * @return 0 if OK, -ve on error
 	 */
 	int (*execute_tuning)(struct udevice *dev, uint opcode);
+
+	/**
+	 * get_tuning() - Get the result of the last tuning
+	 *
+	 * @dev:	Device which was tuned
+	 * @val:	Returns a host specific value for set_tuning()
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*get_tuning)(struct udevice *dev, u32 *val);
+
+	/**
+	 * set_tuning() - Restore the result of an earlier tuning
+	 *
+	 * This is called instead of execute_tuning() when the card is known
+	 * to have been tuned successfully before.
+	 *
+	 * @dev:	Device to set up
+	 * @opcode:	Command opcode execute_tuning() would send
+	 * @val:	Value from get_tuning()
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*set_tuning)(struct udevice *dev, uint opcode, u32 val);
 #endif
 
 	/**
@@ -535,6 +561,55 @@ struct dm_mmc_ops {
 	 * @return 0 if success, -ve on error
 	 */
 	int (*hs400_prepare_ddr)(struct udevice *dev);
+
+#if CONFIG_IS_ENABLED(MMC_CQE)
+	/**
+	 * cqe_enable() - Switch the host to its command queue engine
+	 *
+	 * This is called after the card has been put in command queue mode.
+	 * Until cqe_disable() only the cqe_...() methods are used.
+	 *
+	 * @dev:	Device to set up
+	 * @depth:	Queue depth supported by the card
+	 * @return number of tags (from 0) the caller may use, which is not
+	 *	more than @depth, or -ve on error
+	 */
+	int (*cqe_enable)(struct udevice *dev, uint depth);
+
+	/**
+	 * cqe_disable() - Go back to sending commands with send_cmd()
+	 *
+	 * Any tasks still queued in the host are discarded.
+	 *
+	 * @dev:	Device to set up
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*cqe_disable)(struct udevice *dev);
+
+	/**
+	 * cqe_request() - Queue a data transfer task
+	 *
+	 * @dev:	Device to use
+	 * @tag:	Tag of the task, which must not be in use
+	 * @data:	Transfer to do, of at most the host's b_max blocks. This
+	 *		must remain valid until the task is complete
+	 * @addr:	Card address of the first block, as for CMD18/CMD25
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*cqe_request)(struct udevice *dev, uint tag, struct mmc_data *data,
+			   u32 addr);
+
+	/**
+	 * cqe_wait() - Wait for at least one queued task to complete
+	 *
+	 * @dev:	Device to check
+	 * @done:	Returns a bitmask of the tags which completed
+	 * @timeout_us:	Timeout in microseconds
+	 * @return 0 if OK, -ETIMEDOUT if nothing completed in time, other
+	 *	-ve on error
+	 */
+	int (*cqe_wait)(struct udevice *dev, u32 *done, int timeout_us);
+#endif
 };
 
 #define mmc_get_ops(dev)        ((struct dm_mmc_ops *)(dev)->driver->ops)
@@ -546,6 +621,11 @@ int mmc_getwp(struct mmc *mmc);
 int mmc_execute_tuning(struct mmc *mmc, uint opcode);
 int mmc_wait_dat0(struct mmc *mmc, int state, int timeout_us);
 int mmc_set_enhanced_strobe(struct mmc *mmc);
+int mmc_cqe_enable(struct mmc *mmc, uint depth);
+int mmc_cqe_disable(struct mmc *mmc);
+int mmc_cqe_request(struct mmc *mmc, uint tag, struct mmc_data *data,
+		    u32 addr);
+int mmc_cqe_wait(struct mmc *mmc, u32 *done, int timeout_us);
 int mmc_host_power_cycle(struct mmc *mmc);
 int mmc_deferred_probe(struct mmc *mmc);
 int mmc_reinit(struct mmc *mmc);
@@ -728,6 +808,14 @@ struct mmc {
 	u8 hs400_tuning;
 
 	enum bus_mode user_speed_mode; /* input speed mode from user */
+#if CONFIG_IS_ENABLED(MMC_BUS_MODE_CACHE)
+	u32 tuning;		/* result of the last tuning, for set_tuning() */
+	bool tuning_cached;	/* apply @tuning instead of tuning again */
+#endif
+#if CONFIG_IS_ENABLED(MMC_CQE)
+	uint cqe_depth;		/* command queue depth, 0 if not supported */
+	uint cqe_tags;		/* tags in use while in command queue mode */
+#endif
 };
 
 #if CONFIG_IS_ENABLED(DM_MMC)
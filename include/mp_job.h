@@ -0,0 +1,168 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Running self-contained jobs on otherwise idle secondary CPUs
+ *
+ * Copyright 2023 NXP
+ */
+
+#ifndef __MP_JOB_H
+#define __MP_JOB_H
+
+#include <linux/types.h>
+
+/**
+ * struct mp_job - A unit of work which may run on another CPU
+ *
+ * A job must be self-contained: it may read and write memory and call pure
+ * library code such as hash or decompression functions, but must not use the
+ * console, malloc(), driver model, timers or the watchdog, none of which are
+ * safe to use from more than one CPU at a time.
+ *
+ * @func: Function to run, returning 0 on success or -ve error
+ * @arg: Argument passed to @func
+ * @ret: Return value of @func, valid once mp_job_wait() returns
+ * @state: Internal state (enum mp_job_state)
+ */
+struct mp_job {
+	int (*func)(void *arg);
+	void *arg;
+	int ret;
+	int state;
+};
+
+/**
+ * struct mp_worker - A secondary CPU which runs jobs
+ *
+ * This is shared between the boot CPU and the worker. Only the arch code that
+ * starts and stops workers needs to know about it.
+ *
+ * @job: Job to run next, or NULL if idle. Set by the boot CPU, cleared by the
+ *	worker once the job is finished
+ * @stop: Set by the boot CPU to make mp_job_worker() return
+ * @running: Set by the worker while it is inside mp_job_worker()
+ * @index: Worker number, from 0
+ * @priv: Private data for the arch code
+ */
+struct mp_worker {
+	struct mp_job *job;
+	bool stop;
+	bool running;
+	int index;
+	void *priv;
+};
+
+#if CONFIG_IS_ENABLED(MP_JOB)
+
+/**
+ * mp_job_submit() - Start a job, on a secondary CPU if one is idle
+ *
+ * If no secondary CPU is idle, or there are none, the job is run on the
+ * calling CPU before this returns. Either way mp_job_wait() must be called
+ * before the job is reused or freed.
+ *
+ * @job: Job to start, with @func and @arg set up
+ */
+void mp_job_submit(struct mp_job *job);
+
+/**
+ * mp_job_wait() - Wait for a job to finish
+ *
+ * This keeps the watchdog alive while waiting. If no secondary CPU has taken
+ * the job after a short time, it is run on the calling CPU instead. If it
+ * takes far too long on a secondary CPU, this gives up on it. Either way the
+ * secondary CPUs are not used again.
+ *
+ * @job: Job previously passed to mp_job_submit()
+ * Return: value returned by the job's function, or -ETIMEDOUT if it did not
+ *	finish, in which case the memory it uses must not be reused
+ */
+int mp_job_wait(struct mp_job *job);
+
+/**
+ * mp_job_cpus() - Get the number of CPUs that can run jobs
+ *
+ * This starts the secondary CPUs if needed.
+ *
+ * Return: number of CPUs jobs can run on, including the calling one
+ */
+int mp_job_cpus(void);
+
+/**
+ * mp_job_stop() - Stop all secondary CPUs
+ *
+ * This must be called before handing over to an OS, which expects the
+ * secondary CPUs to be off. Jobs submitted afterwards start them again,
+ * unless some of them failed to stop.
+ */
+void mp_job_stop(void);
+
+/**
+ * mp_job_worker() - Run jobs until told to stop
+ *
+ * This is called by the arch code on each secondary CPU once it can access
+ * memory coherently with the boot CPU, and returns when mp_job_stop() is
+ * called.
+ *
+ * @worker: Worker for this CPU
+ */
+void mp_job_worker(struct mp_worker *worker);
+
+/**
+ * arch_mp_job_start() - Start secondary CPUs to run jobs
+ *
+ * Each CPU that is started must call mp_job_worker() with its worker.
+ *
+ * @workers: Workers to start, with @index set
+ * @max: Maximum number of workers to start
+ * Return: number of workers started (the first ones in @workers)
+ */
+int arch_mp_job_start(struct mp_worker *workers, int max);
+
+/**
+ * arch_mp_job_stop() - Finish stopping secondary CPUs
+ *
+ * This is called once all workers have returned from mp_job_worker() or
+ * have timed out doing so.
+ *
+ * @workers: Workers to stop
+ * @count: Number of workers
+ */
+void arch_mp_job_stop(struct mp_worker *workers, int count);
+
+/**
+ * arch_mp_job_idle() - Wait on a secondary CPU for something to do
+ *
+ * This may return early, but should wait until arch_mp_job_notify() is
+ * called if possible.
+ */
+void arch_mp_job_idle(void);
+
+/**
+ * arch_mp_job_notify() - Wake up secondary CPUs in arch_mp_job_idle()
+ */
+void arch_mp_job_notify(void);
+
+#else
+
+static inline void mp_job_submit(struct mp_job *job)
+{
+	job->ret = job->func(job->arg);
+}
+
+static inline int mp_job_wait(struct mp_job *job)
+{
+	return job->ret;
+}
+
+static inline int mp_job_cpus(void)
+{
+	return 1;
+}
+
+static inline void mp_job_stop(void)
+{
+}
+
+#endif
+
+#endif /* __MP_JOB_H */
@@ -155,6 +155,28 @@ void *os_realloc(void *ptr, size_t length);
  */
 void os_usleep(unsigned long usec);
 
+/**
+ * os_thread_create() - start a host thread
+ *
+ * The thread has all signals blocked, so that they go to the main thread.
+ *
+ * @threadp:	returns the thread, for use with os_thread_join()
+ * @func:	function for the thread to run
+ * @arg:	argument to pass to @func
+ * Return:	0 if OK, -ve on error
+ */
+int os_thread_create(void **threadp, void *(*func)(void *arg), void *arg);
+
+/**
+ * os_thread_join() - wait for a host thread to finish
+ *
+ * This also frees the thread.
+ *
+ * @thread:	thread returned by os_thread_create()
+ * Return:	0 if OK, -ve on error
+ */
+int os_thread_join(void *thread);
+
 /**
  * Gets a monotonic increasing number of nano seconds from the OS
  *
@@ -0,0 +1,18 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Benchmarks, run with 'ut bench'
+ */
+
+#ifndef __TEST_BENCH_H__
+#define __TEST_BENCH_H__
+
+#include <test/test.h>
+
+/*
+ * Declare a new benchmark. These take a while and only report timings, so
+ * they are left out of 'ut all'. The list is not named like a test suite,
+ * so test/py does not pick them up either.
+ */
+#define BENCH_TEST(_name, _flags)	UNIT_TEST(_name, _flags, bench)
+
+#endif /* __TEST_BENCH_H__ */
@@ -28,6 +28,8 @@ enum {
 enum trace_chunk_type {
 	TRACE_CHUNK_FUNCS,
 	TRACE_CHUNK_CALLS,
+	TRACE_CHUNK_EVENTS,
+	TRACE_CHUNK_NAMES,
 };
 
 /* A trace record for a function, as written to the profile output file */
@@ -79,6 +81,68 @@ struct trace_call {
 
 int trace_list_calls(void *buff, size_t buff_size, size_t *needed);
 
+/* Magic number at the start of the data written by boottrace_stash() */
+#define BOOTTRACE_MAGIC		0xb0077ace
+
+/*
+ * Header of the boot timeline handed over to the OS. It is followed by @size
+ * bytes of trace chunks, as written by boottrace_export().
+ */
+struct boottrace_stash_hdr {
+	uint32_t magic;		/* BOOTTRACE_MAGIC */
+	uint32_t size;
+};
+
+/* Types of event in the boot timeline, see struct trace_output_event */
+enum trace_event_type {
+	TRACE_EV_MARK,		/* bootstage mark, @id is the stage */
+	TRACE_EV_STAGE_START,	/* bootstage_start(), @id as above */
+	TRACE_EV_STAGE_END,	/* bootstage_accum(), @id as above */
+	TRACE_EV_FUNC_ENTRY,	/* @id is the function, @arg the caller */
+	TRACE_EV_FUNC_EXIT,	/* as above */
+	TRACE_EV_BLK_START,	/* @dev is the block device, @id the start */
+	TRACE_EV_BLK_END,	/* block and @arg the number of blocks */
+	TRACE_EV_NET_START,	/* @id is the protocol (enum proto_t) */
+	TRACE_EV_NET_END,	/* @arg is the number of bytes received */
+
+	TRACE_EV_COUNT,
+};
+
+/* Flags for trace_output_event */
+enum trace_event_flags {
+	TRACE_EVF_ERROR	= 1 << 0,	/* bootstage or I/O error */
+	TRACE_EVF_WRITE	= 1 << 1,	/* block write, not read */
+};
+
+/*
+ * An event in the boot timeline, as written to the profile output file
+ *
+ * Times are in microseconds since the timer started. Function addresses are
+ * offsets into the code, as for struct trace_call.
+ */
+struct trace_output_event {
+	uint32_t time_us;
+	uint8_t type;		/* enum trace_event_type */
+	uint8_t flags;		/* enum trace_event_flags */
+	uint16_t dev;		/* Sequence number of device, if any */
+	uint32_t id;
+	uint32_t arg;
+};
+
+/*
+ * A name for the events with a given type and ID, as written to the profile
+ * output file. It is followed by @len bytes holding the nul-terminated name,
+ * padded with nul characters to a multiple of four bytes.
+ *
+ * TRACE_EV_MARK names cover all bootstage events and TRACE_EV_BLK_START
+ * names cover all block events, where @id is the device sequence number.
+ */
+struct trace_output_name {
+	uint16_t type;		/* enum trace_event_type */
+	uint16_t len;		/* Length of the name, including padding */
+	uint32_t id;
+};
+
 /**
  * Turn function tracing on and off
  *
@@ -84,6 +84,19 @@ uint32_t crc32_wd(uint32_t crc, const unsigned char *buf, uint len,
  */
 uint32_t crc32_no_comp(uint32_t crc, const unsigned char *buf, uint len);
 
+/**
+ * crc32_no_comp_sw() - Software-only version of crc32_no_comp()
+ *
+ * This is what crc32_no_comp() falls back to when the CPU has no CRC32
+ * instructions. It is exported so that tests can compare the two.
+ *
+ * @crc: Input crc to chain from a previous calculution
+ * @buf: Bytes to checksum
+ * @len: Number of bytes to checksum
+ * Return: checksum value
+ */
+uint32_t crc32_no_comp_sw(uint32_t crc, const unsigned char *buf, uint len);
+
 /**
  * crc32_wd_buf - Perform CRC32 on a buffer and return result in buffer
  *
@@ -122,4 +135,29 @@ void crc32c_init(uint32_t *crc32c_table, uint32_t pol);
 uint32_t crc32c_cal(uint32_t crc, const char *data, int length,
 		    uint32_t *crc32c_table);
 
+/**
+ * crc32c() - Calculate the CRC32C (Castagnoli) of a block of data
+ *
+ * This uses the CPU's CRC32C instructions where available and built-in
+ * tables otherwise, so needs no set-up. Like crc32_no_comp() it does not
+ * invert the CRC before or after, so callers normally start with ~0 and
+ * invert the result.
+ *
+ * @crc: Previous crc
+ * @data: Data bytes to checksum
+ * @length: Number of bytes to process
+ * Return: checksum value
+ */
+uint32_t crc32c(uint32_t crc, const void *data, uint length);
+
+/**
+ * crc32c_sw() - Software-only version of crc32c()
+ *
+ * @crc: Previous crc
+ * @data: Data bytes to checksum
+ * @length: Number of bytes to process
+ * Return: checksum value
+ */
+uint32_t crc32c_sw(uint32_t crc, const void *data, uint length);
+
 #endif /* _UBOOT_CRC_H */
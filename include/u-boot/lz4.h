@@ -9,15 +9,19 @@
 /**
  * ulz4fn() - Decompress LZ4 data
  *
+ * This handles one or more LZ4 frames, with independent or linked blocks,
+ * and skips any skippable frames between them. Checksums are verified if
+ * CONFIG_LZ4_CHECKSUM is enabled.
+ *
  * @src: Source data to decompress
  * @srcn: Length of source data
  * @dst: Destination for uncompressed data
- * @dstn: Returns length of uncompressed data
+ * @dstn: On entry, the size of @dst; returns length of uncompressed data
  * Return: 0 if OK, -EPROTONOSUPPORT if the magic number or version number are
- *	not recognised or independent blocks are used, -EINVAL if the reserved
- *	fields are non-zero, or input is overrun, -EENOBUFS if the destination
- *	buffer is overrun, -EEPROTO if the compressed data causes an error in
- *	the decompression algorithm
+ *	not recognised or a dictionary is needed, -EINVAL if the reserved
+ *	fields are non-zero, or input is overrun, -ENOBUFS if the destination
+ *	buffer is overrun, -EPROTO if the compressed data causes an error in
+ *	the decompression algorithm, -EBADMSG if a checksum does not match
  */
 int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn);
 
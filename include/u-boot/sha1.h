@@ -60,6 +60,13 @@ void sha1_update(sha1_context *ctx, const unsigned char *input,
  */
 void sha1_finish( sha1_context *ctx, unsigned char output[20] );
 
+/* Hash @blocks whole 64-byte blocks, using CPU instructions if available */
+void sha1_process(sha1_context *ctx, const unsigned char *data,
+		  unsigned int blocks);
+/* The portable C version of sha1_process() */
+void sha1_process_generic(sha1_context *ctx, const unsigned char *data,
+			  unsigned int blocks);
+
 /**
  * \brief	   Output = SHA-1( input buffer )
  *
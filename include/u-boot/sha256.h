@@ -19,6 +19,12 @@ void sha256_starts(sha256_context * ctx);
 void sha256_update(sha256_context *ctx, const uint8_t *input, uint32_t length);
 void sha256_finish(sha256_context * ctx, uint8_t digest[SHA256_SUM_LEN]);
 
+/* Hash @blocks whole 64-byte blocks, using CPU instructions if available */
+void sha256_process(sha256_context *ctx, const uint8_t *data, uint32_t blocks);
+/* The portable C version of sha256_process() */
+void sha256_process_generic(sha256_context *ctx, const uint8_t *data,
+			    uint32_t blocks);
+
 void sha256_csum_wd(const unsigned char *input, unsigned int ilen,
 		unsigned char *output, unsigned int chunk_sz);
 
@@ -22,6 +22,12 @@ void sha512_starts(sha512_context * ctx);
 void sha512_update(sha512_context *ctx, const uint8_t *input, uint32_t length);
 void sha512_finish(sha512_context * ctx, uint8_t digest[SHA512_SUM_LEN]);
 
+/* Hash @blocks whole 128-byte blocks, using CPU instructions if available */
+void sha512_process(sha512_context *ctx, const uint8_t *data, uint32_t blocks);
+/* The portable C version of sha512_process() */
+void sha512_process_generic(sha512_context *ctx, const uint8_t *data,
+			    uint32_t blocks);
+
 void sha512_csum_wd(const unsigned char *input, unsigned int ilen,
 		unsigned char *output, unsigned int chunk_sz);
 
@@ -14,6 +14,7 @@
 #include <irq_func.h>
 #include <log.h>
 #include <malloc.h>
+#include <mp_job.h>
 #include <pe.h>
 #include <time.h>
 #include <u-boot/crc.h>
@@ -2166,6 +2167,9 @@ static efi_status_t EFIAPI efi_exit_boot_services(efi_handle_t image_handle,
 			list_del(&evt->link);
 	}
 
+	/* The OS expects to find the secondary CPUs off */
+	mp_job_stop();
+
 	if (!efi_st_keep_devices) {
 		bootm_disable_interrupts();
 		if (IS_ENABLED(CONFIG_USB_DEVICE))
@@ -0,0 +1,467 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Read-only index of the control devicetree
+ *
+ * Without a live tree, finding a node by path, phandle or compatible string
+ * means scanning the flat tree. The index is built with one pass over the
+ * tree and lives in a single allocation:
+ *
+ * - every node, in tree order, with its parent and a hash chain keyed on the
+ *   parent and the node name without its unit address
+ * - the phandles, sorted so they can be found by binary search
+ * - every compatible string of every node, with hash chains in tree order
+ *
+ * Nothing points into the index from outside, so it can be dropped at any
+ * time, after which lookups go back to libfdt.
+ *
+ * Copyright 2023 NXP
+ */
+
+#define LOG_CATEGORY	LOGC_DT
+
+#include <common.h>
+#include <fdt_index.h>
+#include <log.h>
+#include <malloc.h>
+#include <sort.h>
+#include <asm/global_data.h>
+#include <linux/log2.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Deepest nesting of nodes which can be indexed */
+#define FDT_INDEX_MAX_DEPTH	32
+
+/*
+ * Bumped by fdt_index_changed(). This is in the data section since the
+ * control devicetree may be changed before relocation, when BSS cannot be
+ * used.
+ */
+static uint fdt_index_gen __section(".data");
+
+/**
+ * struct fdt_index_node - A node in the index
+ *
+ * @offset: Offset of the node in the blob
+ * @parent: Index of the parent node, -1 for the root node
+ * @next_name: Next node in the same name hash chain, or -1
+ */
+struct fdt_index_node {
+	int offset;
+	int parent;
+	int next_name;
+};
+
+/**
+ * struct fdt_index_phandle - A node with a phandle
+ *
+ * @phandle: Phandle of the node
+ * @offset: Offset of the node in the blob
+ */
+struct fdt_index_phandle {
+	u32 phandle;
+	int offset;
+};
+
+/**
+ * struct fdt_index_compat - One compatible string of a node
+ *
+ * @node: Index of the node
+ * @str: Offset of the string in the blob
+ * @next: Next entry in the same hash chain, or -1
+ */
+struct fdt_index_compat {
+	int node;
+	int str;
+	int next;
+};
+
+/**
+ * struct fdt_index - Index of a devicetree blob
+ *
+ * @fdt: Blob which was indexed
+ * @size_dt_struct: Size of its structure block, to spot changes
+ * @size_dt_strings: Size of its strings block, to spot changes
+ * @gen: Value of fdt_index_gen when it was indexed, to spot other changes
+ * @aliases: Offset of the /aliases node, or -ve if none
+ * @nodes: All nodes, in tree order
+ * @node_count: Number of nodes
+ * @name_hash: First node in each name hash chain, or -1
+ * @name_mask: Number of name hash chains, less one
+ * @phandles: Nodes with a phandle, sorted by phandle then offset
+ * @phandle_count: Number of nodes with a phandle
+ * @compats: All compatible strings
+ * @compat_hash: First entry in each compatible hash chain, or -1
+ * @compat_mask: Number of compatible hash chains, less one
+ */
+struct fdt_index {
+	const void *fdt;
+	u32 size_dt_struct;
+	u32 size_dt_strings;
+	uint gen;
+	int aliases;
+	struct fdt_index_node *nodes;
+	int node_count;
+	int *name_hash;
+	uint name_mask;
+	struct fdt_index_phandle *phandles;
+	int phandle_count;
+	struct fdt_index_compat *compats;
+	int *compat_hash;
+	uint compat_mask;
+};
+
+/* FNV-1a of a string, mixed with a seed */
+static uint fdt_index_hash(uint seed, const char *str, int len)
+{
+	u32 hash = 2166136261U ^ seed;
+
+	while (len--) {
+		hash ^= (u8)*str++;
+		hash *= 16777619;
+	}
+
+	return hash;
+}
+
+static int fdt_index_phandle_cmp(const void *a, const void *b)
+{
+	const struct fdt_index_phandle *pa = a, *pb = b;
+
+	if (pa->phandle != pb->phandle)
+		return pa->phandle < pb->phandle ? -1 : 1;
+
+	return pa->offset - pb->offset;
+}
+
+/* Count the nodes, phandles and compatible strings in the tree */
+static int fdt_index_count(const void *fdt, int *nodesp, int *phandlesp,
+			   int *compatsp)
+{
+	const char *list, *end;
+	int offset, depth, len;
+
+	*nodesp = 0;
+	*phandlesp = 0;
+	*compatsp = 0;
+
+	/* The depth drops below zero at the end of the root node */
+	for (offset = 0, depth = 0; offset >= 0 && depth >= 0;
+	     offset = fdt_next_node(fdt, offset, &depth)) {
+		if (depth >= FDT_INDEX_MAX_DEPTH)
+			return -EINVAL;
+		(*nodesp)++;
+		if (fdt_get_phandle(fdt, offset))
+			(*phandlesp)++;
+		list = fdt_getprop(fdt, offset, "compatible", &len);
+		if (!list || len <= 0)
+			continue;
+		for (end = list + len; list < end; list += strlen(list) + 1) {
+			if (!memchr(list, '\0', end - list))
+				break;
+			(*compatsp)++;
+		}
+	}
+	if (offset < 0)
+		return -EINVAL;
+
+	return 0;
+}
+
+static void fdt_index_fill(struct fdt_index *idx)
+{
+	const void *fdt = idx->fdt;
+	int parents[FDT_INDEX_MAX_DEPTH];
+	struct fdt_index_compat *compat;
+	struct fdt_index_node *node;
+	int offset, depth, i, len;
+	int phandle_count = 0;
+	int compat_count = 0;
+	const char *name, *list, *end;
+	uint hash;
+	u32 phandle;
+
+	for (offset = 0, depth = 0, i = 0; i < idx->node_count;
+	     offset = fdt_next_node(fdt, offset, &depth), i++) {
+		node = &idx->nodes[i];
+		node->offset = offset;
+		node->parent = depth ? parents[depth - 1] : -1;
+		parents[depth] = i;
+
+		phandle = fdt_get_phandle(fdt, offset);
+		if (phandle) {
+			idx->phandles[phandle_count].phandle = phandle;
+			idx->phandles[phandle_count].offset = offset;
+			phandle_count++;
+		}
+
+		list = fdt_getprop(fdt, offset, "compatible", &len);
+		if (!list || len <= 0)
+			continue;
+		for (end = list + len; list < end; list += strlen(list) + 1) {
+			if (!memchr(list, '\0', end - list))
+				break;
+			compat = &idx->compats[compat_count++];
+			compat->node = i;
+			compat->str = list - (const char *)fdt;
+		}
+	}
+
+	/* Build the chains backwards, so that each lists nodes in tree order */
+	for (i = idx->node_count - 1; i >= 0; i--) {
+		node = &idx->nodes[i];
+		name = fdt_get_name(fdt, node->offset, NULL);
+		hash = fdt_index_hash(node->parent, name, strchrnul(name, '@') -
+				      name) & idx->name_mask;
+		node->next_name = idx->name_hash[hash];
+		idx->name_hash[hash] = i;
+	}
+	for (i = compat_count - 1; i >= 0; i--) {
+		compat = &idx->compats[i];
+		name = (const char *)fdt + compat->str;
+		hash = fdt_index_hash(0, name, strlen(name)) & idx->compat_mask;
+		compat->next = idx->compat_hash[hash];
+		idx->compat_hash[hash] = i;
+	}
+
+	qsort(idx->phandles, idx->phandle_count, sizeof(*idx->phandles),
+	      fdt_index_phandle_cmp);
+}
+
+int fdt_index_init(void)
+{
+	const void *fdt = gd->fdt_blob;
+	int node_count, phandle_count, compat_count;
+	uint name_size, compat_size;
+	struct fdt_index *idx;
+	size_t size;
+	void *ptr;
+	int ret;
+
+	fdt_index_invalidate();
+	if (!fdt || fdt_check_header(fdt))
+		return -EINVAL;
+	ret = fdt_index_count(fdt, &node_count, &phandle_count,
+			      &compat_count);
+	if (ret)
+		return log_msg_ret("cnt", ret);
+
+	name_size = __roundup_pow_of_two(node_count);
+	compat_size = __roundup_pow_of_two(max(compat_count, 1));
+	size = sizeof(*idx) +
+		node_count * sizeof(struct fdt_index_node) +
+		phandle_count * sizeof(struct fdt_index_phandle) +
+		compat_count * sizeof(struct fdt_index_compat) +
+		(name_size + compat_size) * sizeof(int);
+	idx = malloc(size);
+	if (!idx)
+		return log_msg_ret("mem", -ENOMEM);
+
+	/* Everything in the index is int-sized, so this keeps it aligned */
+	ptr = idx + 1;
+	idx->nodes = ptr;
+	ptr += node_count * sizeof(struct fdt_index_node);
+	idx->phandles = ptr;
+	ptr += phandle_count * sizeof(struct fdt_index_phandle);
+	idx->compats = ptr;
+	ptr += compat_count * sizeof(struct fdt_index_compat);
+	idx->name_hash = ptr;
+	ptr += name_size * sizeof(int);
+	idx->compat_hash = ptr;
+	memset(idx->name_hash, 0xff, (name_size + compat_size) * sizeof(int));
+
+	idx->fdt = fdt;
+	idx->size_dt_struct = fdt_size_dt_struct(fdt);
+	idx->size_dt_strings = fdt_size_dt_strings(fdt);
+	idx->gen = fdt_index_gen;
+	idx->aliases = fdt_path_offset(fdt, "/aliases");
+	idx->node_count = node_count;
+	idx->name_mask = name_size - 1;
+	idx->phandle_count = phandle_count;
+	idx->compat_mask = compat_size - 1;
+	fdt_index_fill(idx);
+	gd_set_fdt_index(idx);
+	log_debug("Indexed %d nodes, %d phandles, %d compatible strings in %zu bytes\n",
+		  node_count, phandle_count, compat_count, size);
+
+	return 0;
+}
+
+void fdt_index_invalidate(void)
+{
+	free(gd_fdt_index());
+	gd_set_fdt_index(NULL);
+}
+
+void fdt_index_changed(const void *fdt)
+{
+	if (fdt == gd->fdt_blob)
+		fdt_index_gen++;
+}
+
+/*
+ * Get the index if it is for @fdt and still matches it. If the control
+ * devicetree has moved, changed size or been written to, the index is
+ * dropped.
+ */
+static struct fdt_index *fdt_index_get(const void *fdt)
+{
+	struct fdt_index *idx = gd_fdt_index();
+
+	if (!idx)
+		return NULL;
+	if (idx->fdt == fdt && idx->gen == fdt_index_gen &&
+	    fdt_size_dt_struct(fdt) == idx->size_dt_struct &&
+	    fdt_size_dt_strings(fdt) == idx->size_dt_strings)
+		return idx;
+	if (idx->fdt == fdt || fdt == gd->fdt_blob) {
+		log_debug("Control devicetree changed, dropping index\n");
+		fdt_index_invalidate();
+	}
+
+	return NULL;
+}
+
+/* Find a node in the index by its offset */
+static int fdt_index_find(struct fdt_index *idx, int offset)
+{
+	int lo = 0, hi = idx->node_count - 1, mid;
+
+	while (lo <= hi) {
+		mid = (lo + hi) / 2;
+		if (idx->nodes[mid].offset == offset)
+			return mid;
+		if (idx->nodes[mid].offset < offset)
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+
+	return -FDT_ERR_BADOFFSET;
+}
+
+/* Find a child by name, matching as fdt_subnode_offset_namelen() does */
+static int fdt_index_subnode(struct fdt_index *idx, int parent,
+			     const char *name, int namelen)
+{
+	const char *at = memchr(name, '@', namelen);
+	struct fdt_index_node *node;
+	const char *node_name;
+	uint hash;
+	int i;
+
+	hash = fdt_index_hash(parent, name, at ? at - name : namelen);
+	for (i = idx->name_hash[hash & idx->name_mask]; i >= 0;
+	     i = node->next_name) {
+		node = &idx->nodes[i];
+		if (node->parent != parent)
+			continue;
+		node_name = fdt_get_name(idx->fdt, node->offset, NULL);
+		if (strncmp(node_name, name, namelen))
+			continue;
+		if (!node_name[namelen] ||
+		    (!at && node_name[namelen] == '@'))
+			return i;
+	}
+
+	return -FDT_ERR_NOTFOUND;
+}
+
+int fdt_index_path_offset(const void *fdt, const char *path)
+{
+	struct fdt_index *idx = fdt_index_get(fdt);
+	const char *end, *p, *q;
+	int node = 0, offset;
+
+	if (!idx)
+		return fdt_path_offset(fdt, path);
+
+	end = path + strlen(path);
+	p = path;
+	if (*path != '/') {
+		q = strchrnul(path, '/');
+		if (idx->aliases < 0)
+			return -FDT_ERR_BADPATH;
+		p = fdt_getprop_namelen(fdt, idx->aliases, path, q - path,
+					NULL);
+		if (!p)
+			return -FDT_ERR_BADPATH;
+		offset = fdt_index_path_offset(fdt, p);
+		if (offset < 0)
+			return offset;
+		node = fdt_index_find(idx, offset);
+		if (node < 0)
+			return node;
+		p = q;
+	}
+
+	while (p < end) {
+		while (*p == '/')
+			p++;
+		if (!*p)
+			break;
+		q = strchrnul(p, '/');
+		node = fdt_index_subnode(idx, node, p, q - p);
+		if (node < 0)
+			return node;
+		p = q;
+	}
+
+	return idx->nodes[node].offset;
+}
+
+int fdt_index_node_offset_by_phandle(const void *fdt, uint32_t phandle)
+{
+	struct fdt_index *idx = fdt_index_get(fdt);
+	int lo, hi, mid;
+
+	if (!idx)
+		return fdt_node_offset_by_phandle(fdt, phandle);
+	if (!phandle || phandle == (u32)-1)
+		return -FDT_ERR_BADPHANDLE;
+
+	/* Find the first entry, in case the phandle is used twice */
+	lo = 0;
+	hi = idx->phandle_count;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (idx->phandles[mid].phandle < phandle)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo < idx->phandle_count && idx->phandles[lo].phandle == phandle)
+		return idx->phandles[lo].offset;
+
+	return -FDT_ERR_NOTFOUND;
+}
+
+int fdt_index_node_offset_by_compatible(const void *fdt, int startoffset,
+					const char *compat)
+{
+	struct fdt_index *idx = fdt_index_get(fdt);
+	struct fdt_index_compat *entry;
+	int start = -1;
+	uint hash;
+	int i;
+
+	if (!idx)
+		return fdt_node_offset_by_compatible(fdt, startoffset, compat);
+	if (startoffset >= 0) {
+		start = fdt_index_find(idx, startoffset);
+		if (start < 0)
+			return fdt_node_offset_by_compatible(fdt, startoffset,
+							     compat);
+	}
+
+	hash = fdt_index_hash(0, compat, strlen(compat));
+	for (i = idx->compat_hash[hash & idx->compat_mask]; i >= 0;
+	     i = entry->next) {
+		entry = &idx->compats[i];
+		if (entry->node > start &&
+		    !strcmp((const char *)fdt + entry->str, compat))
+			return idx->nodes[entry->node].offset;
+	}
+
+	return -FDT_ERR_NOTFOUND;
+}
@@ -16,6 +16,7 @@
 #include <env.h>
 #include <errno.h>
 #include <fdtdec.h>
+#include <fdt_index.h>
 #include <fdt_support.h>
 #include <gzip.h>
 #include <mapmem.h>
@@ -643,7 +644,8 @@ int fdtdec_lookup_phandle(const void *blob, int node, const char *prop_name)
 	if (!phandle)
 		return -FDT_ERR_NOTFOUND;
 
-	lookup = fdt_node_offset_by_phandle(blob, fdt32_to_cpu(*phandle));
+	lookup = fdt_index_node_offset_by_phandle(blob,
+						  fdt32_to_cpu(*phandle));
 	return lookup;
 }
 
@@ -774,8 +776,8 @@ int fdtdec_parse_phandle_with_args(const void *blob, int src_node,
 			 * below.
 			 */
 			if (cells_name || cur_index == index) {
-				node = fdt_node_offset_by_phandle(blob,
-								  phandle);
+				node = fdt_index_node_offset_by_phandle(
+						blob, phandle);
 				if (node < 0) {
 					debug("%s: could not find phandle\n",
 					      fdt_get_name(blob, src_node,
@@ -1259,6 +1261,7 @@ int fdtdec_set_ethernet_mac_address(void *fdt, const u8 *mac, size_t size)
 		return -ENOENT;
 	}
 
+	fdt_index_changed(fdt);
 	err = fdt_setprop_inplace(fdt, offset, "local-mac-address", mac, size);
 	if (err < 0)
 		return err;
@@ -1311,6 +1314,8 @@ int fdtdec_add_reserved_memory(void *blob, const char *basename,
 	fdt_size_t size;
 	char name[64];
 
+	fdt_index_changed(blob);
+
 	/* create an empty /reserved-memory node if one doesn't exist */
 	parent = fdt_path_offset(blob, "/reserved-memory");
 	if (parent < 0) {
@@ -58,7 +58,9 @@ static lbaint_t write_sparse_chunk_raw(struct sparse_storage *info,
 	lbaint_t n = blkcnt, write_blks, blks = 0, aligned_buf_blks = 100;
 	uint32_t *aligned_buf = NULL;
 
-	if (CONFIG_IS_ENABLED(SYS_DCACHE_OFF)) {
+	/* There is no need to copy data which is suitable for DMA already */
+	if (CONFIG_IS_ENABLED(SYS_DCACHE_OFF) ||
+	    IS_ALIGNED((ulong)data, ARCH_DMA_MINALIGN)) {
 		write_blks = info->write(info, blk, n, data);
 		if (write_blks < n)
 			goto write_fail;
@@ -106,6 +108,51 @@ write_fail:
 	return -1;
 }
 
+static lbaint_t write_sparse_chunk_fill(struct sparse_storage *info,
+					lbaint_t blk, lbaint_t blkcnt,
+					uint32_t fill_val, char *response)
+{
+	int fill_buf_num_blks = CONFIG_IMAGE_SPARSE_FILLBUF_SIZE / info->blksz;
+	uint32_t *fill_buf;
+	lbaint_t blks, total = 0;
+	int i;
+	int j;
+
+	fill_buf = (uint32_t *)
+		   memalign(ARCH_DMA_MINALIGN,
+			    ROUNDUP(info->blksz * fill_buf_num_blks,
+				    ARCH_DMA_MINALIGN));
+	if (!fill_buf) {
+		info->mssg("Malloc failed for: CHUNK_TYPE_FILL", response);
+		return -1;
+	}
+
+	for (i = 0;
+	     i < (info->blksz * fill_buf_num_blks / sizeof(fill_val));
+	     i++)
+		fill_buf[i] = fill_val;
+
+	for (i = 0; i < blkcnt;) {
+		j = blkcnt - i;
+		if (j > fill_buf_num_blks)
+			j = fill_buf_num_blks;
+		blks = info->write(info, blk + total, j, fill_buf);
+		/* blks might be > j (eg. NAND bad-blocks) */
+		if (blks < j) {
+			printf("%s: %s " LBAFU " [%d]\n", __func__,
+			       "Write failed, block #", blk + total, j);
+			info->mssg("flash write failure", response);
+			free(fill_buf);
+			return -1;
+		}
+		total += blks;
+		i += j;
+	}
+	free(fill_buf);
+
+	return total;
+}
+
 int write_sparse_image(struct sparse_storage *info,
 		       const char *part_name, void *data, char *response)
 {
@@ -116,16 +163,10 @@ int write_sparse_image(struct sparse_storage *info,
 	unsigned int chunk;
 	unsigned int offset;
 	uint64_t chunk_data_sz;
-	uint32_t *fill_buf = NULL;
 	uint32_t fill_val;
 	sparse_header_t *sparse_header;
 	chunk_header_t *chunk_header;
 	uint32_t total_blocks = 0;
-	int fill_buf_num_blks;
-	int i;
-	int j;
-
-	fill_buf_num_blks = CONFIG_IMAGE_SPARSE_FILLBUF_SIZE / info->blksz;
 
 	/* Read and skip over sparse image header */
 	sparse_header = (sparse_header_t *)data;
@@ -211,7 +252,7 @@ int write_sparse_image(struct sparse_storage *info,
 
 			blks = write_sparse_chunk_raw(info, blk, blkcnt,
 						      data, response);
-			if (blks < 0)
+			if (IS_ERR_VALUE(blks))
 				return -1;
 
 			blk += blks;
@@ -227,26 +268,9 @@ int write_sparse_image(struct sparse_storage *info,
 				return -1;
 			}
 
-			fill_buf = (uint32_t *)
-				   memalign(ARCH_DMA_MINALIGN,
-					    ROUNDUP(
-						info->blksz * fill_buf_num_blks,
-						ARCH_DMA_MINALIGN));
-			if (!fill_buf) {
-				info->mssg("Malloc failed for: CHUNK_TYPE_FILL",
-					   response);
-				return -1;
-			}
-
 			fill_val = *(uint32_t *)data;
 			data = (char *)data + sizeof(uint32_t);
 
-			for (i = 0;
-			     i < (info->blksz * fill_buf_num_blks /
-				  sizeof(fill_val));
-			     i++)
-				fill_buf[i] = fill_val;
-
 			if (blk + blkcnt > info->start + info->size) {
 				printf(
 				    "%s: Request would exceed partition size!\n",
@@ -256,29 +280,15 @@ int write_sparse_image(struct sparse_storage *info,
 				return -1;
 			}
 
-			for (i = 0; i < blkcnt;) {
-				j = blkcnt - i;
-				if (j > fill_buf_num_blks)
-					j = fill_buf_num_blks;
-				blks = info->write(info, blk, j, fill_buf);
-				/* blks might be > j (eg. NAND bad-blocks) */
-				if (blks < j) {
-					printf("%s: %s " LBAFU " [%d]\n",
-					       __func__,
-					       "Write failed, block #",
-					       blk, j);
-					info->mssg("flash write failure",
-						   response);
-					free(fill_buf);
-					return -1;
-				}
-				blk += blks;
-				i += j;
-			}
+			blks = write_sparse_chunk_fill(info, blk, blkcnt,
+						       fill_val, response);
+			if (IS_ERR_VALUE(blks))
+				return -1;
+
+			blk += blks;
 			bytes_written += ((u64)blkcnt) * info->blksz;
 			total_blocks += DIV_ROUND_UP_ULL(chunk_data_sz,
 							 sparse_header->blk_sz);
-			free(fill_buf);
 			break;
 
 		case CHUNK_TYPE_DONT_CARE:
@@ -316,3 +326,312 @@ int write_sparse_image(struct sparse_storage *info,
 
 	return 0;
 }
+
+/* Flush raw data gathered in the buffer to storage */
+static int sparse_stream_flush(struct sparse_stream *ss, char *response)
+{
+	struct sparse_storage *info = ss->info;
+	lbaint_t blkcnt, blks;
+
+	if (!ss->buf_len)
+		return 0;
+	blkcnt = ss->buf_len / info->blksz;
+	blks = write_sparse_chunk_raw(info, ss->buf_blk, blkcnt, ss->buf,
+				      response);
+	if (IS_ERR_VALUE(blks))
+		return -1;
+
+	/* More blocks are used if there are NAND bad-blocks */
+	ss->blk += blks - blkcnt;
+	ss->buf_blk += blks;
+	ss->buf_len = 0;
+
+	return 0;
+}
+
+/*
+ * Gather a header of @total bytes, keeping the first @size bytes in @hdr.
+ * Returns the number of bytes used from @data.
+ */
+static size_t sparse_stream_hdr(struct sparse_stream *ss, void *hdr,
+				uint size, uint total, const char *data,
+				size_t len)
+{
+	size_t n = min_t(size_t, len, total - ss->pos);
+
+	if (ss->pos < size)
+		memcpy(hdr + ss->pos, data, min_t(size_t, n, size - ss->pos));
+	ss->pos += n;
+
+	return n;
+}
+
+static int sparse_stream_check(struct sparse_stream *ss, char *response)
+{
+	sparse_header_t *sparse_header = &ss->header;
+	struct sparse_storage *info = ss->info;
+	unsigned int offset;
+
+	if (!is_sparse_image(sparse_header) ||
+	    sparse_header->file_hdr_sz < sizeof(sparse_header_t) ||
+	    sparse_header->chunk_hdr_sz < sizeof(chunk_header_t)) {
+		info->mssg("not a sparse image", response);
+		return -1;
+	}
+
+	div_u64_rem(sparse_header->blk_sz, info->blksz, &offset);
+	if (offset) {
+		printf("%s: Sparse image block size issue [%u]\n",
+		       __func__, sparse_header->blk_sz);
+		info->mssg("sparse image block size issue", response);
+		return -1;
+	}
+
+	puts("Flashing Sparse Image\n");
+
+	return 0;
+}
+
+/* Move on to the next chunk header, if there is one */
+static void sparse_stream_next_chunk(struct sparse_stream *ss)
+{
+	ss->pos = 0;
+	if (ss->chunk_num == ss->header.total_chunks)
+		ss->state = SPARSE_STREAM_DONE;
+	else
+		ss->state = SPARSE_STREAM_CHUNK_HDR;
+}
+
+static void sparse_stream_chunk_done(struct sparse_stream *ss)
+{
+	ss->chunk_num++;
+	sparse_stream_next_chunk(ss);
+}
+
+/* Deal with a chunk header, once it has all been received */
+static int sparse_stream_chunk(struct sparse_stream *ss, char *response)
+{
+	sparse_header_t *sparse_header = &ss->header;
+	chunk_header_t *chunk_header = &ss->chunk;
+	struct sparse_storage *info = ss->info;
+	uint64_t chunk_data_sz;
+	lbaint_t blkcnt;
+
+	if (chunk_header->chunk_type != CHUNK_TYPE_RAW) {
+		debug("=== Chunk Header ===\n");
+		debug("chunk_type: 0x%x\n", chunk_header->chunk_type);
+		debug("chunk_data_sz: 0x%x\n", chunk_header->chunk_sz);
+		debug("total_size: 0x%x\n", chunk_header->total_sz);
+	}
+
+	chunk_data_sz = ((u64)sparse_header->blk_sz) * chunk_header->chunk_sz;
+	blkcnt = DIV_ROUND_UP_ULL(chunk_data_sz, info->blksz);
+	ss->blkcnt = blkcnt;
+	ss->pos = 0;
+	switch (chunk_header->chunk_type) {
+	case CHUNK_TYPE_RAW:
+		if (chunk_header->total_sz !=
+		    (sparse_header->chunk_hdr_sz + chunk_data_sz)) {
+			info->mssg("Bogus chunk size for chunk type Raw",
+				   response);
+			return -1;
+		}
+		break;
+	case CHUNK_TYPE_FILL:
+		if (chunk_header->total_sz !=
+		    (sparse_header->chunk_hdr_sz + sizeof(uint32_t))) {
+			info->mssg("Bogus chunk size for chunk type FILL",
+				   response);
+			return -1;
+		}
+		break;
+	case CHUNK_TYPE_DONT_CARE:
+		if (sparse_stream_flush(ss, response))
+			return -1;
+		ss->blk += info->reserve(info, ss->blk, blkcnt);
+		ss->total_blocks += chunk_header->chunk_sz;
+		sparse_stream_chunk_done(ss);
+		return 0;
+	case CHUNK_TYPE_CRC32:
+		if (chunk_header->total_sz != sparse_header->chunk_hdr_sz) {
+			info->mssg("Bogus chunk size for chunk type Dont Care",
+				   response);
+			return -1;
+		}
+		ss->total_blocks += chunk_header->chunk_sz;
+		ss->left = chunk_data_sz;
+		ss->state = SPARSE_STREAM_SKIP;
+		if (!ss->left)
+			sparse_stream_chunk_done(ss);
+		return 0;
+	default:
+		printf("%s: Unknown chunk type: %x\n", __func__,
+		       chunk_header->chunk_type);
+		info->mssg("Unknown chunk type", response);
+		return -1;
+	}
+
+	if (ss->blk + blkcnt > info->start + info->size) {
+		printf("%s: Request would exceed partition size!\n", __func__);
+		info->mssg("Request would exceed partition size!", response);
+		return -1;
+	}
+
+	ss->bytes_written += ((u64)blkcnt) * info->blksz;
+	if (chunk_header->chunk_type == CHUNK_TYPE_FILL) {
+		ss->total_blocks += DIV_ROUND_UP_ULL(chunk_data_sz,
+						     sparse_header->blk_sz);
+		ss->state = SPARSE_STREAM_FILL;
+		return 0;
+	}
+
+	/* Raw data carries on from any raw data already in the buffer */
+	if (!ss->buf_len)
+		ss->buf_blk = ss->blk;
+	ss->blk += blkcnt;
+	ss->total_blocks += chunk_header->chunk_sz;
+	ss->left = chunk_data_sz;
+	ss->state = SPARSE_STREAM_RAW;
+	if (!ss->left)
+		sparse_stream_chunk_done(ss);
+
+	return 0;
+}
+
+/* Buffer raw data, writing it out whenever the buffer is full */
+static int sparse_stream_raw(struct sparse_stream *ss, const char *data,
+			     size_t len, char *response)
+{
+	size_t n;
+
+	while (len) {
+		n = min(len, ss->buf_size - ss->buf_len);
+		memcpy(ss->buf + ss->buf_len, data, n);
+		ss->buf_len += n;
+		data += n;
+		len -= n;
+		if (ss->buf_len == ss->buf_size &&
+		    sparse_stream_flush(ss, response))
+			return -1;
+	}
+
+	return 0;
+}
+
+int sparse_stream_init(struct sparse_stream *ss, struct sparse_storage *info,
+		       void *buf, size_t size)
+{
+	if (!info->mssg)
+		info->mssg = default_log;
+
+	memset(ss, '\0', sizeof(*ss));
+	ss->info = info;
+	ss->buf = buf;
+	ss->buf_size = rounddown(size, info->blksz);
+	if (!ss->buf_size)
+		return -EINVAL;
+	ss->blk = info->start;
+	ss->state = SPARSE_STREAM_FILE_HDR;
+
+	return 0;
+}
+
+int sparse_stream_write(struct sparse_stream *ss, const void *data,
+			size_t len, char *response)
+{
+	const char *ptr = data;
+	lbaint_t blks;
+	uint total;
+	size_t n;
+
+	while (len) {
+		switch (ss->state) {
+		case SPARSE_STREAM_FILE_HDR:
+			/* The header may be longer than we expect */
+			total = sizeof(ss->header);
+			if (ss->pos >= total)
+				total = ss->header.file_hdr_sz;
+			n = sparse_stream_hdr(ss, &ss->header,
+					      sizeof(ss->header), total, ptr,
+					      len);
+			if (ss->pos == sizeof(ss->header) &&
+			    sparse_stream_check(ss, response))
+				return -1;
+			if (ss->pos == max_t(uint, sizeof(ss->header),
+					     ss->header.file_hdr_sz))
+				sparse_stream_next_chunk(ss);
+			break;
+		case SPARSE_STREAM_CHUNK_HDR:
+			n = sparse_stream_hdr(ss, &ss->chunk,
+					      sizeof(ss->chunk),
+					      ss->header.chunk_hdr_sz,
+					      ptr, len);
+			if (ss->pos == ss->header.chunk_hdr_sz &&
+			    sparse_stream_chunk(ss, response))
+				return -1;
+			break;
+		case SPARSE_STREAM_RAW:
+			n = min_t(u64, len, ss->left);
+			if (sparse_stream_raw(ss, ptr, n, response))
+				return -1;
+			ss->left -= n;
+			if (!ss->left)
+				sparse_stream_chunk_done(ss);
+			break;
+		case SPARSE_STREAM_FILL:
+			n = sparse_stream_hdr(ss, &ss->fill_val,
+					      sizeof(ss->fill_val),
+					      sizeof(ss->fill_val), ptr, len);
+			if (ss->pos < sizeof(ss->fill_val))
+				break;
+			if (sparse_stream_flush(ss, response))
+				return -1;
+			blks = write_sparse_chunk_fill(ss->info, ss->blk,
+						       ss->blkcnt, ss->fill_val,
+						       response);
+			if (IS_ERR_VALUE(blks))
+				return -1;
+			ss->blk += blks;
+			sparse_stream_chunk_done(ss);
+			break;
+		case SPARSE_STREAM_SKIP:
+			n = min_t(u64, len, ss->left);
+			ss->left -= n;
+			if (!ss->left)
+				sparse_stream_chunk_done(ss);
+			break;
+		case SPARSE_STREAM_DONE:
+		default:
+			/* Ignore anything after the last chunk */
+			n = len;
+			break;
+		}
+		ptr += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+int sparse_stream_finish(struct sparse_stream *ss, const char *part_name,
+			 char *response)
+{
+	if (ss->state != SPARSE_STREAM_DONE) {
+		ss->info->mssg("sparse image is incomplete", response);
+		return -1;
+	}
+	if (sparse_stream_flush(ss, response))
+		return -1;
+
+	debug("Wrote %d blocks, expected to write %d blocks\n",
+	      ss->total_blocks, ss->header.total_blks);
+	printf("........ wrote %llu bytes to '%s'\n", ss->bytes_written,
+	       part_name);
+
+	if (ss->total_blocks != ss->header.total_blks) {
+		ss->info->mssg("sparse image write failure", response);
+		return -1;
+	}
+
+	return 0;
+}
@@ -14,7 +14,7 @@
 **************************************/
 
 /* customized version of memcpy, which may overwrite up to 7 bytes beyond dstEnd */
-static void LZ4_wildCopy(void* dstPtr, const void* srcPtr, void* dstEnd)
+FORCE_INLINE void LZ4_wildCopy(void* dstPtr, const void* srcPtr, void* dstEnd)
 {
     BYTE* d = (BYTE*)dstPtr;
     const BYTE* s = (const BYTE*)srcPtr;
@@ -22,6 +22,57 @@ static void LZ4_wildCopy(void* dstPtr, const void* srcPtr, void* dstEnd)
     do { LZ4_copy8(d,s); d+=8; s+=8; } while (d<e);
 }
 
+/* as LZ4_wildCopy(), 16 bytes at a time, so it may overwrite up to 15 bytes beyond dstEnd.
+ * A source behind the destination must be at least 16 bytes behind. */
+FORCE_INLINE void LZ4_wildCopy16(void* dstPtr, const void* srcPtr, void* dstEnd)
+{
+    BYTE* d = (BYTE*)dstPtr;
+    const BYTE* s = (const BYTE*)srcPtr;
+    BYTE* e = (BYTE*)dstEnd;
+    do { LZ4_copy16(d,s); d+=16; s+=16; } while (d<e);
+}
+
+/* adjustments which step an overlapping match source (offset < 8) 8 bytes back */
+static const size_t dec32table[] = {4, 1, 2, 1, 4, 4, 4, 4};
+static const size_t dec64table[] = {0, 0, 0, (size_t)-1, 0, 1, 2, 3};
+
+/* copy a match which overlaps its own output, offset bytes back, up to dstEnd.
+ * It may overwrite up to 7 bytes beyond dstEnd. Offsets 1, 2 and 4 repeat an
+ * 8-byte pattern; others copy 8 bytes at a time once the source is 8 back. */
+FORCE_INLINE void LZ4_copyOverlap(BYTE* op, const BYTE* match, BYTE* const dstEnd, const size_t offset)
+{
+    BYTE v[8];
+
+    switch (offset)
+    {
+    case 1:
+        v[0] = v[1] = v[2] = v[3] = v[4] = v[5] = v[6] = v[7] = match[0];
+        break;
+    case 2:
+        v[0] = v[2] = v[4] = v[6] = match[0];
+        v[1] = v[3] = v[5] = v[7] = match[1];
+        break;
+    case 4:
+        LZ4_copy4(v, match);
+        LZ4_copy4(v+4, match);
+        break;
+    default:
+        if (offset < 8)
+        {
+            op[0] = match[0];
+            op[1] = match[1];
+            op[2] = match[2];
+            op[3] = match[3];
+            match += dec32table[offset];
+            LZ4_copy4(op+4, match);
+            op += 8; match -= dec64table[offset];
+        } else { LZ4_copy8(op, match); op+=8; match+=8; }
+        if (op < dstEnd) LZ4_wildCopy(op, match, dstEnd);
+        return;
+    }
+    do { LZ4_copy8(op, v); op+=8; } while (op<dstEnd);
+}
+
 
 /**************************************
 *  Common Constants
@@ -74,7 +125,7 @@ FORCE_INLINE int LZ4_decompress_generic(
                  int partialDecoding,    /* full, partial */
                  int targetOutputSize,   /* only used if partialDecoding==partial */
                  int dict,               /* noDict, withPrefix64k, usingExtDict */
-                 const BYTE* const lowPrefix,  /* == dest if dict == noDict */
+                 const BYTE* const lowPrefix,  /* start of history: dest, or earlier output for linked blocks, if dict == noDict */
                  const BYTE* const dictStart,  /* only if dict==usingExtDict */
                  const size_t dictSize         /* note : = 0 if noDict */
                  )
@@ -90,8 +141,10 @@ FORCE_INLINE int LZ4_decompress_generic(
     const BYTE* const lowLimit = lowPrefix - dictSize;
 
     const BYTE* const dictEnd = (const BYTE*)dictStart + dictSize;
-    const size_t dec32table[] = {4, 1, 2, 1, 4, 4, 4, 4};
-    const size_t dec64table[] = {0, 0, 0, (size_t)-1, 0, 1, 2, 3};
+
+    /* limits for the shortcut, which copies up to 14 literals and an 18-byte match in fixed-size pieces */
+    const BYTE* const shortiend = iend - 14 /*maxLL*/ - 2 /*offset*/;
+    BYTE* const shortoend = oend - 14 /*maxLL*/ - 18 /*maxML*/;
 
     const int safeDecode = (endOnInput==endOnInputSize);
     const int checkOffset = ((safeDecode) && (dictSize < (int)(64 KB)));
@@ -110,9 +163,34 @@ FORCE_INLINE int LZ4_decompress_generic(
         size_t length;
         const BYTE* match;
 
-        /* get literal length */
         token = *ip++;
-        if ((length=(token>>ML_BITS)) == RUN_MASK)
+        length = token>>ML_BITS;
+
+        /* shortcut for the most common case: a short literal run, then a short match
+           at least 8 bytes back, with enough room in both buffers to copy them whole */
+        if ((endOnInput) && (length != RUN_MASK) && likely((ip < shortiend) & (op <= shortoend)))
+        {
+            LZ4_copy16(op, ip);
+            op += length; ip += length;
+
+            length = token & ML_MASK;
+            match = op - LZ4_readLE16(ip); ip+=2;
+            if ((length != ML_MASK) && ((size_t)(op-match) >= 8) && ((!checkOffset) || (match >= lowLimit)))
+            {
+                LZ4_copy8(op, match);
+                LZ4_copy8(op+8, match+8);
+                op[16] = match[16];
+                op[17] = match[17];
+                op += length + MINMATCH;
+                continue;
+            }
+
+            /* the match does not fit the shortcut, but the offset is already decoded */
+            goto _copy_match;
+        }
+
+        /* get literal length */
+        if (length == RUN_MASK)
         {
             unsigned s;
             do
@@ -145,11 +223,15 @@ FORCE_INLINE int LZ4_decompress_generic(
             op += length;
             break;     /* Necessarily EOF, due to parsing restrictions */
         }
-        LZ4_wildCopy(op, ip, cpy);
+        if ((cpy <= oend-16) && (ip+length <= iend-16))
+            LZ4_wildCopy16(op, ip, cpy);
+        else
+            LZ4_wildCopy(op, ip, cpy);
         ip += length; op = cpy;
 
         /* get offset */
         match = cpy - LZ4_readLE16(ip); ip+=2;
+_copy_match:
         if ((checkOffset) && (unlikely(match < lowLimit))) goto _output_error;   /* Error : offset outside destination buffer */
 
         /* get matchlength */
@@ -202,6 +284,15 @@ FORCE_INLINE int LZ4_decompress_generic(
 
         /* copy repeated sequence */
         cpy = op + length;
+        if (likely(cpy <= oend-16))
+        {
+            if (likely((size_t)(op-match) >= 16))
+                LZ4_wildCopy16(op, match, cpy);
+            else
+                LZ4_copyOverlap(op, match, cpy, op-match);
+            op = cpy;
+            continue;
+        }
         if (unlikely((op-match)<8))
         {
             const size_t dec64 = dec64table[op-match];
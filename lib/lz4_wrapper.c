@@ -6,22 +6,39 @@
 #include <common.h>
 #include <compiler.h>
 #include <image.h>
+#include <malloc.h>
+#include <mp_job.h>
 #include <linux/kernel.h>
+#include <linux/sizes.h>
 #include <linux/types.h>
+#include <linux/xxhash.h>
 #include <asm/unaligned.h>
 #include <u-boot/lz4.h>
 
-static u16 LZ4_readLE16(const void *src)
+static __always_inline u16 LZ4_readLE16(const void *src)
 {
 	return get_unaligned_le16(src);
 }
-static void LZ4_copy4(void *dst, const void *src)
+/*
+ * Fixed-size copies are left to the compiler, which makes them single loads
+ * and stores where the architecture allows unaligned access and the build
+ * does not forbid it (-mstrict-align, -mno-unaligned-access)
+ */
+static __always_inline void LZ4_copy4(void *dst, const void *src)
 {
-	put_unaligned(get_unaligned((const u32 *)src), (u32 *)dst);
+	__builtin_memcpy(dst, src, 4);
 }
-static void LZ4_copy8(void *dst, const void *src)
+static __always_inline void LZ4_copy8(void *dst, const void *src)
 {
-	put_unaligned(get_unaligned((const u64 *)src), (u64 *)dst);
+	__builtin_memcpy(dst, src, 8);
+}
+/* Both halves are loaded before either is stored */
+static __always_inline void LZ4_copy16(void *dst, const void *src)
+{
+	u64 v[2];
+
+	__builtin_memcpy(v, src, 16);
+	__builtin_memcpy(dst, v, 16);
 }
 
 typedef  uint8_t BYTE;
@@ -32,99 +49,377 @@ typedef uint64_t U64;
 
 #define FORCE_INLINE static inline __attribute__((always_inline))
 
-/* lz4.c is unaltered (except removing unrelated code) from github.com/Cyan4973/lz4. */
+/*
+ * lz4.c is from github.com/Cyan4973/lz4 with unrelated code removed. The
+ * shortcut for short sequences and the wider match copies follow later
+ * releases of the same decoder.
+ */
 #include "lz4.c"	/* #include for inlining, do not link! */
 
 #define LZ4F_BLOCKUNCOMPRESSED_FLAG 0x80000000U
+#define LZ4F_SKIPPABLE_MAGIC	0x184d2a50
+#define LZ4F_SKIPPABLE_MASK	0xfffffff0
 
-int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn)
+/* Frame descriptor flags */
+#define LZ4F_VERSION(flags)		(((flags) >> 6) & 0x3)
+#define LZ4F_INDEPENDENT_BLOCKS		BIT(5)
+#define LZ4F_BLOCK_CHECKSUM		BIT(4)
+#define LZ4F_CONTENT_SIZE		BIT(3)
+#define LZ4F_CONTENT_CHECKSUM		BIT(2)
+#define LZ4F_DICT_ID			BIT(0)
+
+/**
+ * struct lz4_frame - An LZ4 frame whose header and block list have been read
+ *
+ * @blocks: First block header
+ * @end: End of the frame, after the end mark and any content checksum
+ * @block_max: Largest output of a block
+ * @count: Number of blocks
+ * @flags: Frame descriptor flags (LZ4F_...)
+ * @checksum: Expected xxh32 of the content, if LZ4F_CONTENT_CHECKSUM is set
+ */
+struct lz4_frame {
+	const void *blocks;
+	const void *end;
+	size_t block_max;
+	int count;
+	u8 flags;
+	u32 checksum;
+};
+
+/*
+ * Read the frame header at @in and walk the block headers, so that the frame
+ * is known to lie within the input before anything is written. In-place
+ * decompression overwrites the input as it goes, so anything needed later,
+ * like the content checksum, is read here.
+ */
+static int lz4_frame_scan(const void *in, const void *end,
+			  struct lz4_frame *fr)
 {
-	const void *end = dst + *dstn;
-	const void *in = src;
-	void *out = dst;
-	int has_block_checksum;
-	int ret;
-	*dstn = 0;
+	const void *pos = in;
+	u32 block_size;
+	u8 block_desc;
+
+	if (end - pos < sizeof(u32) + 3 * sizeof(u8))
+		return -EINVAL;	/* input overrun */
+	if (get_unaligned_le32(pos) != LZ4F_MAGIC)
+		return -EPROTONOSUPPORT;	/* unknown format */
+	pos += sizeof(u32);
+	fr->flags = *(u8 *)pos++;
+	block_desc = *(u8 *)pos++;
 
-	{ /* With in-place decompression the header may become invalid later. */
-		u32 magic;
-		u8 flags, version, independent_blocks, has_content_size;
-		u8 block_desc;
+	if (LZ4F_VERSION(fr->flags) != 1)
+		return -EPROTONOSUPPORT;	/* unknown format */
+	if ((fr->flags & 0x02) || (block_desc & 0x8f))
+		return -EINVAL;	/* reserved bits must be zero */
+	if (fr->flags & LZ4F_DICT_ID)
+		return -EPROTONOSUPPORT;	/* no dictionaries here */
+	if (((block_desc >> 4) & 0x7) < 4)
+		return -EINVAL;	/* invalid block maximum size */
+	fr->block_max = 1 << (8 + 2 * ((block_desc >> 4) & 0x7));
 
-		if (srcn < sizeof(u32) + 3*sizeof(u8))
+	if (fr->flags & LZ4F_CONTENT_SIZE) {
+		if (end - pos < sizeof(u64) + sizeof(u8))
 			return -EINVAL;	/* input overrun */
+		pos += sizeof(u64);
+	}
+	if (CONFIG_IS_ENABLED(LZ4_CHECKSUM) &&
+	    *(u8 *)pos != ((xxh32(in + sizeof(u32), pos - in - sizeof(u32),
+				  0) >> 8) & 0xff))
+		return -EBADMSG;	/* header checksum */
+	pos += sizeof(u8);
+	fr->blocks = pos;
 
-		magic = get_unaligned_le32(in);
-		in += sizeof(u32);
-		flags = *(u8 *)in;
-		in += sizeof(u8);
-		block_desc = *(u8 *)in;
-		in += sizeof(u8);
-
-		version = (flags >> 6) & 0x3;
-		independent_blocks = (flags >> 5) & 0x1;
-		has_block_checksum = (flags >> 4) & 0x1;
-		has_content_size = (flags >> 3) & 0x1;
-
-		/* We assume there's always only a single, standard frame. */
-		if (magic != LZ4F_MAGIC || version != 1)
-			return -EPROTONOSUPPORT;	/* unknown format */
-		if ((flags & 0x03) || (block_desc & 0x8f))
-			return -EINVAL;	/* reserved bits must be zero */
-		if (!independent_blocks)
-			return -EPROTONOSUPPORT; /* we can't support this yet */
-
-		if (has_content_size) {
-			if (srcn < sizeof(u32) + 3*sizeof(u8) + sizeof(u64))
-				return -EINVAL;	/* input overrun */
-			in += sizeof(u64);
-		}
-		/* Header checksum byte */
-		in += sizeof(u8);
+	for (fr->count = 0; ; fr->count++) {
+		if (end - pos < sizeof(u32))
+			return -EINVAL;	/* input overrun */
+		block_size = get_unaligned_le32(pos) &
+			~LZ4F_BLOCKUNCOMPRESSED_FLAG;
+		pos += sizeof(u32);
+		if (!block_size)
+			break;
+		if (block_size > fr->block_max)
+			return -EINVAL;	/* larger than block_max */
+		if (fr->flags & LZ4F_BLOCK_CHECKSUM)
+			block_size += sizeof(u32);
+		if (end - pos < block_size)
+			return -EINVAL;	/* input overrun */
+		pos += block_size;
 	}
 
-	while (1) {
-		u32 block_header, block_size;
+	if (fr->flags & LZ4F_CONTENT_CHECKSUM) {
+		if (end - pos < sizeof(u32))
+			return -EINVAL;	/* input overrun */
+		fr->checksum = get_unaligned_le32(pos);
+		pos += sizeof(u32);
+	}
+	fr->end = pos;
 
-		block_header = get_unaligned_le32(in);
-		in += sizeof(u32);
-		block_size = block_header & ~LZ4F_BLOCKUNCOMPRESSED_FLAG;
+	return 0;
+}
 
-		if (in - src + block_size > srcn) {
-			ret = -EINVAL;		/* input overrun */
-			break;
+static bool lz4_block_checksum_ok(const void *in, u32 block_size)
+{
+	return xxh32(in, block_size, 0) == get_unaligned_le32(in + block_size);
+}
+
+/*
+ * Decompress one block to @out. Matches may reach back as far as @prefix,
+ * which is @out for independent blocks and the start of the frame's output
+ * for linked ones. Returns the number of bytes written, or -ve on error.
+ */
+static int lz4_block(const void *in, u32 header, void *out, size_t out_max,
+		     const void *prefix)
+{
+	u32 block_size = header & ~LZ4F_BLOCKUNCOMPRESSED_FLAG;
+	int ret;
+
+	if (header & LZ4F_BLOCKUNCOMPRESSED_FLAG) {
+		if (block_size > out_max)
+			return -ENOBUFS;	/* output overrun */
+		memcpy(out, in, block_size);
+		return block_size;
+	}
+
+	/* constant folding essential, do not touch params! */
+	ret = LZ4_decompress_generic(in, out, block_size, out_max,
+			endOnInputSize, full, 0, noDict, prefix, NULL, 0);
+	if (ret < 0)
+		return -EPROTO;	/* decompression error */
+
+	return ret;
+}
+
+/**
+ * struct lz4_block_job - Decompression of one block on a secondary CPU
+ *
+ * @job: Job doing the decompression
+ * @in: Block data
+ * @header: Block header
+ * @out: Output position
+ * @out_max: Space available at @out
+ * @out_size: Returns the number of bytes written
+ */
+struct lz4_block_job {
+	struct mp_job job;
+	const void *in;
+	u32 header;
+	void *out;
+	size_t out_max;
+	size_t out_size;
+};
+
+static int lz4_block_job_run(void *arg)
+{
+	struct lz4_block_job *bj = arg;
+	int ret;
+
+	ret = lz4_block(bj->in, bj->header, bj->out, bj->out_max, bj->out);
+	if (ret < 0)
+		return ret;
+	bj->out_size = ret;
+
+	return 0;
+}
+
+/*
+ * Decompress independent blocks on all available CPUs. Every block but the
+ * last is expected to fill a whole block_max bytes of output, which is what
+ * the reference compressor does; since the frame format does not promise
+ * this, the result is checked. Returns -ENOSYS if the data cannot be handled
+ * this way, or on any error, so that the caller can start again serially and
+ * report the error properly.
+ */
+static int lz4_frame_blocks(const struct lz4_frame *fr, void *dst,
+			    size_t dstn, size_t *sizep)
+{
+	size_t block_max = fr->block_max;
+	struct lz4_block_job *jobs;
+	const void *pos;
+	int count = fr->count;
+	size_t total;
+	int i, ret;
+
+	if (mp_job_cpus() < 2 || block_max < SZ_64K ||
+	    !(fr->flags & LZ4F_INDEPENDENT_BLOCKS))
+		return -ENOSYS;
+
+	/* In-place decompression would overwrite blocks not yet read */
+	if (fr->blocks < dst + dstn && dst < fr->end)
+		return -ENOSYS;
+
+	if (count < 2 || (count - 1) * block_max >= dstn)
+		return -ENOSYS;
+
+	if (CONFIG_IS_ENABLED(LZ4_CHECKSUM) &&
+	    (fr->flags & LZ4F_BLOCK_CHECKSUM)) {
+		for (i = 0, pos = fr->blocks; i < count; i++) {
+			u32 block_size = get_unaligned_le32(pos) &
+				~LZ4F_BLOCKUNCOMPRESSED_FLAG;
+
+			pos += sizeof(u32);
+			if (!lz4_block_checksum_ok(pos, block_size))
+				return -ENOSYS;
+			pos += block_size + sizeof(u32);
 		}
+	}
+
+	jobs = calloc(count, sizeof(*jobs));
+	if (!jobs)
+		return -ENOSYS;
+
+	for (i = 0, pos = fr->blocks; i < count; i++) {
+		struct lz4_block_job *bj = &jobs[i];
+
+		bj->header = get_unaligned_le32(pos);
+		bj->in = pos + sizeof(u32);
+		bj->out = dst + i * block_max;
+		bj->out_max = min(block_max, dstn - i * block_max);
+		bj->job.func = lz4_block_job_run;
+		bj->job.arg = bj;
+		mp_job_submit(&bj->job);
+
+		pos = bj->in + (bj->header & ~LZ4F_BLOCKUNCOMPRESSED_FLAG);
+		if (fr->flags & LZ4F_BLOCK_CHECKSUM)
+			pos += sizeof(u32);
+	}
+
+	ret = 0;
+	for (i = 0, total = 0; i < count; i++) {
+		if (mp_job_wait(&jobs[i].job) ||
+		    (i < count - 1 && jobs[i].out_size != block_max))
+			ret = -ENOSYS;
+		total += jobs[i].out_size;
+	}
+	free(jobs);
+	if (ret)
+		return ret;
+
+	if (CONFIG_IS_ENABLED(LZ4_CHECKSUM) &&
+	    (fr->flags & LZ4F_CONTENT_CHECKSUM) &&
+	    xxh32(dst, total, 0) != fr->checksum)
+		return -ENOSYS;
+	*sizep = total;
+
+	return 0;
+}
+
+/*
+ * Decompress one frame to @dst, returning the number of bytes written in
+ * @sizep even on error. The content checksum is updated after each block,
+ * while its output is still in the cache.
+ */
+static int lz4_frame(const struct lz4_frame *fr, void *dst, size_t dstn,
+		     size_t *sizep)
+{
+	bool check = CONFIG_IS_ENABLED(LZ4_CHECKSUM);
+	const void *end = dst + dstn;
+	const void *in = fr->blocks;
+	struct xxh32_state state;
+	void *out = dst;
+	u32 header, block_size;
+	int ret;
+
+	if (CONFIG_IS_ENABLED(MP_JOB)) {
+		ret = lz4_frame_blocks(fr, dst, dstn, sizep);
+		if (ret != -ENOSYS)
+			return ret;
+	}
+
+	if (check && (fr->flags & LZ4F_CONTENT_CHECKSUM))
+		xxh32_reset(&state, 0);
 
+	while (1) {
+		header = get_unaligned_le32(in);
+		in += sizeof(u32);
+		block_size = header & ~LZ4F_BLOCKUNCOMPRESSED_FLAG;
 		if (!block_size) {
 			ret = 0;	/* decompression successful */
 			break;
 		}
 
-		if (block_header & LZ4F_BLOCKUNCOMPRESSED_FLAG) {
-			size_t size = min((ptrdiff_t)block_size, end - out);
-			memcpy(out, in, size);
-			out += size;
-			if (size < block_size) {
-				ret = -ENOBUFS;	/* output overrun */
-				break;
-			}
-		} else {
-			/* constant folding essential, do not touch params! */
-			ret = LZ4_decompress_generic(in, out, block_size,
-					end - out, endOnInputSize,
-					full, 0, noDict, out, NULL, 0);
-			if (ret < 0) {
-				ret = -EPROTO;	/* decompression error */
-				break;
-			}
-			out += ret;
+		if (check && (fr->flags & LZ4F_BLOCK_CHECKSUM) &&
+		    !lz4_block_checksum_ok(in, block_size)) {
+			ret = -EBADMSG;
+			break;
 		}
 
+		if ((header & LZ4F_BLOCKUNCOMPRESSED_FLAG) &&
+		    block_size > end - out) {
+			/* Keep as much as fits, as before */
+			memcpy(out, in, end - out);
+			out += end - out;
+			ret = -ENOBUFS;	/* output overrun */
+			break;
+		}
+
+		ret = lz4_block(in, header, out, end - out,
+				(fr->flags & LZ4F_INDEPENDENT_BLOCKS) ?
+				out : dst);
+		if (ret < 0)
+			break;
+		if (check && (fr->flags & LZ4F_CONTENT_CHECKSUM))
+			xxh32_update(&state, out, ret);
+		out += ret;
+
 		in += block_size;
-		if (has_block_checksum)
+		if (fr->flags & LZ4F_BLOCK_CHECKSUM)
 			in += sizeof(u32);
 	}
 
-	*dstn = out - dst;
+	if (!ret && check && (fr->flags & LZ4F_CONTENT_CHECKSUM) &&
+	    xxh32_digest(&state) != fr->checksum)
+		ret = -EBADMSG;
+	*sizep = out - dst;
+
 	return ret;
 }
+
+/* Check whether another LZ4 or skippable frame follows */
+static bool lz4_more_frames(const void *in, const void *end)
+{
+	u32 magic;
+
+	if (end - in < sizeof(u32))
+		return false;
+	magic = get_unaligned_le32(in);
+
+	return magic == LZ4F_MAGIC ||
+		(magic & LZ4F_SKIPPABLE_MASK) == LZ4F_SKIPPABLE_MAGIC;
+}
+
+int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn)
+{
+	const void *end = src + srcn;
+	const void *in = src;
+	size_t out_max = *dstn;
+	struct lz4_frame fr;
+	size_t size;
+	u32 skip;
+	int ret;
+
+	*dstn = 0;
+	do {
+		/* Skippable frames carry user data, which is ignored */
+		if (srcn - (in - src) >= 2 * sizeof(u32) &&
+		    (get_unaligned_le32(in) & LZ4F_SKIPPABLE_MASK) ==
+		    LZ4F_SKIPPABLE_MAGIC) {
+			skip = get_unaligned_le32(in + sizeof(u32));
+			if (end - in - 2 * sizeof(u32) < skip)
+				return -EINVAL;	/* input overrun */
+			in += 2 * sizeof(u32) + skip;
+			continue;
+		}
+
+		ret = lz4_frame_scan(in, end, &fr);
+		if (ret)
+			return ret;
+		ret = lz4_frame(&fr, dst + *dstn, out_max - *dstn, &size);
+		*dstn += size;
+		if (ret)
+			return ret;
+		in = fr.end;
+	} while (lz4_more_frames(in, end));
+
+	return 0;
+}
@@ -0,0 +1,222 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Running self-contained jobs on otherwise idle secondary CPUs
+ *
+ * Each worker has a one-entry mailbox which only the boot CPU fills and only
+ * the worker empties, so no locking is needed, just ordered accesses.
+ *
+ * Copyright 2023 NXP
+ */
+
+#define LOG_CATEGORY	LOGC_ARCH
+
+#include <common.h>
+#include <log.h>
+#include <mp_job.h>
+#include <time.h>
+#include <watchdog.h>
+#include <asm/global_data.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* How long to wait for a worker to start, stop or take a job */
+#define MP_JOB_TIMEOUT_MS	100
+
+/* How long a job may run, far longer than any hash or decompression takes */
+#define MP_JOB_RUN_TIMEOUT_MS	10000
+
+enum mp_job_state {
+	MP_JOB_IDLE,
+	MP_JOB_QUEUED,
+	MP_JOB_RUNNING,
+	MP_JOB_DONE,
+};
+
+static struct mp_worker mp_workers[CONFIG_MP_JOB_MAX_CPUS];
+static int mp_nstarted;		/* workers started by the arch code */
+static int mp_nworkers;		/* workers which are known to be running */
+static bool mp_started;
+static bool mp_broken;		/* a worker failed, so never use them again */
+
+#define mp_load(p)		__atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define mp_store(p, val)	__atomic_store_n(p, val, __ATOMIC_RELEASE)
+
+/* Claim a queued job, so that it is run once only */
+static bool mp_job_claim(struct mp_job *job)
+{
+	int state = MP_JOB_QUEUED;
+
+	return __atomic_compare_exchange_n(&job->state, &state, MP_JOB_RUNNING,
+					   false, __ATOMIC_ACQ_REL,
+					   __ATOMIC_ACQUIRE);
+}
+
+__weak int arch_mp_job_start(struct mp_worker *workers, int max)
+{
+	return 0;
+}
+
+__weak void arch_mp_job_stop(struct mp_worker *workers, int count)
+{
+}
+
+__weak void arch_mp_job_idle(void)
+{
+}
+
+__weak void arch_mp_job_notify(void)
+{
+}
+
+void mp_job_worker(struct mp_worker *worker)
+{
+	struct mp_job *job;
+
+	mp_store(&worker->running, true);
+	while (!mp_load(&worker->stop)) {
+		job = mp_load(&worker->job);
+		if (!job) {
+			arch_mp_job_idle();
+			continue;
+		}
+		/* The boot CPU may have taken the job back */
+		if (mp_job_claim(job)) {
+			job->ret = job->func(job->arg);
+			mp_store(&job->state, MP_JOB_DONE);
+		}
+		mp_store(&worker->job, NULL);
+	}
+	mp_store(&worker->running, false);
+}
+
+/* Wait for all workers' @running flag to reach @running */
+static int mp_job_sync(int count, bool running)
+{
+	ulong start = get_timer(0);
+	int i;
+
+	for (i = 0; i < count; i++) {
+		while (mp_load(&mp_workers[i].running) != running) {
+			if (get_timer(start) > MP_JOB_TIMEOUT_MS)
+				return i;
+			WATCHDOG_RESET();
+		}
+	}
+
+	return count;
+}
+
+static void mp_job_start(void)
+{
+	int i, count;
+
+	/* Secondary CPUs are only used after relocation */
+	if (mp_started || mp_broken || !(gd->flags & GD_FLG_RELOC))
+		return;
+	mp_started = true;
+
+	for (i = 0; i < CONFIG_MP_JOB_MAX_CPUS; i++) {
+		mp_workers[i].job = NULL;
+		mp_workers[i].stop = false;
+		mp_workers[i].running = false;
+		mp_workers[i].index = i;
+	}
+	count = arch_mp_job_start(mp_workers, CONFIG_MP_JOB_MAX_CPUS);
+	if (count <= 0)
+		return;
+	mp_nstarted = count;
+
+	/* Only use the workers which came up, in case some did not */
+	mp_nworkers = mp_job_sync(count, true);
+	if (mp_nworkers < count)
+		log_warning("Only %d of %d CPUs started\n", mp_nworkers, count);
+	log_debug("%d secondary CPUs running jobs\n", mp_nworkers);
+}
+
+void mp_job_submit(struct mp_job *job)
+{
+	struct mp_worker *worker;
+	int i;
+
+	mp_job_start();
+	job->state = MP_JOB_QUEUED;
+	for (i = 0; i < mp_nworkers; i++) {
+		worker = &mp_workers[i];
+		if (!mp_load(&worker->job)) {
+			mp_store(&worker->job, job);
+			arch_mp_job_notify();
+			return;
+		}
+	}
+
+	/*
+	 * Everyone is busy, so do it ourselves. Mark it running first, so a
+	 * worker still holding it from an earlier submission cannot claim it.
+	 */
+	mp_store(&job->state, MP_JOB_RUNNING);
+	job->ret = job->func(job->arg);
+	job->state = MP_JOB_DONE;
+}
+
+/* Stop handing out jobs, since a worker is not behaving */
+static void mp_job_set_broken(void)
+{
+	mp_broken = true;
+	mp_nworkers = 0;
+}
+
+int mp_job_wait(struct mp_job *job)
+{
+	ulong start = get_timer(0);
+	int ret;
+
+	while (mp_load(&job->state) != MP_JOB_DONE) {
+		if (get_timer(start) > MP_JOB_TIMEOUT_MS && mp_job_claim(job)) {
+			log_warning("Secondary CPU did not take a job\n");
+			mp_job_set_broken();
+			job->ret = job->func(job->arg);
+			break;
+		}
+		if (get_timer(start) > MP_JOB_RUN_TIMEOUT_MS) {
+			log_err("Job on secondary CPU timed out\n");
+			mp_job_set_broken();
+			job->state = MP_JOB_IDLE;
+			return -ETIMEDOUT;
+		}
+		WATCHDOG_RESET();
+	}
+	ret = job->ret;
+	job->state = MP_JOB_IDLE;
+
+	return ret;
+}
+
+int mp_job_cpus(void)
+{
+	mp_job_start();
+
+	return mp_nworkers + 1;
+}
+
+void mp_job_stop(void)
+{
+	int i, count;
+
+	if (!mp_started)
+		return;
+
+	count = mp_nstarted;
+	for (i = 0; i < count; i++)
+		mp_store(&mp_workers[i].stop, true);
+	arch_mp_job_notify();
+	if (mp_job_sync(count, false) < count) {
+		/* A worker may still be polling mp_workers[], so keep it */
+		log_warning("Secondary CPUs did not stop, not using them again\n");
+		mp_broken = true;
+	}
+	arch_mp_job_stop(mp_workers, count);
+
+	mp_nstarted = 0;
+	mp_nworkers = 0;
+	mp_started = false;
+}
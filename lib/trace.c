@@ -4,6 +4,7 @@
  */
 
 #include <common.h>
+#include <boottrace.h>
 #include <mapmem.h>
 #include <time.h>
 #include <trace.h>
@@ -38,6 +39,13 @@ struct trace_hdr {
 	int depth;
 	int depth_limit;
 	int max_depth;
+
+	/*
+	 * Set while a call is being recorded. Recording reads the timer, and
+	 * adds to the boot timeline with BOOTTRACE_FUNCS, either of which may
+	 * call traced functions, so calls made meanwhile are not recorded
+	 */
+	bool trace_locked;
 };
 
 static struct trace_hdr *hdr;	/* Pointer to start of trace buffer */
@@ -116,6 +124,12 @@ static void __attribute__((no_instrument_function)) add_ftrace(void *func_ptr,
 		rec->flags = flags | (timer_get_us() & FUNCF_TIMESTAMP_MASK);
 	}
 	hdr->ftrace_count++;
+
+	if (IS_ENABLED(CONFIG_BOOTTRACE_FUNCS))
+		boottrace_add(flags == FUNCF_ENTRY ? TRACE_EV_FUNC_ENTRY :
+			      TRACE_EV_FUNC_EXIT, 0, 0,
+			      func_ptr_to_num(func_ptr) * FUNC_SITE_SIZE,
+			      func_ptr_to_num(caller) * FUNC_SITE_SIZE);
 }
 
 static void __attribute__((no_instrument_function)) add_textbase(void)
@@ -142,10 +156,11 @@ static void __attribute__((no_instrument_function)) add_textbase(void)
 void __attribute__((no_instrument_function)) __cyg_profile_func_enter(
 		void *func_ptr, void *caller)
 {
-	if (trace_enabled) {
+	if (trace_enabled && !hdr->trace_locked) {
 		int func;
 
 		trace_swap_gd();
+		hdr->trace_locked = true;
 		add_ftrace(func_ptr, caller, FUNCF_ENTRY);
 		func = func_ptr_to_num(func_ptr);
 		if (func < hdr->func_count) {
@@ -157,6 +172,7 @@ void __attribute__((no_instrument_function)) __cyg_profile_func_enter(
 		hdr->depth++;
 		if (hdr->depth > hdr->depth_limit)
 			hdr->max_depth = hdr->depth;
+		hdr->trace_locked = false;
 		trace_swap_gd();
 	}
 }
@@ -170,10 +186,12 @@ void __attribute__((no_instrument_function)) __cyg_profile_func_enter(
 void __attribute__((no_instrument_function)) __cyg_profile_func_exit(
 		void *func_ptr, void *caller)
 {
-	if (trace_enabled) {
+	if (trace_enabled && !hdr->trace_locked) {
 		trace_swap_gd();
+		hdr->trace_locked = true;
 		add_ftrace(func_ptr, caller, FUNCF_EXIT);
 		hdr->depth--;
+		hdr->trace_locked = false;
 		trace_swap_gd();
 	}
 }
@@ -9,56 +9,323 @@
 #include <abuf.h>
 #include <log.h>
 #include <malloc.h>
+#include <mp_job.h>
+#include <asm/cache.h>
+#include <linux/kernel.h>
 #include <linux/zstd.h>
+#include "zstd_internal.h"
 
-int zstd_decompress(struct abuf *in, struct abuf *out)
+/*
+ * Workspace kept between decompressions, so that booting several images
+ * does not allocate the contexts each time. It is used by one decompression
+ * at a time; any other allocates its own.
+ */
+static struct {
+	void *buf;
+	size_t size;
+	bool busy;
+} zstd_arena;
+
+/**
+ * zstd_get_workspace() - Get a workspace for decompression
+ *
+ * @size: Number of bytes needed
+ * @ownp: Returns true if the workspace must be freed rather than returned to
+ *	the arena
+ * Return: workspace, or NULL if out of memory
+ */
+static void *zstd_get_workspace(size_t size, bool *ownp)
 {
-	ZSTD_DStream *dstream;
-	ZSTD_inBuffer in_buf;
-	ZSTD_outBuffer out_buf;
-	void *workspace;
-	size_t wsize;
-	int ret;
+	*ownp = zstd_arena.busy;
+	if (*ownp)
+		return malloc(size);
 
-	wsize = ZSTD_DStreamWorkspaceBound(abuf_size(in));
-	workspace = malloc(wsize);
-	if (!workspace) {
-		debug("%s: cannot allocate workspace of size %zu\n", __func__,
-			wsize);
-		return -ENOMEM;
+	if (size > zstd_arena.size) {
+		free(zstd_arena.buf);
+		zstd_arena.buf = malloc(size);
+		zstd_arena.size = zstd_arena.buf ? size : 0;
+		if (!zstd_arena.buf)
+			return NULL;
 	}
+	zstd_arena.busy = true;
 
-	dstream = ZSTD_initDStream(abuf_size(in), workspace, wsize);
-	if (!dstream) {
-		log_err("%s: ZSTD_initDStream failed\n", __func__);
-		ret = -EPERM;
-		goto do_free;
+	return zstd_arena.buf;
+}
+
+static void zstd_put_workspace(void *workspace, bool own)
+{
+	if (own)
+		free(workspace);
+	else if (workspace)
+		zstd_arena.busy = false;
+}
+
+int zstd_stream_init(struct zstd_stream *zs, void *dst, size_t dst_size)
+{
+	size_t wsize = ZSTD_DCtxWorkspaceBound();
+
+	memset(zs, '\0', sizeof(*zs));
+	zs->workspace = zstd_get_workspace(wsize + ZSTD_BLOCKSIZE_ABSOLUTEMAX,
+					   &zs->own);
+	if (!zs->workspace)
+		return -ENOMEM;
+
+	zs->dctx = ZSTD_initDCtx(zs->workspace, wsize);
+	if (!zs->dctx) {
+		zstd_put_workspace(zs->workspace, zs->own);
+		zs->workspace = NULL;
+		return -ENOMEM;
 	}
+	zs->unit = zs->workspace + wsize;
+	zs->dst = dst;
+	zs->dst_size = dst_size;
+	zs->idle = true;
+
+	return 0;
+}
 
-	in_buf.src = abuf_data(in);
-	in_buf.pos = 0;
-	in_buf.size = abuf_size(in);
+int zstd_stream_feed(struct zstd_stream *zs, const void *src, size_t size)
+{
+	const void *unit;
+	size_t need, res, n;
 
-	out_buf.dst = abuf_data(out);
-	out_buf.pos = 0;
-	out_buf.size = abuf_size(out);
+	while (size) {
+		need = ZSTD_nextSrcSizeToDecompress(zs->dctx);
+		if (!need) {
+			/* The last frame ended, so expect another */
+			ZSTD_decompressBegin(zs->dctx);
+			zs->idle = true;
+			continue;
+		}
+		if (zs->idle) {
+			zs->idle = false;
+			zs->frames++;
+		}
 
-	while (1) {
-		size_t res;
+		if (ZSTD_isSkipFrame(zs->dctx)) {
+			/* Nothing reads the contents of a skippable frame */
+			n = min(size, need - zs->staged);
+			zs->staged += n;
+			src += n;
+			size -= n;
+			if (zs->staged < need)
+				break;
+			unit = zs->unit;
+		} else if (need > ZSTD_BLOCKSIZE_ABSOLUTEMAX) {
+			log_debug("Block of %zx bytes is too large\n", need);
+			return -EBADMSG;
+		} else if (!zs->staged && size >= need) {
+			unit = src;
+			src += need;
+			size -= need;
+		} else {
+			n = min(size, need - zs->staged);
+			memcpy(zs->unit + zs->staged, src, n);
+			zs->staged += n;
+			src += n;
+			size -= n;
+			if (zs->staged < need)
+				break;
+			unit = zs->unit;
+		}
+		zs->staged = 0;
 
-		res = ZSTD_decompressStream(dstream, &out_buf, &in_buf);
+		res = ZSTD_decompressContinue(zs->dctx, zs->dst + zs->pos,
+					      zs->dst_size - zs->pos, unit, need);
 		if (ZSTD_isError(res)) {
-			ret = ZSTD_getErrorCode(res);
-			log_err("ZSTD_decompressStream error %d\n", ret);
-			goto do_free;
+			log_debug("ZSTD_decompressContinue error %d\n",
+				  ZSTD_getErrorCode(res));
+			if (ZSTD_getErrorCode(res) == ZSTD_error_dstSize_tooSmall)
+				return -ENOSPC;
+			return -EBADMSG;
 		}
+		zs->pos += res;
+	}
+
+	return 0;
+}
+
+int zstd_stream_finish(struct zstd_stream *zs)
+{
+	bool ended;
 
-		if (in_buf.pos >= abuf_size(in) || !res)
-			break;
+	ended = !zs->staged && zs->frames &&
+		(zs->idle || !ZSTD_nextSrcSizeToDecompress(zs->dctx));
+	zstd_put_workspace(zs->workspace, zs->own);
+	zs->workspace = NULL;
+	if (!ended) {
+		log_err("Truncated zstd data\n");
+		return -EBADMSG;
 	}
 
-	ret = out_buf.pos;
+	return zs->pos;
+}
+
+/**
+ * struct zstd_frame_job - Decompression of one frame on a secondary CPU
+ *
+ * @job: Job doing the decompression
+ * @dctx: Decompression context, one per CPU
+ * @src: Compressed frame
+ * @src_size: Size of compressed frame
+ * @dst: Output buffer
+ * @dst_size: Decompressed size given in the frame header
+ */
+struct zstd_frame_job {
+	struct mp_job job;
+	ZSTD_DCtx *dctx;
+	const void *src;
+	size_t src_size;
+	void *dst;
+	size_t dst_size;
+};
+
+static int zstd_frame_job_run(void *arg)
+{
+	struct zstd_frame_job *fj = arg;
+	size_t res;
+
+	res = ZSTD_decompressDCtx(fj->dctx, fj->dst, fj->dst_size, fj->src,
+				  fj->src_size);
+	if (ZSTD_isError(res) || res != fj->dst_size)
+		return -EBADMSG;
+
+	return 0;
+}
+
+/*
+ * Find the frames in @in, filling in their input and output positions in
+ * @jobs if not NULL, and return the number of non-empty frames, or -ENOSYS if
+ * the frames cannot be decompressed independently
+ */
+static int zstd_find_frames(struct abuf *in, struct abuf *out,
+			    struct zstd_frame_job *jobs)
+{
+	const void *src = abuf_data(in);
+	size_t left = abuf_size(in);
+	size_t pos = 0, csize;
+	unsigned long long dsize;
+	int count = 0;
+
+	while (left) {
+		dsize = ZSTD_getFrameContentSize(src, left);
+		csize = ZSTD_findFrameCompressedSize(src, left);
+		if (dsize == ZSTD_CONTENTSIZE_UNKNOWN ||
+		    dsize == ZSTD_CONTENTSIZE_ERROR || ZSTD_isError(csize) ||
+		    dsize > abuf_size(out) - pos)
+			return -ENOSYS;
+		if (dsize) {
+			if (jobs) {
+				jobs[count].src = src;
+				jobs[count].src_size = csize;
+				jobs[count].dst = abuf_data(out) + pos;
+				jobs[count].dst_size = dsize;
+			}
+			count++;
+		}
+		src += csize;
+		left -= csize;
+		pos += dsize;
+	}
+
+	return count;
+}
+
+/*
+ * Decompress a series of frames, each of which records its size, on all
+ * available CPUs. This is what multi-threaded compressors such as pzstd
+ * produce. Returns -ENOSYS if this is not possible, so the caller can fall
+ * back to streaming.
+ */
+static int zstd_decompress_frames(struct abuf *in, struct abuf *out)
+{
+	struct zstd_frame_job *jobs;
+	void *workspace;
+	bool own;
+	int ncpus, nframes, i, j;
+	size_t wsize, total = 0;
+	int ret = 0;
+
+	ncpus = mp_job_cpus();
+	if (ncpus < 2)
+		return -ENOSYS;
+
+	/* The frames would overwrite each other's input */
+	if (abuf_data(in) < abuf_data(out) + abuf_size(out) &&
+	    abuf_data(out) < abuf_data(in) + abuf_size(in))
+		return -ENOSYS;
+
+	nframes = zstd_find_frames(in, out, NULL);
+	if (nframes < 2)
+		return -ENOSYS;
+	ncpus = min(ncpus, nframes);
+
+	jobs = calloc(nframes, sizeof(*jobs));
+	if (!jobs)
+		return -ENOMEM;
+	zstd_find_frames(in, out, jobs);
+
+	wsize = ALIGN(ZSTD_DCtxWorkspaceBound(), ARCH_DMA_MINALIGN);
+	workspace = zstd_get_workspace(ncpus * wsize, &own);
+	if (!workspace) {
+		ret = -ENOMEM;
+		goto do_free;
+	}
+
+	/* Run one frame per CPU at a time, reusing the contexts */
+	for (i = 0; i < nframes; i += ncpus) {
+		for (j = 0; j < ncpus && i + j < nframes; j++) {
+			struct zstd_frame_job *fj = &jobs[i + j];
+
+			fj->dctx = ZSTD_initDCtx(workspace + j * wsize, wsize);
+			fj->job.func = zstd_frame_job_run;
+			fj->job.arg = fj;
+			mp_job_submit(&fj->job);
+		}
+		for (j = 0; j < ncpus && i + j < nframes; j++) {
+			int res = mp_job_wait(&jobs[i + j].job);
+
+			if (res && !ret) {
+				log_err("Frame %d decompression error %d\n",
+					i + j, res);
+				ret = res;
+			}
+			total += jobs[i + j].dst_size;
+		}
+		if (ret)
+			goto do_free;
+	}
+	ret = total;
+
 do_free:
-	free(workspace);
+	zstd_put_workspace(workspace, own);
+	free(jobs);
+
 	return ret;
 }
+
+int zstd_decompress(struct abuf *in, struct abuf *out)
+{
+	struct zstd_stream zs;
+	int ret;
+
+	if (CONFIG_IS_ENABLED(MP_JOB)) {
+		ret = zstd_decompress_frames(in, out);
+		if (ret != -ENOSYS)
+			return ret;
+	}
+
+	ret = zstd_stream_init(&zs, abuf_data(out), abuf_size(out));
+	if (ret) {
+		debug("%s: cannot allocate workspace\n", __func__);
+		return ret;
+	}
+	ret = zstd_stream_feed(&zs, abuf_data(in), abuf_size(in));
+	if (ret) {
+		log_err("zstd decompression error %d\n", ret);
+		zstd_stream_finish(&zs);
+		return ret;
+	}
+
+	return zstd_stream_finish(&zs);
+}
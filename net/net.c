@@ -83,6 +83,7 @@
 
 #include <common.h>
 #include <bootstage.h>
+#include <boottrace.h>
 #include <command.h>
 #include <console.h>
 #include <env.h>
@@ -411,6 +412,7 @@ int net_loop(enum proto_t protocol)
 	debug_cond(DEBUG_INT_STATE, "--- net_loop Entry\n");
 
 	bootstage_mark_name(BOOTSTAGE_ID_ETH_START, "eth_start");
+	boottrace_add(TRACE_EV_NET_START, 0, 0, protocol, 0);
 	net_init();
 	if (eth_is_on_demand_init()) {
 		eth_halt();
@@ -418,6 +420,8 @@ int net_loop(enum proto_t protocol)
 		ret = eth_init();
 		if (ret < 0) {
 			eth_halt();
+			boottrace_add(TRACE_EV_NET_END, TRACE_EVF_ERROR, 0,
+				      protocol, 0);
 			return ret;
 		}
 	} else {
@@ -671,6 +675,8 @@ done:
 	net_set_icmp_handler(NULL);
 #endif
 	net_set_state(prev_net_state);
+	boottrace_add(TRACE_EV_NET_END, ret < 0 ? TRACE_EVF_ERROR : 0, 0,
+		      protocol, net_boot_file_size);
 
 #if defined(CONFIG_CMD_PCAP)
 	if (pcap_active())
@@ -37,6 +37,7 @@
 #include "nfs.h"
 #include "bootp.h"
 #include <time.h>
+#include <linux/log2.h>
 
 #define HASHES_PER_LINE 65	/* Number of "loading" hashes per line	*/
 #define NFS_RETRY_COUNT 30
@@ -49,12 +50,44 @@
 #define NFS_RPC_ERR	1
 #define NFS_RPC_DROP	124
 
+/* Largest READ allowed by NFSv2 (NFS_MAXDATA in RFC1094) */
+#define NFS2_MAXDATA	8192
+/* Headers which come with the data in a READ reply */
+#define NFS_READ_OVERHEAD	(IP_UDP_HDR_SIZE + sizeof(struct rpc_t) - \
+				 NFS_READ_SIZE)
+/* Bytes per progress hash */
+#define NFS_HASH_BYTES	(NFS_READ_SIZE / 2 * 10)
+
 static int fs_mounted;
 static unsigned long rpc_id;
-static int nfs_offset = -1;
-static int nfs_len;
+static int nfs_offset = -1;	/* offset of the next READ to send */
 static ulong nfs_timeout = NFS_TIMEOUT;
 
+/**
+ * struct nfs_read_slot - A READ request waiting for its reply
+ *
+ * @xid: RPC ID the request was last sent with
+ * @offset: File offset of the data asked for
+ * @len: Number of bytes asked for, 0 if the slot is free
+ */
+static struct nfs_read_slot {
+	ulong xid;
+	uint offset;
+	uint len;
+} nfs_reads[CONFIG_NFS_READ_WINDOW];
+
+static uint nfs_read_size;	/* bytes asked for in each READ */
+static long nfs_file_size;	/* size of the file, -1 until known */
+static ulong nfs_read_done;	/* bytes received */
+static ulong nfs_hashes;	/* progress hashes printed */
+static ulong nfs_time_start;
+static struct {
+	ulong reads;		/* READ replies received */
+	ulong ahead;		/* replies received before an earlier one */
+	ulong shorts;		/* replies with less data than asked for */
+	ulong timeouts;		/* timeouts waiting for a reply */
+} nfs_stats;
+
 static char dirfh[NFS_FHSIZE];	/* NFSv2 / NFSv3 file handle of directory */
 static char filefh[NFS3_FHSIZE]; /* NFSv2 / NFSv3 file handle */
 static int filefh3_length;	/* (variable) length of filefh when NFSv3 */
@@ -391,6 +424,101 @@ static void nfs_read_req(int offset, int readlen)
 	rpc_req(PROG_NFS, NFS_READ, data, len);
 }
 
+static void nfs_read_send(struct nfs_read_slot *slot)
+{
+	nfs_read_req(slot->offset, slot->len);
+	slot->xid = rpc_id;
+}
+
+/* Send all READ requests which are waiting for a reply again */
+static void nfs_read_resend(void)
+{
+	int i;
+
+	for (i = 0; i < CONFIG_NFS_READ_WINDOW; i++) {
+		if (nfs_reads[i].len)
+			nfs_read_send(&nfs_reads[i]);
+	}
+}
+
+/*
+ * Send READ requests for the rest of the file until the window is full,
+ * returning the number of requests in flight. Only one request is sent until
+ * the file size is known.
+ */
+static int nfs_read_fill(void)
+{
+	struct nfs_read_slot *slot;
+	int busy = 0;
+	uint len;
+	int i;
+
+	for (i = 0; i < CONFIG_NFS_READ_WINDOW; i++) {
+		if (nfs_reads[i].len)
+			busy++;
+	}
+
+	for (i = 0; i < CONFIG_NFS_READ_WINDOW; i++) {
+		slot = &nfs_reads[i];
+		if (slot->len)
+			continue;
+		if (nfs_file_size < 0 ? busy : nfs_offset >= nfs_file_size)
+			break;
+		len = nfs_read_size;
+		if (nfs_file_size >= 0 && nfs_file_size - nfs_offset < len)
+			len = nfs_file_size - nfs_offset;
+		slot->offset = nfs_offset;
+		slot->len = len;
+		nfs_offset += len;
+		nfs_read_send(slot);
+		busy++;
+	}
+
+	return busy;
+}
+
+/* Work out how much to read at once: as much as fits in one datagram */
+static uint nfs_max_read_size(void)
+{
+	uint size = NFS_READ_SIZE;
+
+#ifdef CONFIG_IP_DEFRAG
+	size = max_t(uint, size,
+		     rounddown_pow_of_two(CONFIG_NET_MAXDEFRAG -
+					  NFS_READ_OVERHEAD));
+	if ((supported_nfs_versions & NFSV2_FLAG) && size > NFS2_MAXDATA)
+		size = NFS2_MAXDATA;
+#endif
+
+	return size;
+}
+
+static void nfs_read_start(void)
+{
+	memset(nfs_reads, '\0', sizeof(nfs_reads));
+	memset(&nfs_stats, '\0', sizeof(nfs_stats));
+	nfs_offset = 0;
+	nfs_file_size = -1;
+	nfs_read_done = 0;
+	nfs_hashes = 0;
+	nfs_read_size = nfs_max_read_size();
+	nfs_time_start = get_timer(0);
+	nfs_read_fill();
+}
+
+static void nfs_read_complete(void)
+{
+	ulong time = get_timer(nfs_time_start);
+
+	if (time > 0) {
+		puts("\n\t ");	/* Line up with "Loading: " */
+		print_size(nfs_read_done / time * 1000, "/s");
+	}
+	printf("\n\t %lu reads of up to %u bytes, window %d: %lu early, %lu short, %lu timeouts",
+	       nfs_stats.reads, nfs_read_size, CONFIG_NFS_READ_WINDOW,
+	       nfs_stats.ahead, nfs_stats.shorts, nfs_stats.timeouts);
+}
+
 /**************************************************************************
 RPC request dispatcher
 **************************************************************************/
@@ -421,7 +549,7 @@ static void nfs_send(void)
 		nfs_lookup_req(nfs_filename);
 		break;
 	case STATE_READ_REQ:
-		nfs_read_req(nfs_offset, nfs_len);
+		nfs_read_resend();
 		break;
 	case STATE_READLINK_REQ:
 		nfs_readlink_req();
@@ -664,19 +792,35 @@ static int nfs_readlink_reply(uchar *pkt, unsigned len)
 	return 0;
 }
 
+/*
+ * Handle the reply to a READ request, which may be any of those in flight.
+ * The data is stored straight from the packet, since it may be larger than
+ * struct rpc_t when IP reassembly is enabled.
+ */
 static int nfs_read_reply(uchar *pkt, unsigned len)
 {
+	struct nfs_read_slot *slot = NULL;
 	struct rpc_t rpc_pkt;
+	ulong xid;
 	int rlen;
-	uchar *data_ptr;
+	uint data_off;
+	long size = -1;
+	bool eof;
+	int i;
 
 	debug("%s\n", __func__);
 
-	memcpy(&rpc_pkt.u.data[0], pkt, sizeof(rpc_pkt.u.reply));
+	memcpy(&rpc_pkt.u.data[0], pkt,
+	       min_t(uint, len, sizeof(rpc_pkt.u.reply)));
 
-	if (ntohl(rpc_pkt.u.reply.id) > rpc_id)
+	xid = ntohl(rpc_pkt.u.reply.id);
+	if (xid > rpc_id)
 		return -NFS_RPC_ERR;
-	else if (ntohl(rpc_pkt.u.reply.id) < rpc_id)
+	for (i = 0; i < CONFIG_NFS_READ_WINDOW; i++) {
+		if (nfs_reads[i].len && nfs_reads[i].xid == xid)
+			slot = &nfs_reads[i];
+	}
+	if (!slot)
 		return -NFS_RPC_DROP;
 
 	if (rpc_pkt.u.reply.rstatus  ||
@@ -690,34 +834,71 @@ static int nfs_read_reply(uchar *pkt, unsigned len)
 		return -ntohl(rpc_pkt.u.reply.data[0]);
 	}
 
-	if ((nfs_offset != 0) && !((nfs_offset) %
-			(NFS_READ_SIZE / 2 * 10 * HASHES_PER_LINE)))
-		puts("\n\t ");
-	if (!(nfs_offset % ((NFS_READ_SIZE / 2) * 10)))
-		putc('#');
-
 	if (supported_nfs_versions & NFSV2_FLAG) {
+		/* File size from the attributes */
+		size = ntohl(rpc_pkt.u.reply.data[6]);
 		rlen = ntohl(rpc_pkt.u.reply.data[18]);
-		data_ptr = (uchar *)&(rpc_pkt.u.reply.data[19]);
+		data_off = (uchar *)&rpc_pkt.u.reply.data[19] -
+			(uchar *)&rpc_pkt;
+		eof = slot->offset + rlen >= size;
 	} else {  /* NFSV3_FLAG */
 		int nfsv3_data_offset =
 			nfs3_get_attributes_offset(rpc_pkt.u.reply.data);
 
+		/* Low word of the file size, if there are attributes */
+		if (nfsv3_data_offset > 1)
+			size = ntohl(rpc_pkt.u.reply.data[8]);
 		/* count value */
 		rlen = ntohl(rpc_pkt.u.reply.data[1 + nfsv3_data_offset]);
-		/* Skip unused values :
-			EOF:		32 bits value,
-			data_size:	32 bits value,
-		*/
-		data_ptr = (uchar *)
-			&(rpc_pkt.u.reply.data[4 + nfsv3_data_offset]);
+		eof = rpc_pkt.u.reply.data[2 + nfsv3_data_offset];
+		/* Skip data_size, a 32 bits value */
+		data_off = (uchar *)
+			&rpc_pkt.u.reply.data[4 + nfsv3_data_offset] -
+			(uchar *)&rpc_pkt;
 	}
 
-	if (((uchar *)&(rpc_pkt.u.reply.data[0]) - (uchar *)(&rpc_pkt) + rlen) > len)
-			return -9999;
+	if (rlen < 0 || rlen > slot->len || data_off + rlen > len)
+		return -9999;
 
-	if (store_block(data_ptr, nfs_offset, rlen))
-			return -9999;
+	if (store_block(pkt + data_off, slot->offset, rlen))
+		return -9999;
+
+	nfs_stats.reads++;
+	for (i = 0; i < CONFIG_NFS_READ_WINDOW; i++) {
+		if (nfs_reads[i].len && nfs_reads[i].offset < slot->offset) {
+			nfs_stats.ahead++;
+			break;
+		}
+	}
+
+	nfs_read_done += rlen;
+	while (nfs_hashes < nfs_read_done / NFS_HASH_BYTES) {
+		if (nfs_hashes && !(nfs_hashes % HASHES_PER_LINE))
+			puts("\n\t ");
+		putc('#');
+		nfs_hashes++;
+	}
+
+	if (!rlen || eof) {
+		/* Nothing is asked for beyond this */
+		nfs_file_size = slot->offset + rlen;
+		slot->len = 0;
+	} else if (rlen < slot->len) {
+		/*
+		 * The server sends no more than it can in one go, so ask for
+		 * less from now on, and for the rest of this block now
+		 */
+		nfs_stats.shorts++;
+		if (nfs_read_size > rlen)
+			nfs_read_size = rlen;
+		slot->offset += rlen;
+		slot->len -= rlen;
+		nfs_read_send(slot);
+	} else {
+		slot->len = 0;
+	}
+	if (nfs_file_size < 0 && size >= 0)
+		nfs_file_size = size;
 
 	return rlen;
 }
@@ -732,6 +913,7 @@ static void nfs_timeout_handler(void)
 		net_start_again();
 	} else {
 		puts("T ");
+		nfs_stats.timeouts++;
 		net_set_timeout_handler(nfs_timeout +
 					NFS_TIMEOUT * nfs_timeout_count,
 					nfs_timeout_handler);
@@ -747,7 +929,8 @@ static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 
 	debug("%s\n", __func__);
 
-	if (len > sizeof(struct rpc_t))
+	/* READ replies may be larger, see nfs_max_read_size() */
+	if (len > sizeof(struct rpc_t) && nfs_state != STATE_READ_REQ)
 		return;
 
 	if (dest != nfs_our_port)
@@ -814,9 +997,7 @@ static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			nfs_send();
 		} else {
 			nfs_state = STATE_READ_REQ;
-			nfs_offset = 0;
-			nfs_len = NFS_READ_SIZE;
-			nfs_send();
+			nfs_read_start();
 		}
 		break;
 
@@ -843,16 +1024,17 @@ static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		if (rlen == -NFS_RPC_DROP)
 			break;
 		net_set_timeout_handler(nfs_timeout, nfs_timeout_handler);
-		if (rlen > 0) {
-			nfs_offset += rlen;
-			nfs_send();
+		if (rlen >= 0 && nfs_read_fill()) {
+			break;
 		} else if ((rlen == -NFSERR_ISDIR) || (rlen == -NFSERR_INVAL)) {
 			/* symbolic link */
 			nfs_state = STATE_READLINK_REQ;
 			nfs_send();
 		} else {
-			if (!rlen)
+			if (rlen >= 0) {
+				nfs_read_complete();
 				nfs_download_state = NETLOOP_SUCCESS;
+			}
 			if (rlen < 0)
 				debug("NFS READ error (%d)\n", rlen);
 			nfs_state = STATE_UMOUNT_REQ;
@@ -15,6 +15,7 @@
 #include <mapmem.h>
 #include <net.h>
 #include <asm/global_data.h>
+#include <linux/bitops.h>
 #include <net/tftp.h>
 #include "bootp.h"
 #ifdef CONFIG_SYS_DIRECT_FLASH_TFTP
@@ -27,6 +28,8 @@ DECLARE_GLOBAL_DATA_PTR;
 #define WELL_KNOWN_PORT	69
 /* Millisecs to timeout for lost pkt */
 #define TIMEOUT		5000UL
+/* Fraction of the timeout to wait for the rest of a window */
+#define WINDOW_TIMEOUT_DIV	10
 #ifndef	CONFIG_NET_RETRY_COUNT
 /* # of timeouts before giving up */
 # define TIMEOUT_COUNT	10
@@ -102,8 +105,26 @@ static short	tftp_tsize_num_hash;
 static ushort	tftp_windowsize;
 /* Next block to send ack to */
 static ushort	tftp_next_ack;
-/* Last nack block we send */
-static ushort	tftp_last_nack;
+/* Whether we have asked for a resend of the blocks after tftp_cur_block */
+static bool	tftp_resend_asked;
+/* Block ending the window in which we last saw a gap */
+static ushort	tftp_gap_window_end;
+/* Number of the short block ending the file, counted from 1, or 0 if unknown */
+static ulong	tftp_final_block;
+/* Number of blocks in tftp_ahead */
+static uint	tftp_ahead_count;
+/* Window size to ask for, adapted to the loss seen on earlier transfers */
+static ushort	tftp_window_size_adapt;
+
+/* Statistics for the current transfer */
+static struct {
+	ulong blocks;		/* blocks received */
+	ulong ahead;		/* blocks received before the one expected */
+	ulong dups;		/* blocks received more than once */
+	ulong dropped;		/* blocks too far ahead to keep */
+	ulong resends;		/* resends we asked for */
+	ulong timeouts;		/* timeouts waiting for a block */
+} tftp_stats;
 #ifdef CONFIG_CMD_TFTPPUT
 /* 1 if writing, else 0 */
 static int	tftp_put_active;
@@ -126,6 +147,17 @@ static int	tftp_put_final_block_sent;
 #define TFTP_BLOCK_SIZE		512
 /* sequence number is 16 bit */
 #define TFTP_SEQUENCE_SIZE	((ulong)(1<<16))
+/*
+ * How far ahead of the expected block we keep blocks that arrive early. This
+ * must divide TFTP_SEQUENCE_SIZE so that the bitmap index survives a wrap.
+ */
+#define TFTP_AHEAD_MAX		1024
+
+/*
+ * Blocks received early, indexed by block number modulo TFTP_AHEAD_MAX. This is
+ * sized with BITS_PER_LONG, as the bitops are.
+ */
+static ulong tftp_ahead[TFTP_AHEAD_MAX / BITS_PER_LONG];
 
 #define DEFAULT_NAME_LEN	(8 + 4 + 1)
 static char default_filename[DEFAULT_NAME_LEN];
@@ -158,10 +190,10 @@ static unsigned short tftp_block_size = TFTP_BLOCK_SIZE;
 static unsigned short tftp_block_size_option = CONFIG_TFTP_BLOCKSIZE;
 static unsigned short tftp_window_size_option = TFTP_WINDOWSIZE;
 
-static inline int store_block(int block, uchar *src, unsigned int len)
+/* Store a block, numbered from 1 at the start of the file without wrapping */
+static inline int store_block(ulong block, uchar *src, unsigned int len)
 {
-	ulong offset = block * tftp_block_size + tftp_block_wrap_offset -
-			tftp_block_size;
+	ulong offset = (block - 1) * tftp_block_size;
 	ulong newsize = offset + len;
 	ulong store_addr = tftp_load_addr + offset;
 #ifdef CONFIG_SYS_DIRECT_FLASH_TFTP
@@ -218,6 +250,11 @@ static void new_transfer(void)
 	tftp_prev_block = 0;
 	tftp_block_wrap = 0;
 	tftp_block_wrap_offset = 0;
+	tftp_resend_asked = false;
+	tftp_final_block = 0;
+	tftp_ahead_count = 0;
+	memset(tftp_ahead, '\0', sizeof(tftp_ahead));
+	memset(&tftp_stats, '\0', sizeof(tftp_stats));
 #ifdef CONFIG_CMD_TFTPPUT
 	tftp_put_final_block_sent = 0;
 #endif
@@ -249,6 +286,7 @@ static int load_block(unsigned block, uchar *dst, unsigned len)
 
 static void tftp_send(void);
 static void tftp_timeout_handler(void);
+static void tftp_window_timeout_handler(void);
 
 /**********************************************************************/
 
@@ -311,6 +349,84 @@ static void update_block_number(void)
 	show_block_marker();
 }
 
+/* Get the number of a block from the start of the file, counting from 1 */
+static ulong tftp_file_block(ushort block)
+{
+	return tftp_block_wrap * TFTP_SEQUENCE_SIZE + tftp_cur_block +
+		(ushort)(block - tftp_cur_block);
+}
+
+/*
+ * Move on to the next block, and then past any blocks after it which have
+ * already arrived
+ */
+static void tftp_advance(void)
+{
+	int count = 0;
+
+	for (;;) {
+		tftp_prev_block = tftp_cur_block;
+		tftp_cur_block = (tftp_cur_block + 1) % TFTP_SEQUENCE_SIZE;
+		update_block_number();
+		count++;
+		if (!tftp_ahead_count ||
+		    !__test_and_clear_bit((tftp_cur_block + 1) % TFTP_AHEAD_MAX,
+					  tftp_ahead))
+			break;
+		tftp_ahead_count--;
+	}
+	tftp_resend_asked = false;
+	tftp_stats.blocks += count;
+}
+
+/* Check whether we have reached the block at which the window ends */
+static bool tftp_window_done(void)
+{
+	return (ushort)(tftp_cur_block - tftp_next_ack) < TFTP_SEQUENCE_SIZE / 2;
+}
+
+/*
+ * Ask for the rest of the window again, since the server starts a new window
+ * after whichever block we acknowledge
+ */
+static void tftp_ask_resend(void)
+{
+	tftp_send();
+	tftp_resend_asked = true;
+	tftp_gap_window_end = tftp_next_ack;
+	tftp_next_ack = tftp_cur_block + tftp_windowsize;
+	tftp_stats.resends++;
+}
+
+/*
+ * Pick the window size to ask for next time. The window is fixed once the
+ * server accepts it, so this halves it after a transfer which needed resends
+ * in more than a quarter of its windows, typically because the receive ring
+ * overflows, and grows it by a quarter after one which needed them in fewer
+ * than one in 16.
+ *
+ * @failed: true if the transfer is being restarted after too many timeouts
+ */
+static void tftp_window_update(bool failed)
+{
+	ulong losses = tftp_stats.resends + tftp_stats.timeouts;
+	ulong windows = tftp_stats.blocks / tftp_windowsize + 1;
+	ushort size = tftp_window_size_adapt;
+
+	/* Nothing to adapt if the server did not agree to a window */
+	if (tftp_windowsize < 2)
+		return;
+	if (failed || losses * 4 > windows)
+		size = max(tftp_windowsize / 2, 2);
+	else if (losses * 16 < windows)
+		size = min(size + max(size / 4, 1),
+			   (int)tftp_window_size_option);
+	if (size != tftp_window_size_adapt)
+		debug("TFTP window size %d -> %d\n", tftp_window_size_adapt,
+		      size);
+	tftp_window_size_adapt = size;
+}
+
 /* The TFTP get or put is complete */
 static void tftp_complete(void)
 {
@@ -329,6 +445,13 @@ static void tftp_complete(void)
 		print_size(net_boot_file_size /
 			time_start * 1000, "/s");
 	}
+	if (!tftp_put_active) {
+		printf("\n\t %lu blocks, window %d: %lu early, %lu duplicate, %lu dropped, %lu resent, %lu timeouts",
+		       tftp_stats.blocks, tftp_windowsize, tftp_stats.ahead,
+		       tftp_stats.dups, tftp_stats.dropped,
+		       tftp_stats.resends, tftp_stats.timeouts);
+		tftp_window_update(false);
+	}
 	puts("\ndone\n");
 	if (IS_ENABLED(CONFIG_CMD_BOOTEFI)) {
 		if (!tftp_put_active)
@@ -386,9 +509,9 @@ static void tftp_send(void)
 		 * Implemented only for tftp get.
 		 * Don't bother sending if it's 1
 		 */
-		if (tftp_state == STATE_SEND_RRQ && tftp_window_size_option > 1)
+		if (tftp_state == STATE_SEND_RRQ && tftp_window_size_adapt > 1)
 			pkt += sprintf((char *)pkt, "windowsize%c%d%c",
-					0, tftp_window_size_option, 0);
+					0, tftp_window_size_adapt, 0);
 		len = pkt - xp;
 		break;
 
@@ -472,6 +595,59 @@ static void icmp_handler(unsigned type, unsigned code, unsigned dest,
 }
 #endif
 
+/*
+ * Handle a data block other than the one expected next. Blocks a little way
+ * ahead are stored straight away and remembered, so that once the gap before
+ * them is filled we can acknowledge past them and the server need not send
+ * them again.
+ */
+static void tftp_data_ahead(ushort block, uchar *src, unsigned len)
+{
+	ushort ahead = block - tftp_cur_block;
+	ulong file_block;
+	bool dup;
+
+	debug("Received unexpected block: %d, expected: %d\n", block,
+	      (ushort)(tftp_cur_block + 1));
+	if (!ahead || ahead >= TFTP_SEQUENCE_SIZE / 2) {
+		/* Resent after we had already received it */
+		tftp_stats.dups++;
+		return;
+	}
+	if (ahead >= TFTP_AHEAD_MAX) {
+		tftp_stats.dropped++;
+		return;
+	}
+
+	dup = __test_and_set_bit(block % TFTP_AHEAD_MAX, tftp_ahead);
+	if (dup) {
+		tftp_stats.dups++;
+	} else {
+		file_block = tftp_file_block(block);
+		if (store_block(file_block, src, len)) {
+			eth_halt();
+			net_set_state(NETLOOP_FAIL);
+			return;
+		}
+		if (len < tftp_block_size)
+			tftp_final_block = file_block;
+		tftp_ahead_count++;
+		tftp_stats.ahead++;
+	}
+
+	/*
+	 * Ask for a resend from the gap as soon as we see it. If the resent
+	 * window ends without filling the gap, ask again rather than waiting
+	 * for the timeout. If that window ends where the one which showed the
+	 * gap did, only a repeat of its last block shows that it was resent.
+	 */
+	if (!tftp_resend_asked ||
+	    ((ushort)(block - tftp_next_ack) < TFTP_SEQUENCE_SIZE / 2 &&
+	     (dup || block != tftp_next_ack ||
+	      tftp_next_ack != tftp_gap_window_end)))
+		tftp_ask_resend();
+}
+
 static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			 unsigned src, unsigned len)
 {
@@ -479,6 +655,7 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 	__be16 *s;
 	int i;
 	u16 timeout_val_rcvd;
+	ushort block;
 
 	if (dest != tftp_our_port) {
 			return;
@@ -605,29 +782,17 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		if (len < 2)
 			return;
 		len -= 2;
+		block = ntohs(*(__be16 *)pkt);
 
-		if (ntohs(*(__be16 *)pkt) != (ushort)(tftp_cur_block + 1)) {
-			debug("Received unexpected block: %d, expected: %d\n",
-			      ntohs(*(__be16 *)pkt),
-			      (ushort)(tftp_cur_block + 1));
-			/*
-			 * If one packet is dropped most likely
-			 * all other buffers in the window
-			 * that will arrive will cause a sending NACK.
-			 * This just overwellms the server, let's just send one.
-			 */
-			if (tftp_last_nack != tftp_cur_block) {
-				tftp_send();
-				tftp_last_nack = tftp_cur_block;
-				tftp_next_ack = (ushort)(tftp_cur_block +
-							 tftp_windowsize);
-			}
+		if (block != (ushort)(tftp_cur_block + 1)) {
+			if (tftp_state == STATE_DATA)
+				tftp_data_ahead(block, pkt + 2, len);
+			else
+				debug("Received unexpected block: %d, expected: %d\n",
+				      block, (ushort)(tftp_cur_block + 1));
 			break;
 		}
 
-		tftp_cur_block++;
-		tftp_cur_block %= TFTP_SEQUENCE_SIZE;
-
 		if (tftp_state == STATE_SEND_RRQ) {
 			debug("Server did not acknowledge any options!\n");
 			tftp_next_ack = tftp_windowsize;
@@ -640,33 +805,29 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			tftp_remote_port = src;
 			new_transfer();
 
-			if (tftp_cur_block != 1) {	/* Assertion */
+			if (block != 1) {	/* Assertion */
 				puts("\nTFTP error: ");
-				printf("First block is not block 1 (%ld)\n",
-				       tftp_cur_block);
+				printf("First block is not block 1 (%d)\n",
+				       block);
 				puts("Starting again\n\n");
 				net_start_again();
 				break;
 			}
 		}
 
-		if (tftp_cur_block == tftp_prev_block) {
-			/* Same block again; ignore it. */
-			break;
-		}
-
-		update_block_number();
-		tftp_prev_block = tftp_cur_block;
 		timeout_count_max = tftp_timeout_count_max;
-		net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
 
-		if (store_block(tftp_cur_block, pkt + 2, len)) {
+		if (store_block(tftp_file_block(block), pkt + 2, len)) {
 			eth_halt();
 			net_set_state(NETLOOP_FAIL);
 			break;
 		}
+		if (len < tftp_block_size)
+			tftp_final_block = tftp_file_block(block);
 
-		if (len < tftp_block_size) {
+		tftp_advance();
+		if (tftp_final_block &&
+		    tftp_file_block(tftp_cur_block) == tftp_final_block) {
 			tftp_send();
 			tftp_complete();
 			break;
@@ -674,12 +835,23 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 
 		/*
 		 *	Acknowledge the block just received, which will prompt
-		 *	the remote for the next one.
+		 *	the remote for the next window.
 		 */
-		if (tftp_cur_block == tftp_next_ack) {
+		if (tftp_window_done()) {
 			tftp_send();
-			tftp_next_ack += tftp_windowsize;
+			tftp_next_ack = tftp_cur_block + tftp_windowsize;
 		}
+
+		/*
+		 * The server sends a window all at once, so if the rest of it
+		 * does not follow soon, its tail was lost
+		 */
+		if ((ushort)(tftp_next_ack - tftp_cur_block) < tftp_windowsize)
+			net_set_timeout_handler(timeout_ms / WINDOW_TIMEOUT_DIV,
+						tftp_window_timeout_handler);
+		else
+			net_set_timeout_handler(timeout_ms,
+						tftp_timeout_handler);
 		break;
 
 	case TFTP_ERROR:
@@ -711,15 +883,33 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 static void tftp_timeout_handler(void)
 {
 	if (++timeout_count > timeout_count_max) {
+		if (tftp_state == STATE_DATA && !tftp_put_active)
+			tftp_window_update(true);
 		restart("Retry count exceeded");
 	} else {
 		puts("T ");
 		net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
+		if (tftp_state == STATE_DATA && !tftp_put_active) {
+			/* The server resends a whole window after our ACK */
+			tftp_stats.timeouts++;
+			tftp_next_ack = tftp_cur_block + tftp_windowsize;
+		}
 		if (tftp_state != STATE_RECV_WRQ)
 			tftp_send();
 	}
 }
 
+/*
+ * Ask for the rest of a window whose tail was lost, rather than waiting for a
+ * full timeout. If we already asked, wait for that in the normal way.
+ */
+static void tftp_window_timeout_handler(void)
+{
+	net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
+	if (!tftp_resend_asked)
+		tftp_ask_resend();
+}
+
 /* Initialize tftp_load_addr and tftp_load_size from image_load_addr and lmb */
 static int tftp_init_load_addr(void)
 {
@@ -873,7 +1063,9 @@ void tftp_start(enum proto_t protocol)
 #endif
 	tftp_cur_block = 0;
 	tftp_windowsize = 1;
-	tftp_last_nack = 0;
+	if (!tftp_window_size_adapt ||
+	    tftp_window_size_adapt > tftp_window_size_option)
+		tftp_window_size_adapt = tftp_window_size_option;
 	/* zero out server ether in case the server ip has changed */
 	memset(net_server_ethaddr, 0, 6);
 	/* Revert tftp_block_size to dflt */
@@ -911,6 +1103,7 @@ void tftp_start_server(void)
 	/* Revert tftp_block_size to dflt */
 	tftp_block_size = TFTP_BLOCK_SIZE;
 	tftp_cur_block = 0;
+	tftp_windowsize = 1;
 	tftp_our_port = WELL_KNOWN_PORT;
 
 #ifdef CONFIG_TFTP_TSIZE
@@ -7,7 +7,13 @@
 
 #include <common.h>
 #include <bootm.h>
+#include <bootstage.h>
+#include <hash.h>
+#include <image.h>
+#include <malloc.h>
+#include <mapmem.h>
 #include <asm/global_data.h>
+#include <linux/libfdt.h>
 #include <test/suites.h>
 #include <test/test.h>
 #include <test/ut.h>
@@ -238,6 +244,124 @@ static int bootm_test_subst_both(struct unit_test_state *uts)
 }
 BOOTM_TEST(bootm_test_subst_both, 0);
 
+enum {
+	FIT_BUF_SIZE	= 0x4000,
+	FIT_DATA_SIZE	= 0x800,
+};
+
+/* Add an image to a FIT, with a SHA256 hash of its data */
+static int bootm_add_fit_image(struct unit_test_state *uts, void *fit,
+			       int images, const char *name, const char *type,
+			       u8 fill)
+{
+	uint8_t value[FIT_MAX_HASH_LEN];
+	int value_len = sizeof(value);
+	char data[FIT_DATA_SIZE];
+	int node, hash;
+
+	memset(data, fill, sizeof(data));
+	if (!strcmp(type, "flat_dt"))
+		ut_assertok(fdt_create_empty_tree(data, sizeof(data)));
+	ut_assertok(hash_block("sha256", data, sizeof(data), value,
+			       &value_len));
+
+	node = fdt_add_subnode(fit, images, name);
+	ut_assert(node >= 0);
+	ut_assertok(fdt_setprop_string(fit, node, FIT_TYPE_PROP, type));
+	ut_assertok(fdt_setprop_string(fit, node, FIT_OS_PROP, "linux"));
+	ut_assertok(fdt_setprop_string(fit, node, FIT_ARCH_PROP, "sandbox"));
+	ut_assertok(fdt_setprop_string(fit, node, FIT_COMP_PROP, "none"));
+	ut_assertok(fdt_setprop(fit, node, FIT_DATA_PROP, data, sizeof(data)));
+	hash = fdt_add_subnode(fit, node, "hash-1");
+	ut_assert(hash >= 0);
+	ut_assertok(fdt_setprop_string(fit, hash, FIT_ALGO_PROP, "sha256"));
+	ut_assertok(fdt_setprop(fit, hash, FIT_VALUE_PROP, value, value_len));
+
+	return 0;
+}
+
+/* Load the kernel and ramdisk of the default configuration of a FIT */
+static int bootm_load_fit(struct unit_test_state *uts, void *fit,
+			  int *pendingp)
+{
+	const char *conf = NULL;
+	bootm_headers_t images;
+	ulong data, len;
+	int ret;
+
+	memset(&images, '\0', sizeof(images));
+	images.verify = 1;
+	ret = fit_image_load(&images, map_to_sysmem(fit), NULL, &conf,
+			     IH_ARCH_DEFAULT, IH_TYPE_KERNEL,
+			     BOOTSTAGE_ID_FIT_KERNEL_START, FIT_LOAD_IGNORED,
+			     &data, &len);
+	ut_assert(ret >= 0);
+	*pendingp = fit_image_hash_pending();
+
+	ret = fit_image_load(&images, map_to_sysmem(fit), NULL, &conf,
+			     IH_ARCH_DEFAULT, IH_TYPE_RAMDISK,
+			     BOOTSTAGE_ID_FIT_RD_START, FIT_LOAD_IGNORED,
+			     &data, &len);
+	fit_image_hash_drop();
+
+	return ret < 0 ? ret : 0;
+}
+
+/* Test that bootm hashes the images of a configuration in parallel */
+static int bootm_test_fit_hash(struct unit_test_state *uts)
+{
+	int images, confs, conf, node, pending;
+	const void *data;
+	size_t size;
+	void *fit;
+
+	if (!IS_ENABLED(CONFIG_MP_JOB))
+		return -EAGAIN;
+
+	fit = malloc(FIT_BUF_SIZE);
+	ut_assertnonnull(fit);
+	ut_assertok(fdt_create_empty_tree(fit, FIT_BUF_SIZE));
+	ut_assertok(fdt_setprop_string(fit, 0, FIT_DESC_PROP, "test"));
+	ut_assertok(fdt_setprop_u32(fit, 0, FIT_TIMESTAMP_PROP, 0));
+	images = fdt_add_subnode(fit, 0, "images");
+	ut_assert(images >= 0);
+	ut_assertok(bootm_add_fit_image(uts, fit, images, "kernel-1", "kernel",
+					0x11));
+	ut_assertok(bootm_add_fit_image(uts, fit, images, "ramdisk-1",
+					"ramdisk", 0x22));
+	ut_assertok(bootm_add_fit_image(uts, fit, images, "fdt-1", "flat_dt",
+					0));
+
+	confs = fdt_add_subnode(fit, 0, FIT_CONFS_PATH + 1);
+	ut_assert(confs >= 0);
+	ut_assertok(fdt_setprop_string(fit, confs, FIT_DEFAULT_PROP, "conf-1"));
+	conf = fdt_add_subnode(fit, confs, "conf-1");
+	ut_assert(conf >= 0);
+	ut_assertok(fdt_setprop_string(fit, conf, FIT_KERNEL_PROP,
+				       "kernel-1"));
+	ut_assertok(fdt_setprop_string(fit, conf, FIT_RAMDISK_PROP,
+				       "ramdisk-1"));
+	ut_assertok(fdt_setprop_string(fit, conf, FIT_FDT_PROP, "fdt-1"));
+
+	/* Loading the kernel leaves the ramdisk and FDT hashes in flight */
+	ut_assertok(bootm_load_fit(uts, fit, &pending));
+	ut_asserteq(2, pending);
+	ut_asserteq(0, fit_image_hash_pending());
+
+	/* A bad ramdisk must still be caught */
+	node = fdt_path_offset(fit, "/images/ramdisk-1");
+	ut_assert(node >= 0);
+	ut_assertok(fit_image_get_data_and_size(fit, node, &data, &size));
+	((u8 *)data)[size - 1] ^= 1;
+	ut_asserteq(-EACCES, bootm_load_fit(uts, fit, &pending));
+	ut_asserteq(2, pending);
+
+	free(fit);
+
+	return 0;
+}
+BOOTM_TEST(bootm_test_fit_hash, 0);
+
 int do_ut_bootm(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
 {
 	struct unit_test *tests = UNIT_TEST_SUITE_START(bootm_test);
@@ -13,6 +13,8 @@
 
 static int do_ut_all(struct cmd_tbl *cmdtp, int flag, int argc,
 		     char *const argv[]);
+static int do_ut_bench(struct cmd_tbl *cmdtp, int flag, int argc,
+		       char *const argv[]);
 
 int cmd_ut_category(const char *name, const char *prefix,
 		    struct unit_test *tests, int n_ents,
@@ -89,6 +91,15 @@ static int do_ut_all(struct cmd_tbl *cmdtp, int flag, int argc,
 	return any_fail;
 }
 
+static int do_ut_bench(struct cmd_tbl *cmdtp, int flag, int argc,
+		       char *const argv[])
+{
+	struct unit_test *tests = UNIT_TEST_SUITE_START(bench);
+	const int n_ents = UNIT_TEST_SUITE_COUNT(bench);
+
+	return cmd_ut_category("bench", "bench_", tests, n_ents, argc, argv);
+}
+
 static int do_ut(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
 {
 	struct cmd_tbl *cp;
@@ -100,6 +111,10 @@ static int do_ut(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
 	argc--;
 	argv++;
 
+	/* Benchmarks are not in cmd_ut_sub so that 'ut all' skips them */
+	if (!strcmp(argv[0], "bench"))
+		return do_ut_bench(cmdtp, flag, argc, argv);
+
 	cp = find_cmd_tbl(argv[0], cmd_ut_sub, ARRAY_SIZE(cmd_ut_sub));
 
 	if (cp)
@@ -111,6 +126,7 @@ static int do_ut(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
 #ifdef CONFIG_SYS_LONGHELP
 static char ut_help_text[] =
 	"all - execute all enabled tests\n"
+	"ut bench [test-name] - run benchmarks, which 'all' leaves out\n"
 #ifdef CONFIG_SANDBOX
 	"ut bloblist - Test bloblist implementation\n"
 	"ut compression - Test compressors and bootm decompression\n"
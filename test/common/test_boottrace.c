@@ -0,0 +1,157 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the boot timeline
+ *
+ * Copyright 2023 NXP
+ */
+
+#include <common.h>
+#include <bootstage.h>
+#include <boottrace.h>
+#include <malloc.h>
+#include <mapmem.h>
+#include <test/common.h>
+#include <test/test.h>
+#include <test/ut.h>
+#include <linux/libfdt.h>
+
+#define TEST_ID		(BOOTSTAGE_ID_USER + 200)
+
+/* Find an event in an exported timeline, returning NULL if not found */
+static struct trace_output_event *find_event(void *buf,
+					     enum trace_event_type type,
+					     u32 id)
+{
+	struct trace_output_hdr *hdr = buf;
+	struct trace_output_event *ev = (void *)(hdr + 1);
+	size_t i;
+
+	for (i = 0; i < hdr->rec_count; i++, ev++) {
+		if (ev->type == type && ev->id == id)
+			return ev;
+	}
+
+	return NULL;
+}
+
+/* Find a name in an exported timeline, returning NULL if not found */
+static const char *find_name(void *buf, enum trace_event_type type, u32 id)
+{
+	struct trace_output_hdr *hdr = buf;
+	struct trace_output_name *name;
+	void *ptr;
+	size_t i;
+
+	ptr = hdr + 1;
+	hdr = ptr + hdr->rec_count * sizeof(struct trace_output_event);
+	if (hdr->type != TRACE_CHUNK_NAMES)
+		return NULL;
+	ptr = hdr + 1;
+	for (i = 0; i < hdr->rec_count; i++) {
+		name = ptr;
+		if (name->type == type && name->id == id)
+			return (const char *)(name + 1);
+		ptr += sizeof(*name) + name->len;
+	}
+
+	return NULL;
+}
+
+static int test_boottrace_export(struct unit_test_state *uts)
+{
+	struct trace_output_event *ev;
+	struct trace_output_hdr *hdr;
+	size_t needed, size;
+	ulong start;
+	void *buf;
+
+	boottrace_clear();
+	start = bootstage_start(TEST_ID, "boottrace_test");
+	bootstage_accum(TEST_ID);
+	bootstage_error(TEST_ID + 1);
+	boottrace_add(TRACE_EV_NET_START, 0, 0, 3, 0);
+	boottrace_add(TRACE_EV_NET_END, 0, 0, 3, 1234);
+
+	ut_asserteq(-ENOSPC, boottrace_export(NULL, 0, &size));
+	buf = malloc(size);
+	ut_assertnonnull(buf);
+	ut_assertok(boottrace_export(buf, size, &needed));
+	ut_asserteq(size, needed);
+
+	hdr = buf;
+	ut_asserteq(TRACE_CHUNK_EVENTS, hdr->type);
+	ut_asserteq(5, hdr->rec_count);
+
+	ev = find_event(buf, TRACE_EV_STAGE_START, TEST_ID);
+	ut_assertnonnull(ev);
+	ut_asserteq((u32)start, ev->time_us);
+	ut_assert(ev[1].type == TRACE_EV_STAGE_END);
+	ut_assert(ev[1].time_us >= ev->time_us);
+
+	ev = find_event(buf, TRACE_EV_MARK, TEST_ID + 1);
+	ut_assertnonnull(ev);
+	ut_asserteq(TRACE_EVF_ERROR, ev->flags);
+
+	ev = find_event(buf, TRACE_EV_NET_END, 3);
+	ut_assertnonnull(ev);
+	ut_asserteq(1234, ev->arg);
+
+	/* Names cover all bootstage records, not just those in the buffer */
+	ut_asserteq_str("reset",
+			find_name(buf, TRACE_EV_MARK, BOOTSTAGE_ID_AWAKE));
+
+	ut_asserteq(-ENOSPC, boottrace_export(buf, size - 1, &needed));
+	ut_asserteq(size, needed);
+	free(buf);
+
+	return 0;
+}
+COMMON_TEST(test_boottrace_export, 0);
+
+static int test_boottrace_stash(struct unit_test_state *uts)
+{
+	struct boottrace_stash_hdr *hdr;
+	const fdt64_t *reg;
+	char fdt[1024];
+	u64 addr, size;
+	size_t needed;
+	int chosen;
+	void *buf;
+	int len;
+
+	boottrace_clear();
+	bootstage_mark_name(TEST_ID + 2, "boottrace_stash");
+	ut_asserteq(-ENOSPC, boottrace_export(NULL, 0, &needed));
+
+	buf = malloc(needed + sizeof(*hdr));
+	ut_assertnonnull(buf);
+	ut_assertok(fdt_create_empty_tree(fdt, sizeof(fdt)));
+	ut_asserteq(-EINVAL, boottrace_stash(fdt, 0, needed + sizeof(*hdr)));
+	ut_asserteq(-ENOSPC, boottrace_stash(fdt, map_to_sysmem(buf),
+					     needed));
+	ut_assertok(boottrace_stash(fdt, map_to_sysmem(buf),
+				    needed + sizeof(*hdr)));
+
+	hdr = buf;
+	ut_asserteq(BOOTTRACE_MAGIC, hdr->magic);
+	ut_asserteq(needed, hdr->size);
+	ut_assertnonnull(find_event(hdr + 1, TRACE_EV_MARK, TEST_ID + 2));
+
+	/* The empty tree has two address and two size cells */
+	chosen = fdt_path_offset(fdt, "/chosen");
+	ut_assert(chosen >= 0);
+	reg = fdt_getprop(fdt, chosen, "u-boot,boottrace", &len);
+	ut_assertnonnull(reg);
+	ut_asserteq(2 * sizeof(*reg), len);
+	ut_asserteq(map_to_sysmem(buf), fdt64_to_cpu(reg[0]));
+	ut_asserteq(needed + sizeof(*hdr), fdt64_to_cpu(reg[1]));
+
+	ut_asserteq(1, fdt_num_mem_rsv(fdt));
+	ut_assertok(fdt_get_mem_rsv(fdt, 0, &addr, &size));
+	ut_asserteq(map_to_sysmem(buf), addr);
+	ut_asserteq(needed + sizeof(*hdr), size);
+	free(buf);
+
+	return 0;
+}
+COMMON_TEST(test_boottrace_stash, 0);
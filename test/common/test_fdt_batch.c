@@ -0,0 +1,151 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for batched device tree fixups
+ *
+ * Copyright 2023 NXP
+ */
+
+#include <common.h>
+#include <fdt_support.h>
+#include <test/common.h>
+#include <test/test.h>
+#include <test/ut.h>
+#include <linux/libfdt.h>
+
+#define FDT_BUF_SIZE	8192
+#define FDT_TREE_SIZE	2048
+
+static const char dev_compat[] = "test,dev\0test,other";
+static const char model[] = "A model name which is longer than the others";
+
+/* Build the tree which both sets of fixups are applied to */
+static int make_tree(struct unit_test_state *uts, void *fdt)
+{
+	int soc, node;
+
+	ut_assertok(fdt_create_empty_tree(fdt, FDT_TREE_SIZE));
+	ut_assertok(fdt_setprop_string(fdt, 0, "compatible", "test,root"));
+	soc = fdt_add_subnode(fdt, 0, "soc");
+	ut_assert(soc >= 0);
+
+	node = fdt_add_subnode(fdt, soc, "dev@1000");
+	ut_assert(node >= 0);
+	ut_assertok(fdt_setprop(fdt, node, "compatible", dev_compat,
+				sizeof(dev_compat)));
+	ut_assertok(fdt_setprop_string(fdt, node, "status", "okay"));
+	ut_assertok(fdt_setprop_u32(fdt, node, "clock-frequency", 1));
+
+	node = fdt_add_subnode(fdt, soc, "dev@2000");
+	ut_assert(node >= 0);
+	ut_assertok(fdt_setprop_string(fdt, node, "compatible", "test,dev"));
+
+	node = fdt_add_subnode(fdt, soc, "phy");
+	ut_assert(node >= 0);
+	ut_assertok(fdt_setprop_u32(fdt, node, "phandle", 5));
+	ut_assertok(fdt_setprop_u32(fdt, node, "reg", 1));
+
+	node = fdt_add_subnode(fdt, soc, "gpio");
+	ut_assert(node >= 0);
+	ut_assertok(fdt_setprop_string(fdt, node, "compatible", "test,gpio"));
+	ut_assertok(fdt_setprop_u32(fdt, node, "phandle", 7));
+
+	node = fdt_add_subnode(fdt, 0, "aliases");
+	ut_assert(node >= 0);
+	ut_assertok(fdt_setprop_string(fdt, node, "phy0", "/soc/phy"));
+
+	return 0;
+}
+
+/* Check that two trees have the same nodes and properties */
+static int compare_trees(struct unit_test_state *uts, const void *a,
+			 const void *b)
+{
+	int oa, ob, da = 0, db = 0, pa, pb, la, lb;
+	const char *na, *nb;
+	const void *va, *vb;
+
+	/* The depth drops below zero at the end of the root node */
+	for (oa = 0, ob = 0; oa >= 0 && ob >= 0 && da >= 0 && db >= 0;
+	     oa = fdt_next_node(a, oa, &da), ob = fdt_next_node(b, ob, &db)) {
+		ut_asserteq_str(fdt_get_name(a, oa, NULL),
+				fdt_get_name(b, ob, NULL));
+		ut_asserteq(da, db);
+
+		for (pa = fdt_first_property_offset(a, oa),
+		     pb = fdt_first_property_offset(b, ob);
+		     pa >= 0 && pb >= 0;
+		     pa = fdt_next_property_offset(a, pa),
+		     pb = fdt_next_property_offset(b, pb)) {
+			va = fdt_getprop_by_offset(a, pa, &na, &la);
+			vb = fdt_getprop_by_offset(b, pb, &nb, &lb);
+			ut_asserteq_str(na, nb);
+			ut_asserteq(la, lb);
+			ut_asserteq_mem(va, vb, la);
+		}
+		ut_asserteq(pa, pb);
+	}
+	ut_asserteq(da, db);
+	ut_asserteq(oa, ob);
+
+	return 0;
+}
+
+static int test_fdt_batch(struct unit_test_state *uts)
+{
+	char old[FDT_BUF_SIZE], new[FDT_BUF_SIZE];
+	struct fdt_batch fb;
+	int node, count;
+
+	ut_assertok(make_tree(uts, old));
+	ut_assertok(make_tree(uts, new));
+
+	/* The existing helpers, one change at a time */
+	do_fixup_by_compat(old, "test,dev", "status", "disabled",
+			   sizeof("disabled"), 1);
+	do_fixup_by_compat_u32(old, "test,dev", "clock-frequency", 24000000,
+			       0);
+	do_fixup_by_path(old, "/soc/dev", "label", "first", sizeof("first"),
+			 1);
+	do_fixup_by_path_u32(old, "phy0", "reg", 3, 0);
+	node = fdt_node_offset_by_phandle(old, 7);
+	ut_assertok(fdt_delprop(old, node, "phandle"));
+	ut_assertok(fdt_status_disabled(old, node));
+	ut_assertok(fdt_setprop_string(old, 0, "model", model));
+
+	/* The same changes, queued and made in one go */
+	ut_assertok(fdt_batch_init(&fb, new));
+	ut_asserteq(fdt_path_offset(new, "/soc/dev@2000"),
+		    fdt_batch_path_offset(&fb, "/soc/dev@2000"));
+	ut_asserteq(fdt_path_offset(new, "phy0"),
+		    fdt_batch_path_offset(&fb, "phy0"));
+	ut_asserteq(-FDT_ERR_NOTFOUND, fdt_batch_path_offset(&fb, "/soc/none"));
+	ut_asserteq(fdt_node_offset_by_phandle(new, 5),
+		    fdt_batch_node_by_phandle(&fb, 5));
+	ut_asserteq(-FDT_ERR_NOTFOUND, fdt_batch_node_by_phandle(&fb, 6));
+	count = 0;
+	fdt_batch_for_each_compatible(node, &fb, "test,dev")
+		count++;
+	ut_asserteq(2, count);
+
+	fdt_batch_fixup_by_compat(&fb, "test,dev", "status", "disabled",
+				  sizeof("disabled"), 1);
+	fdt_batch_fixup_by_compat(&fb, "test,dev", "clock-frequency",
+				  &(fdt32_t){cpu_to_fdt32(24000000)},
+				  sizeof(fdt32_t), 0);
+	fdt_batch_fixup_by_path(&fb, "/soc/dev", "label", "first",
+				sizeof("first"), 1);
+	fdt_batch_fixup_by_path(&fb, "phy0", "reg", &(fdt32_t){cpu_to_fdt32(3)},
+				sizeof(fdt32_t), 0);
+	node = fdt_batch_node_by_phandle(&fb, 7);
+	ut_assertok(fdt_batch_delprop(&fb, node, "phandle"));
+	ut_assertok(fdt_batch_set_status(&fb, node, FDT_STATUS_DISABLED));
+	ut_assertok(fdt_batch_setprop_string(&fb, 0, "model", model));
+	ut_assertok(fdt_batch_apply(&fb));
+	fdt_batch_uninit(&fb);
+
+	ut_assertok(fdt_check_header(new));
+	ut_assertok(compare_trees(uts, old, new));
+
+	return 0;
+}
+COMMON_TEST(test_fdt_batch, 0);
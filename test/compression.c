@@ -11,17 +11,24 @@
 #include <log.h>
 #include <malloc.h>
 #include <mapmem.h>
+#include <rand.h>
+#include <time.h>
 #include <asm/io.h>
+#include <asm/unaligned.h>
+#include <linux/sizes.h>
+#include <linux/xxhash.h>
 
 #include <u-boot/lz4.h>
 #include <u-boot/zlib.h>
 #include <bzlib.h>
+#include <linux/zstd.h>
 
 #include <lzma/LzmaTypes.h>
 #include <lzma/LzmaDec.h>
 #include <lzma/LzmaTools.h>
 
 #include <linux/lzo.h>
+#include <test/bench.h>
 #include <test/compression.h>
 #include <test/suites.h>
 #include <test/ut.h>
@@ -121,6 +128,23 @@ static const char lz4_compressed[] =
 	"\x9d\x12\x8c\x9d";
 static const unsigned long lz4_compressed_size = 276;
 
+/* zstd -19 /tmp/plain.txt -o /tmp/plain.zst */
+static const char zstd_compressed[] =
+	"\x28\xb5\x2f\xfd\x64\x5e\x00\xad\x05\x00\x42\x4e\x26\x17\x90\x3b"
+	"\x07\x04\x5a\x13\x8b\xa7\x65\x34\x12\x21\x6d\xb0\x39\xbb\xae\xe8"
+	"\xba\xc9\xcd\x5e\x02\x49\xd0\x2b\xa9\xfa\x96\x92\xe7\x1f\x19\x19"
+	"\x7c\x8f\xf1\x9d\x54\x37\xfc\xd6\x0a\xf3\x0c\x93\x56\xc7\x52\x4f"
+	"\x0a\x62\x3e\xd1\xa5\x83\x17\x31\xab\x5d\x8f\x57\xf3\xcc\x3b\x58"
+	"\xf8\x91\x8c\xf1\x2a\x5c\x89\xdd\xf2\x9b\x15\xb7\x92\x5b\xbe\xba"
+	"\xab\xd5\xd1\x34\xdf\xf0\x02\x0e\x61\xcd\x7b\xd6\x01\xfc\xc2\xa7"
+	"\xd4\xd1\x3d\x26\x9c\x10\x49\xb8\x5b\xcd\xba\x7c\xf7\xac\x4b\xad"
+	"\xb7\x31\x1c\xbc\xf9\xcb\x62\x8e\x2e\x9b\x0f\xd3\x87\x57\x45\x12"
+	"\x16\xfa\x3a\x79\xde\x65\xf8\xcc\x48\xd5\x43\xa6\xbd\xc3\x91\x29"
+	"\x65\x29\xa7\x5b\x9a\x08\x08\x00\x60\x13\x00\x63\xa3\x8e\x28\x94"
+	"\x79\x41\x2a\x78\xc2\x91\x70\x9f\xaa\x6a\x21\x7a\xa1\xaa\x0c\xe4"
+	"\xf4\x6e\xfa";
+static const unsigned long zstd_compressed_size = 195;
+
 
 #define TEST_BUFFER_SIZE	512
 
@@ -296,6 +320,49 @@ static int uncompress_using_lz4(struct unit_test_state *uts,
 	return (ret != 0);
 }
 
+static int compress_using_zstd(struct unit_test_state *uts,
+			       void *in, unsigned long in_size,
+			       void *out, unsigned long out_max,
+			       unsigned long *out_size)
+{
+	/* There is no zstd compression in u-boot, so fake it. */
+	ut_asserteq(in_size,  strlen(plain));
+	ut_asserteq_mem(plain, in, in_size);
+
+	if (zstd_compressed_size > out_max)
+		return -1;
+
+	memcpy(out, zstd_compressed, zstd_compressed_size);
+	if (out_size)
+		*out_size = zstd_compressed_size;
+
+	return 0;
+}
+
+static int uncompress_using_zstd(struct unit_test_state *uts,
+				 void *in, unsigned long in_size,
+				 void *out, unsigned long out_max,
+				 unsigned long *out_size)
+{
+	struct zstd_stream zs;
+	unsigned long pos, len;
+	int ret = 0, size;
+
+	/* Feed odd-sized chunks so that blocks are split across them */
+	ut_assertok(zstd_stream_init(&zs, out, out_max));
+	for (pos = 0; pos < in_size && !ret; pos += len) {
+		len = min(in_size - pos, 7UL);
+		ret = zstd_stream_feed(&zs, in + pos, len);
+	}
+	size = zstd_stream_finish(&zs);
+	if (ret || size < 0)
+		return 1;
+	if (out_size)
+		*out_size = size;
+
+	return 0;
+}
+
 #define errcheck(statement) if (!(statement)) { \
 	fprintf(stderr, "\tFailed: %s\n", #statement); \
 	ret = 1; \
@@ -440,6 +507,267 @@ static int compression_test_lz4(struct unit_test_state *uts)
 }
 COMPRESSION_TEST(compression_test_lz4, 0);
 
+/* Frame descriptor flags used by the generated LZ4 frames */
+#define LZ4_GEN_INDEPENDENT	0x20
+#define LZ4_GEN_BLOCK_CHECKSUM	0x10
+#define LZ4_GEN_CHECKSUM	0x04
+
+/* Write the extra bytes of a literal or match length of @len + 15 */
+static u8 *lz4_gen_len(u8 *o, uint len)
+{
+	for (; len >= 255; len -= 255)
+		*o++ = 255;
+	*o++ = len;
+
+	return o;
+}
+
+/*
+ * Encode @size bytes at @pos in @plain as an LZ4 block of random literal runs
+ * and matches, filling in @plain as it goes. Matches reach back at most @hist
+ * bytes before @pos and favour the short and overlapping offsets which have
+ * their own paths in the decoder. Returns the size of the block.
+ */
+static uint lz4_gen_block(u8 *out, u8 *plain, uint pos, uint size, uint hist)
+{
+	static const uint offsets[] = { 1, 2, 3, 4, 7, 8, 15, 16 };
+	uint base = pos - hist, end = pos + size;
+	uint lit, mlen, offset, n;
+	u8 *o = out;
+	u8 *token;
+
+	while (1) {
+		lit = rand() % 8 ? rand() % 20 : rand() % 300;
+		mlen = 4 + (rand() % 8 ? rand() % 24 : rand() % 1000);
+		if (pos + lit == base)
+			lit++;
+		if (pos + lit + mlen + 12 > end)
+			break;
+
+		if (rand() % 2)
+			offset = offsets[rand() % ARRAY_SIZE(offsets)];
+		else
+			offset = 1 + rand() % SZ_64K;
+		offset = min(offset, min(pos + lit - base, SZ_64K - 1U));
+
+		token = o++;
+		*token = min(lit, 15U) << 4 | min(mlen - 4, 15U);
+		if (lit >= 15)
+			o = lz4_gen_len(o, lit - 15);
+		for (n = 0; n < lit; n++)
+			plain[pos++] = *o++ = 'a' + rand() % 26;
+		put_unaligned_le16(offset, o);
+		o += 2;
+		if (mlen - 4 >= 15)
+			o = lz4_gen_len(o, mlen - 4 - 15);
+		for (n = 0; n < mlen; n++, pos++)
+			plain[pos] = plain[pos - offset];
+	}
+
+	/* The block ends with literals only */
+	lit = end - pos;
+	*o++ = min(lit, 15U) << 4;
+	if (lit >= 15)
+		o = lz4_gen_len(o, lit - 15);
+	for (n = 0; n < lit; n++)
+		plain[pos++] = *o++ = 'a' + rand() % 26;
+
+	return o - out;
+}
+
+/*
+ * Generate an LZ4 frame holding @size bytes, which are written to @plain.
+ * @block_id is the block maximum size code (4 for 64KB to 7 for 4MB) and
+ * @flags the LZ4_GEN_... flags. Returns the size of the frame.
+ */
+static uint lz4_gen_frame(u8 *out, u8 *plain, uint size, uint block_id,
+			  uint flags)
+{
+	uint block_max = 1 << (8 + 2 * block_id);
+	uint pos, n, len;
+	u8 *o = out;
+
+	put_unaligned_le32(LZ4F_MAGIC, o);
+	o[4] = 0x40 | flags;
+	o[5] = block_id << 4;
+	o[6] = (xxh32(o + 4, 2, 0) >> 8) & 0xff;
+	o += 7;
+
+	for (pos = 0; pos < size; pos += n) {
+		n = min(size - pos, block_max);
+		len = lz4_gen_block(o + 4, plain, pos, n,
+				    flags & LZ4_GEN_INDEPENDENT ? 0 : pos);
+		put_unaligned_le32(len, o);
+		o += 4;
+		if (flags & LZ4_GEN_BLOCK_CHECKSUM) {
+			put_unaligned_le32(xxh32(o, len, 0), o + len);
+			o += 4;
+		}
+		o += len;
+	}
+	put_unaligned_le32(0, o);
+	o += 4;
+	if (flags & LZ4_GEN_CHECKSUM) {
+		put_unaligned_le32(xxh32(plain, size, 0), o);
+		o += 4;
+	}
+
+	return o - out;
+}
+
+/* Decompress generated LZ4 data and check the result */
+static int lz4_check(struct unit_test_state *uts, const u8 *in, uint in_size,
+		     const u8 *plain, uint size, u8 *out)
+{
+	size_t out_size = size;
+
+	memset(out, '\0', size);
+	ut_assertok(ulz4fn(in, in_size, out, &out_size));
+	ut_asserteq(size, out_size);
+	ut_asserteq_mem(plain, out, size);
+
+	return 0;
+}
+
+/* Check the frame variants which the 'lz4' tool can produce */
+static int compression_test_lz4_frames(struct unit_test_state *uts)
+{
+	const uint size = SZ_256K + 1234;
+	u8 *in, *plain, *out;
+	uint len, len2;
+	size_t out_size;
+
+	in = malloc(4 * size);
+	plain = malloc(2 * size);
+	out = malloc(2 * size);
+	ut_assertnonnull(in);
+	ut_assertnonnull(plain);
+	ut_assertnonnull(out);
+	srand(1234);
+
+	/* Independent blocks with all checksums */
+	len = lz4_gen_frame(in, plain, size, 4, LZ4_GEN_INDEPENDENT |
+			    LZ4_GEN_BLOCK_CHECKSUM | LZ4_GEN_CHECKSUM);
+	ut_assertok(lz4_check(uts, in, len, plain, size, out));
+
+	/* Linked blocks, whose matches reach into the block before */
+	len = lz4_gen_frame(in, plain, size, 4, LZ4_GEN_CHECKSUM);
+	ut_assertok(lz4_check(uts, in, len, plain, size, out));
+
+	/* A single large block */
+	len = lz4_gen_frame(in, plain, size, 7, LZ4_GEN_INDEPENDENT);
+	ut_assertok(lz4_check(uts, in, len, plain, size, out));
+
+	/* Output buffer too small */
+	out_size = size - 1;
+	ut_assert(ulz4fn(in, len, out, &out_size) < 0);
+
+	/* Truncated input */
+	out_size = size;
+	ut_asserteq(-EINVAL, ulz4fn(in, len - 1, out, &out_size));
+
+	/* Two frames with a skippable frame between them */
+	len = lz4_gen_frame(in, plain, size, 5, LZ4_GEN_CHECKSUM);
+	put_unaligned_le32(0x184d2a55, in + len);
+	put_unaligned_le32(3, in + len + 4);
+	len += 8 + 3;
+	len2 = lz4_gen_frame(in + len, plain + size, size, 4,
+			     LZ4_GEN_INDEPENDENT);
+	ut_assertok(lz4_check(uts, in, len + len2, plain, 2 * size, out));
+
+	if (IS_ENABLED(CONFIG_LZ4_CHECKSUM)) {
+		/* Content checksum */
+		len = lz4_gen_frame(in, plain, size, 4, LZ4_GEN_CHECKSUM);
+		in[len - 1] ^= 1;
+		out_size = size;
+		ut_asserteq(-EBADMSG, ulz4fn(in, len, out, &out_size));
+
+		/* Block checksum, with the block itself corrupted */
+		len = lz4_gen_frame(in, plain, size, 4, LZ4_GEN_INDEPENDENT |
+				    LZ4_GEN_BLOCK_CHECKSUM);
+		in[20] ^= 1;
+		out_size = size;
+		ut_asserteq(-EBADMSG, ulz4fn(in, len, out, &out_size));
+
+		/* Header checksum */
+		in[6] ^= 1;
+		out_size = size;
+		ut_asserteq(-EBADMSG, ulz4fn(in, len, out, &out_size));
+	}
+
+	free(out);
+	free(plain);
+	free(in);
+
+	return 0;
+}
+COMPRESSION_TEST(compression_test_lz4_frames, 0);
+
+/* Report decompression throughput against memcpy(); checks only the output */
+static int bench_lz4(struct unit_test_state *uts)
+{
+	const uint size = SZ_4M, passes = 8;
+	static const struct {
+		const char *name;
+		uint block_id;
+		uint flags;
+	} frames[] = {
+		{ "lz4 64KB blocks", 4, LZ4_GEN_INDEPENDENT },
+		{ "lz4 4MB blocks", 7, LZ4_GEN_INDEPENDENT },
+		{ "lz4 linked", 4, 0 },
+		{ "lz4 checksum", 4, LZ4_GEN_INDEPENDENT | LZ4_GEN_CHECKSUM },
+	};
+	u8 *in, *plain, *out;
+	ulong start, us;
+	size_t out_size;
+	uint i, j, len;
+
+	in = malloc(size + size / 8);
+	plain = malloc(size);
+	out = malloc(size);
+	ut_assertnonnull(in);
+	ut_assertnonnull(plain);
+	ut_assertnonnull(out);
+	srand(1234);
+
+	for (i = 0; i < ARRAY_SIZE(frames); i++) {
+		len = lz4_gen_frame(in, plain, size, frames[i].block_id,
+				    frames[i].flags);
+		ut_assertok(lz4_check(uts, in, len, plain, size, out));
+
+		start = timer_get_us();
+		for (j = 0; j < passes; j++) {
+			out_size = size;
+			ut_assertok(ulz4fn(in, len, out, &out_size));
+		}
+		us = timer_get_us() - start;
+		/* bytes per microsecond is the same as MB/s */
+		printf("%-16s %6llu MB/s (ratio %u%%)\n", frames[i].name,
+		       (u64)size * passes / (us ? us : 1), len * 100 / size);
+	}
+
+	start = timer_get_us();
+	for (j = 0; j < passes; j++)
+		memcpy(out, plain, size);
+	us = timer_get_us() - start;
+	printf("%-16s %6llu MB/s\n", "memcpy",
+	       (u64)size * passes / (us ? us : 1));
+
+	free(out);
+	free(plain);
+	free(in);
+
+	return 0;
+}
+BENCH_TEST(bench_lz4, 0);
+
+static int compression_test_zstd(struct unit_test_state *uts)
+{
+	return run_test(uts, "zstd", compress_using_zstd,
+			uncompress_using_zstd);
+}
+COMPRESSION_TEST(compression_test_zstd, 0);
+
 static int compress_using_none(struct unit_test_state *uts,
 			       void *in, unsigned long in_size,
 			       void *out, unsigned long out_max,
@@ -530,6 +858,12 @@ static int compression_test_bootm_lz4(struct unit_test_state *uts)
 }
 COMPRESSION_TEST(compression_test_bootm_lz4, 0);
 
+static int compression_test_bootm_zstd(struct unit_test_state *uts)
+{
+	return run_bootm_test(uts, IH_COMP_ZSTD, compress_using_zstd);
+}
+COMPRESSION_TEST(compression_test_bootm_zstd, 0);
+
 static int compression_test_bootm_none(struct unit_test_state *uts)
 {
 	return run_bootm_test(uts, IH_COMP_NONE, compress_using_none);
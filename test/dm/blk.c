@@ -4,11 +4,15 @@
  */
 
 #include <common.h>
+#include <boottrace.h>
 #include <dm.h>
+#include <malloc.h>
 #include <part.h>
 #include <usb.h>
 #include <asm/global_data.h>
 #include <asm/state.h>
+#include <asm/test.h>
+#include <dm/device-internal.h>
 #include <dm/test.h>
 #include <test/test.h>
 #include <test/ut.h>
@@ -217,3 +221,278 @@ static int dm_test_blk_iter(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_blk_iter, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+static void blk_test_done(struct blk_req *req)
+{
+	int *count = req->priv;
+
+	(*count)++;
+}
+
+/* Write some blocks and read them back with several requests in flight */
+static int blk_check_submit(struct unit_test_state *uts,
+			    struct blk_desc *dev_desc)
+{
+	char write[8 * 512], read[8 * 512], one[512];
+	struct blk_req req, sgreq;
+	struct blk_sg sg[8];
+	int count = 0;
+	int i;
+
+	for (i = 0; i < sizeof(write); i++)
+		write[i] = i ^ (i >> 9);
+
+	blk_req_init(&req, BLK_REQ_WRITE, 8, 8, write);
+	req.done = blk_test_done;
+	req.priv = &count;
+	ut_assertok(blk_submit(dev_desc, &req));
+	ut_assertok(blk_wait(dev_desc, &req));
+	ut_asserteq(8, req.result);
+	ut_asserteq(1, count);
+
+	/* Read it back in two pieces, swapping their places in memory */
+	memset(read, '\0', sizeof(read));
+	memset(&sgreq, '\0', sizeof(sgreq));
+	sg[0].buffer = read + 3 * 512;
+	sg[0].blkcnt = 1;
+	sg[1].buffer = read;
+	sg[1].blkcnt = 3;
+	sgreq.op = BLK_REQ_READ;
+	sgreq.start = 8;
+	sgreq.sg = sg;
+	sgreq.sg_count = 2;
+	sgreq.done = blk_test_done;
+	sgreq.priv = &count;
+	blk_req_init(&req, BLK_REQ_READ, 9, 1, one);
+	req.done = blk_test_done;
+	req.priv = &count;
+	ut_assertok(blk_submit(dev_desc, &sgreq));
+	ut_assertok(blk_submit(dev_desc, &req));
+	ut_assertok(blk_wait(dev_desc, &sgreq));
+	ut_assertok(blk_wait(dev_desc, &req));
+	ut_asserteq(3, count);
+	ut_asserteq(4, blk_req_blkcnt(&sgreq));
+	ut_asserteq(4, sgreq.result);
+	ut_asserteq_mem(write, read + 3 * 512, 512);
+	ut_asserteq_mem(write + 512, read, 512);
+	ut_asserteq_mem(write + 1024, read + 512, 1024);
+	ut_asserteq_mem(write + 512, one, 512);
+
+	/* Use more pieces than the driver can have in flight, backwards */
+	memset(read, '\0', sizeof(read));
+	for (i = 0; i < ARRAY_SIZE(sg); i++) {
+		sg[i].buffer = read + (ARRAY_SIZE(sg) - 1 - i) * 512;
+		sg[i].blkcnt = 1;
+	}
+	sgreq.sg_count = ARRAY_SIZE(sg);
+	ut_assertok(blk_submit(dev_desc, &sgreq));
+	ut_assertok(blk_wait(dev_desc, &sgreq));
+	ut_asserteq(4, count);
+	for (i = 0; i < ARRAY_SIZE(sg); i++)
+		ut_asserteq_mem(write + i * 512, read + (7 - i) * 512, 512);
+
+	return 0;
+}
+
+/* Test asynchronous requests, including scatter lists */
+static int dm_test_blk_submit(struct unit_test_state *uts)
+{
+	struct blk_desc *dev_desc;
+
+	/* The MMC driver has no queue, so the uclass runs requests itself */
+	ut_assertok(blk_get_device_by_str("mmc", "0", &dev_desc));
+	ut_assertok(blk_check_submit(uts, dev_desc));
+
+	return 0;
+}
+DM_TEST(dm_test_blk_submit, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+/* Test requests queued by the virtio block driver */
+static int dm_test_blk_submit_virtio(struct unit_test_state *uts)
+{
+	struct udevice *bus, *dev;
+
+	ut_assertok(uclass_first_device_err(UCLASS_VIRTIO, &bus));
+	ut_assertok(device_find_first_child(bus, &dev));
+	ut_assertnonnull(dev);
+	ut_assertok(device_probe(dev));
+	ut_assertok(blk_check_submit(uts, dev_get_uclass_plat(dev)));
+
+	return 0;
+}
+DM_TEST(dm_test_blk_submit_virtio, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+/* Test requests queued by the NVMe driver, including a hung controller */
+static int dm_test_blk_submit_nvme(struct unit_test_state *uts)
+{
+	struct blk_desc *dev_desc;
+	struct udevice *nvme, *dev;
+	struct blk_req req;
+	char buf[512];
+
+	sandbox_set_enable_memio(true);
+	ut_assertok(uclass_first_device_err(UCLASS_NVME, &nvme));
+	ut_assertok(blk_get_from_parent(nvme, &dev));
+	ut_assertok(device_probe(dev));
+	dev_desc = dev_get_uclass_plat(dev);
+	ut_assertok(blk_check_submit(uts, dev_desc));
+
+	/* The queue is reset before a timed-out request is handed back */
+	sandbox_nvme_hold_io(nvme, true);
+	blk_req_init(&req, BLK_REQ_READ, 8, 1, buf);
+	ut_assertok(blk_submit(dev_desc, &req));
+	ut_asserteq(0, blk_poll(dev_desc));
+	ut_asserteq(false, req.complete);
+	timer_test_add_offset(31 * 1000);
+	ut_asserteq(-ETIMEDOUT, blk_poll(dev_desc));
+	ut_asserteq(true, req.complete);
+	ut_asserteq(-ETIMEDOUT, req.result);
+	ut_asserteq(1, sandbox_nvme_get_io_resets(nvme));
+
+	/* After which the controller can be used again */
+	sandbox_nvme_hold_io(nvme, false);
+	ut_assertok(blk_check_submit(uts, dev_desc));
+	sandbox_set_enable_memio(false);
+
+	return 0;
+}
+DM_TEST(dm_test_blk_submit_nvme, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+/* Test the block cache, including its replacement policies */
+static int dm_test_blk_cache(struct unit_test_state *uts)
+{
+	struct block_cache_stats stats;
+	char buf[8 * 512], data[8 * 512];
+	lbaint_t lba;
+	int i;
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = i / 512;
+
+	ut_assertok(blkcache_set_policy("lru"));
+	blkcache_configure_bytes(8, 16 * 512);
+	blkcache_stats(&stats);
+	ut_asserteq_str("lru", stats.policy);
+
+	/* Cached blocks can be read back, in whole or in part */
+	blkcache_fill(IF_TYPE_HOST, 5, 100, 4, 512, data);
+	ut_asserteq(1, blkcache_read(IF_TYPE_HOST, 5, 100, 4, 512, buf));
+	ut_asserteq_mem(data, buf, 4 * 512);
+	ut_asserteq(1, blkcache_read(IF_TYPE_HOST, 5, 102, 1, 512, buf));
+	ut_asserteq_mem(data + 2 * 512, buf, 512);
+	ut_asserteq(0, blkcache_read(IF_TYPE_HOST, 5, 103, 2, 512, buf));
+	ut_asserteq(0, blkcache_read(IF_TYPE_HOST, 6, 100, 1, 512, buf));
+
+	blkcache_stats(&stats);
+	ut_asserteq(2, stats.hits);
+	ut_asserteq(2, stats.misses);
+	ut_asserteq(4, stats.entries);
+	ut_asserteq(4 * 512, stats.used);
+
+	/* The budget is respected, dropping the oldest blocks */
+	for (lba = 200; lba < 232; lba += 8)
+		blkcache_fill(IF_TYPE_HOST, 5, lba, 8, 512, data);
+	blkcache_stats(&stats);
+	ut_asserteq(16, stats.entries);
+	ut_asserteq(0, blkcache_read(IF_TYPE_HOST, 5, 100, 1, 512, buf));
+	ut_asserteq(1, blkcache_read(IF_TYPE_HOST, 5, 224, 8, 512, buf));
+
+	blkcache_invalidate(IF_TYPE_HOST, 5);
+	ut_asserteq(0, blkcache_read(IF_TYPE_HOST, 5, 224, 1, 512, buf));
+	blkcache_stats(&stats);
+	ut_asserteq(0, stats.entries);
+
+	/* ARC keeps blocks which are read again across a one-off scan */
+	if (IS_ENABLED(CONFIG_BLOCK_CACHE_ARC)) {
+		ut_assertok(blkcache_set_policy("arc"));
+		blkcache_fill(IF_TYPE_HOST, 5, 0, 8, 512, data);
+		ut_asserteq(1, blkcache_read(IF_TYPE_HOST, 5, 0, 8, 512, buf));
+		for (lba = 1000; lba < 1400; lba += 8)
+			blkcache_fill(IF_TYPE_HOST, 5, lba, 8, 512, data);
+		ut_asserteq(1, blkcache_read(IF_TYPE_HOST, 5, 0, 8, 512, buf));
+		ut_asserteq_mem(data, buf, sizeof(data));
+	}
+	ut_asserteq(-EINVAL, blkcache_set_policy("fifo"));
+
+	/* Read-ahead is only requested for sequential reads */
+	blkcache_set_readahead(32);
+	ut_asserteq(0, blkcache_readahead(IF_TYPE_HOST, 7, 10, 2));
+	ut_asserteq(32, blkcache_readahead(IF_TYPE_HOST, 7, 12, 2));
+	ut_asserteq(0, blkcache_readahead(IF_TYPE_HOST, 7, 40, 2));
+	ut_asserteq(0, blkcache_readahead(IF_TYPE_HOST, 7, 42, 100));
+
+	blkcache_invalidate(IF_TYPE_HOST, 5);
+	blkcache_set_readahead(CONFIG_BLOCK_CACHE_READAHEAD);
+	ut_assertok(blkcache_set_policy(CONFIG_BLOCK_CACHE_POLICY));
+	blkcache_configure_bytes(CONFIG_BLOCK_CACHE_MAX_BLOCKS,
+				 CONFIG_BLOCK_CACHE_SIZE);
+
+	return 0;
+}
+DM_TEST(dm_test_blk_cache, 0);
+
+#if CONFIG_IS_ENABLED(BOOTTRACE)
+/* Test that transfers with the driver are recorded in the boot timeline */
+static int dm_test_blk_boottrace(struct unit_test_state *uts)
+{
+	struct trace_output_event *ev, *end;
+	struct trace_output_hdr *hdr;
+	struct blk_desc *dev_desc;
+	char data[2 * 512];
+	int start = 0, write = 0;
+	size_t size;
+	void *buf;
+
+	ut_assertok(blk_get_device_by_str("mmc", "0", &dev_desc));
+	blkcache_invalidate(dev_desc->if_type, dev_desc->devnum);
+	boottrace_clear();
+	ut_asserteq(2, blk_dread(dev_desc, 20, 2, data));
+	ut_asserteq(2, blk_dwrite(dev_desc, 20, 2, data));
+
+	boottrace_export(NULL, 0, &size);
+	buf = malloc(size);
+	ut_assertnonnull(buf);
+	ut_assertok(boottrace_export(buf, size, &size));
+	hdr = buf;
+	ev = (void *)(hdr + 1);
+	for (end = ev + hdr->rec_count; ev < end; ev++) {
+		if (ev->dev != dev_seq(dev_desc->bdev) || ev->id != 20)
+			continue;
+		if (ev->type == TRACE_EV_BLK_START) {
+			start++;
+			if (ev->flags & TRACE_EVF_WRITE) {
+				write++;
+				ut_asserteq(2, ev->arg);
+			}
+			ut_assert(ev->arg >= 2);
+			ut_asserteq(TRACE_EV_BLK_END, ev[1].type);
+			ut_assert(!(ev[1].flags & TRACE_EVF_ERROR));
+		}
+	}
+	ut_asserteq(2, start);
+	ut_asserteq(1, write);
+	free(buf);
+
+	/* a read past the end of the device is recorded as failed */
+	boottrace_clear();
+	ut_asserteq(0, blk_dread(dev_desc, dev_desc->lba, 1, data));
+	boottrace_export(NULL, 0, &size);
+	buf = malloc(size);
+	ut_assertnonnull(buf);
+	ut_assertok(boottrace_export(buf, size, &size));
+	hdr = buf;
+	ev = (void *)(hdr + 1);
+	for (end = ev + hdr->rec_count; ev < end; ev++) {
+		if (ev->type == TRACE_EV_BLK_END &&
+		    ev->dev == dev_seq(dev_desc->bdev) &&
+		    ev->id == dev_desc->lba)
+			break;
+	}
+	ut_assert(ev < end);
+	ut_asserteq(TRACE_EVF_ERROR, ev->flags);
+	free(buf);
+
+	return 0;
+}
+DM_TEST(dm_test_blk_boottrace, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+#endif
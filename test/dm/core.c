@@ -1214,6 +1214,141 @@ static int dm_test_all_have_seq(struct unit_test_state *uts)
 }
 DM_TEST(dm_test_all_have_seq, UT_TESTF_SCAN_PDATA);
 
+#if CONFIG_IS_ENABLED(DM_INDEX)
+/* Check that indexed lookups find the same device as a walk of the uclass */
+static int dm_test_uclass_index(struct unit_test_state *uts)
+{
+	struct udevice *dev, *first, *found;
+	enum uclass_id id;
+	struct uclass *uc;
+	ofnode node;
+
+	ut_assertnonnull(gd_dm_index());
+	list_for_each_entry(uc, gd->uclass_root, sibling_node) {
+		id = uc->uc_drv->id;
+		ut_asserteq_ptr(uc, uclass_find(id));
+
+		uclass_foreach_dev(dev, uc) {
+			if (dev->seq_ != -1) {
+				uclass_foreach_dev(first, uc) {
+					if (first->seq_ == dev->seq_)
+						break;
+				}
+				ut_assertok(uclass_find_device_by_seq(id,
+								      dev->seq_,
+								      &found));
+				ut_asserteq_ptr(first, found);
+			}
+
+			uclass_foreach_dev(first, uc) {
+				if (!strcmp(first->name, dev->name))
+					break;
+			}
+			ut_assertok(uclass_find_device_by_name(id, dev->name,
+							       &found));
+			ut_asserteq_ptr(first, found);
+
+			node = dev_ofnode(dev);
+			if (!ofnode_valid(node))
+				continue;
+			uclass_foreach_dev(first, uc) {
+				if (ofnode_equal(dev_ofnode(first), node))
+					break;
+			}
+			ut_assertok(uclass_find_device_by_ofnode(id, node,
+								 &found));
+			ut_asserteq_ptr(first, found);
+			ut_assertok(device_find_global_by_ofnode(node, &found));
+			ut_assert(ofnode_equal(node, dev_ofnode(found)));
+		}
+	}
+	ut_asserteq(-ENODEV, uclass_find_device_by_seq(UCLASS_TEST_FDT, 1000,
+						       &found));
+	ut_asserteq(-ENODEV, uclass_find_device_by_name(UCLASS_TEST_FDT,
+							"missing", &found));
+
+	/* The index must follow changes to the name and sequence number */
+	ut_assertok(uclass_find_device_by_name(UCLASS_TEST_FDT, "a-test",
+					       &dev));
+	ut_assertok(device_set_name(dev, "renamed"));
+	ut_asserteq(-ENODEV, uclass_find_device_by_name(UCLASS_TEST_FDT,
+							"a-test", &found));
+	ut_assertok(uclass_find_device_by_name(UCLASS_TEST_FDT, "renamed",
+					       &found));
+	ut_asserteq_ptr(dev, found);
+
+	dev->seq_ = 1000;
+	uclass_index_update(dev);
+	ut_assertok(uclass_find_device_by_seq(UCLASS_TEST_FDT, 1000, &found));
+	ut_asserteq_ptr(dev, found);
+
+	/* ...and drop the device when it is unbound */
+	ut_assertok(device_unbind(dev));
+	ut_asserteq(-ENODEV, uclass_find_device_by_seq(UCLASS_TEST_FDT, 1000,
+						       &found));
+	ut_asserteq(-ENODEV, uclass_find_device_by_name(UCLASS_TEST_FDT,
+							"renamed", &found));
+
+	return 0;
+}
+DM_TEST(dm_test_uclass_index, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+#endif
+
+#if CONFIG_IS_ENABLED(DM_ASYNC_PROBE)
+/* Test that slow probes overlap when started together */
+static int dm_test_probe_async(struct unit_test_state *uts)
+{
+	struct dm_test_priv *priv[3];
+	struct udevice *dev[3];
+	int i;
+
+	/* We don't care about the numbering for this test */
+	uts->skip_post_probe = 1;
+
+	ut_assertok(device_bind_with_driver_data(uts->root,
+						 DM_DRIVER_GET(test_async_drv),
+						 "async0", 3, ofnode_null(),
+						 &dev[0]));
+	ut_assertok(device_bind_with_driver_data(uts->root,
+						 DM_DRIVER_GET(test_async_drv),
+						 "async1", 1, ofnode_null(),
+						 &dev[1]));
+	ut_assertok(device_bind_with_driver_data(uts->root,
+						 DM_DRIVER_GET(test_async_drv),
+						 "async2", 2, ofnode_null(),
+						 &dev[2]));
+
+	ut_assertok(device_probe_async(dev, 2));
+	for (i = 0; i < 2; i++) {
+		priv[i] = dev_get_priv(dev[i]);
+		ut_assert(device_active(dev[i]));
+		ut_asserteq(0, dev_get_flags(dev[i]) &
+			    (DM_FLAG_PROBE_POLL | DM_FLAG_PROBE_PENDING));
+
+		/* Both devices had started before either was polled */
+		ut_asserteq(2, priv[i]->ping_total);
+	}
+	ut_asserteq(4, priv[0]->op_count[DM_TEST_OP_PROBE_POLL]);
+	ut_asserteq(2, priv[1]->op_count[DM_TEST_OP_PROBE_POLL]);
+	ut_asserteq(6, dm_testdrv_op_count[DM_TEST_OP_PROBE_POLL]);
+	ut_assert(!device_active(dev[2]));
+
+	/* A plain probe waits for the device itself */
+	ut_assertok(device_probe(dev[2]));
+	priv[2] = dev_get_priv(dev[2]);
+	ut_assert(device_active(dev[2]));
+	ut_asserteq(3, priv[2]->op_count[DM_TEST_OP_PROBE_POLL]);
+	ut_asserteq(3, priv[2]->ping_total);
+
+	/* Probing again does nothing */
+	ut_assertok(device_probe_async(dev, 3));
+	ut_asserteq(9, dm_testdrv_op_count[DM_TEST_OP_PROBE_POLL]);
+
+	return 0;
+}
+DM_TEST(dm_test_probe_async, 0);
+#endif
+
 #if CONFIG_IS_ENABLED(DM_DMA)
 static int dm_test_dma_offset(struct unit_test_state *uts)
 {
@@ -20,6 +20,8 @@
 #include <test/test.h>
 #include <test/ut.h>
 
+#include "../../drivers/net/dwc_eth_qos_ring.h"
+
 #define DM_TEST_ETH_NUM		4
 
 static int dm_test_eth(struct unit_test_state *uts)
@@ -431,3 +433,139 @@ static int dm_test_eth_async_ping_reply(struct unit_test_state *uts)
 }
 
 DM_TEST(dm_test_eth_async_ping_reply, UT_TESTF_SCAN_FDT);
+
+#define EQOS_TEST_DESCS		8
+#define EQOS_TEST_DESC_SIZE	(2 * sizeof(struct eqos_desc))
+
+static struct {
+	void *buf;
+	size_t size;
+} eqos_test_ops[4];
+static int eqos_test_nops;
+
+static void eqos_test_record(void *buf, size_t size)
+{
+	if (eqos_test_nops < ARRAY_SIZE(eqos_test_ops)) {
+		eqos_test_ops[eqos_test_nops].buf = buf;
+		eqos_test_ops[eqos_test_nops].size = size;
+	}
+	eqos_test_nops++;
+}
+
+/* Check the DWC EQoS ring index arithmetic and range cache maintenance */
+static int dm_test_eth_eqos_ring(struct unit_test_state *uts)
+{
+	struct eqos_desc descs[EQOS_TEST_DESCS * 2];
+	struct eqos_ring ring;
+
+	eqos_ring_init(&ring, descs, EQOS_TEST_DESC_SIZE, EQOS_TEST_DESCS);
+	ut_asserteq_ptr(&descs[6], eqos_ring_desc(&ring, 3));
+	ut_asserteq(1, eqos_ring_add(&ring, 0, 1));
+	ut_asserteq(0, eqos_ring_add(&ring, 7, 1));
+	ut_asserteq(7, eqos_ring_add(&ring, 0, -1));
+	ut_asserteq(5, eqos_ring_add(&ring, 2, -5));
+
+	/* A run which does not wrap takes one operation */
+	eqos_test_nops = 0;
+	eqos_ring_sync(&ring, 2, 4, eqos_test_record);
+	ut_asserteq(1, eqos_test_nops);
+	ut_asserteq_ptr(&descs[4], eqos_test_ops[0].buf);
+	ut_asserteq(4 * EQOS_TEST_DESC_SIZE, eqos_test_ops[0].size);
+
+	/* Neither does the whole ring */
+	eqos_test_nops = 0;
+	eqos_ring_sync(&ring, 0, EQOS_TEST_DESCS, eqos_test_record);
+	ut_asserteq(1, eqos_test_nops);
+	ut_asserteq_ptr(&descs[0], eqos_test_ops[0].buf);
+	ut_asserteq(EQOS_TEST_DESCS * EQOS_TEST_DESC_SIZE,
+		    eqos_test_ops[0].size);
+
+	/* A run which wraps takes two */
+	eqos_test_nops = 0;
+	eqos_ring_sync(&ring, 6, 5, eqos_test_record);
+	ut_asserteq(2, eqos_test_nops);
+	ut_asserteq_ptr(&descs[12], eqos_test_ops[0].buf);
+	ut_asserteq(2 * EQOS_TEST_DESC_SIZE, eqos_test_ops[0].size);
+	ut_asserteq_ptr(&descs[0], eqos_test_ops[1].buf);
+	ut_asserteq(3 * EQOS_TEST_DESC_SIZE, eqos_test_ops[1].size);
+
+	return 0;
+}
+DM_TEST(dm_test_eth_eqos_ring, 0);
+
+/* Pretend to be the DMA receiving @count frames from descriptor @first */
+static void eqos_test_dma_rx(struct eqos_ring *ring, uint first, uint count)
+{
+	while (count--) {
+		eqos_ring_desc(ring, first)->des3 &= ~EQOS_DESC3_OWN;
+		first = eqos_ring_add(ring, first, 1);
+	}
+}
+
+/*
+ * Pretend to be the driver handling the received frames as eqos_recv() and
+ * eqos_free_pkt() do, returning the number of frames or -ve on error
+ */
+static int eqos_test_drv_rx(struct eqos_ring *ring, int *refills)
+{
+	int frames = 0;
+
+	ring->ready = eqos_ring_scan(ring, ring->num);
+	while (ring->ready) {
+		eqos_ring_desc(ring, ring->next)->des3 |= EQOS_DESC3_OWN;
+		eqos_ring_consume(ring);
+		frames++;
+		if (eqos_ring_refill_due(ring)) {
+			ring->dirty = 0;
+			(*refills)++;
+		}
+	}
+	if (ring->dirty)
+		return -EINVAL;
+
+	return frames;
+}
+
+/* Check the DWC EQoS RX batching against a simple DMA model */
+static int dm_test_eth_eqos_rx_batch(struct unit_test_state *uts)
+{
+	struct eqos_desc descs[EQOS_TEST_DESCS * 2];
+	struct eqos_ring ring;
+	int i, refills;
+
+	eqos_ring_init(&ring, descs, EQOS_TEST_DESC_SIZE, EQOS_TEST_DESCS);
+	for (i = 0; i < EQOS_TEST_DESCS; i++)
+		eqos_ring_desc(&ring, i)->des3 = EQOS_DESC3_OWN;
+
+	/* Nothing received */
+	refills = 0;
+	ut_asserteq(0, eqos_test_drv_rx(&ring, &refills));
+	ut_asserteq(0, refills);
+
+	/* A single frame is handed back straight away */
+	eqos_test_dma_rx(&ring, 0, 1);
+	ut_asserteq(1, eqos_test_drv_rx(&ring, &refills));
+	ut_asserteq(1, ring.next);
+	ut_asserteq(1, refills);
+
+	/* A burst which wraps is handed back a quarter of the ring at a time */
+	refills = 0;
+	eqos_test_dma_rx(&ring, 1, 7);
+	ut_asserteq(7, eqos_test_drv_rx(&ring, &refills));
+	ut_asserteq(0, ring.next);
+	ut_asserteq(4, refills);
+
+	/* A full ring is found in one scan and handed back in four batches */
+	refills = 0;
+	eqos_test_dma_rx(&ring, 0, EQOS_TEST_DESCS);
+	ut_asserteq(EQOS_TEST_DESCS, eqos_test_drv_rx(&ring, &refills));
+	ut_asserteq(0, ring.next);
+	ut_asserteq(4, refills);
+
+	/* Every descriptor went back to the DMA */
+	for (i = 0; i < EQOS_TEST_DESCS; i++)
+		ut_assert(eqos_ring_desc(&ring, i)->des3 & EQOS_DESC3_OWN);
+
+	return 0;
+}
+DM_TEST(dm_test_eth_eqos_rx_batch, 0);
@@ -5,6 +5,8 @@
 
 #include <common.h>
 #include <dm.h>
+#include <fdt_index.h>
+#include <malloc.h>
 #include <asm/global_data.h>
 #include <dm/of_extra.h>
 #include <dm/test.h>
@@ -130,3 +132,105 @@ static int dm_test_fdtdec_add_reserved_memory(struct unit_test_state *uts)
 }
 DM_TEST(dm_test_fdtdec_add_reserved_memory,
 	UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT | UT_TESTF_FLAT_TREE);
+
+/* Check the index of @blob against libfdt */
+static int check_fdt_index(struct unit_test_state *uts, void *blob)
+{
+	const char *compat;
+	int node, depth, expect, i;
+	char path[256];
+	u32 phandle;
+
+	ut_assertok(fdt_index_init());
+	if (CONFIG_IS_ENABLED(OF_FDT_INDEX))
+		ut_assertnonnull(gd_fdt_index());
+
+	/* The depth drops below zero at the end of the root node */
+	for (node = 0, depth = 0; node >= 0 && depth >= 0;
+	     node = fdt_next_node(blob, node, &depth)) {
+		ut_assertok(fdt_get_path(blob, node, path, sizeof(path)));
+		ut_asserteq(fdt_path_offset(blob, path),
+			    fdt_index_path_offset(blob, path));
+
+		phandle = fdt_get_phandle(blob, node);
+		if (phandle) {
+			expect = fdt_node_offset_by_phandle(blob, phandle);
+			ut_asserteq(expect, fdt_index_node_offset_by_phandle(
+					blob, phandle));
+		}
+
+		for (i = 0; ; i++) {
+			compat = fdt_stringlist_get(blob, node, "compatible",
+						    i, NULL);
+			if (!compat)
+				break;
+			expect = fdt_node_offset_by_compatible(blob, -1,
+							       compat);
+			ut_asserteq(expect, fdt_index_node_offset_by_compatible(
+					blob, -1, compat));
+			expect = fdt_node_offset_by_compatible(blob, node,
+							       compat);
+			ut_asserteq(expect, fdt_index_node_offset_by_compatible(
+					blob, node, compat));
+		}
+	}
+
+	/* Aliases, unit addresses and things which are not there */
+	ut_asserteq(fdt_path_offset(blob, "/a-test"),
+		    fdt_index_path_offset(blob, "testfdt8"));
+	ut_asserteq(fdt_path_offset(blob, "/eth@10002000"),
+		    fdt_index_path_offset(blob, "ethernet0"));
+	ut_asserteq(fdt_path_offset(blob, "/eth"),
+		    fdt_index_path_offset(blob, "/eth"));
+	ut_asserteq(-FDT_ERR_NOTFOUND, fdt_index_path_offset(blob, "/no-node"));
+	ut_asserteq(-FDT_ERR_BADPATH, fdt_index_path_offset(blob, "no-alias"));
+	ut_asserteq(-FDT_ERR_BADPHANDLE,
+		    fdt_index_node_offset_by_phandle(blob, 0));
+	ut_asserteq(-FDT_ERR_NOTFOUND,
+		    fdt_index_node_offset_by_phandle(blob, 0xfffffff0));
+	ut_asserteq(-FDT_ERR_NOTFOUND,
+		    fdt_index_node_offset_by_compatible(blob, -1, "no,compat"));
+
+	/* A change which keeps the size of the tree drops the index too */
+	fdt_index_changed(blob);
+	ut_asserteq(fdt_path_offset(blob, "/a-test"),
+		    fdt_index_path_offset(blob, "/a-test"));
+	ut_assertnull(gd_fdt_index());
+
+	/* Changing the size of the tree drops the index */
+	ut_assertok(fdt_index_init());
+	ut_assertok(fdt_setprop_string(blob, 0, "fdt-index-test", "changed"));
+	ut_asserteq(fdt_path_offset(blob, "/a-test"),
+		    fdt_index_path_offset(blob, "/a-test"));
+	ut_assertnull(gd_fdt_index());
+
+	return 0;
+}
+
+static int dm_test_fdt_index(struct unit_test_state *uts)
+{
+	const void *old_fdt = gd->fdt_blob;
+	bool indexed = gd_fdt_index();
+	int blob_sz, ret;
+	void *blob;
+
+	blob_sz = fdt_totalsize(gd->fdt_blob) + 4096;
+	blob = malloc(blob_sz);
+	ut_assertnonnull(blob);
+
+	/* Index a writable copy of the fdt blob */
+	ut_assertok(fdt_open_into(gd->fdt_blob, blob, blob_sz));
+	gd->fdt_blob = blob;
+	ret = check_fdt_index(uts, blob);
+	gd->fdt_blob = old_fdt;
+	if (indexed) {
+		ut_assertok(fdt_index_init());
+	} else {
+		fdt_index_invalidate();
+	}
+	free(blob);
+
+	return ret;
+}
+DM_TEST(dm_test_fdt_index,
+	UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT | UT_TESTF_FLAT_TREE);
@@ -7,6 +7,7 @@
 #include <dm.h>
 #include <mmc.h>
 #include <part.h>
+#include <asm/test.h>
 #include <dm/test.h>
 #include <test/test.h>
 #include <test/ut.h>
@@ -52,3 +53,59 @@ static int dm_test_mmc_blk(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_mmc_blk, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+#if CONFIG_IS_ENABLED(MMC_CQE)
+static int dm_test_mmc_cqe(struct unit_test_state *uts)
+{
+	struct blk_desc *dev_desc;
+	struct udevice *dev;
+	char write[32 * 512], read[32 * 512];
+	int i;
+
+	ut_assertok(uclass_get_device(UCLASS_MMC, 0, &dev));
+	dev_desc = mmc_get_blk_desc(mmc_get_mmc_dev(dev));
+	ut_assertnonnull(dev_desc);
+
+	for (i = 0; i < sizeof(write); i++)
+		write[i] = i ^ (i >> 9);
+	ut_asserteq(32, blk_dwrite(dev_desc, 10, 32, write));
+
+	/* 32 blocks in tasks of 5 takes 7 tasks */
+	sandbox_mmc_set_cqe(dev, 4, 5);
+	memset(read, '\0', sizeof(read));
+	ut_asserteq(32, blk_dread(dev_desc, 10, 32, read));
+	ut_asserteq_mem(write, read, sizeof(write));
+	ut_asserteq(7, sandbox_mmc_get_cqe_tasks(dev));
+	ut_asserteq(1, sandbox_mmc_get_cqe_enables(dev));
+
+	/* The queue stays enabled for the next read */
+	memset(read, '\0', sizeof(read));
+	ut_asserteq(12, blk_dread(dev_desc, 14, 12, read));
+	ut_asserteq_mem(write + 4 * 512, read, 12 * 512);
+	ut_asserteq(10, sandbox_mmc_get_cqe_tasks(dev));
+	ut_asserteq(1, sandbox_mmc_get_cqe_enables(dev));
+
+	/* A read which fits in one transfer does not use the queue */
+	memset(read, '\0', sizeof(read));
+	ut_asserteq(5, blk_dread(dev_desc, 20, 5, read));
+	ut_asserteq_mem(write + 10 * 512, read, 5 * 512);
+	ut_asserteq(10, sandbox_mmc_get_cqe_tasks(dev));
+
+	/* That took the device out of queue mode, so it is entered again */
+	memset(read, '\0', sizeof(read));
+	ut_asserteq(32, blk_dread(dev_desc, 10, 32, read));
+	ut_asserteq_mem(write, read, sizeof(write));
+	ut_asserteq(17, sandbox_mmc_get_cqe_tasks(dev));
+	ut_asserteq(2, sandbox_mmc_get_cqe_enables(dev));
+
+	/* Without a queue the same read is done with CMD18 */
+	sandbox_mmc_set_cqe(dev, 0, 5);
+	memset(read, '\0', sizeof(read));
+	ut_asserteq(32, blk_dread(dev_desc, 10, 32, read));
+	ut_asserteq_mem(write, read, sizeof(write));
+	ut_asserteq(17, sandbox_mmc_get_cqe_tasks(dev));
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_cqe, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+#endif
@@ -10,6 +10,7 @@
 #include <mapmem.h>
 #include <os.h>
 #include <spi.h>
+#include <spi-mem.h>
 #include <spi_flash.h>
 #include <asm/state.h>
 #include <asm/test.h>
@@ -22,6 +23,7 @@
 static int dm_test_spi_flash(struct unit_test_state *uts)
 {
 	struct udevice *dev, *emul;
+	__maybe_unused struct spi_flash *flash;
 	int full_size = 0x200000;
 	int size = 0x10000;
 	u8 *src, *dst;
@@ -34,6 +36,13 @@ static int dm_test_spi_flash(struct unit_test_state *uts)
 	ut_assertok(os_write_file("spi.bin", src, full_size));
 	ut_assertok(uclass_first_device_err(UCLASS_SPI_FLASH, &dev));
 
+#if CONFIG_IS_ENABLED(SPI_DIRMAP)
+	/* sandbox has no direct mapping, so reads use the fallback */
+	flash = dev_get_uclass_priv(dev);
+	ut_assertnonnull(flash->dirmap.rdesc);
+	ut_asserteq(1, flash->dirmap.rdesc->nodirmap);
+#endif
+
 	dst = map_sysmem(0x20000 + full_size, full_size);
 	ut_assertok(spi_flash_read_dm(dev, 0, size, dst));
 	ut_asserteq_mem(src, dst, size);
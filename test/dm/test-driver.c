@@ -155,6 +155,39 @@ U_BOOT_DRIVER(test_manual_drv) = {
 	.unbind	= test_manual_unbind,
 };
 
+#if CONFIG_IS_ENABLED(DM_ASYNC_PROBE)
+/* The device becomes ready after driver_data calls to probe_poll() */
+static int test_async_probe_poll(struct udevice *dev)
+{
+	struct dm_test_priv *priv = dev_get_priv(dev);
+
+	/* Record how many devices had started probing when this one polled */
+	if (!priv->op_count[DM_TEST_OP_PROBE_POLL])
+		priv->ping_total = dm_testdrv_op_count[DM_TEST_OP_PROBE];
+	dm_testdrv_op_count[DM_TEST_OP_PROBE_POLL]++;
+	if (priv->op_count[DM_TEST_OP_PROBE_POLL]++ < dev_get_driver_data(dev))
+		return -EAGAIN;
+
+	return 0;
+}
+
+static int test_async_probe(struct udevice *dev)
+{
+	dm_testdrv_op_count[DM_TEST_OP_PROBE]++;
+
+	return 0;
+}
+
+U_BOOT_DRIVER(test_async_drv) = {
+	.name	= "test_async_drv",
+	.id	= UCLASS_TEST,
+	.ops	= &test_manual_ops,
+	.probe	= test_async_probe,
+	.probe_poll	= test_async_probe_poll,
+	.priv_auto	= sizeof(struct dm_test_priv),
+};
+#endif
+
 U_BOOT_DRIVER(test_pre_reloc_drv) = {
 	.name	= "test_pre_reloc_drv",
 	.id	= UCLASS_TEST,
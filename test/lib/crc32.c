@@ -0,0 +1,177 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the CRC32 and CRC32C implementations, with a simple benchmark
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <rand.h>
+#include <time.h>
+#include <test/bench.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+#include <linux/sizes.h>
+#include <u-boot/crc.h>
+
+#define CRC32_POLY	0xedb88320
+#define CRC32C_POLY	0x82f63b78
+
+/* Size of the benchmark buffer and number of passes over it */
+#define BENCH_SIZE	SZ_1M
+#define BENCH_PASSES	16
+
+/* Bit-at-a-time reference, without the final inversion */
+static u32 crc_bitwise(u32 poly, u32 crc, const u8 *p, uint len)
+{
+	int i;
+
+	while (len--) {
+		crc ^= *p++;
+		for (i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ (crc & 1 ? poly : 0);
+	}
+
+	return crc;
+}
+
+static u32 crc32_bitwise(u32 crc, const u8 *p, uint len)
+{
+	return crc_bitwise(CRC32_POLY, crc, p, len);
+}
+
+static u8 *crc_test_data(uint size)
+{
+	u8 *data;
+	int i;
+
+	data = malloc(size);
+	if (!data)
+		return NULL;
+	srand(1234);
+	for (i = 0; i < size; i++)
+		data[i] = rand();
+
+	return data;
+}
+
+/* Test the CRC32 variants against the standard check value and each other */
+static int lib_test_crc32(struct unit_test_state *uts)
+{
+	static const char check[] = "123456789";
+	uint align, len;
+	u32 ref;
+	u8 *data;
+
+	ut_asserteq(0xcbf43926, crc32(0, (const u8 *)check, strlen(check)));
+	ut_asserteq(0xcbf43926,
+		    ~crc32_no_comp_sw(~0, (const u8 *)check, strlen(check)));
+
+	data = crc_test_data(256);
+	ut_assertnonnull(data);
+	for (align = 0; align < 8; align++) {
+		for (len = 0; len < 256 - 8; len += 3) {
+			ref = crc32_bitwise(0x12345678, data + align, len);
+			ut_asserteq(ref, crc32_no_comp(0x12345678, data + align,
+						       len));
+			ut_asserteq(ref, crc32_no_comp_sw(0x12345678,
+							  data + align, len));
+		}
+	}
+	free(data);
+
+	return 0;
+}
+LIB_TEST(lib_test_crc32, 0);
+
+#ifdef CONFIG_CRC32C
+static u32 crc32c_bitwise(u32 crc, const u8 *p, uint len)
+{
+	return crc_bitwise(CRC32C_POLY, crc, p, len);
+}
+
+/* Test the CRC32C variants, including the table-driven crc32c_cal() */
+static int lib_test_crc32c(struct unit_test_state *uts)
+{
+	static const char check[] = "123456789";
+	u32 table[256];
+	uint align, len;
+	u32 ref;
+	u8 *data;
+
+	ut_asserteq(0xe3069283, ~crc32c(~0, check, strlen(check)));
+	ut_asserteq(0xe3069283, ~crc32c_sw(~0, check, strlen(check)));
+
+	crc32c_init(table, CRC32C_POLY);
+	data = crc_test_data(256);
+	ut_assertnonnull(data);
+	for (align = 0; align < 8; align++) {
+		for (len = 0; len < 256 - 8; len += 3) {
+			ref = crc32c_bitwise(0x12345678, data + align, len);
+			ut_asserteq(ref, crc32c(0x12345678, data + align, len));
+			ut_asserteq(ref, crc32c_sw(0x12345678, data + align,
+						   len));
+			ut_asserteq(ref, crc32c_cal(0x12345678,
+						    (char *)data + align, len,
+						    table));
+		}
+	}
+	free(data);
+
+	return 0;
+}
+LIB_TEST(lib_test_crc32c, 0);
+#endif
+
+static void crc_bench(const char *name, u32 (*func)(u32, const u8 *, uint),
+		      const u8 *data, uint size, int passes)
+{
+	ulong start, us;
+	u32 crc = ~0;
+	int i;
+
+	start = timer_get_us();
+	for (i = 0; i < passes; i++)
+		crc = func(crc, data, size);
+	us = timer_get_us() - start;
+
+	/* bytes per microsecond is the same as MB/s */
+	printf("%-16s %08x %6llu MB/s\n", name, crc,
+	       (u64)size * passes / (us ? us : 1));
+}
+
+#ifdef CONFIG_CRC32C
+static u32 crc32c_bench(u32 crc, const u8 *p, uint len)
+{
+	return crc32c(crc, p, len);
+}
+
+static u32 crc32c_sw_bench(u32 crc, const u8 *p, uint len)
+{
+	return crc32c_sw(crc, p, len);
+}
+#endif
+
+/* Report the throughput of each variant; checks nothing beyond allocation */
+static int bench_crc32(struct unit_test_state *uts)
+{
+	u8 *data;
+
+	data = crc_test_data(BENCH_SIZE);
+	ut_assertnonnull(data);
+	crc_bench("crc32", crc32_no_comp, data, BENCH_SIZE, BENCH_PASSES);
+	crc_bench("crc32 (sw)", crc32_no_comp_sw, data, BENCH_SIZE,
+		  BENCH_PASSES);
+	crc_bench("crc32 (bitwise)", crc32_bitwise, data, BENCH_SIZE / 16, 1);
+#ifdef CONFIG_CRC32C
+	crc_bench("crc32c", crc32c_bench, data, BENCH_SIZE, BENCH_PASSES);
+	crc_bench("crc32c (sw)", crc32c_sw_bench, data, BENCH_SIZE,
+		  BENCH_PASSES);
+	crc_bench("crc32c (bitwise)", crc32c_bitwise, data, BENCH_SIZE / 16,
+		  1);
+#endif
+	free(data);
+
+	return 0;
+}
+BENCH_TEST(bench_crc32, 0);
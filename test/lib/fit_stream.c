@@ -0,0 +1,309 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the streaming FIT loader
+ */
+
+#include <common.h>
+#include <gzip.h>
+#include <hash.h>
+#include <image.h>
+#include <malloc.h>
+#include <mapmem.h>
+#include <linux/libfdt.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+#define FIT_SIZE	0x1000
+#define DATA_SIZE	20000
+
+/* data of lib_test_fit_stream_gzip(), compressed with zstd -19 */
+static const char zstd_data[] =
+	"\x28\xb5\x2f\xfd\x64\x20\x4d\x6d\x07\x00\x14\x08\x00\x01\x02\x03"
+	"\x04\x05\x06\x07\x08\x09\x0a\x0b\x0c\x0d\x0e\x0f\x10\x11\x12\x13"
+	"\x14\x15\x16\x17\x18\x19\x1a\x1b\x1c\x1d\x1e\x1f\x20\x21\x22\x23"
+	"\x24\x25\x26\x27\x28\x29\x2a\x2b\x2c\x2d\x2e\x2f\x30\x31\x32\x33"
+	"\x34\x35\x36\x37\x38\x39\x3a\x3b\x3c\x3d\x3e\x3f\x40\x41\x42\x43"
+	"\x44\x45\x46\x47\x48\x49\x4a\x4b\x4c\x4d\x4e\x4f\x50\x51\x52\x53"
+	"\x54\x55\x56\x57\x58\x59\x5a\x5b\x5c\x5d\x5e\x5f\x60\x61\x62\x63"
+	"\x64\x65\x66\x67\x68\x69\x6a\x6b\x6c\x6d\x6e\x6f\x70\x71\x72\x73"
+	"\x74\x75\x76\x77\x78\x79\x7a\x7b\x7c\x7d\x7e\x7f\x00\x80\x82\xa8"
+	"\x20\x7e\xe0\xf7\x3b\x12\xf8\xff\xff\x57\x10\xe8\xaf\x1b\xdb\x3b"
+	"\x20\x5b\x06\x00\x00\x00\x00\x00\x20\x00\x00\x00\x00\x00\x00\x00"
+	"\x00\x00\x00\x00\x00\x10\x00\x00\x00\x00\x00\x00\x00\x00\x00\x40"
+	"\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x01\x00\x00\x00\x00\x00"
+	"\x00\x00\x00\x00\x08\x00\x00\x00\x00\x00\x00\x00\x00\x00\x20\x00"
+	"\x00\x00\x00\x00\x00\x00\x04\x00\x00\x01\x00\x00\x00\x00\x00\x00"
+	"\x00\x00\x00\x02\x80\xd4\x23\xbd\xca\x0d\xff";
+static const ulong zstd_data_size = 251;
+
+/**
+ * make_fit() - create a FIT holding a single image with external data
+ *
+ * The image is named by the firmware property of the default configuration.
+ *
+ * @uts:	Test state
+ * @buf:	Buffer for the FIT, followed by the data
+ * @data:	Data of the image
+ * @size:	Size of @data
+ * @comp:	Compression to record in the FIT
+ * @position:	true to use data-position, false to use data-offset
+ * Return: 0 if OK, 1 on failure
+ */
+static int make_fit(struct unit_test_state *uts, void *buf, const void *data,
+		    ulong size, const char *comp, bool position)
+{
+	uint8_t value[FIT_MAX_HASH_LEN];
+	int value_len = sizeof(value);
+	int images, node, hash, confs, conf;
+
+	ut_assertok(hash_block("sha256", data, size, value, &value_len));
+
+	ut_assertok(fdt_create_empty_tree(buf, FIT_SIZE));
+	ut_assertok(fdt_setprop_string(buf, 0, FIT_DESC_PROP, "test"));
+	ut_assertok(fdt_setprop_u32(buf, 0, FIT_TIMESTAMP_PROP, 0));
+	images = fdt_add_subnode(buf, 0, "images");
+	ut_assert(images >= 0);
+	node = fdt_add_subnode(buf, images, "firmware-1");
+	ut_assert(node >= 0);
+	ut_assertok(fdt_setprop_string(buf, node, FIT_TYPE_PROP, "firmware"));
+	ut_assertok(fdt_setprop_string(buf, node, FIT_COMP_PROP, comp));
+	ut_assertok(fdt_setprop_u32(buf, node, FIT_DATA_SIZE_PROP, size));
+	if (position) {
+		ut_assertok(fdt_setprop_u32(buf, node, FIT_DATA_POSITION_PROP,
+					    FIT_SIZE));
+	} else {
+		ut_assertok(fdt_setprop_u32(buf, node, FIT_DATA_OFFSET_PROP,
+					    0));
+	}
+	hash = fdt_add_subnode(buf, node, "hash-1");
+	ut_assert(hash >= 0);
+	ut_assertok(fdt_setprop_string(buf, hash, FIT_ALGO_PROP, "sha256"));
+	ut_assertok(fdt_setprop(buf, hash, FIT_VALUE_PROP, value, value_len));
+	confs = fdt_add_subnode(buf, 0, FIT_CONFS_PATH + 1);
+	ut_assert(confs >= 0);
+	ut_assertok(fdt_setprop_string(buf, confs, FIT_DEFAULT_PROP, "conf-1"));
+	conf = fdt_add_subnode(buf, confs, "conf-1");
+	ut_assert(conf >= 0);
+	ut_assertok(fdt_setprop_string(buf, conf, FIT_FIRMWARE_PROP,
+				       "firmware-1"));
+
+	if (position) {
+		memcpy(buf + FIT_SIZE, data, size);
+	} else {
+		ut_assertok(fdt_pack(buf));
+		memcpy(buf + ALIGN(fdt_totalsize(buf), 4), data, size);
+	}
+
+	return 0;
+}
+
+static int load_fit(struct unit_test_state *uts, void *buf, void *out,
+		    ulong *lenp)
+{
+	struct fit_stream st;
+	int ret;
+
+	fit_stream_init_mem(&st, buf);
+	/* use small chunks so that the data is split many times */
+	st.chunk_size = 0x200;
+	ut_assertok(fit_stream_open(&st));
+	ret = fit_stream_load(&st, NULL, FIT_FIRMWARE_PROP, map_to_sysmem(out),
+			      lenp);
+	fit_stream_close(&st);
+
+	return ret;
+}
+
+/* Test loading an uncompressed image in chunks */
+static int lib_test_fit_stream_none(struct unit_test_state *uts)
+{
+	char *data, *buf, *out;
+	ulong len;
+	int i;
+
+	data = malloc(DATA_SIZE);
+	buf = malloc(FIT_SIZE + DATA_SIZE);
+	out = calloc(1, DATA_SIZE);
+	ut_assertnonnull(data);
+	ut_assertnonnull(buf);
+	ut_assertnonnull(out);
+	for (i = 0; i < DATA_SIZE; i++)
+		data[i] = i * 7 + (i >> 8);
+
+	ut_assertok(make_fit(uts, buf, data, DATA_SIZE, "none", false));
+	ut_assertok(load_fit(uts, buf, out, &len));
+	ut_asserteq(DATA_SIZE, len);
+	ut_asserteq_mem(data, out, DATA_SIZE);
+
+	/* the same with data-position */
+	memset(out, '\0', DATA_SIZE);
+	ut_assertok(make_fit(uts, buf, data, DATA_SIZE, "none", true));
+	ut_assertok(load_fit(uts, buf, out, &len));
+	ut_asserteq(DATA_SIZE, len);
+	ut_asserteq_mem(data, out, DATA_SIZE);
+
+	/* corrupt the data, which must be detected and not left behind */
+	buf[FIT_SIZE + DATA_SIZE - 1] ^= 1;
+	ut_asserteq(-EBADMSG, load_fit(uts, buf, out, &len));
+	for (i = 0; i < DATA_SIZE; i++)
+		ut_asserteq(0, out[i]);
+
+	free(out);
+	free(buf);
+	free(data);
+
+	return 0;
+}
+LIB_TEST(lib_test_fit_stream_none, 0);
+
+/* Test loading a gzip-compressed image in chunks */
+static int lib_test_fit_stream_gzip(struct unit_test_state *uts)
+{
+	char *data, *buf, *out, *comp;
+	ulong comp_len = DATA_SIZE;
+	ulong len;
+	int i;
+
+	data = malloc(DATA_SIZE);
+	comp = malloc(DATA_SIZE);
+	buf = malloc(FIT_SIZE + DATA_SIZE);
+	out = calloc(1, DATA_SIZE);
+	ut_assertnonnull(data);
+	ut_assertnonnull(comp);
+	ut_assertnonnull(buf);
+	ut_assertnonnull(out);
+	for (i = 0; i < DATA_SIZE; i++)
+		data[i] = (i / 100) & 0x7f;
+	ut_assertok(gzip(comp, &comp_len, (uchar *)data, DATA_SIZE));
+
+	ut_assertok(make_fit(uts, buf, comp, comp_len, "gzip", false));
+	ut_assertok(load_fit(uts, buf, out, &len));
+	ut_asserteq(DATA_SIZE, len);
+	ut_asserteq_mem(data, out, DATA_SIZE);
+
+	/* bad data is decompressed as it is hashed, then wiped again */
+	memset(out, 0xff, DATA_SIZE);
+	buf[ALIGN(fdt_totalsize(buf), 4) + comp_len - 1] ^= 1;
+	ut_asserteq(-EBADMSG, load_fit(uts, buf, out, &len));
+	for (i = 0; i < DATA_SIZE; i++)
+		ut_asserteq(0, out[i]);
+
+	free(out);
+	free(buf);
+	free(comp);
+	free(data);
+
+	return 0;
+}
+LIB_TEST(lib_test_fit_stream_gzip, 0);
+
+/* Test loading a zstd-compressed image in chunks */
+static int lib_test_fit_stream_zstd(struct unit_test_state *uts)
+{
+	struct fit_stream st;
+	char *data, *buf, *out;
+	ulong len;
+	int i;
+
+	data = malloc(DATA_SIZE);
+	buf = malloc(FIT_SIZE + DATA_SIZE);
+	out = calloc(1, DATA_SIZE);
+	ut_assertnonnull(data);
+	ut_assertnonnull(buf);
+	ut_assertnonnull(out);
+	for (i = 0; i < DATA_SIZE; i++)
+		data[i] = (i / 100) & 0x7f;
+
+	ut_assertok(make_fit(uts, buf, zstd_data, zstd_data_size, "zstd",
+			     true));
+	fit_stream_init_mem(&st, buf);
+	/* the data is small, so split it further than load_fit() does */
+	st.chunk_size = 0x40;
+	ut_assertok(fit_stream_open(&st));
+	ut_assertok(fit_stream_load(&st, NULL, FIT_FIRMWARE_PROP,
+				    map_to_sysmem(out), &len));
+	ut_asserteq(DATA_SIZE, len);
+	ut_asserteq_mem(data, out, DATA_SIZE);
+
+	/* bad data is decompressed as it is hashed, then wiped again */
+	memset(out, 0xff, DATA_SIZE);
+	buf[FIT_SIZE + zstd_data_size - 1] ^= 1;
+	ut_asserteq(-EBADMSG, fit_stream_load(&st, NULL, FIT_FIRMWARE_PROP,
+					      map_to_sysmem(out), &len));
+	fit_stream_close(&st);
+	for (i = 0; i < DATA_SIZE; i++)
+		ut_asserteq(0, out[i]);
+
+	free(out);
+	free(buf);
+	free(data);
+
+	return 0;
+}
+LIB_TEST(lib_test_fit_stream_zstd, 0);
+
+/* Test that fit_image_load() hashes an image as it decompresses it */
+static int lib_test_fit_stream_image_load(struct unit_test_state *uts)
+{
+	char *data, *buf, *out, *comp;
+	ulong comp_len = DATA_SIZE;
+	bootm_headers_t images;
+	const char *conf;
+	ulong load, len;
+	int i, node;
+
+	data = malloc(DATA_SIZE);
+	comp = malloc(DATA_SIZE);
+	buf = malloc(FIT_SIZE + DATA_SIZE);
+	out = calloc(1, DATA_SIZE);
+	ut_assertnonnull(data);
+	ut_assertnonnull(comp);
+	ut_assertnonnull(buf);
+	ut_assertnonnull(out);
+
+	/* fit_image_load() only allows for 20 times compression */
+	for (i = 0; i < DATA_SIZE; i++)
+		data[i] = (i * 2654435761U) >> 24;
+	ut_assertok(gzip(comp, &comp_len, (uchar *)data, DATA_SIZE));
+
+	ut_assertok(make_fit(uts, buf, comp, comp_len, "gzip", true));
+	node = fdt_path_offset(buf, "/images/firmware-1");
+	ut_assert(node >= 0);
+	ut_assertok(fdt_setprop_string(buf, node, FIT_OS_PROP, "u-boot"));
+	ut_assertok(fdt_setprop_string(buf, node, FIT_ARCH_PROP, "sandbox"));
+	ut_assertok(fdt_setprop_u32(buf, node, FIT_LOAD_PROP,
+				    map_to_sysmem(out)));
+
+	memset(&images, '\0', sizeof(images));
+	images.verify = 1;
+	conf = NULL;
+	ut_asserteq(node, fit_image_load(&images, map_to_sysmem(buf), NULL,
+					 &conf, IH_ARCH_DEFAULT,
+					 IH_TYPE_FIRMWARE, 0,
+					 FIT_LOAD_REQUIRED, &load, &len));
+	ut_asserteq(map_to_sysmem(out), load);
+	ut_asserteq(DATA_SIZE, len);
+	ut_asserteq_mem(data, out, DATA_SIZE);
+
+	/*
+	 * Bad data is decompressed as it is hashed, then wiped again, rather
+	 * than being rejected before it is decompressed
+	 */
+	memset(out, 0xff, DATA_SIZE);
+	buf[FIT_SIZE + comp_len - 1] ^= 1;
+	ut_asserteq(-EACCES, fit_image_load(&images, map_to_sysmem(buf), NULL,
+					    &conf, IH_ARCH_DEFAULT,
+					    IH_TYPE_FIRMWARE, 0,
+					    FIT_LOAD_REQUIRED, &load, &len));
+	for (i = 0; i < DATA_SIZE; i++)
+		ut_asserteq(0, out[i]);
+
+	free(out);
+	free(buf);
+	free(comp);
+	free(data);
+
+	return 0;
+}
+LIB_TEST(lib_test_fit_stream_image_load, 0);
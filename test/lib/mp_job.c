@@ -0,0 +1,122 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for running jobs on secondary CPUs
+ *
+ * Copyright 2023 NXP
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <mp_job.h>
+#include <rand.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+#include <u-boot/sha256.h>
+
+#define MP_TEST_JOBS	16
+#define MP_TEST_SIZE	0x1000
+
+/* Upper bound on how long one job waits for another, in loop iterations */
+#define MP_TEST_SPINS	1000000000
+
+struct mp_test_hash {
+	struct mp_job job;
+	const u8 *data;
+	u8 out[SHA256_SUM_LEN];
+};
+
+static int mp_test_hash_run(void *arg)
+{
+	struct mp_test_hash *th = arg;
+	sha256_context ctx;
+
+	sha256_starts(&ctx);
+	sha256_update(&ctx, th->data, MP_TEST_SIZE);
+	sha256_finish(&ctx, th->out);
+
+	return 0;
+}
+
+/* Check that jobs give the same results wherever they run */
+static int lib_test_mp_job_hash(struct unit_test_state *uts)
+{
+	struct mp_test_hash *th;
+	u8 expect[SHA256_SUM_LEN];
+	u8 *data;
+	int i;
+
+	ut_assert(mp_job_cpus() > 1);
+
+	data = malloc(MP_TEST_JOBS * MP_TEST_SIZE);
+	ut_assertnonnull(data);
+	th = calloc(MP_TEST_JOBS, sizeof(*th));
+	ut_assertnonnull(th);
+	srand(1234);
+	for (i = 0; i < MP_TEST_JOBS * MP_TEST_SIZE; i++)
+		data[i] = rand();
+
+	for (i = 0; i < MP_TEST_JOBS; i++) {
+		th[i].job.func = mp_test_hash_run;
+		th[i].job.arg = &th[i];
+		th[i].data = data + i * MP_TEST_SIZE;
+		mp_job_submit(&th[i].job);
+	}
+	for (i = 0; i < MP_TEST_JOBS; i++) {
+		ut_assertok(mp_job_wait(&th[i].job));
+		sha256_csum_wd(th[i].data, MP_TEST_SIZE, expect, 0);
+		ut_asserteq_mem(expect, th[i].out, SHA256_SUM_LEN);
+	}
+	free(th);
+	free(data);
+
+	return 0;
+}
+LIB_TEST(lib_test_mp_job_hash, 0);
+
+static int mp_test_wait_run(void *arg)
+{
+	int *flag = arg;
+	long i;
+
+	for (i = 0; i < MP_TEST_SPINS; i++) {
+		if (__atomic_load_n(flag, __ATOMIC_ACQUIRE))
+			return 0;
+	}
+
+	return -ETIMEDOUT;
+}
+
+static int mp_test_set_run(void *arg)
+{
+	__atomic_store_n((int *)arg, 1, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+/*
+ * Check that jobs really run at the same time, since the first cannot finish
+ * until the second has run. Then check that the CPUs can be stopped and
+ * started again.
+ */
+static int lib_test_mp_job_parallel(struct unit_test_state *uts)
+{
+	struct mp_job wait, set;
+	int pass, flag;
+
+	for (pass = 0; pass < 2; pass++) {
+		flag = 0;
+		wait.func = mp_test_wait_run;
+		wait.arg = &flag;
+		set.func = mp_test_set_run;
+		set.arg = &flag;
+		mp_job_submit(&wait);
+		mp_job_submit(&set);
+		ut_assertok(mp_job_wait(&set));
+		ut_assertok(mp_job_wait(&wait));
+		mp_job_stop();
+	}
+
+	return 0;
+}
+LIB_TEST(lib_test_mp_job_parallel, 0);
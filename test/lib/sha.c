@@ -0,0 +1,134 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the SHA block functions, which may use CPU instructions
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <rand.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+#include <u-boot/sha1.h>
+#include <u-boot/sha256.h>
+#include <u-boot/sha512.h>
+
+/* Number of 128-byte blocks hashed, plus one byte for misalignment */
+#define TEST_BLOCKS	33
+
+static u8 *sha_test_data(void)
+{
+	u8 *data;
+	int i;
+
+	data = malloc(TEST_BLOCKS * 128 + 1);
+	if (!data)
+		return NULL;
+	srand(1234);
+	for (i = 0; i < TEST_BLOCKS * 128 + 1; i++)
+		data[i] = rand();
+
+	return data;
+}
+
+#if CONFIG_IS_ENABLED(SHA1)
+/* Test sha1_process() against the C version, on aligned and unaligned data */
+static int lib_test_sha1_process(struct unit_test_state *uts)
+{
+	sha1_context ctx, ref;
+	u8 *data;
+	int align, blocks;
+
+	data = sha_test_data();
+	ut_assertnonnull(data);
+	for (align = 0; align < 2; align++) {
+		for (blocks = 1; blocks <= TEST_BLOCKS * 2; blocks += 7) {
+			sha1_starts(&ctx);
+			sha1_starts(&ref);
+			sha1_process(&ctx, data + align, blocks);
+			sha1_process_generic(&ref, data + align, blocks);
+			ut_asserteq_mem(ref.state, ctx.state, sizeof(ref.state));
+		}
+	}
+	free(data);
+
+	return 0;
+}
+LIB_TEST(lib_test_sha1_process, 0);
+#endif
+
+/* Test sha256_process() against the C version */
+static int lib_test_sha256_process(struct unit_test_state *uts)
+{
+	sha256_context ctx, ref;
+	u8 *data;
+	int align, blocks;
+
+	data = sha_test_data();
+	ut_assertnonnull(data);
+	for (align = 0; align < 2; align++) {
+		for (blocks = 1; blocks <= TEST_BLOCKS * 2; blocks += 7) {
+			sha256_starts(&ctx);
+			sha256_starts(&ref);
+			sha256_process(&ctx, data + align, blocks);
+			sha256_process_generic(&ref, data + align, blocks);
+			ut_asserteq_mem(ref.state, ctx.state, sizeof(ref.state));
+		}
+	}
+	free(data);
+
+	return 0;
+}
+LIB_TEST(lib_test_sha256_process, 0);
+
+#if CONFIG_IS_ENABLED(SHA512)
+/* Test sha512_process() against the C version */
+static int lib_test_sha512_process(struct unit_test_state *uts)
+{
+	sha512_context ctx, ref;
+	u8 *data;
+	int align, blocks;
+
+	data = sha_test_data();
+	ut_assertnonnull(data);
+	for (align = 0; align < 2; align++) {
+		for (blocks = 1; blocks <= TEST_BLOCKS; blocks += 4) {
+			sha512_starts(&ctx);
+			sha512_starts(&ref);
+			sha512_process(&ctx, data + align, blocks);
+			sha512_process_generic(&ref, data + align, blocks);
+			ut_asserteq_mem(ref.state, ctx.state, sizeof(ref.state));
+		}
+	}
+	free(data);
+
+	return 0;
+}
+LIB_TEST(lib_test_sha512_process, 0);
+#endif
+
+/*
+ * Test the whole hash with the FIPS 180-2 two-block message, so that the
+ * padding and the block function are exercised together
+ */
+static int lib_test_sha256_fips(struct unit_test_state *uts)
+{
+	static const char msg[] =
+		"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+	static const u8 expect[SHA256_SUM_LEN] = {
+		0x24, 0x8d, 0x6a, 0x61, 0xd2, 0x06, 0x38, 0xb8,
+		0xe5, 0xc0, 0x26, 0x93, 0x0c, 0x3e, 0x60, 0x39,
+		0xa3, 0x3c, 0xe4, 0x59, 0x64, 0xff, 0x21, 0x67,
+		0xf6, 0xec, 0xed, 0xd4, 0x19, 0xdb, 0x06, 0xc1,
+	};
+	u8 out[SHA256_SUM_LEN];
+	sha256_context ctx;
+
+	sha256_starts(&ctx);
+	sha256_update(&ctx, (const u8 *)msg, strlen(msg));
+	sha256_finish(&ctx, out);
+	ut_asserteq_mem(expect, out, sizeof(out));
+
+	return 0;
+}
+LIB_TEST(lib_test_sha256_fips, 0);
@@ -0,0 +1,131 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for writing sparse images as they arrive
+ *
+ * Copyright 2023 NXP
+ */
+
+#include <common.h>
+#include <image-sparse.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+#define SPARSE_BLKSZ	1024
+#define STORAGE_BLKSZ	512
+#define TOTAL_BLKS	7
+#define FILL_VAL	0x12345678
+
+static char storage[TOTAL_BLKS * SPARSE_BLKSZ];
+
+static lbaint_t ram_write(struct sparse_storage *info, lbaint_t blk,
+			  lbaint_t blkcnt, const void *buffer)
+{
+	if (blk + blkcnt > info->start + info->size)
+		return 0;
+	memcpy(storage + blk * info->blksz, buffer, blkcnt * info->blksz);
+
+	return blkcnt;
+}
+
+static lbaint_t ram_reserve(struct sparse_storage *info, lbaint_t blk,
+			    lbaint_t blkcnt)
+{
+	return blkcnt;
+}
+
+static void add_chunk(char **ptrp, uint type, uint blocks, uint data_len)
+{
+	chunk_header_t *chunk = (chunk_header_t *)*ptrp;
+
+	chunk->chunk_type = cpu_to_le16(type);
+	chunk->reserved1 = 0;
+	chunk->chunk_sz = cpu_to_le32(blocks);
+	chunk->total_sz = cpu_to_le32(sizeof(*chunk) + data_len);
+	*ptrp += sizeof(*chunk);
+}
+
+/* Build an image with raw, fill and don't-care chunks; return its size */
+static size_t make_image(char *buf)
+{
+	sparse_header_t *hdr = (sparse_header_t *)buf;
+	char *ptr = buf + sizeof(*hdr);
+	u32 fill = cpu_to_le32(FILL_VAL);
+	int i;
+
+	hdr->magic = cpu_to_le32(SPARSE_HEADER_MAGIC);
+	hdr->major_version = cpu_to_le16(1);
+	hdr->minor_version = 0;
+	hdr->file_hdr_sz = cpu_to_le16(sizeof(sparse_header_t));
+	hdr->chunk_hdr_sz = cpu_to_le16(sizeof(chunk_header_t));
+	hdr->blk_sz = cpu_to_le32(SPARSE_BLKSZ);
+	hdr->total_blks = cpu_to_le32(TOTAL_BLKS);
+	hdr->total_chunks = cpu_to_le32(4);
+	hdr->image_checksum = 0;
+
+	add_chunk(&ptr, CHUNK_TYPE_RAW, 3, 3 * SPARSE_BLKSZ);
+	for (i = 0; i < 3 * SPARSE_BLKSZ; i++)
+		*ptr++ = i * 7;
+	add_chunk(&ptr, CHUNK_TYPE_FILL, 2, sizeof(fill));
+	memcpy(ptr, &fill, sizeof(fill));
+	ptr += sizeof(fill);
+	add_chunk(&ptr, CHUNK_TYPE_DONT_CARE, 1, 0);
+	add_chunk(&ptr, CHUNK_TYPE_RAW, 1, SPARSE_BLKSZ);
+	memset(ptr, 0x5a, SPARSE_BLKSZ);
+	ptr += SPARSE_BLKSZ;
+
+	return ptr - buf;
+}
+
+static void setup_storage(struct sparse_storage *info)
+{
+	memset(info, '\0', sizeof(*info));
+	info->blksz = STORAGE_BLKSZ;
+	info->start = 0;
+	info->size = sizeof(storage) / STORAGE_BLKSZ;
+	info->write = ram_write;
+	info->reserve = ram_reserve;
+	memset(storage, 0xaa, sizeof(storage));
+}
+
+static int lib_test_sparse_stream(struct unit_test_state *uts)
+{
+	char image[TOTAL_BLKS * SPARSE_BLKSZ + 0x100];
+	char expect[sizeof(storage)];
+	char buf[3 * STORAGE_BLKSZ];
+	struct sparse_storage info;
+	char response[64];
+	struct sparse_stream ss;
+	size_t size, pos, len;
+
+	size = make_image(image);
+
+	/* Use the whole-image writer as a reference */
+	setup_storage(&info);
+	ut_assertok(write_sparse_image(&info, "test", image, response));
+	memcpy(expect, storage, sizeof(storage));
+
+	/* Deliver the image in pieces which do not line up with anything */
+	setup_storage(&info);
+	ut_assertok(sparse_stream_init(&ss, &info, buf, sizeof(buf)));
+	for (pos = 0; pos < size; pos += len) {
+		len = min_t(size_t, size - pos, 100);
+		ut_assertok(sparse_stream_write(&ss, image + pos, len,
+						response));
+	}
+	ut_assertok(sparse_stream_finish(&ss, "test", response));
+	ut_asserteq_mem(expect, storage, sizeof(storage));
+
+	/* A truncated image is rejected */
+	setup_storage(&info);
+	ut_assertok(sparse_stream_init(&ss, &info, buf, sizeof(buf)));
+	ut_assertok(sparse_stream_write(&ss, image, size - 1, response));
+	ut_asserteq(-1, sparse_stream_finish(&ss, "test", response));
+
+	/* So is a buffer smaller than a storage block */
+	ut_asserteq(-EINVAL, sparse_stream_init(&ss, &info, buf,
+						STORAGE_BLKSZ - 1));
+
+	return 0;
+}
+LIB_TEST(lib_test_sparse_stream, 0);
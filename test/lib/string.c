@@ -12,6 +12,7 @@
 #include <common.h>
 #include <command.h>
 #include <log.h>
+#include <test/bench.h>
 #include <test/lib.h>
 #include <test/test.h>
 #include <test/ut.h>
@@ -225,3 +226,184 @@ static int lib_memdup(struct unit_test_state *uts)
 	return 0;
 }
 LIB_TEST(lib_memdup, 0);
+
+/* Large enough to take the non-temporal paths of the arch implementations */
+#define LARGE_LEN	(3 << 19)
+/* Room around the large region for offsets and guard bytes */
+#define LARGE_PAD	64
+
+static u8 large_val(uint i)
+{
+	return (i ^ (i >> 8) ^ (i >> 16)) * 7;
+}
+
+static void init_large(u8 *buf, uint len)
+{
+	uint i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = large_val(i);
+}
+
+/**
+ * lib_memcpy_large() - unit test for large memcpy() and memmove()
+ *
+ * Copy regions bigger than the caches, with and without overlap, so that the
+ * paths for large copies are used.
+ *
+ * @uts:	unit test state
+ * Return:	0 = success, 1 = failure
+ */
+static int lib_memcpy_large(struct unit_test_state *uts)
+{
+	static const int offs[][2] = {
+		{ 0, 0 }, { 1, 3 }, { 15, 8 }, { 33, 1 },
+	};
+	static const int moves[] = { -4096, -65, -1, 1, 17, 4096 };
+	const uint len = LARGE_LEN - 8192;
+	u8 *src, *dst;
+	int i, j, n;
+
+	src = malloc(LARGE_LEN + LARGE_PAD);
+	dst = malloc(LARGE_LEN + LARGE_PAD);
+	ut_assertnonnull(src);
+	ut_assertnonnull(dst);
+	init_large(src, LARGE_LEN + LARGE_PAD);
+
+	for (i = 0; i < ARRAY_SIZE(offs); i++) {
+		int o1 = offs[i][0], o2 = offs[i][1];
+
+		memset(dst, 0xee, LARGE_LEN + LARGE_PAD);
+		ut_asserteq_ptr(dst + o2, memcpy(dst + o2, src + o1, len));
+		ut_asserteq_mem(src + o1, dst + o2, len);
+		for (j = 0; j < o2; j++)
+			ut_asserteq(0xee, dst[j]);
+		ut_asserteq(0xee, dst[o2 + len]);
+	}
+
+	/* Overlapping moves in both directions, checked against large_val() */
+	for (i = 0; i < ARRAY_SIZE(moves); i++) {
+		n = moves[i];
+		init_large(dst, LARGE_LEN);
+		ut_asserteq_ptr(dst + 4096 + n,
+				memmove(dst + 4096 + n, dst + 4096, len));
+		for (j = 0; j < LARGE_LEN; j++) {
+			if (j >= 4096 + n && j < 4096 + n + len) {
+				ut_asserteq(large_val(j - n), dst[j]);
+			} else {
+				ut_asserteq(large_val(j), dst[j]);
+			}
+		}
+	}
+	free(dst);
+	free(src);
+
+	return 0;
+}
+LIB_TEST(lib_memcpy_large, 0);
+
+/**
+ * lib_memset_large() - unit test for large memset()
+ *
+ * Both zero, which may use DC ZVA on arm64, and other values are tested.
+ *
+ * @uts:	unit test state
+ * Return:	0 = success, 1 = failure
+ */
+static int lib_memset_large(struct unit_test_state *uts)
+{
+	static const int offs[] = { 0, 1, 15, 33 };
+	const uint len = LARGE_LEN - 7;
+	int i, j, val;
+	u8 *buf;
+
+	buf = malloc(LARGE_LEN + LARGE_PAD);
+	ut_assertnonnull(buf);
+	for (val = 0; val < 0x100; val += 0x5a) {
+		for (i = 0; i < ARRAY_SIZE(offs); i++) {
+			init_large(buf, LARGE_LEN + LARGE_PAD);
+			ut_asserteq_ptr(buf + offs[i],
+					memset(buf + offs[i], val, len));
+			for (j = 0; j < LARGE_LEN + LARGE_PAD; j++) {
+				if (j >= offs[i] && j < offs[i] + len) {
+					ut_asserteq(val, buf[j]);
+				} else {
+					ut_asserteq(large_val(j), buf[j]);
+				}
+			}
+		}
+	}
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_memset_large, 0);
+
+/* Total bytes handled for each size in bench_mem() */
+#define BENCH_BYTES	(64 << 20)
+#define BENCH_MAX	(4 << 20)
+
+enum mem_bench_op {
+	BENCH_MEMCPY,
+	BENCH_MEMMOVE,
+	BENCH_MEMSET0,
+	BENCH_MEMSET,
+};
+
+static void mem_bench(enum mem_bench_op op, u8 *dst, u8 *src, uint size)
+{
+	static const char *const names[] = {
+		"memcpy", "memmove", "memset(0)", "memset",
+	};
+	uint passes = BENCH_BYTES / size;
+	ulong start, us;
+	uint i;
+
+	start = timer_get_us();
+	for (i = 0; i < passes; i++) {
+		switch (op) {
+		case BENCH_MEMCPY:
+			memcpy(dst, src, size);
+			break;
+		case BENCH_MEMMOVE:
+			/* Overlapping, so always the backwards copy */
+			memmove(src + 64, src, size);
+			break;
+		case BENCH_MEMSET0:
+			memset(dst, '\0', size);
+			break;
+		case BENCH_MEMSET:
+			memset(dst, 0x5a, size);
+			break;
+		}
+	}
+	us = timer_get_us() - start;
+
+	/* bytes per microsecond is the same as MB/s */
+	printf("%-10s %8u %6llu MB/s\n", names[op], size,
+	       (u64)size * passes / (us ? us : 1));
+}
+
+/* Report the throughput for a range of sizes; checks nothing beyond malloc */
+static int bench_mem(struct unit_test_state *uts)
+{
+	enum mem_bench_op op;
+	u8 *src, *dst;
+	uint size;
+
+	src = malloc(BENCH_MAX + 64);
+	dst = malloc(BENCH_MAX);
+	ut_assertnonnull(src);
+	ut_assertnonnull(dst);
+	memset(src, 0x33, BENCH_MAX + 64);
+	for (op = BENCH_MEMCPY; op <= BENCH_MEMSET; op++) {
+		for (size = 256; size <= BENCH_MAX; size <<= 4)
+			mem_bench(op, dst, src, size);
+		mem_bench(op, dst, src, BENCH_MAX);
+	}
+	free(dst);
+	free(src);
+
+	return 0;
+}
+BENCH_TEST(bench_mem, 0);
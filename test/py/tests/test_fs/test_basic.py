@@ -114,6 +114,22 @@ class TestFsBasic(object):
                 'setenv filesize'])
             assert(md5val[1] in ''.join(output))
 
+        if fs_type == 'ext4':
+            with u_boot_console.log.section('Test Case 5c - ext4stats'):
+                # Test Case 5c - runs and device reads used for the load
+                output = u_boot_console.run_command_list([
+                    'ext4stats', 'ext4stats'])
+                m = re.search(r'runs: (\d+), holes: \d+, '
+                              r'device reads: (\d+), coalesced: (\d+)',
+                              output[0])
+                assert(m)
+                runs, reads, coalesced = map(int, m.groups())
+                assert(reads >= 1)
+                assert(reads + coalesced <= runs)
+                # The counts are reset once read
+                assert('runs: 0, holes: 0, device reads: 0, coalesced: 0'
+                       in output[1])
+
     def test_fs6(self, u_boot_console, fs_obj_basic):
         """
         Test Case 6 - load, reading last 1MB of 3GB file
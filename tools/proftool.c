@@ -51,10 +51,21 @@ struct trace_configline_info {
 /* The contents of the trace config file */
 struct trace_configline_info *trace_config_head;
 
+/* A name from a TRACE_CHUNK_NAMES chunk */
+struct event_name {
+	enum trace_event_type type;
+	uint32_t id;
+	char *name;
+};
+
 struct func_info *func_list;
 int func_count;
 struct trace_call *call_list;
 int call_count;
+struct trace_output_event *event_list;
+int event_count;
+struct event_name *name_list;
+int name_count;
 int verbose;	/* Verbosity level 0=none, 1=warn, 2=notice, 3=info, 4=debug */
 unsigned long text_offset;		/* text address of first function */
 
@@ -85,6 +96,8 @@ static void usage(void)
 		"\n"
 		"Commands\n"
 		"   dump-ftrace\t\tDump out textual data in ftrace format\n"
+		"   dump-chrome\t\tDump out boot timeline in Chrome format\n"
+		"   dump-folded\t\tDump out folded stacks for a flamegraph\n"
 		"\n"
 		"Options:\n"
 		"   -m <map>\tSpecify Systen.map file\n"
@@ -226,10 +239,63 @@ static int read_calls(FILE *fin, size_t count)
 	return 0;
 }
 
+static int read_events(FILE *fin, size_t count)
+{
+	struct trace_output_event *ev;
+
+	notice("event count: %zu\n", count);
+	ev = realloc(event_list, (event_count + count) * sizeof(*ev));
+	if (!ev) {
+		error("Cannot allocate event_list\n");
+		return -1;
+	}
+	event_list = ev;
+	if (count && read_data(fin, ev + event_count, count * sizeof(*ev)))
+		return 1;
+	event_count += count;
+
+	return 0;
+}
+
+static int read_names(FILE *fin, size_t count)
+{
+	struct trace_output_name rec;
+	struct event_name *name;
+	int i;
+
+	name_list = realloc(name_list, (name_count + count) * sizeof(*name));
+	if (!name_list) {
+		error("Cannot allocate name_list\n");
+		return -1;
+	}
+	for (i = 0; i < count; i++) {
+		if (read_data(fin, &rec, sizeof(rec)))
+			return 1;
+		name = &name_list[name_count++];
+		name->type = rec.type;
+		name->id = rec.id;
+		name->name = calloc(1, rec.len + 1);
+		if (!name->name) {
+			error("Cannot allocate name\n");
+			return -1;
+		}
+		if (rec.len && read_data(fin, name->name, rec.len))
+			return 1;
+	}
+
+	return 0;
+}
+
 static int read_profile(FILE *fin, int *not_found)
 {
+	struct boottrace_stash_hdr stash;
 	struct trace_output_hdr hdr;
 
+	/* Skip the header of data stashed for the OS */
+	if (fread(&stash, sizeof(stash), 1, fin) != 1 ||
+	    stash.magic != BOOTTRACE_MAGIC)
+		rewind(fin);
+
 	*not_found = 0;
 	while (!feof(fin)) {
 		int err;
@@ -249,6 +315,16 @@ static int read_profile(FILE *fin, int *not_found)
 			if (read_calls(fin, hdr.rec_count))
 				return 1;
 			break;
+
+		case TRACE_CHUNK_EVENTS:
+			if (read_events(fin, hdr.rec_count))
+				return 1;
+			break;
+
+		case TRACE_CHUNK_NAMES:
+			if (read_names(fin, hdr.rec_count))
+				return 1;
+			break;
 		}
 	}
 	return 0;
@@ -532,6 +608,359 @@ static int make_ftrace(void)
 	return 0;
 }
 
+/*
+ * Function calls come from the boot timeline if it has them, else from the
+ * function trace. This adds those from the function trace to the timeline.
+ */
+static int add_call_events(void)
+{
+	struct trace_output_event *ev;
+	struct trace_call *call;
+	int i;
+
+	for (i = 0; i < event_count; i++) {
+		if (event_list[i].type == TRACE_EV_FUNC_ENTRY)
+			return 0;
+	}
+
+	ev = realloc(event_list, (event_count + call_count) * sizeof(*ev));
+	if (!ev) {
+		error("Cannot allocate event_list\n");
+		return -1;
+	}
+	event_list = ev;
+	ev += event_count;
+	for (i = 0, call = call_list; i < call_count; i++, call++) {
+		if (TRACE_CALL_TYPE(call) != FUNCF_ENTRY &&
+		    TRACE_CALL_TYPE(call) != FUNCF_EXIT)
+			continue;
+		memset(ev, '\0', sizeof(*ev));
+		ev->time_us = call->flags & FUNCF_TIMESTAMP_MASK;
+		ev->type = TRACE_CALL_TYPE(call) == FUNCF_ENTRY ?
+			TRACE_EV_FUNC_ENTRY : TRACE_EV_FUNC_EXIT;
+		ev->id = call->func;
+		ev->arg = call->caller;
+		ev++;
+		event_count++;
+	}
+
+	return 0;
+}
+
+/* Get the function for a call event, or NULL if unknown or excluded */
+static struct func_info *event_func(const struct trace_output_event *ev,
+				    int *missing_count, int *skip_count)
+{
+	struct func_info *func = find_func_by_offset(ev->id);
+
+	if (!func) {
+		warn("Cannot find function at %lx\n", text_offset + ev->id);
+		(*missing_count)++;
+		return NULL;
+	}
+	if (!(func->flags & FUNCF_TRACE)) {
+		debug("Funcion '%s' is excluded from trace\n", func->name);
+		(*skip_count)++;
+		return NULL;
+	}
+
+	return func;
+}
+
+static const char *find_event_name(enum trace_event_type type, uint32_t id)
+{
+	int i;
+
+	for (i = 0; i < name_count; i++) {
+		if (name_list[i].type == type && name_list[i].id == id)
+			return name_list[i].name;
+	}
+
+	return NULL;
+}
+
+/* Print a string as a JSON string, with quotes */
+static void out_json_str(const char *str)
+{
+	putchar('"');
+	for (; *str; str++) {
+		if (*str == '"' || *str == '\\')
+			putchar('\\');
+		if ((unsigned char)*str >= ' ')
+			putchar(*str);
+	}
+	putchar('"');
+}
+
+/* Threads in the Chrome trace, one for each kind of event */
+enum {
+	TID_BOOTSTAGE	= 1,
+	TID_FUNC,
+	TID_BLK,
+	TID_NET,
+};
+
+static const char *const thread_name[] = {
+	[TID_BOOTSTAGE]	= "bootstage",
+	[TID_FUNC]	= "functions",
+	[TID_BLK]	= "block",
+	[TID_NET]	= "network",
+};
+
+/* Names of network protocols, indexed by enum proto_t in include/net.h */
+static const char *const proto_name[] = {
+	"bootp", "rarp", "arp", "tftp", "dhcp", "ping", "dns", "nfs", "cdp",
+	"netcons", "sntp", "tftpsrv", "tftpput", "linklocal", "fastboot",
+	"wol", "udp",
+};
+
+static void out_chrome_event(int *first, const char *ph, int tid,
+			     const char *name, uint32_t time)
+{
+	printf("%s\n{\"ph\":\"%s\",\"pid\":1,\"tid\":%d,\"ts\":%u,\"name\":",
+	       *first ? "" : ",", ph, tid, time);
+	out_json_str(name);
+	*first = 0;
+}
+
+/* Find the start event matching an end event, or NULL if none */
+static struct trace_output_event *find_start(struct trace_output_event *end)
+{
+	struct trace_output_event *ev;
+
+	for (ev = end - 1; ev >= event_list; ev--) {
+		if (ev->type != end->type - 1)
+			continue;
+		if (end->type == TRACE_EV_BLK_END ? ev->dev == end->dev :
+		    ev->id == end->id)
+			return ev;
+	}
+
+	return NULL;
+}
+
+/*
+ * Chrome trace format, which can be viewed with chrome://tracing or
+ * https://ui.perfetto.dev - the format is described in "Trace Event Format"
+ * from the Chromium project
+ */
+static int make_chrome(void)
+{
+	struct trace_output_event *ev, *start;
+	int missing_count = 0, skip_count = 0;
+	struct func_info *func;
+	const char *name;
+	char buf[40];
+	int first = 1;
+	int i;
+
+	if (add_call_events())
+		return -1;
+
+	printf("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+	for (i = TID_BOOTSTAGE; i <= TID_NET; i++) {
+		printf("%s\n{\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"name\":\"thread_name\",\"args\":{\"name\":\"%s\"}}",
+		       first ? "" : ",", i, thread_name[i]);
+		first = 0;
+	}
+
+	for (i = 0, ev = event_list; i < event_count; i++, ev++) {
+		switch (ev->type) {
+		case TRACE_EV_MARK:
+			name = find_event_name(TRACE_EV_MARK, ev->id);
+			if (!name) {
+				snprintf(buf, sizeof(buf), "id=%u", ev->id);
+				name = buf;
+			}
+			out_chrome_event(&first, "i", TID_BOOTSTAGE, name,
+					 ev->time_us);
+			printf(",\"s\":\"g\",\"args\":{\"id\":%u,\"error\":%d}}",
+			       ev->id, !!(ev->flags & TRACE_EVF_ERROR));
+			break;
+
+		case TRACE_EV_STAGE_END:
+			start = find_start(ev);
+			if (!start)
+				break;
+			name = find_event_name(TRACE_EV_MARK, ev->id);
+			if (!name) {
+				snprintf(buf, sizeof(buf), "id=%u", ev->id);
+				name = buf;
+			}
+			out_chrome_event(&first, "X", TID_BOOTSTAGE, name,
+					 start->time_us);
+			printf(",\"dur\":%u}", ev->time_us - start->time_us);
+			break;
+
+		case TRACE_EV_FUNC_ENTRY:
+		case TRACE_EV_FUNC_EXIT:
+			func = event_func(ev, &missing_count, &skip_count);
+			if (!func)
+				break;
+			out_chrome_event(&first,
+					 ev->type == TRACE_EV_FUNC_ENTRY ?
+					 "B" : "E", TID_FUNC, func->name,
+					 ev->time_us);
+			printf("}");
+			break;
+
+		case TRACE_EV_BLK_END:
+			start = find_start(ev);
+			if (!start)
+				break;
+			name = find_event_name(TRACE_EV_BLK_START, ev->dev);
+			snprintf(buf, sizeof(buf), "%s %s", name ? name : "blk",
+				 ev->flags & TRACE_EVF_WRITE ? "write" :
+				 "read");
+			out_chrome_event(&first, "X", TID_BLK, buf,
+					 start->time_us);
+			printf(",\"dur\":%u,\"args\":{\"start\":%u,\"blocks\":%u,\"error\":%d}}",
+			       ev->time_us - start->time_us, start->id,
+			       start->arg, !!(ev->flags & TRACE_EVF_ERROR));
+			break;
+
+		case TRACE_EV_NET_END:
+			start = find_start(ev);
+			if (!start)
+				break;
+			if (ev->id < sizeof(proto_name) / sizeof(proto_name[0]))
+				name = proto_name[ev->id];
+			else
+				name = "net";
+			out_chrome_event(&first, "X", TID_NET, name,
+					 start->time_us);
+			printf(",\"dur\":%u,\"args\":{\"bytes\":%u,\"error\":%d}}",
+			       ev->time_us - start->time_us, ev->arg,
+			       !!(ev->flags & TRACE_EVF_ERROR));
+			break;
+		}
+	}
+	printf("\n]}\n");
+	info("chrome: %d functions not found, %d excluded\n", missing_count,
+	     skip_count);
+
+	return 0;
+}
+
+/* Time spent with a particular call stack */
+struct folded_stack {
+	char *stack;
+	unsigned long time_us;
+};
+
+static int h_cmp_stack(const void *v1, const void *v2)
+{
+	const struct folded_stack *s1 = v1, *s2 = v2;
+
+	return strcmp(s1->stack, s2->stack);
+}
+
+/* Join the names of the functions in a stack with ';' */
+static char *join_stack(struct func_info **stack, int depth)
+{
+	size_t len = 1;
+	char *str, *p;
+	int i;
+
+	for (i = 0; i < depth; i++)
+		len += strlen(stack[i]->name) + 1;
+	str = malloc(len);
+	if (!str)
+		return NULL;
+	for (i = 0, p = str; i < depth; i++)
+		p += sprintf(p, "%s%s", i ? ";" : "", stack[i]->name);
+	*p = '\0';
+
+	return str;
+}
+
+/*
+ * Folded stacks, one line per call stack with the time spent in its leaf
+ * function in microseconds, as read by flamegraph.pl from
+ * https://github.com/brendangregg/FlameGraph
+ */
+static int make_folded(void)
+{
+	int missing_count = 0, skip_count = 0;
+	struct folded_stack *folded = NULL;
+	struct func_info **stack = NULL;
+	int depth = 0, max_depth = 0;
+	struct trace_output_event *ev;
+	int count = 0, alloced = 0;
+	struct func_info *func;
+	uint32_t last = 0;
+	int i, j;
+
+	if (add_call_events())
+		return -1;
+
+	for (i = 0, ev = event_list; i < event_count; i++, ev++) {
+		if (ev->type != TRACE_EV_FUNC_ENTRY &&
+		    ev->type != TRACE_EV_FUNC_EXIT)
+			continue;
+
+		/* Charge the time since the last call or return */
+		if (depth && ev->time_us != last) {
+			if (count == alloced) {
+				alloced += 4096;
+				folded = realloc(folded,
+						 alloced * sizeof(*folded));
+				if (!folded) {
+					error("Cannot allocate stacks\n");
+					return -1;
+				}
+			}
+			folded[count].stack = join_stack(stack, depth);
+			if (!folded[count].stack) {
+				error("Cannot allocate stack\n");
+				return -1;
+			}
+			folded[count++].time_us = ev->time_us - last;
+		}
+		last = ev->time_us;
+
+		func = event_func(ev, &missing_count, &skip_count);
+		if (!func)
+			continue;
+		if (ev->type == TRACE_EV_FUNC_ENTRY) {
+			if (depth == max_depth) {
+				max_depth += 64;
+				stack = realloc(stack,
+						max_depth * sizeof(*stack));
+				if (!stack) {
+					error("Cannot allocate stack\n");
+					return -1;
+				}
+			}
+			stack[depth++] = func;
+		} else {
+			/* Calls may be missing if the trace was too deep */
+			for (j = depth - 1; j >= 0 && stack[j] != func; j--)
+				;
+			if (j >= 0)
+				depth = j;
+		}
+	}
+
+	qsort(folded, count, sizeof(*folded), h_cmp_stack);
+	for (i = 0; i < count; i = j) {
+		unsigned long time_us = 0;
+
+		for (j = i; j < count &&
+		     !strcmp(folded[i].stack, folded[j].stack); j++)
+			time_us += folded[j].time_us;
+		printf("%s %lu\n", folded[i].stack, time_us);
+	}
+	for (i = 0; i < count; i++)
+		free(folded[i].stack);
+	free(folded);
+	free(stack);
+	info("folded: %d functions not found, %d excluded\n", missing_count,
+	     skip_count);
+
+	return 0;
+}
+
 static int prof_tool(int argc, char *const argv[],
 		     const char *prof_fname, const char *map_fname,
 		     const char *trace_config_fname)
@@ -552,6 +981,10 @@ static int prof_tool(int argc, char *const argv[],
 
 		if (0 == strcmp(cmd, "dump-ftrace"))
 			err = make_ftrace();
+		else if (0 == strcmp(cmd, "dump-chrome"))
+			err = make_chrome();
+		else if (0 == strcmp(cmd, "dump-folded"))
+			err = make_folded();
 		else
 			warn("Unknown command '%s'\n", cmd);
 	}